@@ -27,6 +27,7 @@
 #endif
 
 #if defined(CONF_FAMILY_UNIX)
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/utsname.h>
@@ -113,6 +114,21 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+typedef struct
+{
+	int num;
+	NETBATCHSTATS stats;
+	int socks[VLEN];
+	sockaddr_storage addrs[VLEN];
+	socklen_t addrlens[VLEN];
+	int sizes[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+#if defined(CONF_PLATFORM_LINUX)
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+#endif
+} NETSOCKET_SEND_QUEUE;
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -122,6 +138,9 @@ struct NETSOCKET_INTERNAL
 	int web_ipv6sock;
 
 	NETSOCKET_BUFFER buffer;
+	// only allocated once batching was used, queueing while `batching` is set
+	NETSOCKET_SEND_QUEUE *send_queue;
+	bool batching;
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1, -1};
 
@@ -437,6 +456,38 @@ int io_sync(IOHANDLE io)
 #endif
 }
 
+const void *io_map(IOHANDLE io, int64_t *size)
+{
+	*size = io_length(io);
+	if(*size <= 0)
+	{
+		return nullptr;
+	}
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping = CreateFileMappingW((HANDLE)_get_osfhandle(_fileno((FILE *)io)), nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		return nullptr;
+	}
+	// the view keeps the mapping alive
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	return data;
+#else
+	void *data = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fileno((FILE *)io), 0);
+	return data == MAP_FAILED ? nullptr : data;
+#endif
+}
+
+void io_unmap(const void *data, int64_t size)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<void *>(data), size);
+#endif
+}
+
 int io_error(IOHANDLE io)
 {
 	return ferror((FILE *)io);
@@ -1579,6 +1630,7 @@ static void priv_net_close_all_sockets(NETSOCKET sock)
 	}
 #endif
 
+	free(sock->send_queue);
 	free(sock);
 }
 
@@ -1781,9 +1833,99 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+static void net_udp_queue_flush(NETSOCKET_SEND_QUEUE *queue)
+{
+	int i = 0;
+	while(i < queue->num)
+	{
+#if defined(CONF_PLATFORM_LINUX)
+		// sendmmsg takes a single socket, send the run of packets for the same one together
+		int end = i + 1;
+		while(end < queue->num && queue->socks[end] == queue->socks[i])
+			end++;
+		for(int j = i; j < end; j++)
+		{
+			// the queue isn't zeroed, no control data or flags must be passed on
+			mem_zero(&queue->msgs[j], sizeof(queue->msgs[j]));
+			queue->iovecs[j].iov_base = queue->bufs[j];
+			queue->iovecs[j].iov_len = queue->sizes[j];
+			queue->msgs[j].msg_hdr.msg_name = &queue->addrs[j];
+			queue->msgs[j].msg_hdr.msg_namelen = queue->addrlens[j];
+			queue->msgs[j].msg_hdr.msg_iov = &queue->iovecs[j];
+			queue->msgs[j].msg_hdr.msg_iovlen = 1;
+		}
+		while(i < end)
+		{
+			int sent = sendmmsg(queue->socks[i], &queue->msgs[i], end - i, 0);
+			queue->stats.syscalls++;
+			if(sent <= 0)
+			{
+				// drop the packet that failed, like a failing sendto would
+				queue->stats.failed++;
+				i++;
+			}
+			else
+			{
+				i += sent;
+			}
+		}
+#else
+		if(sendto(queue->socks[i], queue->bufs[i], queue->sizes[i], 0, (sockaddr *)&queue->addrs[i], queue->addrlens[i]) < 0)
+			queue->stats.failed++;
+		queue->stats.syscalls++;
+		i++;
+#endif
+	}
+	queue->num = 0;
+}
+
+static void net_udp_queue_add(NETSOCKET_SEND_QUEUE *queue, int socket, const void *sa, socklen_t sa_len, const void *data, int size)
+{
+	if(queue->num == VLEN)
+		net_udp_queue_flush(queue);
+	const int i = queue->num++;
+	queue->socks[i] = socket;
+	mem_copy(&queue->addrs[i], sa, sa_len);
+	queue->addrlens[i] = sa_len;
+	mem_copy(queue->bufs[i], data, size);
+	queue->sizes[i] = size;
+	queue->stats.packets++;
+	queue->stats.bytes += size;
+}
+
+void net_udp_batch_begin(NETSOCKET sock)
+{
+	if(!sock->send_queue)
+	{
+		sock->send_queue = (NETSOCKET_SEND_QUEUE *)malloc(sizeof(*sock->send_queue));
+		// without a queue the packets are sent right away
+		if(!sock->send_queue)
+			return;
+		sock->send_queue->num = 0;
+	}
+	if(!sock->batching)
+		mem_zero(&sock->send_queue->stats, sizeof(sock->send_queue->stats));
+	sock->batching = true;
+}
+
+void net_udp_batch_flush(NETSOCKET sock, NETBATCHSTATS *stats)
+{
+	if(!sock->send_queue)
+	{
+		if(stats)
+			mem_zero(stats, sizeof(*stats));
+		return;
+	}
+	net_udp_queue_flush(sock->send_queue);
+	if(stats)
+		*stats = sock->send_queue->stats;
+	sock->batching = false;
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
+	const bool queue = sock->batching && !(addr->type & NETTYPE_LINK_BROADCAST) && size <= PACKETSIZE;
 
 	if(addr->type & NETTYPE_IPV4)
 	{
@@ -1802,7 +1944,15 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in(addr, &sa);
 			}
 
-			d = sendto(sock->ipv4sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+			if(queue)
+			{
+				net_udp_queue_add(sock->send_queue, sock->ipv4sock, &sa, sizeof(sa), data, size);
+				d = size;
+			}
+			else
+			{
+				d = sendto(sock->ipv4sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+			}
 		}
 		else
 		{
@@ -1850,7 +2000,15 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 				netaddr_to_sockaddr_in6(addr, &sa);
 			}
 
-			d = sendto(sock->ipv6sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+			if(queue)
+			{
+				net_udp_queue_add(sock->send_queue, sock->ipv6sock, &sa, sizeof(sa), data, size);
+				d = size;
+			}
+			else
+			{
+				d = sendto(sock->ipv6sock, (const char *)data, size, 0, (sockaddr *)&sa, sizeof(sa));
+			}
 		}
 		else
 		{
@@ -2028,6 +2186,8 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 void net_udp_close(NETSOCKET sock)
 {
+	if(sock->batching)
+		net_udp_batch_flush(sock, nullptr);
 	priv_net_close_all_sockets(sock);
 }
 
@@ -421,6 +421,32 @@ int io_flush(IOHANDLE io);
  */
 int io_sync(IOHANDLE io);
 
+/**
+ * Maps a whole file into memory for reading. The pages are shared with the
+ * operating system's file cache and other processes mapping the same file.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param size Receives the size of the file.
+ *
+ * @return Pointer to the mapped memory, `nullptr` on failure or for empty files.
+ *
+ * @remark The file must not be modified or truncated while it is mapped.
+ * @remark The memory must be unmapped with @link io_unmap @endlink.
+ */
+const void *io_map(IOHANDLE io, int64_t *size);
+
+/**
+ * Unmaps memory mapped with @link io_map @endlink.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Pointer returned by @link io_map @endlink.
+ * @param size Size returned by @link io_map @endlink.
+ */
+void io_unmap(const void *data, int64_t size);
+
 /**
  * Checks whether an error occurred during I/O with the file.
  *
@@ -1041,6 +1067,35 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
  */
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data);
 
+/**
+ * Starts queueing the packets sent with `net_udp_send` on this socket instead of
+ * sending each of them with its own system call.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @remark Broadcasts and websocket packets are still sent right away.
+ * @remark The queue is flushed early when it runs full.
+ * @remark If the queue can't be allocated, packets are sent right away as well.
+ * @see net_udp_batch_flush
+ */
+void net_udp_batch_begin(NETSOCKET sock);
+
+/**
+ * Sends all packets queued since `net_udp_batch_begin` and stops queueing.
+ *
+ * On Linux, consecutive packets for the same underlying socket are sent with a
+ * single `sendmmsg` call, other platforms send them one by one.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ * @param stats Optional pointer that receives statistics about the batch, including
+ *        early flushes. May be `nullptr`.
+ */
+void net_udp_batch_flush(NETSOCKET sock, NETBATCHSTATS *stats);
+
 /**
  * Closes an UDP socket.
  *
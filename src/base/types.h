@@ -96,6 +96,20 @@ typedef struct NETSTATS
 	uint64_t recv_bytes;
 } NETSTATS;
 
+/**
+ * Statistics about the packets queued on a socket between
+ * `net_udp_batch_begin` and `net_udp_batch_flush`.
+ *
+ * @ingroup Network-UDP
+ */
+typedef struct NETBATCHSTATS
+{
+	int packets;
+	int bytes;
+	int syscalls;
+	int failed;
+} NETBATCHSTATS;
+
 #if defined(CONF_FAMILY_WINDOWS)
 /**
  * A handle for a process.
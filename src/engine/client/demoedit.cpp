@@ -23,5 +23,8 @@ void CDemoEdit::Run()
 	m_Success = m_DemoEditor.Slice(m_aDemo, m_aDst, m_StartTick, m_EndTick, nullptr, nullptr);
 	// We remove the temporary demo file if slicing is successful
 	if(m_Success)
+	{
 		m_pStorage->RemoveFile(m_aDemo, IStorage::TYPE_SAVE);
+		RemoveDemoIndex(m_pStorage, m_aDemo, IStorage::TYPE_SAVE);
+	}
 }
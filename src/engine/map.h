@@ -36,7 +36,17 @@ class IEngineMap : public IMap
 {
 	MACRO_INTERFACE("enginemap")
 public:
-	[[nodiscard]] virtual bool Load(const char *pMapName) = 0;
+	// A memory mapped map file is read straight from the file cache, see
+	// `MappedData`. The file must not be modified while it's loaded.
+	[[nodiscard]] virtual bool Load(const char *pMapName, bool MemoryMap = false) = 0;
+	// Loads a map next to the current one and unpacks the data the game
+	// needs. May be called from another thread as long as only one
+	// preparation runs at a time and `LoadPrepared` isn't called meanwhile.
+	[[nodiscard]] virtual bool Prepare(const char *pMapName, bool MemoryMap = false) = 0;
+	// Replaces the current map with the prepared one if that was prepared
+	// from `pMapName` and the file didn't change since. The prepared map is
+	// dropped either way.
+	[[nodiscard]] virtual bool LoadPrepared(const char *pMapName) = 0;
 	virtual void Unload() = 0;
 	virtual bool IsLoaded() const = 0;
 	virtual IOHANDLE File() const = 0;
@@ -44,6 +54,8 @@ public:
 	virtual SHA256_DIGEST Sha256() const = 0;
 	virtual unsigned Crc() const = 0;
 	virtual int MapSize() const = 0;
+	// The whole map file if it was memory mapped, `nullptr` otherwise.
+	virtual const void *MappedData() const = 0;
 };
 
 extern IEngineMap *CreateEngineMap();
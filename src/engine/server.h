@@ -49,6 +49,23 @@ public:
 		const CUuid *m_pConnectionId;
 	};
 
+	/*
+		Structure: CInputStats
+			How well the inputs of a client arrived since it joined or the map changed.
+	*/
+	struct CInputStats
+	{
+		int m_NumInputs;
+		// arrived after their tick, applied in the next one
+		int m_NumLate;
+		// too far ahead to be stored, dropped
+		int m_NumTooEarly;
+		// for a tick that already had an input, dropped
+		int m_NumDuplicate;
+		// ticks without an input
+		int m_NumMissing;
+	};
+
 	int Tick() const { return m_CurrentGameTick; }
 	int TickSpeed() const { return SERVER_TICK_SPEED; }
 
@@ -314,6 +331,9 @@ public:
 
 	virtual void OnTick() = 0;
 
+	// Called once before snapshots are created for the current tick.
+	virtual void OnPreSnap() = 0;
+
 	// Snap for a specific client.
 	//
 	// GlobalSnap is true when sending snapshots to all clients,
@@ -381,6 +401,7 @@ public:
 	virtual void TeehistorianRecordPlayerRejoin(int ClientId) = 0;
 	virtual void TeehistorianRecordPlayerName(int ClientId, const char *pName) = 0;
 	virtual void TeehistorianRecordPlayerFinish(int ClientId, int TimeTicks) = 0;
+	virtual void TeehistorianRecordInputStats(int ClientId, const IServer::CInputStats &Stats) = 0;
 	virtual void TeehistorianRecordTeamFinish(int TeamId, int TimeTicks) = 0;
 
 	virtual void FillAntibot(CAntibotRoundData *pData) = 0;
@@ -2,6 +2,7 @@
 
 #include "connection.h"
 
+#include <base/math.h>
 #include <base/system.h>
 
 #include <engine/console.h>
@@ -9,8 +10,12 @@
 
 #include <chrono>
 #include <cstring>
+#include <deque>
 #include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -67,6 +72,8 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	// when the query was handed to the pool, for the latency statistics
+	int64_t m_EnqueueTime = 0;
 };
 
 CSqlExecData::CSqlExecData(
@@ -120,25 +127,224 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
+// growable queue of queries, `nullptr` tells the consumer to stop
+class CSqlQueue
+{
+public:
+	// returns the number of queries in the queue afterwards
+	int Push(std::unique_ptr<CSqlExecData> pData)
+	{
+		int Size;
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+			m_vpQueries.push_back(std::move(pData));
+			Size = m_vpQueries.size();
+		}
+		m_NumQueries.Signal();
+		return Size;
+	}
+
+	// blocks until there is a query
+	std::unique_ptr<CSqlExecData> Pop()
+	{
+		m_NumQueries.Wait();
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		std::unique_ptr<CSqlExecData> pData = std::move(m_vpQueries.front());
+		m_vpQueries.pop_front();
+		return pData;
+	}
+
+	int Size() { return m_NumQueries.GetApproximateValue(); }
+
+private:
+	CSemaphore m_NumQueries;
+	std::mutex m_Mutex;
+	std::deque<std::unique_ptr<CSqlExecData>> m_vpQueries;
+};
+
+// latencies of one kind of query, in power of two buckets of milliseconds
+struct CSqlQueryStats
+{
+	enum
+	{
+		// [0, 1ms), [1ms, 2ms), [2ms, 4ms), ..., [8192ms, inf)
+		NUM_BUCKETS = 15,
+	};
+
+	int64_t m_Count = 0;
+	int64_t m_Failed = 0;
+	int64_t m_MaxWait = 0;
+	int64_t m_MaxExec = 0;
+	int64_t m_aWait[NUM_BUCKETS] = {};
+	int64_t m_aExec[NUM_BUCKETS] = {};
+
+	static int Bucket(int64_t Duration)
+	{
+		int Bucket = 0;
+		for(int64_t Ms = Duration * 1000 / time_freq(); Ms > 0 && Bucket < NUM_BUCKETS - 1; Ms /= 2)
+			Bucket++;
+		return Bucket;
+	}
+
+	// upper bound of the bucket that holds the given percentile, -1 for the last bucket
+	static int PercentileMs(const int64_t *pBuckets, int64_t Count, int Percent)
+	{
+		int64_t Seen = 0;
+		for(int i = 0; i < NUM_BUCKETS - 1; i++)
+		{
+			Seen += pBuckets[i];
+			if(Seen * 100 >= Count * Percent)
+				return 1 << i;
+		}
+		return -1;
+	}
+};
+
+struct CDbConnectionPool::CSharedData
+{
+	// Used as signal that shutdown is in progress from main thread to
+	// speed up the queries by discarding read queries and writing to
+	// the sqlite file instead of the remote mysql server.
+	std::atomic_bool m_Shutdown{false};
+	// Threads that did not finish their queue yet, the main thread
+	// waits for this to reach zero on shutdown.
+	std::atomic_int m_NumRunning{0};
+
+	// Writes go first to the backup thread, which passes them on to
+	// the worker thread in the same order.
+	CSqlQueue m_BackupQueue;
+	CSqlQueue m_WriteQueue;
+	// Reads are taken by whichever read worker is free.
+	CSqlQueue m_ReadQueue;
+
+	// The read databases, each read worker opens its own connections
+	// to them. Entries are only ever appended.
+	std::mutex m_ReadDatabasesMutex;
+	std::vector<std::unique_ptr<CSqlExecData>> m_vpReadDatabases;
+
+	// Setting up a sqlite connection creates the tables, only let one
+	// connection at a time do that as sqlite doesn't wait for locks.
+	std::mutex m_SqliteSetupMutex;
+
+	std::mutex m_StatsMutex;
+	std::map<std::string, CSqlQueryStats> m_QueryStats;
+
+	void RecordQuery(const CSqlExecData *pData, int64_t Start, bool Success)
+	{
+		const int64_t End = time_get_impl();
+		const int64_t Wait = Start - pData->m_EnqueueTime;
+		const int64_t Exec = End - Start;
+		std::lock_guard<std::mutex> Lock(m_StatsMutex);
+		CSqlQueryStats &Stats = m_QueryStats[pData->m_pName];
+		Stats.m_Count++;
+		Stats.m_Failed += !Success;
+		Stats.m_MaxWait = maximum(Stats.m_MaxWait, Wait);
+		Stats.m_MaxExec = maximum(Stats.m_MaxExec, Exec);
+		Stats.m_aWait[CSqlQueryStats::Bucket(Wait)]++;
+		Stats.m_aExec[CSqlQueryStats::Bucket(Exec)]++;
+	}
+};
+
+static std::unique_ptr<IDbConnection> CreateSetupConnection(std::mutex *pSqliteSetupMutex, const CSqlExecData *pData)
+{
+	if(pData->m_Mode == CSqlExecData::ADD_MYSQL)
+		return CreateMysqlConnection(pData->m_Ptr.m_Mysql.m_Config);
+
+	auto pSqlite = CreateSqliteConnection(pData->m_Ptr.m_Sqlite.m_FileName, true);
+	std::lock_guard<std::mutex> Lock(*pSqliteSetupMutex);
+	char aError[256] = "unknown error";
+	if(pSqlite->Connect(aError, sizeof(aError)))
+		pSqlite->Disconnect();
+	else
+		dbg_msg("sql", "failed setting up sqlite database: %s", aError);
+	return pSqlite;
+}
+
+void CDbConnectionPool::Enqueue(int Lane, std::unique_ptr<CSqlExecData> pData)
+{
+	pData->m_EnqueueTime = time_get_impl();
+	int Pending;
+	if(Lane == LANE_READ)
+	{
+		Pending = m_pShared->m_ReadQueue.Push(std::move(pData));
+	}
+	else
+	{
+		Pending = m_pShared->m_BackupQueue.Push(std::move(pData));
+		Pending += m_pShared->m_WriteQueue.Size();
+	}
+
+	// report when the database can't keep up, doubling the threshold each time
+	m_aPendingMax[Lane] = maximum(m_aPendingMax[Lane], Pending);
+	if(Pending >= m_aPendingWarn[Lane])
+	{
+		dbg_msg("sql", "%d %s queries pending, the database can't keep up", Pending, Lane == LANE_READ ? "read" : "write");
+		m_aPendingWarn[Lane] *= 2;
+	}
+	else if(Pending < PENDING_WARN_START / 4)
+	{
+		m_aPendingWarn[Lane] = PENDING_WARN_START;
+	}
+}
+
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	Enqueue(LANE_WRITE, std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+}
+
+void CDbConnectionPool::PrintStats(IConsole *pConsole)
+{
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "pending queries: read=%d (max %d) write=%d (max %d)",
+		m_pShared->m_ReadQueue.Size(), m_aPendingMax[LANE_READ],
+		m_pShared->m_BackupQueue.Size() + m_pShared->m_WriteQueue.Size(), m_aPendingMax[LANE_WRITE]);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+
+	const auto &&FormatPercentile = [](char *pBuf, int BufSize, const int64_t *pBuckets, int64_t Count, int Percent) {
+		int Ms = CSqlQueryStats::PercentileMs(pBuckets, Count, Percent);
+		if(Ms < 0)
+			str_copy(pBuf, "slow", BufSize);
+		else
+			str_format(pBuf, BufSize, "<%dms", Ms);
+	};
+
+	std::lock_guard<std::mutex> Lock(m_pShared->m_StatsMutex);
+	for(const auto &[Name, Stats] : m_pShared->m_QueryStats)
+	{
+		char aaWait[3][16];
+		char aaExec[3][16];
+		const int aPercents[] = {50, 90, 99};
+		for(int i = 0; i < 3; i++)
+		{
+			FormatPercentile(aaWait[i], sizeof(aaWait[i]), Stats.m_aWait, Stats.m_Count, aPercents[i]);
+			FormatPercentile(aaExec[i], sizeof(aaExec[i]), Stats.m_aExec, Stats.m_Count, aPercents[i]);
+		}
+		str_format(aBuf, sizeof(aBuf), "%s: count=%d failed=%d wait p50/p90/p99=%s/%s/%s max=%dms exec p50/p90/p99=%s/%s/%s max=%dms",
+			Name.c_str(), (int)Stats.m_Count, (int)Stats.m_Failed,
+			aaWait[0], aaWait[1], aaWait[2], (int)(Stats.m_MaxWait * 1000 / time_freq()),
+			aaExec[0], aaExec[1], aaExec[2], (int)(Stats.m_MaxExec * 1000 / time_freq()));
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	}
 }
 
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+	{
+		std::lock_guard<std::mutex> Lock(m_pShared->m_ReadDatabasesMutex);
+		m_pShared->m_vpReadDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
+	}
+	Enqueue(LANE_WRITE, std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
 }
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+	{
+		std::lock_guard<std::mutex> Lock(m_pShared->m_ReadDatabasesMutex);
+		m_pShared->m_vpReadDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
+	}
+	Enqueue(LANE_WRITE, std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
 }
 
 void CDbConnectionPool::Execute(
@@ -146,9 +352,9 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(m_vpReadThreads.empty() && !m_Shutdown)
+		StartReadWorkers();
+	Enqueue(LANE_READ, std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -156,9 +362,7 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	Enqueue(LANE_WRITE, std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::OnShutdown()
@@ -167,9 +371,11 @@ void CDbConnectionPool::OnShutdown()
 		return;
 	m_Shutdown = true;
 	m_pShared->m_Shutdown.store(true);
-	m_pShared->m_NumBackup.Signal();
+	m_pShared->m_BackupQueue.Push(nullptr);
+	for(size_t i = 0; i < m_vpReadThreads.size(); i++)
+		m_pShared->m_ReadQueue.Push(nullptr);
 	int i = 0;
-	while(m_pShared->m_Shutdown.load())
+	while(m_pShared->m_NumRunning.load() > 0)
 	{
 		// print a log about every two seconds
 		if(i % 20 == 0 && i > 0)
@@ -182,7 +388,7 @@ void CDbConnectionPool::OnShutdown()
 }
 
 // The backup worker thread looks at write queries and stores them
-// in the sqlite database (WRITE_BACKUP). It skips over read queries.
+// in the sqlite database (WRITE_BACKUP). It skips over other queries.
 // After processing the query, it gets passed on to the Worker thread.
 // This is done to not loose ranks when the server shuts down before all
 // queries are executed on the mysql server
@@ -215,35 +421,44 @@ void CBackup::ProcessQueries()
 {
 	for(int JobNum = 0;; JobNum++)
 	{
-		m_pShared->m_NumBackup.Wait();
-		CSqlExecData *pThreadData = m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)].get();
+		std::unique_ptr<CSqlExecData> pThreadData = m_pShared->m_BackupQueue.Pop();
 
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_pShared->m_NumWorker.Signal();
+			m_pShared->m_WriteQueue.Push(nullptr);
+			m_pShared->m_NumRunning--;
 			return;
 		}
 
 		if(pThreadData->m_Mode == CSqlExecData::ADD_SQLITE &&
 			pThreadData->m_Ptr.m_Sqlite.m_Mode == CDbConnectionPool::Mode::WRITE_BACKUP)
 		{
-			m_pWriteBackup = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_FileName, true);
+			m_pWriteBackup = CreateSetupConnection(&m_pShared->m_SqliteSetupMutex, pThreadData.get());
 		}
 		else if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS && m_pWriteBackup.get())
 		{
-			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData, Write::BACKUP_FIRST);
+			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData.get(), Write::BACKUP_FIRST);
 			if(m_DebugSql || !Success)
 				dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", JobNum, pThreadData->m_pName, Success);
 		}
-		m_pShared->m_NumWorker.Signal();
+		m_pShared->m_WriteQueue.Push(std::move(pThreadData));
+	}
+}
+
+static void CompleteQuery(CSqlExecData *pData, bool Success)
+{
+	if(pData->m_pThreadData != nullptr && pData->m_pThreadData->m_pResult != nullptr)
+	{
+		pData->m_pThreadData->m_pResult->m_Success = Success;
+		pData->m_pThreadData->m_pResult->m_Completed.store(true);
 	}
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
-// entry from the backup server after completing it on the write server.
-// static void Worker(void *pUser);
+// The worker thread executes the write queries in order on mysql or
+// sqlite. If we write on a mysql server and have a backup server
+// configured, we'll remove the entry from the backup server after
+// completing it on the write server.
 class CWorker
 {
 public:
@@ -264,7 +479,8 @@ private:
 	//                most one WRITE server. The WRITE server for all DDNet
 	//                Servers must be the same (to counteract double loads).
 	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
+	// The read connections are only used to print them, the read workers
+	// have their own.
 	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
@@ -282,58 +498,29 @@ void CWorker::Start(void *pUser)
 
 void CWorker::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails, write to the backup
+	// database until all requests are handled
 	bool FailMode = false;
 	for(int JobNum = 0;; JobNum++)
 	{
-		if(FailMode && m_pShared->m_NumWorker.GetApproximateValue() == 0)
+		if(FailMode && m_pShared->m_WriteQueue.Size() == 0)
 		{
 			FailMode = false;
 		}
-		m_pShared->m_NumWorker.Wait();
-		auto pThreadData = std::move(m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)]);
+		std::unique_ptr<CSqlExecData> pThreadData = m_pShared->m_WriteQueue.Pop();
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_pShared->m_Shutdown.store(false);
+			m_pShared->m_NumRunning--;
 			return;
 		}
+		const int64_t Start = time_get_impl();
 		bool Success = false;
 		switch(pThreadData->m_Mode)
 		{
 		case CSqlExecData::READ_ACCESS:
-		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
-			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
-				{
-					ReadServer = CurServer;
-					if(m_DebugSql)
-						dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
-			}
-			if(!Success)
-			{
-				FailMode = true;
-			}
-		}
-		break;
+			dbg_assert(false, "read query on the write lane");
+			break;
 		case CSqlExecData::WRITE_ACCESS:
 		{
 			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
@@ -359,41 +546,26 @@ void CWorker::ProcessQueries()
 					dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
 				Success = true;
 			}
+			m_pShared->RecordQuery(pThreadData.get(), Start, Success);
 		}
 		break;
 		case CSqlExecData::ADD_MYSQL:
-		{
-			auto pMysql = CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
-			switch(pThreadData->m_Ptr.m_Mysql.m_Mode)
-			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
-				break;
-			case CDbConnectionPool::Mode::WRITE:
-				m_pWriteConnection = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::WRITE_BACKUP:
-				m_pWriteBackup = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::NUM_MODES:
-				break;
-			}
-			Success = true;
-			break;
-		}
 		case CSqlExecData::ADD_SQLITE:
 		{
-			auto pSqlite = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_FileName, true);
-			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
+			CDbConnectionPool::Mode Mode = pThreadData->m_Mode == CSqlExecData::ADD_MYSQL ?
+							       pThreadData->m_Ptr.m_Mysql.m_Mode :
+							       pThreadData->m_Ptr.m_Sqlite.m_Mode;
+			auto pConnection = CreateSetupConnection(&m_pShared->m_SqliteSetupMutex, pThreadData.get());
+			switch(Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
+				m_vpReadConnections.push_back(std::move(pConnection));
 				break;
 			case CDbConnectionPool::Mode::WRITE:
-				m_pWriteConnection = std::move(pSqlite);
+				m_pWriteConnection = std::move(pConnection);
 				break;
 			case CDbConnectionPool::Mode::WRITE_BACKUP:
-				m_pWriteBackup = std::move(pSqlite);
+				m_pWriteBackup = std::move(pConnection);
 				break;
 			case CDbConnectionPool::Mode::NUM_MODES:
 				break;
@@ -408,11 +580,7 @@ void CWorker::ProcessQueries()
 		}
 		if(!Success)
 			dbg_msg("sql", "[%i] %s failed on all databases", JobNum, pThreadData->m_pName);
-		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
-		{
-			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
-			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
-		}
+		CompleteQuery(pThreadData.get(), Success);
 	}
 }
 
@@ -441,6 +609,102 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// The read workers execute read queries in parallel. Each of them has
+// its own connections to the read databases, so a slow query only
+// blocks one of them.
+class CReadWorker
+{
+public:
+	CReadWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int DebugSql, int Id) :
+		m_DebugSql(DebugSql), m_Id(Id), m_pShared(std::move(pShared)) {}
+	static void Start(void *pUser);
+	void ProcessQueries();
+
+private:
+	// opens connections to read databases registered since the last query
+	void SyncConnections();
+
+	bool m_DebugSql;
+	int m_Id;
+
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+};
+
+/* static */
+void CReadWorker::Start(void *pUser)
+{
+	CReadWorker *pThis = (CReadWorker *)pUser;
+	pThis->ProcessQueries();
+	delete pThis;
+}
+
+void CReadWorker::SyncConnections()
+{
+	std::lock_guard<std::mutex> Lock(m_pShared->m_ReadDatabasesMutex);
+	while(m_vpReadConnections.size() < m_pShared->m_vpReadDatabases.size())
+	{
+		const CSqlExecData *pData = m_pShared->m_vpReadDatabases[m_vpReadConnections.size()].get();
+		m_vpReadConnections.push_back(CreateSetupConnection(&m_pShared->m_SqliteSetupMutex, pData));
+	}
+}
+
+void CReadWorker::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	// enter fail mode when a sql request fails, skip read request during
+	// it until all queued requests are handled
+	bool FailMode = false;
+	for(int JobNum = 0;; JobNum++)
+	{
+		if(FailMode && m_pShared->m_ReadQueue.Size() == 0)
+		{
+			FailMode = false;
+		}
+		std::unique_ptr<CSqlExecData> pThreadData = m_pShared->m_ReadQueue.Pop();
+		if(pThreadData == nullptr)
+		{
+			m_pShared->m_NumRunning--;
+			return;
+		}
+		SyncConnections();
+
+		const int64_t Start = time_get_impl();
+		bool Success = false;
+		for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+		{
+			if(m_pShared->m_Shutdown)
+			{
+				dbg_msg("sql", "[%i:%i] %s dismissed read request during shutdown", m_Id, JobNum, pThreadData->m_pName);
+				break;
+			}
+			if(FailMode)
+			{
+				dbg_msg("sql", "[%i:%i] %s dismissed read request during FailMode", m_Id, JobNum, pThreadData->m_pName);
+				break;
+			}
+			int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
+			if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+			{
+				ReadServer = CurServer;
+				if(m_DebugSql)
+					dbg_msg("sql", "[%i:%i] %s done on read database %d", m_Id, JobNum, pThreadData->m_pName, CurServer);
+				Success = true;
+				break;
+			}
+		}
+		if(!Success)
+		{
+			FailMode = true;
+			dbg_msg("sql", "[%i:%i] %s failed on all databases", m_Id, JobNum, pThreadData->m_pName);
+		}
+		m_pShared->RecordQuery(pThreadData.get(), Start, Success);
+		CompleteQuery(pThreadData.get(), Success);
+	}
+}
+
 /* static */
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
 {
@@ -477,7 +741,10 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 
 CDbConnectionPool::CDbConnectionPool()
 {
+	for(int &PendingWarn : m_aPendingWarn)
+		PendingWarn = PENDING_WARN_START;
 	m_pShared = std::make_shared<CSharedData>();
+	m_pShared->m_NumRunning = 2;
 	m_pWorkerThread = thread_init(CWorker::Start, new CWorker(m_pShared, g_Config.m_DbgSql), "database worker thread");
 	m_pBackupThread = thread_init(CBackup::Start, new CBackup(m_pShared, g_Config.m_DbgSql), "database backup worker thread");
 }
@@ -489,4 +756,19 @@ CDbConnectionPool::~CDbConnectionPool()
 		thread_wait(m_pWorkerThread);
 	if(m_pBackupThread)
 		thread_wait(m_pBackupThread);
+	for(void *pThread : m_vpReadThreads)
+		thread_wait(pThread);
+}
+
+void CDbConnectionPool::StartReadWorkers()
+{
+	// the config isn't loaded yet when the pool is constructed
+	const int NumReadWorkers = g_Config.m_SvSqlReadWorkers;
+	m_pShared->m_NumRunning += NumReadWorkers;
+	for(int i = 0; i < NumReadWorkers; i++)
+	{
+		char aName[32];
+		str_format(aName, sizeof(aName), "database read thread %d", i);
+		m_vpReadThreads.push_back(thread_init(CReadWorker::Start, new CReadWorker(m_pShared, g_Config.m_DbgSql, i), aName));
+	}
 }
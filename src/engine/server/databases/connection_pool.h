@@ -78,6 +78,8 @@ public:
 	};
 
 	void Print(IConsole *pConsole, Mode DatabaseMode);
+	// Prints the latency histograms of all queries and the queue lengths.
+	void PrintStats(IConsole *pConsole);
 
 	void RegisterSqliteDatabase(Mode DatabaseMode, const char FileName[64]);
 	void RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig);
@@ -97,38 +99,37 @@ public:
 
 	friend class CWorker;
 	friend class CBackup;
+	friend class CReadWorker;
 
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
 
-	// Only the main thread accesses this variable. It points to the index,
-	// where the next query is added to the queue.
-	int m_InsertIdx = 0;
+	enum
+	{
+		LANE_READ,
+		LANE_WRITE,
+		NUM_LANES,
+	};
+	enum
+	{
+		PENDING_WARN_START = 64,
+	};
+	void Enqueue(int Lane, std::unique_ptr<struct CSqlExecData> pData);
+	void StartReadWorkers();
 
 	bool m_Shutdown = false;
 
-	struct CSharedData
-	{
-		// Used as signal that shutdown is in progress from main thread to
-		// speed up the queries by discarding read queries and writing to
-		// the sqlite file instead of the remote mysql server.
-		// The worker thread signals the main thread that all queries are
-		// processed by setting this variable to false again.
-		std::atomic_bool m_Shutdown{false};
-		// Queries go first to the backup thread. This semaphore signals about
-		// new queries.
-		CSemaphore m_NumBackup;
-		// When the backup thread processed the query, it signals the main
-		// thread with this semaphore about the new query
-		CSemaphore m_NumWorker;
-
-		// spsc queue with additional backup worker to look at queries first.
-		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
-	};
+	// Only the main thread accesses these. Number of pending queries per
+	// lane at which the next backpressure warning is printed and the highest
+	// number of pending queries seen.
+	int m_aPendingWarn[NUM_LANES];
+	int m_aPendingMax[NUM_LANES] = {};
 
+	struct CSharedData;
 	std::shared_ptr<CSharedData> m_pShared;
 	void *m_pWorkerThread = nullptr;
 	void *m_pBackupThread = nullptr;
+	std::vector<void *> m_vpReadThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
@@ -117,9 +117,8 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 
 		if(NetMatch(&Data, Server()->ClientAddr(i)))
 		{
-			CNetHash NetHash(&Data);
 			char aBuf[256];
-			MakeBanInfo(pBanPool->Find(&Data, &NetHash), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
+			MakeBanInfo(pBanPool->Find(&Data), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
 			Server()->m_NetServer.Drop(i, aBuf);
 		}
 	}
@@ -212,7 +211,7 @@ void CServer::CClient::Reset()
 	// reset input
 	for(auto &Input : m_aInputs)
 		Input.m_GameTick = -1;
-	m_CurrentInput = 0;
+	mem_zero(&m_InputStats, sizeof(m_InputStats));
 	mem_zero(&m_LastPreInput, sizeof(m_LastPreInput));
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
 
@@ -226,13 +225,76 @@ void CServer::CClient::Reset()
 	m_RedirectDropTime = 0;
 }
 
+// Does the slow parts of `CServer::LoadMap` on a worker thread: loading
+// the datafile, unpacking its layers and reading both map versions for
+// downloads. Memory mapped maps are downloaded from the mapping instead.
+class CMapPrepareJob : public IJob
+{
+	IEngineMap *m_pMap;
+	IStorage *m_pStorage;
+	bool m_Sixup;
+	bool m_MemoryMap;
+
+	void Run() override
+	{
+		const int64_t Start = time_get_impl();
+		if(!m_pMap->Prepare(m_aPath, m_MemoryMap))
+			return;
+		if(!m_MemoryMap && !m_pStorage->ReadFile(m_aPath, IStorage::TYPE_ALL, &m_pData, &m_Size))
+			return;
+		m_Success = true;
+
+		if(m_Sixup)
+		{
+			char aSixupPath[IO_MAX_PATH_LENGTH];
+			str_format(aSixupPath, sizeof(aSixupPath), "maps7/%s.map", m_aMapName);
+			if(m_pStorage->ReadFile(aSixupPath, IStorage::TYPE_ALL, &m_pSixupData, &m_SixupSize))
+			{
+				m_SixupSha256 = sha256(m_pSixupData, m_SixupSize);
+				m_SixupCrc = crc32(0, (const unsigned char *)m_pSixupData, m_SixupSize);
+			}
+			else
+			{
+				m_pSixupData = nullptr;
+			}
+		}
+		log_info("server", "prepared map '%s' in %.2f ms", m_aMapName, (time_get_impl() - Start) * 1000.0 / time_freq());
+	}
+
+public:
+	char m_aMapName[IO_MAX_PATH_LENGTH];
+	char m_aPath[IO_MAX_PATH_LENGTH];
+
+	// results, only valid once the job is done
+	bool m_Success = false;
+	void *m_pData = nullptr;
+	unsigned m_Size = 0;
+	void *m_pSixupData = nullptr;
+	unsigned m_SixupSize = 0;
+	SHA256_DIGEST m_SixupSha256;
+	unsigned m_SixupCrc = 0;
+
+	CMapPrepareJob(IEngineMap *pMap, IStorage *pStorage, const char *pMapName, bool Sixup, bool MemoryMap) :
+		m_pMap(pMap), m_pStorage(pStorage), m_Sixup(Sixup), m_MemoryMap(MemoryMap)
+	{
+		str_copy(m_aMapName, pMapName);
+		str_format(m_aPath, sizeof(m_aPath), "maps/%s.map", pMapName);
+	}
+
+	~CMapPrepareJob() override
+	{
+		free(m_pData);
+		free(m_pSixupData);
+	}
+};
+
 CServer::CServer()
 {
 	m_pConfig = &g_Config;
 	for(int i = 0; i < MAX_CLIENTS; i++)
-		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true);
-	m_aDemoRecorder[RECORDER_MANUAL] = CDemoRecorder(&m_SnapshotDelta, false);
-	m_aDemoRecorder[RECORDER_AUTO] = CDemoRecorder(&m_SnapshotDelta, false);
+		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true, &m_DemoWriter);
+	m_aDemoRecorder[RECORDER_MANUAL] = CDemoRecorder(&m_SnapshotDelta, false, &m_DemoWriter);
+	m_aDemoRecorder[RECORDER_AUTO] = CDemoRecorder(&m_SnapshotDelta, false, &m_DemoWriter);
 
 	m_pGameServer = nullptr;
 
@@ -268,6 +330,8 @@ CServer::CServer()
 	m_pConnectionPool = new CDbConnectionPool();
 	m_pRegister = nullptr;
 
+	sphore_init(&m_SnapshotJobsDone);
+
 	m_aErrorShutdownReason[0] = 0;
 
 	Init();
@@ -275,6 +339,13 @@ CServer::CServer()
 
 CServer::~CServer()
 {
+	// the job uses the map
+	while(m_pMapPrepareJob && !m_pMapPrepareJob->Done())
+		thread_yield();
+	m_pMapPrepareJob = nullptr;
+
+	if(m_CurrentMapDataMapped)
+		m_apCurrentMapData[MAP_TYPE_SIX] = nullptr;
 	for(auto &pCurrentMapData : m_apCurrentMapData)
 	{
 		free(pCurrentMapData);
@@ -291,6 +362,10 @@ CServer::~CServer()
 
 	delete m_pRegister;
 	delete m_pConnectionPool;
+
+	if(!m_vpSnapshotJobDeltas.empty())
+		m_SnapshotJobPool.Shutdown();
+	sphore_destroy(&m_SnapshotJobsDone);
 }
 
 const char *CServer::DnsblStateStr(EDnsblState State)
@@ -971,10 +1046,164 @@ void CServer::SendMsgRaw(int ClientId, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
+class CSnapshotJob : public IJob
+{
+	CServer *m_pServer;
+	int m_Share;
+	int m_NumShares;
+	CSnapshotDelta *m_pSnapshotDelta;
+	SEMAPHORE *m_pDone;
+
+	void Run() override
+	{
+		m_pServer->PrepareSnapshots(m_Share, m_NumShares, *m_pSnapshotDelta);
+		sphore_signal(m_pDone);
+	}
+
+public:
+	CSnapshotJob(CServer *pServer, int Share, int NumShares, CSnapshotDelta *pSnapshotDelta, SEMAPHORE *pDone) :
+		m_pServer(pServer), m_Share(Share), m_NumShares(NumShares), m_pSnapshotDelta(pSnapshotDelta), m_pDone(pDone)
+	{
+	}
+};
+
+void CServer::UpdateSnapshotJobPool()
+{
+	const size_t NumThreads = Config()->m_SvSnapshotThreads;
+	if(m_vpSnapshotJobDeltas.size() == NumThreads)
+		return;
+
+	if(!m_vpSnapshotJobDeltas.empty())
+		m_SnapshotJobPool.Shutdown();
+	m_vpSnapshotJobDeltas.clear();
+	if(NumThreads == 0)
+		return;
+
+	// the workers need the same static item sizes as the main delta
+	for(size_t i = 0; i < NumThreads; i++)
+		m_vpSnapshotJobDeltas.push_back(std::make_unique<CSnapshotDelta>(m_SnapshotDelta));
+	m_SnapshotJobPool.Init(NumThreads);
+}
+
+void CServer::PrepareSnapshots(int Share, int NumShares, CSnapshotDelta &SnapshotDelta)
+{
+	for(size_t i = Share; i < m_vSnapshotClients.size(); i += NumShares)
+		PrepareSnapshot(m_vSnapshotClients[i], SnapshotDelta);
+}
+
+void CServer::CreateSnapshotDeltas()
+{
+	// create deltas, possibly on the worker threads, the main thread
+	// handles the first share itself
+	UpdateSnapshotJobPool();
+	const int NumShares = m_vpSnapshotJobDeltas.size() + 1;
+	for(int Share = 1; Share < NumShares; Share++)
+		m_SnapshotJobPool.Add(std::make_shared<CSnapshotJob>(this, Share, NumShares, m_vpSnapshotJobDeltas[Share - 1].get(), &m_SnapshotJobsDone));
+	PrepareSnapshots(0, NumShares, m_SnapshotDelta);
+	for(int Share = 1; Share < NumShares; Share++)
+		sphore_wait(&m_SnapshotJobsDone);
+}
+
+void CServer::PrepareSnapshot(int ClientId, CSnapshotDelta &SnapshotDelta)
+{
+	CClient &Client = m_aClients[ClientId];
+
+	CSnapshotStorage::CHolder *pHolder = Client.m_Snapshots.m_pLast;
+	const CSnapshot *pData = pHolder->m_pSnap;
+	Client.m_SnapshotCrc = pData->Crc();
+
+	// find snapshot that we can perform delta against, its item index was
+	// built when it was sent
+	Client.m_SnapshotDeltaTick = -1;
+	const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
+	const CSnapshotItemIndex *pDeltashotIndex = nullptr;
+	{
+		CSnapshotStorage::CHolder *pDeltaHolder = Client.m_Snapshots.Find(Client.m_LastAckedSnapshot);
+		if(pDeltaHolder)
+		{
+			pDeltashot = pDeltaHolder->m_pSnap;
+			pDeltashotIndex = pDeltaHolder->ItemIndex();
+			Client.m_SnapshotDeltaTick = Client.m_LastAckedSnapshot;
+		}
+		else
+		{
+			// no acked package found, force client to recover rate
+			if(Client.m_SnapRate == CClient::SNAPRATE_FULL)
+				Client.m_SnapRate = CClient::SNAPRATE_RECOVER;
+		}
+	}
+
+	// create delta
+	SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, Client.m_Sixup);
+	SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, Client.m_Sixup);
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	int DeltaSize = SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData, pDeltashotIndex, pHolder->ItemIndex());
+
+	Client.m_SnapshotCompSize = 0;
+	if(DeltaSize)
+	{
+		// compress it
+		Client.m_vSnapshotCompData.resize(CSnapshot::MAX_SIZE);
+		Client.m_SnapshotCompSize = CVariableInt::Compress(aDeltaData, DeltaSize, Client.m_vSnapshotCompData.data(), Client.m_vSnapshotCompData.size());
+	}
+}
+
+void CServer::SendSnapshot(int ClientId)
+{
+	const CClient &Client = m_aClients[ClientId];
+	const int DeltaTick = Client.m_SnapshotDeltaTick;
+	const int Crc = Client.m_SnapshotCrc;
+
+	if(Client.m_SnapshotCompSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		const char *pCompData = Client.m_vSnapshotCompData.data();
+		int NumPackets = (Client.m_SnapshotCompSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = Client.m_SnapshotCompSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+			else
+			{
+				CMsgPacker Msg(NETMSG_SNAP, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+		}
+	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+	}
+}
+
 void CServer::DoSnapshot()
 {
 	bool IsGlobalSnap = Config()->m_SvHighBandwidth || (m_CurrentGameTick % 2) == 0;
 
+	GameServer()->OnPreSnap();
+
 	if(m_aDemoRecorder[RECORDER_MANUAL].IsRecording() || m_aDemoRecorder[RECORDER_AUTO].IsRecording())
 	{
 		// create snapshot for demo recording
@@ -993,6 +1222,7 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	m_vSnapshotClients.clear();
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -1028,8 +1258,6 @@ void CServer::DoSnapshot()
 				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
 			}
 
-			int Crc = pData->Crc();
-
 			// remove old snapshots
 			// keep 3 seconds worth of snapshots
 			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
@@ -1037,75 +1265,15 @@ void CServer::DoSnapshot()
 			// save the snapshot
 			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
 
-			// find snapshot that we can perform delta against
-			int DeltaTick = -1;
-			const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
-			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
-			}
-
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
-
-			if(DeltaSize)
-			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
-
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
-
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
-			}
-			else
-			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
-			}
+			m_vSnapshotClients.push_back(i);
 		}
 	}
 
+	CreateSnapshotDeltas();
+
+	for(int ClientId : m_vSnapshotClients)
+		SendSnapshot(ClientId);
+
 	if(IsGlobalSnap)
 	{
 		GameServer()->OnPostGlobalSnap();
@@ -1123,6 +1291,7 @@ int CServer::ClientRejoinCallback(int ClientId, void *pUser)
 	pThis->m_aClients[ClientId].m_GotDDNetVersionPacket = false;
 	pThis->m_aClients[ClientId].m_DDNetVersionSettled = false;
 
+	pThis->RecordInputStats(ClientId);
 	pThis->m_aClients[ClientId].Reset();
 
 	pThis->GameServer()->TeehistorianRecordPlayerRejoin(ClientId);
@@ -1281,6 +1450,7 @@ int CServer::DelClientCallback(int ClientId, const char *pReason, void *pUser)
 	pThis->m_aClients[ClientId].m_RedirectDropTime = 0;
 	pThis->m_aClients[ClientId].m_HasPersistentData = false;
 
+	pThis->RecordInputStats(ClientId);
 	pThis->GameServer()->TeehistorianRecordPlayerDrop(ClientId, pReason);
 	pThis->Antibot()->OnEngineClientDrop(ClientId, pReason);
 #if defined(CONF_FAMILY_UNIX)
@@ -1289,6 +1459,14 @@ int CServer::DelClientCallback(int ClientId, const char *pReason, void *pUser)
 	return 0;
 }
 
+void CServer::RecordInputStats(int ClientId)
+{
+	const IServer::CInputStats &Stats = m_aClients[ClientId].m_InputStats;
+	if(Stats.m_NumInputs == 0)
+		return;
+	GameServer()->TeehistorianRecordInputStats(ClientId, Stats);
+}
+
 void CServer::SendRconType(int ClientId, bool UsernameReq)
 {
 	CMsgPacker Msg(NETMSG_RCONTYPE, true);
@@ -1875,20 +2053,35 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			m_aClients[ClientId].m_LastInputTick = IntendedTick;
 
-			CClient::CInput *pInput = &m_aClients[ClientId].m_aInputs[m_aClients[ClientId].m_CurrentInput];
+			CClient::CInput Input = {};
+			CClient::CInput *pInput = &Input;
+			Unpacker.GetInts(pInput->m_aData, Size / 4);
+			if(Unpacker.Error())
+			{
+				return;
+			}
 
+			IServer::CInputStats &Stats = m_aClients[ClientId].m_InputStats;
+			Stats.m_NumInputs++;
 			if(IntendedTick <= Tick())
+			{
 				IntendedTick = Tick() + 1;
-
+				Stats.m_NumLate++;
+			}
 			pInput->m_GameTick = IntendedTick;
 
-			for(int i = 0; i < Size / 4; i++)
+			if(IntendedTick - Tick() >= CClient::INPUT_BUFFER_SIZE)
 			{
-				pInput->m_aData[i] = Unpacker.GetInt();
+				// would overwrite the slot of an input that is still pending
+				Stats.m_NumTooEarly++;
 			}
-			if(Unpacker.Error())
+			else
 			{
-				return;
+				CClient::CInput *pSlot = m_aClients[ClientId].InputSlot(IntendedTick);
+				if(pSlot->m_GameTick == IntendedTick)
+					Stats.m_NumDuplicate++;
+				else
+					*pSlot = Input;
 			}
 
 			if(g_Config.m_SvPreInput)
@@ -1933,9 +2126,6 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			GameServer()->OnClientPrepareInput(ClientId, pInput->m_aData);
 			mem_copy(m_aClients[ClientId].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE * sizeof(int));
 
-			m_aClients[ClientId].m_CurrentInput++;
-			m_aClients[ClientId].m_CurrentInput %= 200;
-
 			// call the mod with the fresh input data
 			if(m_aClients[ClientId].m_State == CClient::STATE_INGAME)
 				GameServer()->OnClientDirectInput(ClientId, m_aClients[ClientId].m_LatestInput.m_aData);
@@ -2153,6 +2343,7 @@ bool CServer::RateLimitServerInfoConnless()
 
 void CServer::SendServerInfoConnless(const NETADDR *pAddr, int Token, int Type)
 {
+	m_ServerInfoRequestsServed++;
 	SendServerInfo(pAddr, Token, Type, RateLimitServerInfoConnless());
 }
 
@@ -2191,6 +2382,90 @@ void CServer::CCache::Clear()
 	m_vCache.clear();
 }
 
+const CServer::CServerInfoFragment &CServer::ServerInfoFragment(int ClientId)
+{
+	CServerInfoFragment &Fragment = m_aServerInfoFragments[ClientId];
+	const CClient &Client = m_aClients[ClientId];
+	const bool Player = GameServer()->IsClientPlayer(ClientId);
+	if(Fragment.m_Valid &&
+		str_comp(Fragment.m_aName, ClientName(ClientId)) == 0 &&
+		str_comp(Fragment.m_aClan, ClientClan(ClientId)) == 0 &&
+		Fragment.m_Country == Client.m_Country &&
+		Fragment.m_Score == Client.m_Score &&
+		Fragment.m_Player == Player)
+	{
+		return Fragment;
+	}
+
+	Fragment.m_Valid = true;
+	str_copy(Fragment.m_aName, ClientName(ClientId));
+	str_copy(Fragment.m_aClan, ClientClan(ClientId));
+	Fragment.m_Country = Client.m_Country;
+	Fragment.m_Score = Client.m_Score;
+	Fragment.m_Player = Player;
+	m_ServerInfoFragmentUpdates++;
+
+	CPacker Packer;
+	Packer.Reset();
+	PackServerInfoClient(&Packer, ClientName(ClientId), ClientClan(ClientId), Client.m_Country, Client.m_Score, Player);
+	Fragment.m_vData.assign(Packer.Data(), Packer.Data() + Packer.Size());
+
+	Packer.Reset();
+	PackServerInfoClientSixup(&Packer, ClientName(ClientId), ClientClan(ClientId), Client.m_Country, Client.m_Score, Player);
+	Fragment.m_vDataSixup.assign(Packer.Data(), Packer.Data() + Packer.Size());
+	return Fragment;
+}
+
+void CServer::PackServerInfoClient(CPacker *pPacker, const char *pName, const char *pClan, int Country, std::optional<int> Score, bool Player)
+{
+	char aBuf[16];
+	pPacker->AddString(pName, MAX_NAME_LENGTH); // client name
+	pPacker->AddString(pClan, MAX_CLAN_LENGTH); // client clan
+	str_format(aBuf, sizeof(aBuf), "%d", Country); // client country (ISO 3166-1 numeric)
+	pPacker->AddString(aBuf, 0);
+	int PackedScore;
+	if(Score.has_value())
+	{
+		PackedScore = Score.value();
+		if(PackedScore == 9999)
+			PackedScore = -10000;
+		else if(PackedScore == 0) // 0 time isn't displayed otherwise.
+			PackedScore = -1;
+		else
+			PackedScore = -PackedScore;
+	}
+	else
+	{
+		PackedScore = -9999;
+	}
+	str_format(aBuf, sizeof(aBuf), "%d", PackedScore); // client score
+	pPacker->AddString(aBuf, 0);
+	pPacker->AddString(Player ? "1" : "0", 0); // is player?
+}
+
+void CServer::PackServerInfoClientSixup(CPacker *pPacker, const char *pName, const char *pClan, int Country, std::optional<int> Score, bool Player)
+{
+	pPacker->AddString(pName, MAX_NAME_LENGTH); // client name
+	pPacker->AddString(pClan, MAX_CLAN_LENGTH); // client clan
+	pPacker->AddInt(Country); // client country (ISO 3166-1 numeric)
+	pPacker->AddInt(Score.value_or(-1)); // client score
+	pPacker->AddInt(Player ? 0 : 1); // flag spectator=1, bot=2 (player=0)
+}
+
+int CServer::FormatServerInfoReply(unsigned char *pData, int DataSize, const unsigned char *pHeader, int Token, const void *pChunk, int ChunkSize)
+{
+	char aToken[16];
+	str_format(aToken, sizeof(aToken), "%d", Token);
+	const int TokenSize = str_length(aToken) + 1;
+	const int Size = SERVERBROWSE_SIZE + TokenSize + ChunkSize;
+	if(Size > DataSize)
+		return -1;
+	mem_copy(pData, pHeader, SERVERBROWSE_SIZE);
+	mem_copy(pData + SERVERBROWSE_SIZE, aToken, TokenSize);
+	mem_copy(pData + SERVERBROWSE_SIZE + TokenSize, pChunk, ChunkSize);
+	return Size;
+}
+
 void CServer::CacheServerInfo(CCache *pCache, int Type, bool SendClients)
 {
 	pCache->Clear();
@@ -2355,29 +2630,9 @@ void CServer::CacheServerInfo(CCache *pCache, int Type, bool SendClients)
 
 			int PreviousSize = q.Size();
 
-			q.AddString(ClientName(i), MAX_NAME_LENGTH); // client name
-			q.AddString(ClientClan(i), MAX_CLAN_LENGTH); // client clan
-
-			ADD_INT(q, m_aClients[i].m_Country); // client country (ISO 3166-1 numeric)
-
-			int Score;
-			if(m_aClients[i].m_Score.has_value())
-			{
-				Score = m_aClients[i].m_Score.value();
-				if(Score == 9999)
-					Score = -10000;
-				else if(Score == 0) // 0 time isn't displayed otherwise.
-					Score = -1;
-				else
-					Score = -Score;
-			}
-			else
-			{
-				Score = -9999;
-			}
-
-			ADD_INT(q, Score); // client score
-			ADD_INT(q, GameServer()->IsClientPlayer(i) ? 1 : 0); // is player?
+			// name, clan, country, score and whether it's a player
+			const CServerInfoFragment &Fragment = ServerInfoFragment(i);
+			q.AddRaw(Fragment.m_vData.data(), Fragment.m_vData.size());
 			if(Type == SERVERINFO_EXTENDED)
 				q.AddString("", 0); // extra info, reserved
 
@@ -2468,11 +2723,9 @@ void CServer::CacheServerInfoSixup(CCache *pCache, bool SendClients, int MaxCons
 		{
 			if(m_aClients[i].IncludedInServerInfo())
 			{
-				Packer.AddString(ClientName(i), MAX_NAME_LENGTH); // client name
-				Packer.AddString(ClientClan(i), MAX_CLAN_LENGTH); // client clan
-				Packer.AddInt(m_aClients[i].m_Country); // client country (ISO 3166-1 numeric)
-				Packer.AddInt(m_aClients[i].m_Score.value_or(-1)); // client score
-				Packer.AddInt(GameServer()->IsClientPlayer(i) ? 0 : 1); // flag spectator=1, bot=2 (player=0)
+				// name, clan, country, score and spectator flag
+				const CServerInfoFragment &Fragment = ServerInfoFragment(i);
+				Packer.AddRaw(Fragment.m_vDataSixup.data(), Fragment.m_vDataSixup.size());
 
 				const int MaxPacketSize = NET_MAX_PAYLOAD - 128;
 				if(MaxConsideredClients == MAX_CLIENTS)
@@ -2499,54 +2752,38 @@ void CServer::CacheServerInfoSixup(CCache *pCache, bool SendClients, int MaxCons
 
 void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int Type, bool SendClients)
 {
-	CPacker p;
-	char aBuf[128];
-	p.Reset();
-
-	CCache *pCache = &m_aServerInfoCache[GetCacheIndex(Type, SendClients)];
-
-#define ADD_RAW(p, x) (p).AddRaw(x, sizeof(x))
-#define ADD_INT(p, x) \
-	do \
-	{ \
-		str_format(aBuf, sizeof(aBuf), "%d", x); \
-		(p).AddString(aBuf, 0); \
-	} while(0)
+	const CCache *pCache = &m_aServerInfoCache[GetCacheIndex(Type, SendClients)];
 
+	// the cached chunks don't depend on the token, only the header and the
+	// token itself are put in front of them for each request
 	CNetChunk Packet;
 	Packet.m_ClientId = -1;
 	Packet.m_Address = *pAddr;
 	Packet.m_Flags = NETSENDFLAG_CONNLESS;
 
+	unsigned char aData[NET_MAX_PAYLOAD];
 	for(const auto &Chunk : pCache->m_vCache)
 	{
-		p.Reset();
+		const unsigned char *pHeader = nullptr;
 		if(Type == SERVERINFO_EXTENDED)
-		{
-			if(&Chunk == &pCache->m_vCache.front())
-				p.AddRaw(SERVERBROWSE_INFO_EXTENDED, sizeof(SERVERBROWSE_INFO_EXTENDED));
-			else
-				p.AddRaw(SERVERBROWSE_INFO_EXTENDED_MORE, sizeof(SERVERBROWSE_INFO_EXTENDED_MORE));
-			ADD_INT(p, Token);
-		}
+			pHeader = &Chunk == &pCache->m_vCache.front() ? SERVERBROWSE_INFO_EXTENDED : SERVERBROWSE_INFO_EXTENDED_MORE;
 		else if(Type == SERVERINFO_64_LEGACY)
-		{
-			ADD_RAW(p, SERVERBROWSE_INFO_64_LEGACY);
-			ADD_INT(p, Token);
-		}
+			pHeader = SERVERBROWSE_INFO_64_LEGACY;
 		else if(Type == SERVERINFO_VANILLA || Type == SERVERINFO_INGAME)
-		{
-			ADD_RAW(p, SERVERBROWSE_INFO);
-			ADD_INT(p, Token);
-		}
+			pHeader = SERVERBROWSE_INFO;
 		else
-		{
 			dbg_assert(false, "unknown serverinfo type");
-		}
 
-		p.AddRaw(Chunk.m_vData.data(), Chunk.m_vData.size());
-		Packet.m_pData = p.Data();
-		Packet.m_DataSize = p.Size();
+		const int Size = FormatServerInfoReply(aData, sizeof(aData), pHeader, Token, Chunk.m_vData.data(), Chunk.m_vData.size());
+		if(Size < 0)
+		{
+			// only possible with a token longer than the chunks leave room for,
+			// stop instead of sending a chunk with a part of it missing
+			log_error("server", "server info reply doesn't fit into a packet, token=%d chunk_size=%d", Token, (int)Chunk.m_vData.size());
+			return;
+		}
+		Packet.m_pData = aData;
+		Packet.m_DataSize = Size;
 		m_NetServer.Send(&Packet);
 	}
 }
@@ -2701,6 +2938,7 @@ void CServer::UpdateServerInfo(bool Resend)
 		return;
 
 	UpdateRegisterServerInfo();
+	m_ServerInfoRebuilds++;
 
 	for(int i = 0; i < 3; i++)
 		for(int j = 0; j < 2; j++)
@@ -2782,6 +3020,7 @@ void CServer::PumpNetwork(bool PacketWaiting)
 						Packer.AddRaw(SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
 						Packer.AddInt(SrvBrwsToken);
 						GetServerInfoSixup(&Packer, RateLimitServerInfoConnless());
+						m_ServerInfoRequestsServed++;
 						CNetBase::SendPacketConnlessWithToken7(m_NetServer.Socket(), &Packet.m_Address, Packer.Data(), Packer.Size(), ResponseToken, m_NetServer.GetToken(Packet.m_Address));
 					}
 					else if(Type != -1)
@@ -2847,6 +3086,26 @@ void CServer::ReloadMap()
 	m_SameMapReload = true;
 }
 
+bool CServer::MapPrepared(const char *pMapName)
+{
+	if(m_pMapPrepareJob)
+	{
+		if(!m_pMapPrepareJob->Done())
+			return false;
+		if(str_comp(m_pMapPrepareJob->m_aMapName, pMapName) == 0)
+			return true;
+	}
+
+	char aPath[IO_MAX_PATH_LENGTH];
+	str_format(aPath, sizeof(aPath), "maps/%s.map", pMapName);
+	if(!str_valid_filename(fs_filename(aPath)))
+		return true; // let `LoadMap` report it
+
+	m_pMapPrepareJob = std::make_shared<CMapPrepareJob>(m_pMap, Storage(), pMapName, Config()->m_SvSixup, Config()->m_SvMapMmap);
+	Engine()->AddJob(m_pMapPrepareJob);
+	return false;
+}
+
 int CServer::LoadMap(const char *pMapName)
 {
 	m_MapReload = false;
@@ -2863,7 +3122,18 @@ int CServer::LoadMap(const char *pMapName)
 	{
 		return 0;
 	}
-	if(!m_pMap->Load(aBuf))
+
+	// take the map prepared in the background unless the game changed the
+	// file, e.g. to add map specific settings, or it was modified since.
+	// Otherwise `LoadPrepared` drops the stale map.
+	std::shared_ptr<CMapPrepareJob> pPrepared;
+	if(m_pMapPrepareJob && m_pMapPrepareJob->Done())
+	{
+		if(m_pMap->LoadPrepared(aBuf) && m_pMapPrepareJob->m_Success)
+			pPrepared = m_pMapPrepareJob;
+		m_pMapPrepareJob = nullptr;
+	}
+	if(!pPrepared && !m_pMap->Load(aBuf, Config()->m_SvMapMmap))
 	{
 		return 0;
 	}
@@ -2883,11 +3153,30 @@ int CServer::LoadMap(const char *pMapName)
 	str_copy(m_aCurrentMap, pMapName);
 	m_pCurrentMapName = fs_filename(m_aCurrentMap);
 
-	// load complete map into memory for download
+	// load complete map into memory for download, memory mapped maps are
+	// sent from the mapping which shares its pages with the file cache
 	{
-		free(m_apCurrentMapData[MAP_TYPE_SIX]);
+		if(!m_CurrentMapDataMapped)
+			free(m_apCurrentMapData[MAP_TYPE_SIX]);
+		m_CurrentMapDataMapped = false;
 		void *pData;
-		Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
+		if(m_pMap->MappedData() != nullptr)
+		{
+			// only ever read
+			pData = const_cast<void *>(m_pMap->MappedData());
+			m_aCurrentMapSize[MAP_TYPE_SIX] = m_pMap->MapSize();
+			m_CurrentMapDataMapped = true;
+		}
+		else if(pPrepared && pPrepared->m_pData)
+		{
+			pData = pPrepared->m_pData;
+			m_aCurrentMapSize[MAP_TYPE_SIX] = pPrepared->m_Size;
+			pPrepared->m_pData = nullptr;
+		}
+		else
+		{
+			Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
+		}
 		m_apCurrentMapData[MAP_TYPE_SIX] = (unsigned char *)pData;
 	}
 
@@ -2908,7 +3197,14 @@ int CServer::LoadMap(const char *pMapName)
 	{
 		str_format(aBuf, sizeof(aBuf), "maps7/%s.map", pMapName);
 		void *pData;
-		if(!Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIXUP]))
+		const bool PreparedSixup = pPrepared && pPrepared->m_pSixupData;
+		if(PreparedSixup)
+		{
+			pData = pPrepared->m_pSixupData;
+			m_aCurrentMapSize[MAP_TYPE_SIXUP] = pPrepared->m_SixupSize;
+			pPrepared->m_pSixupData = nullptr;
+		}
+		if(!PreparedSixup && !Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIXUP]))
 		{
 			Config()->m_SvSixup = 0;
 			if(m_pRegister)
@@ -2923,8 +3219,16 @@ int CServer::LoadMap(const char *pMapName)
 			free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
 			m_apCurrentMapData[MAP_TYPE_SIXUP] = (unsigned char *)pData;
 
-			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
-			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+			if(PreparedSixup)
+			{
+				m_aCurrentMapSha256[MAP_TYPE_SIXUP] = pPrepared->m_SixupSha256;
+				m_aCurrentMapCrc[MAP_TYPE_SIXUP] = pPrepared->m_SixupCrc;
+			}
+			else
+			{
+				m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+				m_aCurrentMapCrc[MAP_TYPE_SIXUP] = crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+			}
 			sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIXUP], aSha256, sizeof(aSha256));
 			str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", aBufMsg);
@@ -2992,10 +3296,10 @@ void CServer::UpdateDebugDummies(bool ForceDisconnect)
 		{
 			CNetObj_PlayerInput Input = {0};
 			Input.m_Direction = (ClientId & 1) ? -1 : 1;
-			Client.m_aInputs[0].m_GameTick = Tick() + 1;
-			mem_copy(Client.m_aInputs[0].m_aData, &Input, minimum(sizeof(Input), sizeof(Client.m_aInputs[0].m_aData)));
-			Client.m_LatestInput = Client.m_aInputs[0];
-			Client.m_CurrentInput = 0;
+			CClient::CInput *pSlot = Client.InputSlot(Tick() + 1);
+			pSlot->m_GameTick = Tick() + 1;
+			mem_copy(pSlot->m_aData, &Input, minimum(sizeof(Input), sizeof(pSlot->m_aData)));
+			Client.m_LatestInput = *pSlot;
 		}
 	}
 
@@ -3084,7 +3388,6 @@ int CServer::Run()
 		return -1;
 	}
 
-	m_pEngine = Kernel()->RequestInterface<IEngine>();
 	m_pRegister = CreateRegister(&g_Config, m_pConsole, m_pEngine, &m_Http, g_Config.m_SvRegisterPort > 0 ? g_Config.m_SvRegisterPort : this->Port(), m_NetServer.GetGlobalToken());
 
 	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
@@ -3134,6 +3437,9 @@ int CServer::Run()
 		UpdateServerInfo();
 		while(m_RunServer < STOPPING)
 		{
+			// everything sent until the next wait goes out in one batch
+			m_NetServer.BeginSendBatch();
+
 			if(NonActive)
 				PumpNetwork(PacketWaiting);
 
@@ -3142,8 +3448,8 @@ int CServer::Run()
 			int64_t LastTime = time_get();
 			int NewTicks = 0;
 
-			// load new map
-			if(m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK) // force reload to make sure the ticks stay within a valid range
+			// load new map, keep ticking while it's prepared in the background
+			if((m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK) && MapPrepared(Config()->m_SvMap)) // force reload to make sure the ticks stay within a valid range
 			{
 				const bool SameMapReload = m_SameMapReload;
 				// load map
@@ -3163,6 +3469,11 @@ int CServer::Run()
 #ifdef CONF_DEBUG
 					UpdateDebugDummies(true);
 #endif
+					for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
+					{
+						if(m_aClients[ClientId].m_State > CClient::STATE_AUTH)
+							RecordInputStats(ClientId);
+					}
 					GameServer()->OnShutdown(m_pPersistentData);
 
 					for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
@@ -3223,18 +3534,8 @@ int CServer::Run()
 				{
 					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick() + 1)
-						{
-							GameServer()->OnClientPredictedEarlyInput(c, Input.m_aData);
-							ClientHadInput = true;
-							break;
-						}
-					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedEarlyInput(c, nullptr);
+					const CClient::CInput *pInput = m_aClients[c].FindInput(Tick() + 1);
+					GameServer()->OnClientPredictedEarlyInput(c, pInput ? pInput->m_aData : nullptr);
 				}
 
 				m_CurrentGameTick++;
@@ -3245,18 +3546,10 @@ int CServer::Run()
 				{
 					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick())
-						{
-							GameServer()->OnClientPredictedInput(c, Input.m_aData);
-							ClientHadInput = true;
-							break;
-						}
-					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedInput(c, nullptr);
+					const CClient::CInput *pInput = m_aClients[c].FindInput(Tick());
+					if(!pInput)
+						m_aClients[c].m_InputStats.m_NumMissing++;
+					GameServer()->OnClientPredictedInput(c, pInput ? pInput->m_aData : nullptr);
 				}
 
 				GameServer()->OnTick();
@@ -3348,6 +3641,8 @@ int CServer::Run()
 			if(!NonActive)
 				PumpNetwork(PacketWaiting);
 
+			m_NetServer.FlushSendBatch();
+
 			NonActive = true;
 			for(const auto &Client : m_aClients)
 			{
@@ -3400,6 +3695,7 @@ int CServer::Run()
 				break;
 			}
 		}
+		m_NetServer.FlushSendBatch();
 	}
 	const char *pDisconnectReason = "Server shutdown";
 	if(m_aShutdownReason[0])
@@ -3497,6 +3793,31 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConInputStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const int OnlyClientId = pResult->NumArguments() == 1 ? pResult->GetVictim() : -1;
+	if(OnlyClientId >= MAX_CLIENTS)
+	{
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "Invalid client id");
+		return;
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pThis->m_aClients[i].m_State == CClient::STATE_EMPTY)
+			continue;
+		if(OnlyClientId >= 0 && i != OnlyClientId)
+			continue;
+
+		const IServer::CInputStats &Stats = pThis->m_aClients[i].m_InputStats;
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "id=%d name='%s' inputs=%d late=%d too_early=%d duplicate=%d missing=%d",
+			i, pThis->m_aClients[i].m_aName, Stats.m_NumInputs, Stats.m_NumLate, Stats.m_NumTooEarly, Stats.m_NumDuplicate, Stats.m_NumMissing);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
 static int GetAuthLevel(const char *pLevel)
 {
 	int Level = -1;
@@ -4012,6 +4333,67 @@ void CServer::ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CServer::ConDumpSqlStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	pSelf->DbPool()->PrintStats(pSelf->Console());
+}
+
+void CServer::ConPrepareMap(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	if(pSelf->m_pMapPrepareJob && !pSelf->m_pMapPrepareJob->Done())
+	{
+		log_info("server", "already preparing map '%s'", pSelf->m_pMapPrepareJob->m_aMapName);
+		return;
+	}
+	pSelf->m_pMapPrepareJob = nullptr;
+	pSelf->MapPrepared(pResult->GetString(0));
+}
+
+void CServer::ConServerInfoStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	const int64_t Now = time_get();
+	const double Seconds = pSelf->m_ServerInfoStatsStart == 0 ? 0.0 : (Now - pSelf->m_ServerInfoStatsStart) / (double)time_freq();
+	log_info("server", "server info since the last call: requests=%d (%.1f/s) rebuilds=%d client_updates=%d over %.1fs",
+		pSelf->m_ServerInfoRequestsServed, Seconds > 0.0 ? pSelf->m_ServerInfoRequestsServed / Seconds : 0.0,
+		pSelf->m_ServerInfoRebuilds, pSelf->m_ServerInfoFragmentUpdates, Seconds);
+	pSelf->m_ServerInfoStatsStart = Now;
+	pSelf->m_ServerInfoRequestsServed = 0;
+	pSelf->m_ServerInfoRebuilds = 0;
+	pSelf->m_ServerInfoFragmentUpdates = 0;
+}
+
+void CServer::ConDumpSnapStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	int64_t NumAllocations = 0;
+	int NumStored = 0;
+	for(const CClient &Client : pSelf->m_aClients)
+	{
+		NumAllocations += Client.m_Snapshots.NumAllocations();
+		for(const CSnapshotStorage::CHolder *pHolder = Client.m_Snapshots.m_pFirst; pHolder; pHolder = pHolder->m_pNext)
+			NumStored++;
+	}
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "stored snapshots=%d allocations=%" PRId64, NumStored, NumAllocations);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConDumpNetStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	const CNetServer::CSendBatchTotals &Totals = pSelf->m_NetServer.SendBatchTotals();
+	const NETBATCHSTATS &Last = pSelf->m_NetServer.LastSendBatch();
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "send batches=%" PRId64 " packets=%" PRId64 " bytes=%" PRId64 " syscalls=%" PRId64 " failed=%" PRId64 " packets per syscall=%.2f",
+		Totals.m_Batches, Totals.m_Packets, Totals.m_Bytes, Totals.m_Syscalls, Totals.m_Failed, Totals.m_Syscalls ? (double)Totals.m_Packets / Totals.m_Syscalls : 0.0);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	str_format(aBuf, sizeof(aBuf), "last batch packets=%d bytes=%d syscalls=%d failed=%d", Last.packets, Last.bytes, Last.syscalls, Last.failed);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
 void CServer::ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pThis = static_cast<CServer *>(pUserData);
@@ -4271,6 +4653,7 @@ void CServer::ConchainConnLoggingServerChange(IConsole::IResult *pResult, void *
 void CServer::RegisterCommands()
 {
 	m_pConsole = Kernel()->RequestInterface<IConsole>();
+	m_pEngine = Kernel()->RequestInterface<IEngine>();
 	m_pGameServer = Kernel()->RequestInterface<IGameServer>();
 	m_pMap = Kernel()->RequestInterface<IEngineMap>();
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
@@ -4281,6 +4664,7 @@ void CServer::RegisterCommands()
 	// register console commands
 	Console()->Register("kick", "i[id] ?r[reason]", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "?r[name]", CFGFLAG_SERVER, ConStatus, this, "List players containing name or all players");
+	Console()->Register("input_stats", "?v[id]", CFGFLAG_SERVER, ConInputStats, this, "Show late, early, duplicate and missing inputs of a player or all players");
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
@@ -4291,9 +4675,14 @@ void CServer::RegisterCommands()
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
 
 	Console()->Register("reload", "", CFGFLAG_SERVER, ConMapReload, this, "Reload the map");
+	Console()->Register("prepare_map", "r[map]", CFGFLAG_SERVER, ConPrepareMap, this, "Load a map in the background so changing to it doesn't stall the server");
 
 	Console()->Register("add_sqlserver", "s['r'|'w'] s[Database] s[Prefix] s[User] s[Password] s[IP] i[Port] ?i[SetUpDatabase ?]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAddSqlServer, this, "add a sqlserver");
 	Console()->Register("dump_sqlservers", "s['r'|'w']", CFGFLAG_SERVER, ConDumpSqlServers, this, "dumps all sqlservers readservers = r, writeservers = w");
+	Console()->Register("dump_sqlstats", "", CFGFLAG_SERVER, ConDumpSqlStats, this, "dumps latencies of sql queries and the number of pending queries");
+	Console()->Register("serverinfo_stats", "", CFGFLAG_SERVER, ConServerInfoStats, this, "Show how many server info requests were answered since the last call");
+	Console()->Register("dump_snapstats", "", CFGFLAG_SERVER, ConDumpSnapStats, this, "dumps the number of stored snapshots and the allocations done to store them");
+	Console()->Register("dump_netstats", "", CFGFLAG_SERVER, ConDumpNetStats, this, "dumps the number of packets, bytes and system calls of the batched sends");
 
 	Console()->Register("auth_add", "s[ident] s[level] r[pw]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAdd, this, "Add a rcon key");
 	Console()->Register("auth_add_p", "s[ident] s[level] s[hash] s[salt]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAddHashed, this, "Add a prehashed rcon key");
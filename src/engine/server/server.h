@@ -16,6 +16,7 @@
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
 #include <engine/shared/http.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
@@ -134,6 +135,13 @@ public:
 			SNAPRATE_RECOVER,
 		};
 
+		enum
+		{
+			// inputs are stored at `GameTick % INPUT_BUFFER_SIZE`, inputs
+			// for ticks further ahead are dropped
+			INPUT_BUFFER_SIZE = 256,
+		};
+
 		class CInput
 		{
 		public:
@@ -153,10 +161,23 @@ public:
 		int m_LastInputTick;
 		CSnapshotStorage m_Snapshots;
 
+		// compressed snapshot delta of the current tick, see `PrepareSnapshot`
+		int m_SnapshotDeltaTick;
+		int m_SnapshotCrc;
+		int m_SnapshotCompSize;
+		std::vector<char> m_vSnapshotCompData;
+
 		CNetMsg_Sv_PreInput m_LastPreInput = {};
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		CInput m_aInputs[INPUT_BUFFER_SIZE];
+		IServer::CInputStats m_InputStats;
+
+		CInput *InputSlot(int GameTick) { return &m_aInputs[GameTick % INPUT_BUFFER_SIZE]; }
+		const CInput *FindInput(int GameTick) const
+		{
+			const CInput *pInput = &m_aInputs[GameTick % INPUT_BUFFER_SIZE];
+			return pInput->m_GameTick == GameTick ? pInput : nullptr;
+		}
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -216,6 +237,13 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// per client snapshot deltas are created by these workers,
+	// each with its own delta state
+	CJobPool m_SnapshotJobPool;
+	std::vector<std::unique_ptr<CSnapshotDelta>> m_vpSnapshotJobDeltas;
+	std::vector<int> m_vSnapshotClients;
+	SEMAPHORE m_SnapshotJobsDone;
 	CSnapIdPool m_IdPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -266,8 +294,15 @@ public:
 	unsigned m_aCurrentMapCrc[NUM_MAP_TYPES];
 	unsigned char *m_apCurrentMapData[NUM_MAP_TYPES];
 	unsigned int m_aCurrentMapSize[NUM_MAP_TYPES];
+	// the six map data is the read-only mapping of the map file, see `sv_map_mmap`
+	bool m_CurrentMapDataMapped = false;
 	char m_aMapDownloadUrl[256];
 
+	// loads and hashes the next map in the background, see `LoadMap`
+	std::shared_ptr<class CMapPrepareJob> m_pMapPrepareJob;
+
+	// must outlive the recorders that write on it
+	CDemoWriter m_DemoWriter;
 	CDemoRecorder m_aDemoRecorder[NUM_RECORDERS];
 	CAuthManager m_AuthManager;
 
@@ -338,6 +373,13 @@ public:
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientId) override;
 
 	void DoSnapshot();
+	void UpdateSnapshotJobPool();
+	// creates the compressed snapshot delta for a client, thread-safe for different clients
+	void PrepareSnapshot(int ClientId, CSnapshotDelta &SnapshotDelta);
+	void PrepareSnapshots(int Share, int NumShares, CSnapshotDelta &SnapshotDelta);
+	// creates the deltas of all clients in `m_vSnapshotClients`
+	void CreateSnapshotDeltas();
+	void SendSnapshot(int ClientId);
 
 	static int NewClientCallback(int ClientId, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientId, void *pUser);
@@ -346,6 +388,8 @@ public:
 	static int ClientRejoinCallback(int ClientId, void *pUser);
 
 	void SendRconType(int ClientId, bool UsernameReq);
+	// records the input counters of the client in the teehistorian
+	void RecordInputStats(int ClientId);
 	void SendCapabilities(int ClientId);
 	void SendMap(int ClientId);
 	void SendMapData(int ClientId, int Chunk);
@@ -404,6 +448,35 @@ public:
 	CCache m_aSixupServerInfoCache[2];
 	bool m_ServerInfoNeedsUpdate;
 
+	// The packed server info entry of a client, only packed again when
+	// the info of that client changes
+	class CServerInfoFragment
+	{
+	public:
+		bool m_Valid = false;
+		char m_aName[MAX_NAME_LENGTH];
+		char m_aClan[MAX_CLAN_LENGTH];
+		int m_Country;
+		std::optional<int> m_Score;
+		bool m_Player;
+
+		std::vector<uint8_t> m_vData;
+		std::vector<uint8_t> m_vDataSixup;
+	};
+	CServerInfoFragment m_aServerInfoFragments[MAX_CLIENTS];
+	const CServerInfoFragment &ServerInfoFragment(int ClientId);
+	static void PackServerInfoClient(CPacker *pPacker, const char *pName, const char *pClan, int Country, std::optional<int> Score, bool Player);
+	static void PackServerInfoClientSixup(CPacker *pPacker, const char *pName, const char *pClan, int Country, std::optional<int> Score, bool Player);
+	// Writes header, token and a cached chunk of a server info reply to
+	// pData, returns the size or -1 if it doesn't fit into DataSize bytes
+	static int FormatServerInfoReply(unsigned char *pData, int DataSize, const unsigned char *pHeader, int Token, const void *pChunk, int ChunkSize);
+
+	// counters for `serverinfo_stats`
+	int64_t m_ServerInfoStatsStart = 0;
+	int m_ServerInfoRequestsServed = 0;
+	int m_ServerInfoRebuilds = 0;
+	int m_ServerInfoFragmentUpdates = 0;
+
 	void FillAntibot(CAntibotRoundData *pData) override;
 
 	void ExpireServerInfo() override;
@@ -422,6 +495,9 @@ public:
 	const char *GetMapName() const override;
 	void ReloadMap() override;
 	int LoadMap(const char *pMapName);
+	// Returns whether `pMapName` was prepared in the background, starts
+	// preparing it otherwise.
+	bool MapPrepared(const char *pMapName);
 
 	void SaveDemo(int ClientId, float Time) override;
 	void StartRecord(int ClientId) override;
@@ -433,6 +509,7 @@ public:
 
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConInputStats(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
@@ -452,6 +529,11 @@ public:
 	// console commands for sqlmasters
 	static void ConAddSqlServer(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpSqlStats(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpSnapStats(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpNetStats(IConsole::IResult *pResult, void *pUserData);
+	static void ConPrepareMap(IConsole::IResult *pResult, void *pUserData);
+	static void ConServerInfoStats(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData);
 	static void ConReloadMaplist(IConsole::IResult *pResult, void *pUserData);
@@ -65,6 +65,123 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 	return pSrc;
 }
 
+// The unchecked variants are used while the buffers are large enough for
+// the largest packed int.
+static inline unsigned char *PackUnchecked(unsigned char *pDst, int i)
+{
+	// most ints in snapshots and messages fit into one byte
+	if((unsigned)i + 64 < 128)
+	{
+		*pDst = i < 0 ? 0x40 | (~i & 0x3F) : i;
+		return pDst + 1;
+	}
+
+	*pDst = 0;
+	if(i < 0)
+	{
+		*pDst |= 0x40;
+		i = ~i;
+	}
+	*pDst |= i & 0x3F;
+	i >>= 6;
+	while(i)
+	{
+		*pDst |= 0x80;
+		pDst++;
+		*pDst = i & 0x7F;
+		i >>= 7;
+	}
+	return pDst + 1;
+}
+
+static inline const unsigned char *UnpackUnchecked(const unsigned char *pSrc, int *pOut)
+{
+	const int Sign = (pSrc[0] >> 6) & 1;
+	int Value = pSrc[0] & 0x3F;
+	int Size = 1;
+	if(pSrc[0] & 0x80)
+	{
+		Value |= (pSrc[1] & 0x7F) << 6;
+		Size = 2;
+		if(pSrc[1] & 0x80)
+		{
+			Value |= (pSrc[2] & 0x7F) << (6 + 7);
+			Size = 3;
+			if(pSrc[2] & 0x80)
+			{
+				Value |= (pSrc[3] & 0x7F) << (6 + 7 + 7);
+				Size = 4;
+				if(pSrc[3] & 0x80)
+				{
+					Value |= (pSrc[4] & 0x0F) << (6 + 7 + 7 + 7);
+					Size = 5;
+				}
+			}
+		}
+	}
+	*pOut = Value ^ -Sign;
+	return pSrc + Size;
+}
+
+enum
+{
+	SINGLE_BYTE_RUN = 8,
+};
+
+// Unpacks a run of single byte ints if the next bytes are all of them.
+static inline bool UnpackSingleByteRun(const unsigned char *pSrc, int *pOut)
+{
+	unsigned char Extended = 0;
+	for(int k = 0; k < SINGLE_BYTE_RUN; k++)
+		Extended |= pSrc[k];
+	if(Extended & 0x80)
+		return false;
+	for(int k = 0; k < SINGLE_BYTE_RUN; k++)
+		pOut[k] = (pSrc[k] & 0x3F) ^ -((pSrc[k] >> 6) & 1);
+	return true;
+}
+
+unsigned char *CVariableInt::PackArray(unsigned char *pDst, const int *pValues, int Num, int DstSize)
+{
+	unsigned char *pDstEnd = pDst + DstSize;
+	int i = 0;
+	for(; i < Num && pDstEnd - pDst >= MAX_BYTES_PACKED; i++)
+	{
+		pDst = PackUnchecked(pDst, pValues[i]);
+	}
+	for(; i < Num; i++)
+	{
+		pDst = Pack(pDst, pValues[i], pDstEnd - pDst);
+		if(!pDst)
+			return nullptr;
+	}
+	return pDst;
+}
+
+const unsigned char *CVariableInt::UnpackArray(const unsigned char *pSrc, int *pValues, int Num, int SrcSize)
+{
+	const unsigned char *pSrcEnd = pSrc + SrcSize;
+	int i = 0;
+	while(i < Num && pSrcEnd - pSrc >= MAX_BYTES_PACKED)
+	{
+		if(Num - i >= SINGLE_BYTE_RUN && pSrcEnd - pSrc >= SINGLE_BYTE_RUN && UnpackSingleByteRun(pSrc, pValues + i))
+		{
+			pSrc += SINGLE_BYTE_RUN;
+			i += SINGLE_BYTE_RUN;
+			continue;
+		}
+		pSrc = UnpackUnchecked(pSrc, pValues + i);
+		i++;
+	}
+	for(; i < Num; i++)
+	{
+		pSrc = Unpack(pSrc, pValues + i, pSrcEnd - pSrc);
+		if(!pSrc)
+			return nullptr;
+	}
+	return pSrc;
+}
+
 long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
 {
 	dbg_assert(DstSize % sizeof(int) == 0, "invalid bounds");
@@ -73,6 +190,19 @@ long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int D
 	const unsigned char *pSrcEnd = pSrc + SrcSize;
 	int *pDst = (int *)pDst_;
 	const int *pDstEnd = pDst + DstSize / sizeof(int); // NOLINT(bugprone-sizeof-expression)
+	// the number of ints isn't known, unpack unchecked while the source
+	// holds a whole int and the destination has room for it
+	while(pSrcEnd - pSrc >= MAX_BYTES_PACKED && pDst < pDstEnd)
+	{
+		if(pDstEnd - pDst >= SINGLE_BYTE_RUN && pSrcEnd - pSrc >= SINGLE_BYTE_RUN && UnpackSingleByteRun(pSrc, pDst))
+		{
+			pSrc += SINGLE_BYTE_RUN;
+			pDst += SINGLE_BYTE_RUN;
+			continue;
+		}
+		pSrc = UnpackUnchecked(pSrc, pDst);
+		pDst++;
+	}
 	while(pSrc < pSrcEnd)
 	{
 		if(pDst >= pDstEnd)
@@ -89,17 +219,11 @@ long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int Dst
 {
 	dbg_assert(SrcSize % sizeof(int) == 0, "invalid bounds");
 
-	const int *pSrc = (int *)pSrc_;
-	unsigned char *pDst = (unsigned char *)pDst_;
-	const unsigned char *pDstEnd = pDst + DstSize;
-	SrcSize /= sizeof(int);
-	while(SrcSize)
-	{
-		pDst = CVariableInt::Pack(pDst, *pSrc, pDstEnd - pDst);
-		if(!pDst)
-			return -1;
-		SrcSize--;
-		pSrc++;
-	}
+	// nothing to pack, the destination may be `nullptr` then
+	if(SrcSize == 0)
+		return 0;
+	unsigned char *pDst = PackArray((unsigned char *)pDst_, (const int *)pSrc_, SrcSize / sizeof(int), DstSize);
+	if(!pDst)
+		return -1;
 	return (long)(pDst - (unsigned char *)pDst_);
 }
@@ -15,6 +15,11 @@ public:
 	static unsigned char *Pack(unsigned char *pDst, int i, int DstSize);
 	static const unsigned char *Unpack(const unsigned char *pSrc, int *pInOut, int SrcSize);
 
+	// Pack or unpack `Num` ints at once, same results as calling `Pack` or
+	// `Unpack` for each of them. Return `nullptr` if the buffer is too small.
+	static unsigned char *PackArray(unsigned char *pDst, const int *pValues, int Num, int DstSize);
+	static const unsigned char *UnpackArray(const unsigned char *pSrc, int *pValues, int Num, int SrcSize);
+
 	static long Compress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
 	static long Decompress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
 };
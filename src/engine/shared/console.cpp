@@ -659,15 +659,55 @@ int CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPossi
 	return Index;
 }
 
+// command names are compared with str_comp_nocase, which only folds ASCII
+static std::string CommandIndexKey(const char *pName)
+{
+	std::string Key(pName);
+	for(char &c : Key)
+	{
+		if(c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+	}
+	return Key;
+}
+
+const std::vector<CConsole::CCommand *> *CConsole::FindCommandBucket(const char *pName) const
+{
+	auto It = m_CommandIndex.find(CommandIndexKey(pName));
+	return It == m_CommandIndex.end() ? nullptr : &It->second;
+}
+
+void CConsole::IndexCommand(CCommand *pCommand)
+{
+	// keep the same order as AddCommandSorted
+	std::vector<CCommand *> &vpBucket = m_CommandIndex[CommandIndexKey(pCommand->m_pName)];
+	auto It = std::find_if(vpBucket.begin(), vpBucket.end(), [pCommand](const CCommand *pOther) {
+		return str_comp(pCommand->m_pName, pOther->m_pName) <= 0;
+	});
+	vpBucket.insert(It, pCommand);
+}
+
+void CConsole::UnindexCommand(CCommand *pCommand)
+{
+	auto It = m_CommandIndex.find(CommandIndexKey(pCommand->m_pName));
+	if(It == m_CommandIndex.end())
+		return;
+	std::vector<CCommand *> &vpBucket = It->second;
+	vpBucket.erase(std::remove(vpBucket.begin(), vpBucket.end(), pCommand), vpBucket.end());
+	if(vpBucket.empty())
+		m_CommandIndex.erase(It);
+}
+
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->Next())
+	const std::vector<CCommand *> *pvpBucket = FindCommandBucket(pName);
+	if(!pvpBucket)
+		return nullptr;
+
+	for(CCommand *pCommand : *pvpBucket)
 	{
 		if(pCommand->m_Flags & FlagMask)
-		{
-			if(str_comp_nocase(pCommand->m_pName, pName) == 0)
-				return pCommand;
-		}
+			return pCommand;
 	}
 
 	return nullptr;
@@ -925,12 +965,11 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	IndexCommand(pCommand);
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
-		if(m_pFirstCommand && m_pFirstCommand->Next())
-			pCommand->SetNext(m_pFirstCommand);
-		else
-			pCommand->SetNext(nullptr);
+		pCommand->SetNext(m_pFirstCommand);
 		m_pFirstCommand = pCommand;
 	}
 	else
@@ -1035,6 +1074,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		UnindexCommand(pRemoved);
 		pRemoved->SetNext(m_pRecycleList);
 		m_pRecycleList = pRemoved;
 	}
@@ -1042,6 +1082,12 @@ void CConsole::DeregisterTemp(const char *pName)
 
 void CConsole::DeregisterTempAll()
 {
+	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->Next())
+	{
+		if(pCommand->m_Temp)
+			UnindexCommand(pCommand);
+	}
+
 	// set non temp as first one
 	for(; m_pFirstCommand && m_pFirstCommand->m_Temp; m_pFirstCommand = m_pFirstCommand->Next())
 		;
@@ -1108,13 +1154,14 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::ICommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->Next())
+	const std::vector<CCommand *> *pvpBucket = FindCommandBucket(pName);
+	if(!pvpBucket)
+		return nullptr;
+
+	for(const CCommand *pCommand : *pvpBucket)
 	{
 		if(pCommand->m_Flags & FlagMask && pCommand->m_Temp == Temp)
-		{
-			if(str_comp_nocase(pCommand->Name(), pName) == 0)
-				return pCommand;
-		}
+			return pCommand;
 	}
 
 	return nullptr;
@@ -9,6 +9,8 @@
 #include <engine/storage.h>
 
 #include <optional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 class CConsole : public IConsole
@@ -51,6 +53,8 @@ class CConsole : public IConsole
 	bool m_StoreCommands;
 	const char *m_apStrokeStr[2];
 	CCommand *m_pFirstCommand;
+	// commands by lower case name, each bucket in command list order
+	std::unordered_map<std::string, std::vector<CCommand *>> m_CommandIndex;
 
 	class CExecFile
 	{
@@ -158,6 +162,9 @@ class CConsole : public IConsole
 
 	void AddCommandSorted(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
+	const std::vector<CCommand *> *FindCommandBucket(const char *pName) const;
+	void IndexCommand(CCommand *pCommand);
+	void UnindexCommand(CCommand *pCommand);
 
 	bool m_Cheated;
 
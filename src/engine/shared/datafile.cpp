@@ -129,6 +129,8 @@ class CDatafile
 {
 public:
 	IOHANDLE m_File;
+	const unsigned char *m_pMapped;
+	int64_t m_MappedSize;
 	unsigned m_FileSize;
 	SHA256_DIGEST m_Sha256;
 	unsigned m_Crc;
@@ -139,6 +141,15 @@ public:
 	int *m_pDataSizes;
 	char *m_pData;
 
+	void Unmap()
+	{
+		if(m_pMapped != nullptr)
+		{
+			io_unmap(m_pMapped, m_MappedSize);
+			m_pMapped = nullptr;
+		}
+	}
+
 	int GetFileDataSize(int Index) const
 	{
 		dbg_assert(Index >= 0 && Index < m_Header.m_NumRawData, "Index invalid: %d", Index);
@@ -213,41 +224,51 @@ public:
 				return nullptr;
 			}
 
-			// read the compressed data
-			void *pCompressedData = malloc(DataSize);
-			if(pCompressedData == nullptr)
-			{
-				log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+			// read the compressed data, mapped files are uncompressed straight from the mapping
+			const void *pCompressedData = nullptr;
+			void *pAllocatedData = nullptr;
+			if(m_pMapped != nullptr)
 			{
-				ActualDataSize = io_read(m_File, pCompressedData, DataSize);
+				pCompressedData = m_pMapped + m_DataStartOffset + m_Info.m_pDataOffsets[Index];
 			}
-			if(DataSize != ActualDataSize)
+			else
 			{
-				log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
-				free(pCompressedData);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
+				pAllocatedData = malloc(DataSize);
+				pCompressedData = pAllocatedData;
+				if(pAllocatedData == nullptr)
+				{
+					log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
+					m_ppDataPtrs[Index] = nullptr;
+					m_pDataSizes[Index] = -1;
+					return nullptr;
+				}
+				unsigned ActualDataSize = 0;
+				if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+				{
+					ActualDataSize = io_read(m_File, pAllocatedData, DataSize);
+				}
+				if(DataSize != ActualDataSize)
+				{
+					log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
+					free(pAllocatedData);
+					m_ppDataPtrs[Index] = nullptr;
+					m_pDataSizes[Index] = -1;
+					return nullptr;
+				}
 			}
 
 			// decompress the data
 			m_ppDataPtrs[Index] = static_cast<char *>(malloc(OriginalUncompressedSize));
 			if(m_ppDataPtrs[Index] == nullptr)
 			{
-				free(pCompressedData);
+				free(pAllocatedData);
 				log_error("datafile", "out of memory. could not allocate memory for uncompressed data. index=%d size=%d", Index, OriginalUncompressedSize);
 				m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
 			unsigned long UncompressedSize = OriginalUncompressedSize;
-			const int Result = uncompress(static_cast<Bytef *>(m_ppDataPtrs[Index]), &UncompressedSize, static_cast<Bytef *>(pCompressedData), DataSize);
-			free(pCompressedData);
+			const int Result = uncompress(static_cast<Bytef *>(m_ppDataPtrs[Index]), &UncompressedSize, static_cast<const Bytef *>(pCompressedData), DataSize);
+			free(pAllocatedData);
 			if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
 			{
 				log_error("datafile", "failed to uncompress data. index=%d result=%d wanted=%d got=%ld", Index, Result, OriginalUncompressedSize, UncompressedSize);
@@ -269,7 +290,12 @@ public:
 				return nullptr;
 			}
 			unsigned ActualDataSize = 0;
-			if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+			if(m_pMapped != nullptr)
+			{
+				mem_copy(m_ppDataPtrs[Index], m_pMapped + m_DataStartOffset + m_Info.m_pDataOffsets[Index], DataSize);
+				ActualDataSize = DataSize;
+			}
+			else if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
 			{
 				ActualDataSize = io_read(m_File, m_ppDataPtrs[Index], DataSize);
 			}
@@ -442,7 +468,7 @@ CDataFileReader &CDataFileReader::operator=(CDataFileReader &&Other)
 	return *this;
 }
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MemoryMap)
 {
 	dbg_assert(m_pDataFile == nullptr, "File already open");
 
@@ -455,6 +481,25 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	// map the file if requested, reading falls back to the file handle if that fails
+	const unsigned char *pMapped = nullptr;
+	int64_t MappedSize = 0;
+	if(MemoryMap)
+	{
+		pMapped = static_cast<const unsigned char *>(io_map(File, &MappedSize));
+		if(pMapped == nullptr)
+		{
+			log_warn("datafile", "failed to map file '%s', reading it instead", pFilename);
+		}
+	}
+	const auto &&CloseFile = [&]() {
+		if(pMapped != nullptr)
+		{
+			io_unmap(pMapped, MappedSize);
+		}
+		io_close(File);
+	};
+
 	// determine size and hashes of the file and store them
 	int64_t FileSize = 0;
 	unsigned Crc = 0;
@@ -462,20 +507,34 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	{
 		SHA256_CTX Sha256Ctxt;
 		sha256_init(&Sha256Ctxt);
-		unsigned char aBuffer[64 * 1024];
-		while(true)
+		if(pMapped != nullptr)
 		{
-			const unsigned Bytes = io_read(File, aBuffer, sizeof(aBuffer));
-			if(Bytes == 0)
-				break;
-			FileSize += Bytes;
-			Crc = crc32(Crc, aBuffer, Bytes);
-			sha256_update(&Sha256Ctxt, aBuffer, Bytes);
+			FileSize = MappedSize;
+			for(int64_t Offset = 0; Offset < MappedSize;)
+			{
+				const unsigned Bytes = minimum<int64_t>(MappedSize - Offset, 1024 * 1024 * 1024);
+				Crc = crc32(Crc, pMapped + Offset, Bytes);
+				Offset += Bytes;
+			}
+			sha256_update(&Sha256Ctxt, pMapped, MappedSize);
+		}
+		else
+		{
+			unsigned char aBuffer[64 * 1024];
+			while(true)
+			{
+				const unsigned Bytes = io_read(File, aBuffer, sizeof(aBuffer));
+				if(Bytes == 0)
+					break;
+				FileSize += Bytes;
+				Crc = crc32(Crc, aBuffer, Bytes);
+				sha256_update(&Sha256Ctxt, aBuffer, Bytes);
+			}
 		}
 		Sha256 = sha256_finish(&Sha256Ctxt);
 		if(io_seek(File, 0, IOSEEK_START) != 0)
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "could not seek to start after calculating hashes");
 			return false;
 		}
@@ -485,7 +544,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	CDatafileHeader Header;
 	if(io_read(File, &Header, sizeof(Header)) != sizeof(Header))
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "could not read file header. file truncated or not a datafile.");
 		return false;
 	}
@@ -494,7 +553,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if((Header.m_aId[0] != 'A' || Header.m_aId[1] != 'T' || Header.m_aId[2] != 'A' || Header.m_aId[3] != 'D') &&
 		(Header.m_aId[0] != 'D' || Header.m_aId[1] != 'A' || Header.m_aId[2] != 'T' || Header.m_aId[3] != 'A'))
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "wrong header magic. magic=%x%x%x%x", Header.m_aId[0], Header.m_aId[1], Header.m_aId[2], Header.m_aId[3]);
 		return false;
 	}
@@ -504,7 +563,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	// check header version
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "unsupported header version. version=%d", Header.m_Version);
 		return false;
 	}
@@ -518,7 +577,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Header.m_ItemSize % sizeof(int) != 0 ||
 		Header.m_DataSize < 0)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "invalid header information. num_types=%d num_items=%d num_data=%d item_size=%d data_size=%d",
 			Header.m_NumItemTypes, Header.m_NumItems, Header.m_NumRawData, Header.m_ItemSize, Header.m_DataSize);
 		return false;
@@ -544,7 +603,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	if((int64_t)sizeof(Header) + Size + (int64_t)Header.m_DataSize != FileSize)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "invalid header data size or truncated file. data_size=%d file_size=%" PRId64, Header.m_DataSize, FileSize);
 		return false;
 	}
@@ -559,7 +618,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 		else
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "invalid header size or truncated file. size=%" PRId64 " actual=%" PRId64, HeaderFileSize, FileSize);
 			return false;
 		}
@@ -576,7 +635,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 		else
 		{
-			io_close(File);
+			CloseFile();
 			log_error("datafile", "invalid header swaplen or truncated file. swaplen=%" PRId64 " actual=%" PRId64, HeaderSwaplen, FileSizeSwaplen);
 			return false;
 		}
@@ -589,7 +648,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	AllocSize += (int64_t)Header.m_NumRawData * sizeof(int); // add space for data sizes
 	if(AllocSize > MaxAllocSize)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "file too large. alloc_size=%" PRId64 " max=%" PRId64, AllocSize, MaxAllocSize);
 		return false;
 	}
@@ -597,7 +656,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	CDatafile *pTmpDataFile = static_cast<CDatafile *>(malloc(AllocSize));
 	if(pTmpDataFile == nullptr)
 	{
-		io_close(File);
+		CloseFile();
 		log_error("datafile", "out of memory. could not allocate memory for datafile. alloc_size=%" PRId64, AllocSize);
 		return false;
 	}
@@ -607,6 +666,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
 	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_pMapped = pMapped;
+	pTmpDataFile->m_MappedSize = MappedSize;
 	pTmpDataFile->m_FileSize = FileSize;
 	pTmpDataFile->m_Sha256 = Sha256;
 	pTmpDataFile->m_Crc = Crc;
@@ -619,7 +680,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	const unsigned ReadSize = io_read(pTmpDataFile->m_File, pTmpDataFile->m_pData, Size);
 	if((int64_t)ReadSize != Size)
 	{
-		io_close(pTmpDataFile->m_File);
+		CloseFile();
 		free(pTmpDataFile);
 		log_error("datafile", "truncation error. could not read all item data. wanted=%" PRId64 " got=%d", Size, ReadSize);
 		return false;
@@ -647,7 +708,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	if(!pTmpDataFile->Validate())
 	{
-		io_close(pTmpDataFile->m_File);
+		CloseFile();
 		free(pTmpDataFile);
 		return false;
 	}
@@ -670,6 +731,7 @@ void CDataFileReader::Close()
 		free(m_pDataFile->m_ppDataPtrs[i]);
 	}
 
+	m_pDataFile->Unmap();
 	io_close(m_pDataFile->m_File);
 	free(m_pDataFile);
 	m_pDataFile = nullptr;
@@ -915,6 +977,13 @@ int CDataFileReader::MapSize() const
 	return m_pDataFile->m_FileSize;
 }
 
+const void *CDataFileReader::MappedData() const
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	return m_pDataFile->m_pMapped;
+}
+
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = nullptr;
@@ -31,7 +31,9 @@ public:
 	~CDataFileReader();
 	CDataFileReader &operator=(CDataFileReader &&Other);
 
-	[[nodiscard]] bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// Memory mapped files are hashed and uncompressed without copying them
+	// first, the file must not be modified while it's open.
+	[[nodiscard]] bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MemoryMap = false);
 	void Close();
 	bool IsOpen() const;
 	IOHANDLE File() const;
@@ -54,6 +56,8 @@ public:
 	SHA256_DIGEST Sha256() const;
 	unsigned Crc() const;
 	int MapSize() const;
+	// The whole file if it's memory mapped, `nullptr` otherwise.
+	const void *MappedData() const;
 };
 
 // write access
@@ -26,6 +26,50 @@ static const unsigned char gs_OldVersion = 3;
 static const unsigned char gs_Sha256Version = 6;
 static const unsigned char gs_VersionTickCompression = 5; // demo files with this version or higher will use `CHUNKTICKFLAG_TICK_COMPRESSED`
 
+static const unsigned char gs_aIndexMarker[8] = {'T', 'W', 'D', 'I', 'N', 'D', 'E', 'X'};
+static const unsigned gs_IndexVersion = 1;
+static constexpr int INDEX_HEADER_SIZE = sizeof(gs_aIndexMarker) + 4 + 8 + 4 + 4 + 4;
+static constexpr int INDEX_KEYFRAME_SIZE = 8 + 4;
+
+static void Int64ToBytesBe(unsigned char *pBytes, int64_t Value)
+{
+	uint_to_bytes_be(pBytes, (uint64_t)Value >> 32);
+	uint_to_bytes_be(pBytes + 4, (uint64_t)Value & 0xffffffff);
+}
+
+static int64_t BytesBeToInt64(const unsigned char *pBytes)
+{
+	return (int64_t)(((uint64_t)bytes_be_to_uint(pBytes) << 32) | bytes_be_to_uint(pBytes + 4));
+}
+
+void DemoIndexFilename(const char *pDemoFilename, char *pBuffer, size_t BufferSize)
+{
+	str_format(pBuffer, BufferSize, "%s.idx", pDemoFilename);
+}
+
+void RemoveDemoIndex(IStorage *pStorage, const char *pDemoFilename, int StorageType)
+{
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	DemoIndexFilename(pDemoFilename, aIndexFilename, sizeof(aIndexFilename));
+	if(pStorage->FileExists(aIndexFilename, StorageType))
+		pStorage->RemoveFile(aIndexFilename, StorageType);
+}
+
+void RenameDemoIndex(IStorage *pStorage, const char *pOldDemoFilename, const char *pNewDemoFilename, int StorageType)
+{
+	// a stale index of an earlier demo with the new name must not survive
+	RemoveDemoIndex(pStorage, pNewDemoFilename, StorageType);
+
+	char aOldIndexFilename[IO_MAX_PATH_LENGTH];
+	DemoIndexFilename(pOldDemoFilename, aOldIndexFilename, sizeof(aOldIndexFilename));
+	if(!pStorage->FileExists(aOldIndexFilename, StorageType))
+		return;
+	char aNewIndexFilename[IO_MAX_PATH_LENGTH];
+	DemoIndexFilename(pNewDemoFilename, aNewIndexFilename, sizeof(aNewIndexFilename));
+	if(!pStorage->RenameFile(aOldIndexFilename, aNewIndexFilename, StorageType))
+		pStorage->RemoveFile(aOldIndexFilename, StorageType);
+}
+
 // TODO: rewrite all logs in this file using log_log_color, and remove gs_DemoPrintColor and m_pConsole
 static constexpr ColorRGBA gs_DemoPrintColor{0.75f, 0.7f, 0.7f, 1.0f};
 static constexpr LOG_COLOR DEMO_PRINT_COLOR = {191, 178, 178};
@@ -40,7 +84,7 @@ bool CDemoHeader::Valid() const
 	       mem_has_null(m_aTimestamp, sizeof(m_aTimestamp)) && str_utf8_check(m_aTimestamp);
 }
 
-CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData)
+CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData, CDemoWriter *pWriter)
 {
 	m_File = nullptr;
 	m_aCurrentFilename[0] = '\0';
@@ -49,6 +93,10 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapDat
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_NoMapData = NoMapData;
+	m_pWriter = pWriter;
+	m_Async = false;
+	m_NumQueuedJobs = 0;
+	m_NumDroppedSnapshots = 0;
 }
 
 CDemoRecorder::~CDemoRecorder()
@@ -199,9 +247,20 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	}
 
 	m_LastKeyFrame = -1;
+	m_KeyFrameInterval = g_Config.m_DemoKeyframeInterval * SERVER_TICK_SPEED;
 	m_LastTickMarker = -1;
+	m_LastWrittenTick = -1;
 	m_FirstTick = -1;
+	m_vKeyFrames.clear();
 	m_NumTimelineMarkers = 0;
+	m_Async = m_pWriter != nullptr && g_Config.m_DemoAsync;
+	m_NumDroppedSnapshots = 0;
+
+	// the server changes the static sizes of the shared delta per client, use an own copy
+	// so the writer thread never touches it
+	m_RecordSnapshotDelta = *m_pSnapshotDelta;
+	m_RecordSnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
+	m_RecordSnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
 
 	if(m_pConsole)
 	{
@@ -249,7 +308,7 @@ enum
 
 void CDemoRecorder::WriteTickMarker(int Tick, bool Keyframe)
 {
-	if(m_LastTickMarker == -1 || Tick - m_LastTickMarker > CHUNKMASK_TICK || Keyframe)
+	if(m_LastWrittenTick == -1 || Tick - m_LastWrittenTick > CHUNKMASK_TICK || Keyframe)
 	{
 		unsigned char aChunk[sizeof(int32_t) + 1];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER;
@@ -263,13 +322,11 @@ void CDemoRecorder::WriteTickMarker(int Tick, bool Keyframe)
 	else
 	{
 		unsigned char aChunk[1];
-		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | CHUNKTICKFLAG_TICK_COMPRESSED | (Tick - m_LastTickMarker);
+		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | CHUNKTICKFLAG_TICK_COMPRESSED | (Tick - m_LastWrittenTick);
 		io_write(m_File, aChunk, sizeof(aChunk));
 	}
 
-	m_LastTickMarker = Tick;
-	if(m_FirstTick < 0)
-		m_FirstTick = Tick;
+	m_LastWrittenTick = Tick;
 }
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
@@ -324,8 +381,25 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 
 void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 {
-	if(m_LastKeyFrame == -1 || (Tick - m_LastKeyFrame) > SERVER_TICK_SPEED * 5)
+	m_LastTickMarker = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
+
+	if(m_Async)
+		m_pWriter->Queue(this, CHUNKTYPE_SNAPSHOT, Tick, pData, Size);
+	else
+		WriteSnapshot(Tick, pData, Size);
+}
+
+void CDemoRecorder::WriteSnapshot(int Tick, const void *pData, int Size)
+{
+	if(m_LastKeyFrame == -1 || (Tick - m_LastKeyFrame) > m_KeyFrameInterval)
 	{
+		// remember where the keyframe starts for the index
+		const int64_t Filepos = io_tell(m_File);
+		if(Filepos >= 0)
+			m_vKeyFrames.emplace_back(Filepos, Tick);
+
 		// write full tickmarker
 		WriteTickMarker(Tick, true);
 
@@ -342,9 +416,7 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 
 		// create delta
 		char aDeltaData[CSnapshot::MAX_SIZE + sizeof(int)];
-		m_pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
-		m_pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
-		const int DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot *)m_aLastSnapshotData, (CSnapshot *)pData, &aDeltaData);
+		const int DeltaSize = m_RecordSnapshotDelta.CreateDelta((CSnapshot *)m_aLastSnapshotData, (CSnapshot *)pData, &aDeltaData);
 		if(DeltaSize)
 		{
 			// record delta
@@ -363,7 +435,10 @@ void CDemoRecorder::RecordMessage(const void *pData, int Size)
 			return;
 		}
 	}
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	if(m_Async)
+		m_pWriter->Queue(this, CHUNKTYPE_MESSAGE, m_LastTickMarker, pData, Size);
+	else
+		Write(CHUNKTYPE_MESSAGE, pData, Size);
 }
 
 int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilename)
@@ -371,12 +446,19 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 	if(!m_File)
 		return -1;
 
+	if(m_Async)
+	{
+		m_pWriter->Flush(this);
+		if(m_NumDroppedSnapshots > 0)
+			log_warn("demo_recorder", "Dropped %d snapshots of '%s' because the demo writer fell behind", m_NumDroppedSnapshots, m_aCurrentFilename);
+	}
+
 	if(Mode == IDemoRecorder::EStopMode::KEEP_FILE)
 	{
-		// add the demo length to the header
+		// add the demo length to the header, dropped snapshots aren't part of the file
 		io_seek(m_File, offsetof(CDemoHeader, m_aLength), IOSEEK_START);
 		unsigned char aLength[sizeof(int32_t)];
-		uint_to_bytes_be(aLength, Length());
+		uint_to_bytes_be(aLength, m_LastWrittenTick < 0 ? 0 : (m_LastWrittenTick - m_FirstTick) / SERVER_TICK_SPEED);
 		io_write(m_File, aLength, sizeof(aLength));
 
 		// add the timeline markers to the header
@@ -392,6 +474,7 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 		}
 	}
 
+	const int64_t DemoSize = io_length(m_File);
 	io_close(m_File);
 	m_File = nullptr;
 
@@ -407,6 +490,7 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 			}
 			return -1;
 		}
+		RemoveDemoIndex(m_pStorage, m_aCurrentFilename, IStorage::TYPE_SAVE);
 	}
 	else if(pTargetFilename[0] != '\0')
 	{
@@ -420,6 +504,12 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 			}
 			return -1;
 		}
+		if(!WriteIndex(pTargetFilename, DemoSize))
+			RemoveDemoIndex(m_pStorage, pTargetFilename, IStorage::TYPE_SAVE);
+	}
+	else if(!WriteIndex(m_aCurrentFilename, DemoSize))
+	{
+		RemoveDemoIndex(m_pStorage, m_aCurrentFilename, IStorage::TYPE_SAVE);
 	}
 
 	if(m_pConsole)
@@ -432,6 +522,152 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 	return 0;
 }
 
+bool CDemoRecorder::WriteIndex(const char *pFilename, int64_t DemoSize) const
+{
+	if(m_vKeyFrames.empty() || DemoSize < 0)
+		return false;
+
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	DemoIndexFilename(pFilename, aIndexFilename, sizeof(aIndexFilename));
+	IOHANDLE File = m_pStorage->OpenFile(aIndexFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		log_warn("demo_recorder", "Unable to write demo index '%s'", aIndexFilename);
+		return false;
+	}
+
+	std::vector<unsigned char> vData(INDEX_HEADER_SIZE + m_vKeyFrames.size() * INDEX_KEYFRAME_SIZE);
+	unsigned char *pData = vData.data();
+	mem_copy(pData, gs_aIndexMarker, sizeof(gs_aIndexMarker));
+	uint_to_bytes_be(pData + 8, gs_IndexVersion);
+	Int64ToBytesBe(pData + 12, DemoSize);
+	uint_to_bytes_be(pData + 20, m_vKeyFrames.front().m_Tick);
+	uint_to_bytes_be(pData + 24, m_LastWrittenTick);
+	uint_to_bytes_be(pData + 28, m_vKeyFrames.size());
+	pData += INDEX_HEADER_SIZE;
+	for(const CDemoKeyFrame &KeyFrame : m_vKeyFrames)
+	{
+		Int64ToBytesBe(pData, KeyFrame.m_Filepos);
+		uint_to_bytes_be(pData + 8, KeyFrame.m_Tick);
+		pData += INDEX_KEYFRAME_SIZE;
+	}
+	const bool Success = io_write(File, vData.data(), vData.size()) == vData.size();
+	io_close(File);
+	return Success;
+}
+
+CDemoWriter::CDemoWriter()
+{
+	m_pThread = thread_init(WriterThread, this, "demo writer");
+}
+
+CDemoWriter::~CDemoWriter()
+{
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		m_vpQueue.push_back(nullptr);
+	}
+	m_NumQueued.Signal();
+	thread_wait(m_pThread);
+}
+
+size_t CDemoWriter::QueuedBytes()
+{
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	return m_QueuedBytes;
+}
+
+size_t CDemoWriter::PeakQueuedBytes()
+{
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	return m_PeakQueuedBytes;
+}
+
+int64_t CDemoWriter::NumDroppedSnapshots()
+{
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	return m_NumDroppedSnapshots;
+}
+
+bool CDemoWriter::Queue(CDemoRecorder *pRecorder, int Type, int Tick, const void *pData, int Size)
+{
+	std::unique_ptr<CJob> pJob;
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		if(Type == CHUNKTYPE_SNAPSHOT && m_QueuedBytes + Size > (size_t)g_Config.m_DemoAsyncQueueSize * 1024)
+		{
+			pRecorder->m_NumDroppedSnapshots++;
+			m_NumDroppedSnapshots++;
+			return false;
+		}
+		m_QueuedBytes += Size;
+		m_PeakQueuedBytes = maximum(m_PeakQueuedBytes, m_QueuedBytes);
+		pRecorder->m_NumQueuedJobs++;
+		if(!m_vpFreeJobs.empty())
+		{
+			pJob = std::move(m_vpFreeJobs.back());
+			m_vpFreeJobs.pop_back();
+		}
+	}
+
+	// copy outside of the lock, the writer thread keeps going meanwhile
+	if(!pJob)
+		pJob = std::make_unique<CJob>();
+	pJob->m_pRecorder = pRecorder;
+	pJob->m_Type = Type;
+	pJob->m_Tick = Tick;
+	pJob->m_vData.assign((const unsigned char *)pData, (const unsigned char *)pData + Size);
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		m_vpQueue.push_back(std::move(pJob));
+	}
+	m_NumQueued.Signal();
+	return true;
+}
+
+void CDemoWriter::Flush(CDemoRecorder *pRecorder)
+{
+	std::unique_lock<std::mutex> Lock(m_Mutex);
+	m_JobDone.wait(Lock, [pRecorder]() { return pRecorder->m_NumQueuedJobs == 0; });
+}
+
+void CDemoWriter::WriterThread(void *pUser)
+{
+	static_cast<CDemoWriter *>(pUser)->WriteJobs();
+}
+
+void CDemoWriter::WriteJobs()
+{
+	while(true)
+	{
+		m_NumQueued.Wait();
+		std::unique_ptr<CJob> pJob;
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+			pJob = std::move(m_vpQueue.front());
+			m_vpQueue.pop_front();
+		}
+		if(pJob == nullptr)
+			return;
+
+		CDemoRecorder *pRecorder = pJob->m_pRecorder;
+		if(pJob->m_Type == CHUNKTYPE_SNAPSHOT)
+			pRecorder->WriteSnapshot(pJob->m_Tick, pJob->m_vData.data(), pJob->m_vData.size());
+		else
+			pRecorder->Write(pJob->m_Type, pJob->m_vData.data(), pJob->m_vData.size());
+
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+			m_QueuedBytes -= pJob->m_vData.size();
+			pRecorder->m_NumQueuedJobs--;
+			// keep a few jobs with their buffers around for reuse
+			if(m_vpFreeJobs.size() < 256)
+				m_vpFreeJobs.push_back(std::move(pJob));
+		}
+		m_JobDone.notify_all();
+	}
+}
+
 void CDemoRecorder::AddDemoMarker()
 {
 	if(m_LastTickMarker < 0)
@@ -499,6 +735,7 @@ void CDemoPlayer::Construct(class CSnapshotDelta *pSnapshotDelta, bool UseVideo)
 	m_LastSnapshotDataSize = -1;
 	m_pListener = nullptr;
 	m_UseVideo = UseVideo;
+	m_LoadedIndex = false;
 
 	m_aFilename[0] = '\0';
 	m_aErrorMessage[0] = '\0';
@@ -651,6 +888,75 @@ CDemoPlayer::EScanFileResult CDemoPlayer::ScanFile()
 	return ResetToStartPosition(m_vKeyFrames.empty() ? EScanFileResult::ERROR_UNRECOVERABLE : EScanFileResult::SUCCESS);
 }
 
+bool CDemoPlayer::LoadIndex(class IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	DemoIndexFilename(pFilename, aIndexFilename, sizeof(aIndexFilename));
+	void *pIndexData;
+	unsigned IndexSize;
+	if(!pStorage->ReadFile(aIndexFilename, StorageType, &pIndexData, &IndexSize))
+		return false;
+
+	const int64_t StartPos = io_tell(m_File);
+	const int64_t DemoSize = io_length(m_File);
+	if(StartPos < 0 || DemoSize < 0 || io_seek(m_File, StartPos, IOSEEK_START) != 0)
+	{
+		free(pIndexData);
+		return false;
+	}
+
+	// the demo might have been rewritten without the index, so check that it still matches
+	const unsigned char *pData = (const unsigned char *)pIndexData;
+	const auto &&Valid = [&]() {
+		if(IndexSize < (unsigned)INDEX_HEADER_SIZE ||
+			mem_comp(pData, gs_aIndexMarker, sizeof(gs_aIndexMarker)) != 0 ||
+			bytes_be_to_uint(pData + 8) != gs_IndexVersion ||
+			BytesBeToInt64(pData + 12) != DemoSize)
+			return false;
+		const int FirstTick = bytes_be_to_uint(pData + 20);
+		const int LastTick = bytes_be_to_uint(pData + 24);
+		const unsigned NumKeyFrames = bytes_be_to_uint(pData + 28);
+		if(NumKeyFrames == 0 || (IndexSize - INDEX_HEADER_SIZE) / INDEX_KEYFRAME_SIZE != NumKeyFrames ||
+			FirstTick < MIN_TICK || LastTick < FirstTick || LastTick >= MAX_TICK)
+			return false;
+
+		m_vKeyFrames.reserve(NumKeyFrames);
+		for(unsigned i = 0; i < NumKeyFrames; i++)
+		{
+			const unsigned char *pKeyFrame = pData + INDEX_HEADER_SIZE + i * INDEX_KEYFRAME_SIZE;
+			const int64_t Filepos = BytesBeToInt64(pKeyFrame);
+			const int Tick = bytes_be_to_uint(pKeyFrame + 8);
+			if(Filepos < StartPos || Filepos >= DemoSize || Tick < FirstTick || Tick > LastTick ||
+				(!m_vKeyFrames.empty() && (Filepos <= m_vKeyFrames.back().m_Filepos || Tick < m_vKeyFrames.back().m_Tick)))
+				return false;
+			m_vKeyFrames.emplace_back(Filepos, Tick);
+		}
+
+		// spot check that the last keyframe is where the index says
+		int ChunkType, ChunkSize, ChunkTick = -1;
+		if(io_seek(m_File, m_vKeyFrames.back().m_Filepos, IOSEEK_START) != 0 ||
+			ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) != CHUNKHEADER_SUCCESS ||
+			ChunkType != (CHUNKTYPEFLAG_TICKMARKER | CHUNKTICKFLAG_KEYFRAME) ||
+			ChunkTick != m_vKeyFrames.back().m_Tick)
+			return false;
+
+		m_Info.m_Info.m_FirstTick = FirstTick;
+		m_Info.m_Info.m_LastTick = LastTick;
+		return true;
+	};
+	const bool Result = Valid();
+	free(pIndexData);
+	if(!Result)
+	{
+		m_vKeyFrames.clear();
+		m_Info.m_Info.m_FirstTick = -1;
+		m_Info.m_Info.m_LastTick = -1;
+	}
+	// an unrecoverable error will show up when scanning or playing
+	io_seek(m_File, StartPos, IOSEEK_START);
+	return Result;
+}
+
 void CDemoPlayer::DoTick()
 {
 	// update ticks
@@ -864,8 +1170,10 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// Scan the file for interesting points
-	if(ScanFile() == EScanFileResult::ERROR_UNRECOVERABLE)
+	// Use the index if there is one, scan the file for interesting points otherwise
+	m_vKeyFrames.clear();
+	m_LoadedIndex = LoadIndex(pStorage, pFilename, StorageType);
+	if(!m_LoadedIndex && ScanFile() == EScanFileResult::ERROR_UNRECOVERABLE)
 	{
 		Stop("Error scanning demo file");
 		return -1;
@@ -1046,25 +1354,28 @@ int CDemoPlayer::SetPos(int WantedTick)
 		WantedTick = std::clamp(WantedTick, m_Info.m_Info.m_FirstTick, LastSeekableTick);
 	}
 	const int KeyFrameWantedTick = WantedTick - 5; // -5 because we have to have a current tick and previous tick when we do the playback
-	const float Percent = (KeyFrameWantedTick - m_Info.m_Info.m_FirstTick) / (float)(m_Info.m_Info.m_LastTick - m_Info.m_Info.m_FirstTick);
 
-	// get correct key frame
-	size_t KeyFrame = std::clamp<size_t>(m_vKeyFrames.size() * Percent, 0, m_vKeyFrames.size() - 1);
-	while(KeyFrame < m_vKeyFrames.size() - 1 && m_vKeyFrames[KeyFrame].m_Tick < KeyFrameWantedTick)
-		KeyFrame++;
-	while(KeyFrame > 0 && m_vKeyFrames[KeyFrame].m_Tick > KeyFrameWantedTick)
-		KeyFrame--;
+	// get the last key frame at or before the wanted tick
+	const auto NextKeyFrame = std::upper_bound(m_vKeyFrames.begin(), m_vKeyFrames.end(), KeyFrameWantedTick, [](int Tick, const CDemoKeyFrame &KeyFrame) {
+		return Tick < KeyFrame.m_Tick;
+	});
+	const size_t KeyFrame = NextKeyFrame == m_vKeyFrames.begin() ? 0 : NextKeyFrame - m_vKeyFrames.begin() - 1;
 
-	// seek to the correct key frame
-	if(io_seek(m_File, m_vKeyFrames[KeyFrame].m_Filepos, IOSEEK_START) != 0)
+	// when seeking forward past that key frame, playing on from here is never more work than starting over from it
+	const bool PlayOn = m_Info.m_PreviousTick != -1 && m_Info.m_NextTick < WantedTick && m_vKeyFrames[KeyFrame].m_Tick <= m_Info.m_NextTick;
+	if(!PlayOn)
 	{
-		Stop("Error seeking keyframe position");
-		return -1;
-	}
+		// seek to the correct key frame
+		if(io_seek(m_File, m_vKeyFrames[KeyFrame].m_Filepos, IOSEEK_START) != 0)
+		{
+			Stop("Error seeking keyframe position");
+			return -1;
+		}
 
-	m_Info.m_NextTick = -1;
-	m_Info.m_Info.m_CurrentTick = -1;
-	m_Info.m_PreviousTick = -1;
+		m_Info.m_NextTick = -1;
+		m_Info.m_Info.m_CurrentTick = -1;
+		m_Info.m_PreviousTick = -1;
+	}
 
 	// playback everything until we hit our tick
 	while(m_Info.m_NextTick < WantedTick)
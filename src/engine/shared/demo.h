@@ -6,28 +6,117 @@
 #include "snapshot.h"
 
 #include <base/hash.h>
+#include <base/tl/threading.h>
 
 #include <engine/demo.h>
 #include <engine/shared/protocol.h>
 
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 typedef std::function<void()> TUpdateIntraTimesFunc;
 
+// Keyframe positions of a demo are also written to a small index file next
+// to it, `<demo filename>.idx`, so the player doesn't have to scan all chunk
+// headers when loading. Old clients ignore the file, new clients fall back to
+// scanning if it's missing or doesn't match the demo.
+//
+//     index:    magic, version, demo file size, first tick, last tick, number of keyframes, keyframe*
+//     keyframe: file position, tick
+//
+// Whatever removes or renames a demo has to take the index with it.
+void DemoIndexFilename(const char *pDemoFilename, char *pBuffer, size_t BufferSize);
+void RemoveDemoIndex(class IStorage *pStorage, const char *pDemoFilename, int StorageType);
+void RenameDemoIndex(class IStorage *pStorage, const char *pOldDemoFilename, const char *pNewDemoFilename, int StorageType);
+
+class CDemoKeyFrame
+{
+public:
+	int64_t m_Filepos;
+	int m_Tick;
+
+	CDemoKeyFrame(int64_t Filepos, int Tick) :
+		m_Filepos(Filepos), m_Tick(Tick)
+	{
+	}
+};
+
+// Compresses and writes the snapshots and messages of asynchronous demo
+// recorders on a background thread, so recording only costs the caller a
+// copy of the data. One writer serves any number of recorders.
+//
+// If the thread falls behind by more than `demo_async_queue_size`, new
+// snapshots are dropped. That only leaves a gap in the demo because deltas
+// are created on the writer thread against the last written snapshot.
+// Messages are always queued.
+class CDemoWriter
+{
+public:
+	CDemoWriter();
+	~CDemoWriter();
+
+	size_t QueuedBytes();
+	size_t PeakQueuedBytes();
+	int64_t NumDroppedSnapshots();
+
+private:
+	friend class CDemoRecorder;
+
+	struct CJob
+	{
+		class CDemoRecorder *m_pRecorder;
+		int m_Type;
+		int m_Tick;
+		std::vector<unsigned char> m_vData;
+	};
+
+	// Returns false if the snapshot was dropped.
+	bool Queue(class CDemoRecorder *pRecorder, int Type, int Tick, const void *pData, int Size);
+	// Waits until all data of the recorder is written.
+	void Flush(class CDemoRecorder *pRecorder);
+
+	static void WriterThread(void *pUser);
+	void WriteJobs();
+
+	// `nullptr` stops the writer thread
+	std::mutex m_Mutex;
+	std::deque<std::unique_ptr<CJob>> m_vpQueue;
+	std::vector<std::unique_ptr<CJob>> m_vpFreeJobs;
+	CSemaphore m_NumQueued;
+	std::condition_variable m_JobDone;
+	size_t m_QueuedBytes = 0;
+	size_t m_PeakQueuedBytes = 0;
+	int64_t m_NumDroppedSnapshots = 0;
+
+	void *m_pThread;
+};
+
 class CDemoRecorder : public IDemoRecorder
 {
+	friend class CDemoWriter;
+
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
 
 	IOHANDLE m_File;
 	char m_aCurrentFilename[IO_MAX_PATH_LENGTH];
 	int m_LastTickMarker;
-	int m_LastKeyFrame;
 	int m_FirstTick;
 
+	// only accessed by the writer thread while recording asynchronously
+	int m_LastWrittenTick;
+	int m_LastKeyFrame;
+	int m_KeyFrameInterval;
+	std::vector<CDemoKeyFrame> m_vKeyFrames;
+
 	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	class CSnapshotDelta *m_pSnapshotDelta;
+	// copy of the delta used for writing, with the static sizes of the demo
+	CSnapshotDelta m_RecordSnapshotDelta;
 
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
@@ -37,11 +126,20 @@ class CDemoRecorder : public IDemoRecorder
 	DEMOFUNC_FILTER m_pfnFilter;
 	void *m_pUser;
 
+	CDemoWriter *m_pWriter;
+	bool m_Async;
+	// guarded by the writer's mutex
+	int m_NumQueuedJobs;
+	int m_NumDroppedSnapshots;
+
 	void WriteTickMarker(int Tick, bool Keyframe);
+	void WriteSnapshot(int Tick, const void *pData, int Size);
 	void Write(int Type, const void *pData, int Size);
+	bool WriteIndex(const char *pFilename, int64_t DemoSize) const;
 
 public:
-	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData = false);
+	// Records asynchronously on the given writer if `demo_async` is enabled.
+	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData = false, CDemoWriter *pWriter = nullptr);
 	CDemoRecorder() = default;
 	~CDemoRecorder() override;
 
@@ -100,25 +198,12 @@ private:
 
 	TUpdateIntraTimesFunc m_UpdateIntraTimesFunc;
 
-	// Playback
-	class CKeyFrame
-	{
-	public:
-		int64_t m_Filepos;
-		int m_Tick;
-
-		CKeyFrame(int64_t Filepos, int Tick) :
-			m_Filepos(Filepos), m_Tick(Tick)
-		{
-		}
-	};
-
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	int64_t m_MapOffset;
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	char m_aErrorMessage[256];
-	std::vector<CKeyFrame> m_vKeyFrames;
+	std::vector<CDemoKeyFrame> m_vKeyFrames;
 	CMapInfo m_MapInfo;
 	int m_SpeedIndex;
 
@@ -156,10 +241,12 @@ private:
 		ERROR_UNRECOVERABLE,
 	};
 	EScanFileResult ScanFile();
+	bool LoadIndex(class IStorage *pStorage, const char *pFilename, int StorageType);
 	void UpdateTimes();
 
 	int64_t Time();
 	bool m_Sixup;
+	bool m_LoadedIndex;
 
 public:
 	CDemoPlayer(class CSnapshotDelta *pSnapshotDelta, bool UseVideo);
@@ -184,6 +271,10 @@ public:
 	int SeekTime(float Seconds) override;
 	int SeekTick(ETickOffset TickOffset) override;
 	int SetPos(int WantedTick) override;
+	// Whether the keyframes were read from the index file instead of scanning the demo.
+	bool LoadedIndex() const { return m_LoadedIndex; }
+	int NumKeyFrames() const { return m_vKeyFrames.size(); }
+	const CDemoKeyFrame &KeyFrame(int Index) const { return m_vKeyFrames[Index]; }
 	const CInfo *BaseInfo() const override { return &m_Info.m_Info; }
 	void GetDemoName(char *pBuffer, size_t BufferSize) const override;
 	bool GetDemoInfo(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, int StorageType, CDemoHeader *pDemoHeader, CTimelineMarkers *pTimelineMarkers, CMapInfo *pMapInfo, IOHANDLE *pFile = nullptr, char *pErrorMessage = nullptr, size_t ErrorMessageSize = 0) const override;
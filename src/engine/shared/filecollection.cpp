@@ -5,6 +5,7 @@
 
 #include <base/math.h>
 
+#include <engine/shared/demo.h>
 #include <engine/storage.h>
 
 #include <algorithm>
@@ -41,6 +42,8 @@ void CFileCollection::Init(IStorage *pStorage, const char *pPath, const char *pF
 		}
 
 		m_pStorage->RemoveFile(aBuf, IStorage::TYPE_SAVE);
+		if(str_comp(m_aFileExt, ".demo") == 0)
+			RemoveDemoIndex(m_pStorage, aBuf, IStorage::TYPE_SAVE);
 		FilesDeleted++;
 	}
 }
@@ -92,11 +92,37 @@ void CHuffman::ConstructTree(const unsigned *pFrequencies)
 	Setbits_r(m_pStartNode, 0, 0);
 }
 
+void CHuffman::BuildMultiDecodeLut()
+{
+	for(int i = 0; i < HUFFMAN_MULTI_LUTSIZE; i++)
+	{
+		CMultiSymbol &Entry = m_aMultiDecodeLut[i];
+		while(Entry.m_NumSymbols < HUFFMAN_MULTI_MAX_SYMBOLS)
+		{
+			// walk the tree with the remaining bits
+			const CNode *pNode = m_pStartNode;
+			unsigned NumBits = Entry.m_NumBits;
+			while(!pNode->m_NumBits && NumBits < HUFFMAN_MULTI_LUTBITS)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[(i >> NumBits) & 1]];
+				NumBits++;
+			}
+			// stop at incomplete codes and before the EOF symbol, the
+			// slow path handles them
+			if(!pNode->m_NumBits || pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
+				break;
+			Entry.m_aSymbols[Entry.m_NumSymbols++] = pNode->m_Symbol;
+			Entry.m_NumBits = NumBits;
+		}
+	}
+}
+
 void CHuffman::Init(const unsigned *pFrequencies)
 {
 	// make sure to cleanout every thing
 	mem_zero(m_aNodes, sizeof(m_aNodes));
 	mem_zero(m_apDecodeLut, sizeof(m_apDecodeLut));
+	mem_zero(m_aMultiDecodeLut, sizeof(m_aMultiDecodeLut));
 	m_pStartNode = nullptr;
 	m_NumNodes = 0;
 
@@ -127,79 +153,75 @@ void CHuffman::Init(const unsigned *pFrequencies)
 		if(k == HUFFMAN_LUTBITS)
 			m_apDecodeLut[i] = pNode;
 	}
+
+	BuildMultiDecodeLut();
+
+	for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+	{
+		m_aEncodeBits[i] = m_aNodes[i].m_Bits;
+		m_aEncodeNumBits[i] = m_aNodes[i].m_NumBits;
+	}
+}
+
+static inline uint64_t ReadLittleEndian64(const unsigned char *pSrc)
+{
+	// compilers turn this into a single load
+	return (uint64_t)pSrc[0] | ((uint64_t)pSrc[1] << 8) | ((uint64_t)pSrc[2] << 16) | ((uint64_t)pSrc[3] << 24) |
+	       ((uint64_t)pSrc[4] << 32) | ((uint64_t)pSrc[5] << 40) | ((uint64_t)pSrc[6] << 48) | ((uint64_t)pSrc[7] << 56);
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	do \
-	{ \
-		Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-		Bitcount += m_aNodes[Sym].m_NumBits; \
-	} while(0)
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	do \
-	{ \
-		while(Bitcount >= 8) \
-		{ \
-			*pDst++ = (unsigned char)(Bits & 0xff); \
-			if(pDst == pDstEnd) \
-				return -1; \
-			Bits >>= 8; \
-			Bitcount -= 8; \
-		} \
-	} while(0)
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	// codes are collected in a 64 bit buffer and written 32 bits at a time,
+	// which leaves room for a code of up to 32 bits
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	// the output always ends with a last byte, so 32 bits are only written
+	// if there is room for that byte as well
+	while(pSrc != pSrcEnd)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
-
-		while(pSrc != pSrcEnd)
+		const unsigned char Symbol = *pSrc++;
+		Bits |= (uint64_t)m_aEncodeBits[Symbol] << Bitcount;
+		Bitcount += m_aEncodeNumBits[Symbol];
+		if(Bitcount >= 32)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE();
+			if(pDstEnd - pDst <= 4)
+				return -1;
+			pDst[0] = Bits;
+			pDst[1] = Bits >> 8;
+			pDst[2] = Bits >> 16;
+			pDst[3] = Bits >> 24;
+			pDst += 4;
+			Bits >>= 32;
+			Bitcount -= 32;
 		}
-
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-		HUFFMAN_MACRO_WRITE();
 	}
 
 	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL);
-	HUFFMAN_MACRO_WRITE();
+	Bits |= (uint64_t)m_aEncodeBits[HUFFMAN_EOF_SYMBOL] << Bitcount;
+	Bitcount += m_aEncodeNumBits[HUFFMAN_EOF_SYMBOL];
+	while(Bitcount >= 8)
+	{
+		*pDst++ = Bits;
+		if(pDst == pDstEnd)
+			return -1;
+		Bits >>= 8;
+		Bitcount -= 8;
+	}
 
 	// write out the last bits
 	*pDst++ = Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -207,45 +229,83 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
 	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
 
 	while(true)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		const CNode *pNode = nullptr;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
+		// {A} fill with new bits, 8 bytes at a time as long as the input
+		// allows it. Bits above the bit count are already set then, but
+		// they are the same bits the next fill writes again.
+		if(pSrcEnd - pSrc >= 8)
 		{
-			Bits |= (*pSrc++) << Bitcount;
-			Bitcount += 8;
+			Bits |= ReadLittleEndian64(pSrc) << Bitcount;
+			pSrc += (63 - Bitcount) >> 3;
+			Bitcount |= 56;
+		}
+		else
+		{
+			while(Bitcount <= 56 && pSrc != pSrcEnd)
+			{
+				Bits |= (uint64_t)(*pSrc++) << Bitcount;
+				Bitcount += 8;
+			}
 		}
 
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+		// {B} decode with the multi symbol LUT as long as enough bits are
+		// buffered, codes in it are never longer than the LUT bits
+		const CMultiSymbol *pMulti = &m_aMultiDecodeLut[Bits & HUFFMAN_MULTI_LUTMASK];
+		if(pMulti->m_NumSymbols && pMulti->m_NumBits <= Bitcount)
+		{
+			do
+			{
+				if(pDstEnd - pDst >= HUFFMAN_MULTI_MAX_SYMBOLS)
+				{
+					// write all symbols, the unused ones get overwritten later
+					for(int i = 0; i < HUFFMAN_MULTI_MAX_SYMBOLS; i++)
+						pDst[i] = pMulti->m_aSymbols[i];
+				}
+				else
+				{
+					if(pDstEnd - pDst < pMulti->m_NumSymbols)
+						return -1;
+					for(int i = 0; i < pMulti->m_NumSymbols; i++)
+						pDst[i] = pMulti->m_aSymbols[i];
+				}
+				pDst += pMulti->m_NumSymbols;
+				Bits >>= pMulti->m_NumBits;
+				Bitcount -= pMulti->m_NumBits;
+				pMulti = &m_aMultiDecodeLut[Bits & HUFFMAN_MULTI_LUTMASK];
+			} while(pMulti->m_NumSymbols && Bitcount >= HUFFMAN_MULTI_LUTBITS);
+			continue;
+		}
 
+		// {C} long codes and EOF take the single symbol LUT and walk the tree
+		const CNode *pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
 		if(!pNode)
 			return -1;
 
 		// {D} check if we hit a symbol already
 		if(pNode->m_NumBits)
 		{
+			if(pNode->m_NumBits > Bitcount)
+				return -1;
+
 			// remove the bits for that symbol
 			Bits >>= pNode->m_NumBits;
 			Bitcount -= pNode->m_NumBits;
 		}
 		else
 		{
+			if(Bitcount < HUFFMAN_LUTBITS)
+				return -1;
+
 			// remove the bits that the lut checked up for us
 			Bits >>= HUFFMAN_LUTBITS;
 			Bitcount -= HUFFMAN_LUTBITS;
@@ -253,6 +313,10 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 			// walk the tree bit by bit
 			while(true)
 			{
+				// no more bits, decoding error
+				if(Bitcount == 0)
+					return -1;
+
 				// traverse tree
 				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
 
@@ -263,10 +327,6 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 				// check if we hit a symbol
 				if(pNode->m_NumBits)
 					break;
-
-				// no more bits, decoding error
-				if(Bitcount == 0)
-					return -1;
 			}
 		}
 
@@ -14,7 +14,13 @@ class CHuffman
 
 		HUFFMAN_LUTBITS = 10,
 		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1),
+
+		// the multi symbol LUT decodes all codes that fit into its bits at once
+		HUFFMAN_MULTI_LUTBITS = 12,
+		HUFFMAN_MULTI_LUTSIZE = (1 << HUFFMAN_MULTI_LUTBITS),
+		HUFFMAN_MULTI_LUTMASK = (HUFFMAN_MULTI_LUTSIZE - 1),
+		HUFFMAN_MULTI_MAX_SYMBOLS = 4,
 	};
 
 	struct CNode
@@ -30,17 +36,31 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
-	static const unsigned ms_aFreqTable[HUFFMAN_MAX_SYMBOLS];
+	struct CMultiSymbol
+	{
+		unsigned char m_aSymbols[HUFFMAN_MULTI_MAX_SYMBOLS];
+		// zero if the first code is longer than the LUT or the EOF symbol
+		unsigned char m_NumSymbols;
+		unsigned char m_NumBits;
+	};
 
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
 	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CMultiSymbol m_aMultiDecodeLut[HUFFMAN_MULTI_LUTSIZE];
+	// the codes of the nodes packed tightly for the encoder
+	unsigned m_aEncodeBits[HUFFMAN_MAX_SYMBOLS];
+	unsigned char m_aEncodeNumBits[HUFFMAN_MAX_SYMBOLS];
 	CNode *m_pStartNode;
 	int m_NumNodes;
 
 	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
 	void ConstructTree(const unsigned *pFrequencies);
+	void BuildMultiDecodeLut();
 
 public:
+	// byte frequencies of the network traffic, the EOF symbol is added by `Init`
+	static const unsigned ms_aFreqTable[HUFFMAN_MAX_SYMBOLS];
+
 	/*
 		Function: Init
 			Inits the compressor/decompressor.
@@ -3,11 +3,14 @@
 #include "map.h"
 
 #include <base/log.h>
+#include <base/system.h>
 
 #include <engine/storage.h>
 
 #include <game/mapitems.h>
 
+#include <vector>
+
 CMap::CMap() = default;
 
 int CMap::GetDataSize(int Index) const
@@ -70,16 +73,13 @@ int CMap::NumItems() const
 	return m_DataFile.NumItems();
 }
 
-bool CMap::Load(const char *pMapName)
+bool CMap::Open(const char *pMapName, bool MemoryMap, CDataFileReader &NewDataFile)
 {
 	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
 	if(!pStorage)
 		return false;
 
-	// Ensure current datafile is not left in an inconsistent state if loading fails,
-	// by loading the new datafile separately first.
-	CDataFileReader NewDataFile;
-	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
+	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL, MemoryMap))
 		return false;
 
 	// Check version
@@ -124,12 +124,114 @@ bool CMap::Load(const char *pMapName)
 		}
 	}
 
+	return true;
+}
+
+bool CMap::Load(const char *pMapName, bool MemoryMap)
+{
+	// Ensure current datafile is not left in an inconsistent state if loading fails,
+	// by loading the new datafile separately first.
+	CDataFileReader NewDataFile;
+	if(!Open(pMapName, MemoryMap, NewDataFile))
+		return false;
+
 	// Replace existing datafile with new datafile
 	m_DataFile.Close();
 	m_DataFile = std::move(NewDataFile);
 	return true;
 }
 
+// Modification time and size of the map file that storage finds first
+static bool MapFileStamp(IStorage *pStorage, const char *pMapName, time_t *pModified, int64_t *pSize)
+{
+	char aPath[IO_MAX_PATH_LENGTH];
+	IOHANDLE File = pStorage->OpenFile(pMapName, IOFLAG_READ, IStorage::TYPE_ALL, aPath, sizeof(aPath));
+	if(!File)
+		return false;
+	*pSize = io_length(File);
+	io_close(File);
+	time_t Created;
+	return fs_file_time(aPath, &Created, pModified) == 0;
+}
+
+void CMap::DropPrepared()
+{
+	m_PreparedDataFile.Close();
+	m_aPreparedName[0] = '\0';
+}
+
+bool CMap::Prepare(const char *pMapName, bool MemoryMap)
+{
+	DropPrepared();
+	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
+	if(!pStorage)
+		return false;
+
+	// taken before opening, a change in between makes the map stale
+	// instead of going unnoticed
+	time_t Modified;
+	int64_t Size;
+	if(!MapFileStamp(pStorage, pMapName, &Modified, &Size))
+		return false;
+	CDataFileReader NewDataFile;
+	if(!Open(pMapName, MemoryMap, NewDataFile))
+		return false;
+
+	// Decompress everything but images and sounds now instead of on first
+	// access when the game builds its layers
+	std::vector<bool> vSkipData(NewDataFile.NumData(), false);
+	int Start, Num;
+	NewDataFile.GetType(MAPITEMTYPE_IMAGE, &Start, &Num);
+	for(int i = 0; i < Num; i++)
+	{
+		const CMapItemImage *pImage = static_cast<CMapItemImage *>(NewDataFile.GetItem(Start + i));
+		if(pImage->m_ImageData >= 0 && pImage->m_ImageData < (int)vSkipData.size())
+			vSkipData[pImage->m_ImageData] = true;
+	}
+	NewDataFile.GetType(MAPITEMTYPE_SOUND, &Start, &Num);
+	for(int i = 0; i < Num; i++)
+	{
+		const CMapItemSound *pSound = static_cast<CMapItemSound *>(NewDataFile.GetItem(Start + i));
+		if(pSound->m_SoundData >= 0 && pSound->m_SoundData < (int)vSkipData.size())
+			vSkipData[pSound->m_SoundData] = true;
+	}
+	for(int i = 0; i < (int)vSkipData.size(); i++)
+	{
+		if(!vSkipData[i])
+			NewDataFile.GetData(i);
+	}
+
+	m_PreparedDataFile = std::move(NewDataFile);
+	str_copy(m_aPreparedName, pMapName);
+	m_PreparedModified = Modified;
+	m_PreparedSize = Size;
+	return true;
+}
+
+bool CMap::LoadPrepared(const char *pMapName)
+{
+	// a prepared map is only offered once, it's dropped if it's for another
+	// map or the file changed since, as the caller loads it again anyway
+	bool Valid = m_PreparedDataFile.IsOpen() && str_comp(m_aPreparedName, pMapName) == 0;
+	if(Valid)
+	{
+		IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
+		time_t Modified;
+		int64_t Size;
+		Valid = pStorage && MapFileStamp(pStorage, pMapName, &Modified, &Size) && Modified == m_PreparedModified && Size == m_PreparedSize;
+	}
+	if(!Valid)
+	{
+		DropPrepared();
+		return false;
+	}
+
+	m_DataFile.Close();
+	m_DataFile = std::move(m_PreparedDataFile);
+	m_aPreparedName[0] = '\0';
+	return true;
+}
+
 void CMap::Unload()
 {
 	m_DataFile.Close();
@@ -160,6 +262,11 @@ int CMap::MapSize() const
 	return m_DataFile.MapSize();
 }
 
+const void *CMap::MappedData() const
+{
+	return m_DataFile.MappedData();
+}
+
 void CMap::ExtractTiles(CTile *pDest, size_t DestSize, const CTile *pSrc, size_t SrcSize)
 {
 	size_t DestIndex = 0;
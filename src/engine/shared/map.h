@@ -9,10 +9,21 @@
 
 #include <engine/map.h>
 
+#include <ctime>
+
 class CMap : public IEngineMap
 {
 	CDataFileReader m_DataFile;
 
+	CDataFileReader m_PreparedDataFile;
+	char m_aPreparedName[IO_MAX_PATH_LENGTH] = "";
+	// to notice when the file changed after it was prepared
+	time_t m_PreparedModified = 0;
+	int64_t m_PreparedSize = 0;
+
+	bool Open(const char *pMapName, bool MemoryMap, CDataFileReader &NewDataFile);
+	void DropPrepared();
+
 public:
 	CMap();
 
@@ -32,7 +43,9 @@ public:
 	void *FindItem(int Type, int Id) override;
 	int NumItems() const override;
 
-	[[nodiscard]] bool Load(const char *pMapName) override;
+	[[nodiscard]] bool Load(const char *pMapName, bool MemoryMap = false) override;
+	[[nodiscard]] bool Prepare(const char *pMapName, bool MemoryMap = false) override;
+	[[nodiscard]] bool LoadPrepared(const char *pMapName) override;
 	void Unload() override;
 	bool IsLoaded() const override;
 	IOHANDLE File() const override;
@@ -40,6 +53,7 @@ public:
 	SHA256_DIGEST Sha256() const override;
 	unsigned Crc() const override;
 	int MapSize() const override;
+	const void *MappedData() const override;
 
 	static void ExtractTiles(class CTile *pDest, size_t DestSize, const class CTile *pSrc, size_t SrcSize);
 };
@@ -4,109 +4,342 @@
 
 #include <engine/console.h>
 #include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
 #include <engine/storage.h>
 
-CNetBan::CNetHash::CNetHash(const NETADDR *pAddr)
+static int PrefixWidth(const NETADDR *pAddr)
 {
-	if(pAddr->type == NETTYPE_IPV4)
-		m_Hash = (pAddr->ip[0] + pAddr->ip[1] + pAddr->ip[2] + pAddr->ip[3]) & 0xFF;
+	return pAddr->type == NETTYPE_IPV4 ? 32 : 128;
+}
+
+// ban lists usually write IPv6 addresses without brackets
+static int ParseBanListAddr(NETADDR *pAddr, const char *pStr)
+{
+	if(pStr[0] != '[' && str_find(pStr, ":"))
+	{
+		char aBracketed[NETADDR_MAXSTRSIZE];
+		str_format(aBracketed, sizeof(aBracketed), "[%s]", pStr);
+		return net_addr_from_str(pAddr, aBracketed);
+	}
+	return net_addr_from_str(pAddr, pStr);
+}
+
+CNetBan::CPrefix CNetBan::MakePrefix(const NETADDR *pAddr)
+{
+	const int Width = PrefixWidth(pAddr);
+	CPrefix Prefix = {{0, 0}, Width};
+	for(int i = 0; i < Width / 8; i++)
+		Prefix.m_aKey[i / 8] |= (uint64_t)pAddr->ip[i] << (56 - (i % 8) * 8);
+	return Prefix;
+}
+
+void CNetBan::MakePrefixes(const NETADDR *pAddr, std::vector<CPrefix> *pvPrefixes)
+{
+	pvPrefixes->push_back(MakePrefix(pAddr));
+}
+
+void CNetBan::MakePrefixes(const CNetRange *pRange, std::vector<CPrefix> *pvPrefixes)
+{
+	const int Width = PrefixWidth(&pRange->m_LB);
+	CPrefix Low = MakePrefix(&pRange->m_LB);
+	const CPrefix High = MakePrefix(&pRange->m_UB);
+	while(true)
+	{
+		// largest aligned block starting at `Low` that doesn't go past `High`
+		int Length = Width;
+		while(Length > 0 && !Low.Bit(Length - 1))
+			Length--;
+		CPrefix Last;
+		while(true)
+		{
+			Last = Low;
+			for(int i = Length; i < Width; i++)
+				Last.SetBit(i, true);
+			if(Last.CompareKey(High) <= 0)
+				break;
+			Length++;
+		}
+		pvPrefixes->push_back({{Low.m_aKey[0], Low.m_aKey[1]}, Length});
+		if(Last.CompareKey(High) == 0)
+			break;
+
+		// continue after the block, can't overflow because `Last` is below `High`
+		Low = Last;
+		int Carry = Width - 1;
+		for(; Low.Bit(Carry); Carry--)
+			Low.SetBit(Carry, false);
+		Low.SetBit(Carry, true);
+	}
+}
+
+CNetBan::CPrefix CNetBan::FirstPrefix(const CNetRange *pRange)
+{
+	std::vector<CPrefix> vPrefixes;
+	MakePrefixes(pRange, &vPrefixes);
+	return vPrefixes.front();
+}
+
+template<class T>
+int CNetBan::CPrefixTrie<T>::NewNode(const CPrefix &Prefix, int Length)
+{
+	int Index;
+	if(m_vFreeNodes.empty())
+	{
+		Index = m_vNodes.size();
+		m_vNodes.emplace_back();
+	}
 	else
-		m_Hash = (pAddr->ip[0] + pAddr->ip[1] + pAddr->ip[2] + pAddr->ip[3] + pAddr->ip[4] + pAddr->ip[5] + pAddr->ip[6] + pAddr->ip[7] +
-				 pAddr->ip[8] + pAddr->ip[9] + pAddr->ip[10] + pAddr->ip[11] + pAddr->ip[12] + pAddr->ip[13] + pAddr->ip[14] + pAddr->ip[15]) &
-			 0xFF;
-	m_HashIndex = 0;
+	{
+		Index = m_vFreeNodes.back();
+		m_vFreeNodes.pop_back();
+	}
+
+	CNode &Node = m_vNodes[Index];
+	Node.m_Prefix.m_Length = Length;
+	for(int Part = 0; Part < 2; Part++)
+	{
+		const int Bits = std::clamp(Length - Part * 64, 0, 64);
+		Node.m_Prefix.m_aKey[Part] = Bits == 0 ? 0 : Prefix.m_aKey[Part] & (~(uint64_t)0 << (64 - Bits));
+	}
+	Node.m_aChildren[0] = -1;
+	Node.m_aChildren[1] = -1;
+	Node.m_FirstValue = -1;
+	return Index;
 }
 
-CNetBan::CNetHash::CNetHash(const CNetRange *pRange)
+template<class T>
+void CNetBan::CPrefixTrie<T>::AddValue(int Node, T *pValue)
 {
-	m_Hash = 0;
-	m_HashIndex = 0;
-	for(int i = 0; pRange->m_LB.ip[i] == pRange->m_UB.ip[i]; ++i)
+	int Value;
+	if(m_FirstFreeValue >= 0)
+	{
+		Value = m_FirstFreeValue;
+		m_FirstFreeValue = m_vValues[Value].m_Next;
+	}
+	else
 	{
-		m_Hash += pRange->m_LB.ip[i];
-		++m_HashIndex;
+		Value = m_vValues.size();
+		m_vValues.emplace_back();
 	}
-	m_Hash &= 0xFF;
+	m_vValues[Value].m_pValue = pValue;
+	m_vValues[Value].m_Next = m_vNodes[Node].m_FirstValue;
+	m_vNodes[Node].m_FirstValue = Value;
+}
+
+template<class T>
+void CNetBan::CPrefixTrie<T>::SetChild(int Parent, int Side, int Child)
+{
+	if(Parent < 0)
+		m_Root = Child;
+	else
+		m_vNodes[Parent].m_aChildren[Side] = Child;
 }
 
-int CNetBan::CNetHash::MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
+template<class T>
+void CNetBan::CPrefixTrie<T>::FillJumps(int Index, int MatchValue)
 {
-	int Length = pAddr->type == NETTYPE_IPV4 ? 4 : 16;
-	aHash[0].m_Hash = 0;
-	aHash[0].m_HashIndex = 0;
-	for(int i = 1, Sum = 0; i <= Length; ++i)
+	const CNode &Node = m_vNodes[Index];
+	const int First = Node.m_Prefix.m_aKey[0] >> (64 - JUMP_BITS);
+	if(Node.m_Prefix.m_Length >= JUMP_BITS)
+	{
+		m_vJumps[First] = {Index, MatchValue};
+		return;
+	}
+
+	if(Node.m_FirstValue >= 0)
+		MatchValue = Node.m_FirstValue;
+	const int Half = 1 << (JUMP_BITS - Node.m_Prefix.m_Length - 1);
+	for(int Side = 0; Side < 2; Side++)
 	{
-		Sum += pAddr->ip[i - 1];
-		aHash[i].m_Hash = Sum & 0xFF;
-		aHash[i].m_HashIndex = i % Length;
+		// addresses that aren't below the child end at this node
+		std::fill_n(m_vJumps.begin() + First + Side * Half, Half, CJump{-1, MatchValue});
+		if(Node.m_aChildren[Side] >= 0)
+			FillJumps(Node.m_aChildren[Side], MatchValue);
 	}
-	return Length;
 }
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::InsertUsed(CBan<T> *pBan)
+template<class T>
+void CNetBan::CPrefixTrie<T>::UpdateJumps()
+{
+	if(m_JumpsValid || NumNodes() < JUMP_MIN_NODES)
+		return;
+
+	// addresses outside of the root's prefix match nothing
+	m_vJumps.assign(1 << JUMP_BITS, CJump{-1, -1});
+	FillJumps(m_Root, -1);
+	m_JumpsValid = true;
+}
+
+template<class T>
+void CNetBan::CPrefixTrie<T>::Insert(const CPrefix &Prefix, T *pValue)
 {
-	if(m_pFirstUsed)
+	m_JumpsValid = false;
+	int Parent = -1;
+	int Side = 0;
+	int Index = m_Root;
+	while(Index >= 0)
 	{
-		for(CBan<T> *p = m_pFirstUsed;; p = p->m_pNext)
+		const CPrefix &NodePrefix = m_vNodes[Index].m_Prefix;
+		const int Common = NodePrefix.CommonLength(Prefix, minimum(NodePrefix.m_Length, Prefix.m_Length));
+		if(Common == NodePrefix.m_Length)
 		{
-			if(p->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || (pBan->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && pBan->m_Info.m_Expires <= p->m_Info.m_Expires))
+			if(Common == Prefix.m_Length)
 			{
-				// insert before
-				pBan->m_pNext = p;
-				pBan->m_pPrev = p->m_pPrev;
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = pBan;
-				else
-					m_pFirstUsed = pBan;
-				p->m_pPrev = pBan;
-				break;
+				AddValue(Index, pValue);
+				return;
 			}
+			Parent = Index;
+			Side = Prefix.Bit(Common);
+			Index = m_vNodes[Index].m_aChildren[Side];
+			continue;
+		}
 
-			if(!p->m_pNext)
-			{
-				// last entry
-				p->m_pNext = pBan;
-				pBan->m_pPrev = p;
-				pBan->m_pNext = 0;
-				break;
-			}
+		// the prefixes differ inside of this node, put a new node above it
+		const int OldSide = NodePrefix.Bit(Common);
+		const int Split = NewNode(Prefix, Common);
+		if(Common == Prefix.m_Length)
+		{
+			AddValue(Split, pValue);
+		}
+		else
+		{
+			const int Leaf = NewNode(Prefix, Prefix.m_Length);
+			AddValue(Leaf, pValue);
+			m_vNodes[Split].m_aChildren[!OldSide] = Leaf;
 		}
+		m_vNodes[Split].m_aChildren[OldSide] = Index;
+		SetChild(Parent, Side, Split);
+		return;
 	}
-	else
+
+	const int Leaf = NewNode(Prefix, Prefix.m_Length);
+	AddValue(Leaf, pValue);
+	SetChild(Parent, Side, Leaf);
+}
+
+template<class T>
+void CNetBan::CPrefixTrie<T>::Remove(const CPrefix &Prefix, T *pValue)
+{
+	m_JumpsValid = false;
+	// nodes from the root to the prefix, their lengths strictly increase
+	int aPath[129 + 1];
+	int Depth = 0;
+	for(int Index = m_Root;;)
 	{
-		m_pFirstUsed = pBan;
-		pBan->m_pNext = pBan->m_pPrev = 0;
+		dbg_assert(Index >= 0, "prefix not in trie");
+		const CNode &Node = m_vNodes[Index];
+		dbg_assert(Node.m_Prefix.m_Length <= Prefix.m_Length && Node.m_Prefix.CommonLength(Prefix, Node.m_Prefix.m_Length) == Node.m_Prefix.m_Length, "prefix not in trie");
+		aPath[Depth++] = Index;
+		if(Node.m_Prefix.m_Length == Prefix.m_Length)
+			break;
+		Index = Node.m_aChildren[Prefix.Bit(Node.m_Prefix.m_Length)];
+	}
+
+	int *pLink = &m_vNodes[aPath[Depth - 1]].m_FirstValue;
+	while(*pLink >= 0 && m_vValues[*pLink].m_pValue != pValue)
+		pLink = &m_vValues[*pLink].m_Next;
+	dbg_assert(*pLink >= 0, "value not in trie");
+	const int Value = *pLink;
+	*pLink = m_vValues[Value].m_Next;
+	m_vValues[Value].m_Next = m_FirstFreeValue;
+	m_FirstFreeValue = Value;
+
+	// drop nodes that neither hold values nor join two branches
+	const auto &&Replace = [&](int PathIndex, int Child) {
+		const int Parent = PathIndex > 0 ? aPath[PathIndex - 1] : -1;
+		SetChild(Parent, Parent < 0 ? 0 : Prefix.Bit(m_vNodes[Parent].m_Prefix.m_Length), Child);
+		m_vFreeNodes.push_back(aPath[PathIndex]);
+	};
+	for(int PathIndex = Depth - 1; PathIndex >= 0; PathIndex--)
+	{
+		const CNode &Node = m_vNodes[aPath[PathIndex]];
+		if(Node.m_FirstValue >= 0 || (Node.m_aChildren[0] >= 0 && Node.m_aChildren[1] >= 0))
+			break;
+		const int Child = Node.m_aChildren[0] >= 0 ? Node.m_aChildren[0] : Node.m_aChildren[1];
+		Replace(PathIndex, Child);
+		// a parent that is left with one branch can be dropped as well
+		if(Child >= 0)
+			break;
 	}
 }
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData, const CBanInfo *pInfo, const CNetHash *pNetHash)
+template<class T>
+void CNetBan::CPrefixTrie<T>::Reset()
+{
+	m_vNodes.clear();
+	m_vFreeNodes.clear();
+	m_vValues.clear();
+	m_FirstFreeValue = -1;
+	m_Root = -1;
+	m_vJumps.clear();
+	m_JumpsValid = false;
+}
+
+template<class T>
+void CNetBan::CBanPool<T>::LinkExpiry(CBan<T> *pBan)
+{
+	pBan->m_pExpiryPrev = nullptr;
+	pBan->m_pExpiryNext = nullptr;
+	if(pBan->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER)
+		return;
+
+	CBan<T> *&pSlot = m_apExpiryWheel[pBan->m_Info.m_Expires % EXPIRY_WHEEL_SIZE];
+	if(pSlot)
+		pSlot->m_pExpiryPrev = pBan;
+	pBan->m_pExpiryNext = pSlot;
+	pSlot = pBan;
+}
+
+template<class T>
+void CNetBan::CBanPool<T>::UnlinkExpiry(CBan<T> *pBan)
+{
+	if(pBan->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER)
+		return;
+
+	if(pBan->m_pExpiryNext)
+		pBan->m_pExpiryNext->m_pExpiryPrev = pBan->m_pExpiryPrev;
+	if(pBan->m_pExpiryPrev)
+		pBan->m_pExpiryPrev->m_pExpiryNext = pBan->m_pExpiryNext;
+	else
+		m_apExpiryWheel[pBan->m_Info.m_Expires % EXPIRY_WHEEL_SIZE] = pBan->m_pExpiryNext;
+	pBan->m_pExpiryNext = pBan->m_pExpiryPrev = nullptr;
+}
+
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T>::Add(const T *pData, const CBanInfo *pInfo)
 {
 	if(!m_pFirstFree)
-		return nullptr;
+	{
+		m_vpChunks.push_back(std::make_unique<CBan<T>[]>(CHUNK_SIZE));
+		CBan<T> *pChunk = m_vpChunks.back().get();
+		for(int i = 0; i < CHUNK_SIZE - 1; ++i)
+			pChunk[i].m_pNext = &pChunk[i + 1];
+		pChunk[CHUNK_SIZE - 1].m_pNext = nullptr;
+		m_pFirstFree = pChunk;
+	}
 
 	// create new ban
 	CBan<T> *pBan = m_pFirstFree;
+	m_pFirstFree = pBan->m_pNext;
 	pBan->m_Data = *pData;
 	pBan->m_Info = *pInfo;
-	pBan->m_NetHash = *pNetHash;
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
+
+	// append it to the used list
+	pBan->m_pNext = nullptr;
+	pBan->m_pPrev = m_pLastUsed;
+	if(m_pLastUsed)
+		m_pLastUsed->m_pNext = pBan;
 	else
-		m_pFirstFree = pBan->m_pNext;
+		m_pFirstUsed = pBan;
+	m_pLastUsed = pBan;
 
-	// add it to the hash list
-	if(m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash])
-		m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]->m_pHashPrev = pBan;
-	pBan->m_pHashPrev = 0;
-	pBan->m_pHashNext = m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash];
-	m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash] = pBan;
+	LinkExpiry(pBan);
 
-	// insert it into the used list
-	InsertUsed(pBan);
+	// make it findable by all addresses it covers
+	m_vPrefixes.clear();
+	MakePrefixes(pData, &m_vPrefixes);
+	for(const CPrefix &Prefix : m_vPrefixes)
+		m_aTries[Family(pData)].Insert(Prefix, pBan);
 
 	// update ban count
 	++m_CountUsed;
@@ -114,33 +347,31 @@ typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData,
 	return pBan;
 }
 
-template<class T, int HashCount>
-int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
+template<class T>
+int CNetBan::CBanPool<T>::Remove(CBan<T> *pBan)
 {
 	if(pBan == nullptr)
 		return -1;
 
-	// remove from hash list
-	if(pBan->m_pHashNext)
-		pBan->m_pHashNext->m_pHashPrev = pBan->m_pHashPrev;
-	if(pBan->m_pHashPrev)
-		pBan->m_pHashPrev->m_pHashNext = pBan->m_pHashNext;
-	else
-		m_aapHashList[pBan->m_NetHash.m_HashIndex][pBan->m_NetHash.m_Hash] = pBan->m_pHashNext;
-	pBan->m_pHashNext = pBan->m_pHashPrev = 0;
+	m_vPrefixes.clear();
+	MakePrefixes(&pBan->m_Data, &m_vPrefixes);
+	for(const CPrefix &Prefix : m_vPrefixes)
+		m_aTries[Family(&pBan->m_Data)].Remove(Prefix, pBan);
+
+	UnlinkExpiry(pBan);
 
 	// remove from used list
 	if(pBan->m_pNext)
 		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
+	else
+		m_pLastUsed = pBan->m_pPrev;
 	if(pBan->m_pPrev)
 		pBan->m_pPrev->m_pNext = pBan->m_pNext;
 	else
 		m_pFirstUsed = pBan->m_pNext;
 
 	// add to recycle list
-	if(m_pFirstFree)
-		m_pFirstFree->m_pPrev = pBan;
-	pBan->m_pPrev = 0;
+	pBan->m_pPrev = nullptr;
 	pBan->m_pNext = m_pFirstFree;
 	m_pFirstFree = pBan;
 
@@ -150,50 +381,63 @@ int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
 	return 0;
 }
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
+template<class T>
+void CNetBan::CBanPool<T>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
 {
+	UnlinkExpiry(pBan);
 	pBan->m_Info = *pInfo;
+	LinkExpiry(pBan);
+}
 
-	// remove from used list
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
-	else
-		m_pFirstUsed = pBan->m_pNext;
+template<class T>
+void CNetBan::CBanPool<T>::Optimize()
+{
+	for(auto &Trie : m_aTries)
+		Trie.UpdateJumps();
+}
 
-	// insert it into the used list
-	InsertUsed(pBan);
+template<class T>
+void CNetBan::CBanPool<T>::CollectExpired(int64_t Now, std::vector<CBan<CDataType> *> *pvpExpired)
+{
+	// visit the slots of the seconds since the last call, each slot at most once
+	const int64_t First = maximum(m_ExpiryCursor, Now - (int64_t)EXPIRY_WHEEL_SIZE);
+	for(int64_t Second = First; Second < Now; ++Second)
+	{
+		for(CBan<T> *pBan = m_apExpiryWheel[Second % EXPIRY_WHEEL_SIZE]; pBan; pBan = pBan->m_pExpiryNext)
+		{
+			if(pBan->m_Info.m_Expires < Now)
+				pvpExpired->push_back(pBan);
+		}
+	}
+	m_ExpiryCursor = Now;
 }
 
+// used by the tests and derived classes as well
+template class CNetBan::CBanPool<NETADDR>;
+template class CNetBan::CBanPool<CNetRange>;
+
 void CNetBan::UnbanAll()
 {
 	m_BanAddrPool.Reset();
 	m_BanRangePool.Reset();
 }
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Reset()
+template<class T>
+void CNetBan::CBanPool<T>::Reset()
 {
-	mem_zero(m_aapHashList, sizeof(m_aapHashList));
-	mem_zero(m_aBans, sizeof(m_aBans));
-	m_pFirstUsed = 0;
+	m_vpChunks.clear();
+	for(auto &Trie : m_aTries)
+		Trie.Reset();
+	mem_zero(m_apExpiryWheel, sizeof(m_apExpiryWheel));
+	m_ExpiryCursor = 0;
+	m_pFirstFree = nullptr;
+	m_pFirstUsed = nullptr;
+	m_pLastUsed = nullptr;
 	m_CountUsed = 0;
-
-	for(int i = 1; i < MAX_BANS - 1; ++i)
-	{
-		m_aBans[i].m_pNext = &m_aBans[i + 1];
-		m_aBans[i].m_pPrev = &m_aBans[i - 1];
-	}
-
-	m_aBans[0].m_pNext = &m_aBans[1];
-	m_aBans[MAX_BANS - 1].m_pPrev = &m_aBans[MAX_BANS - 2];
-	m_pFirstFree = &m_aBans[0];
 }
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Get(int Index) const
+template<class T>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T>::Get(int Index) const
 {
 	if(Index < 0 || Index >= Num())
 		return nullptr;
@@ -226,8 +470,7 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	str_copy(Info.m_aReason, pReason);
 
 	// check if it already exists
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		// adjust the ban
@@ -239,24 +482,17 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	}
 
 	// add ban and print result
-	pBan = pBanPool->Add(pData, &Info, &NetHash);
-	if(pBan)
-	{
-		char aBuf[256];
-		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return 0;
-	}
-	else
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (full banlist)");
-	return -1;
+	pBan = pBanPool->Add(pData, &Info);
+	char aBuf[256];
+	MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return 0;
 }
 
 template<class T>
 int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 {
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		char aBuf[256];
@@ -270,6 +506,22 @@ int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 	return -1;
 }
 
+template<class T>
+int CNetBan::ImportBan(T *pBanPool, const typename T::CDataType *pData, const CBanInfo *pInfo)
+{
+	if(NetMatch(pData, &m_LocalhostIpV4) || NetMatch(pData, &m_LocalhostIpV6))
+		return -1;
+
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
+	if(pBan)
+	{
+		pBanPool->Update(pBan, pInfo);
+		return 1;
+	}
+	pBanPool->Add(pData, pInfo);
+	return 0;
+}
+
 void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 {
 	m_pConsole = pConsole;
@@ -288,6 +540,7 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	Console()->Register("bans", "?i[page]", CFGFLAG_SERVER | CFGFLAG_MASTER, ConBans, this, "Show banlist (page 1 by default, 20 entries per page)");
 	Console()->Register("bans_find", "s[ip]", CFGFLAG_SERVER | CFGFLAG_MASTER, ConBansFind, this, "Find all ban records for the specified IP address");
 	Console()->Register("bans_save", "s[file]", CFGFLAG_SERVER | CFGFLAG_MASTER | CFGFLAG_STORE, ConBansSave, this, "Save banlist in a file");
+	Console()->Register("bans_import", "s[file] ?i[minutes] ?r[reason]", CFGFLAG_SERVER | CFGFLAG_MASTER | CFGFLAG_STORE, ConBansImport, this, "Ban all addresses, CIDR prefixes and ranges listed in a file (permanently by default)");
 }
 
 void CNetBan::Update()
@@ -296,18 +549,25 @@ void CNetBan::Update()
 
 	// remove expired bans
 	char aBuf[256], aNetStr[256];
-	while(m_BanAddrPool.First() && m_BanAddrPool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanAddrPool.First()->m_Info.m_Expires < Now)
+	std::vector<CBanAddr *> vpExpiredAddrs;
+	m_BanAddrPool.CollectExpired(Now, &vpExpiredAddrs);
+	for(CBanAddr *pBan : vpExpiredAddrs)
 	{
-		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanAddrPool.First()->m_Data, aNetStr, sizeof(aNetStr)));
+		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&pBan->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanAddrPool.Remove(m_BanAddrPool.First());
+		m_BanAddrPool.Remove(pBan);
 	}
-	while(m_BanRangePool.First() && m_BanRangePool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanRangePool.First()->m_Info.m_Expires < Now)
+	std::vector<CBanRange *> vpExpiredRanges;
+	m_BanRangePool.CollectExpired(Now, &vpExpiredRanges);
+	for(CBanRange *pBan : vpExpiredRanges)
 	{
-		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanRangePool.First()->m_Data, aNetStr, sizeof(aNetStr)));
+		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&pBan->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanRangePool.Remove(m_BanRangePool.First());
+		m_BanRangePool.Remove(pBan);
 	}
+
+	m_BanAddrPool.Optimize();
+	m_BanRangePool.Optimize();
 }
 
 int CNetBan::BanAddr(const NETADDR *pAddr, int Seconds, const char *pReason, bool VerbatimReason)
@@ -385,11 +645,9 @@ bool CNetBan::IsBanned(const NETADDR *pOrigAddr, char *pBuf, unsigned BufferSize
 		pAddr = &Addr;
 		Addr.type = NETTYPE_IPV6;
 	}
-	CNetHash aHash[17];
-	int Length = CNetHash::MakeHashArray(pAddr, aHash);
 
 	// check ban addresses
-	CBanAddr *pBan = m_BanAddrPool.Find(pAddr, &aHash[Length]);
+	CBanAddr *pBan = m_BanAddrPool.Match(pAddr);
 	if(pBan)
 	{
 		MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
@@ -397,19 +655,106 @@ bool CNetBan::IsBanned(const NETADDR *pOrigAddr, char *pBuf, unsigned BufferSize
 	}
 
 	// check ban ranges
-	for(int i = Length - 1; i >= 0; --i)
+	CBanRange *pBanRange = m_BanRangePool.Match(pAddr);
+	if(pBanRange)
 	{
-		for(CBanRange *pBanRange = m_BanRangePool.First(&aHash[i]); pBanRange; pBanRange = pBanRange->m_pHashNext)
+		MakeBanInfo(pBanRange, pBuf, BufferSize, MSGTYPE_PLAYER);
+		return true;
+	}
+
+	return false;
+}
+
+int CNetBan::ImportBans(const char *pFilename, int Seconds, const char *pReason)
+{
+	char aBuf[256];
+	CLineReader LineReader;
+	if(!LineReader.OpenFile(Storage()->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL)))
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to open ban file '%s'", pFilename);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+		return -1;
+	}
+
+	CBanInfo Info = {0};
+	Info.m_Expires = Seconds > 0 ? time_timestamp() + Seconds : static_cast<int64_t>(CBanInfo::EXPIRES_NEVER);
+	Info.m_VerbatimReason = false;
+	str_copy(Info.m_aReason, pReason);
+
+	int Added = 0;
+	int Updated = 0;
+	int Invalid = 0;
+	int LineNumber = 0;
+	while(const char *pLine = LineReader.Get())
+	{
+		LineNumber++;
+		// the entry is the first word, the rest of the line is a comment
+		char aEntry[128];
+		pLine = str_skip_whitespaces_const(pLine);
+		int Length = 0;
+		while(pLine[Length] && !str_isspace(pLine[Length]) && pLine[Length] != '#' && pLine[Length] != ';')
+			Length++;
+		if(Length == 0)
+			continue;
+		str_truncate(aEntry, sizeof(aEntry), pLine, Length);
+
+		int Result = -1;
+		CNetRange Range;
+		char *pSeparator;
+		if((pSeparator = (char *)str_find(aEntry, "-")))
+		{
+			*pSeparator = '\0';
+			if(ParseBanListAddr(&Range.m_LB, aEntry) == 0 && ParseBanListAddr(&Range.m_UB, pSeparator + 1) == 0 && Range.IsValid())
+				Result = ImportBan(&m_BanRangePool, &Range, &Info);
+		}
+		else if((pSeparator = (char *)str_find(aEntry, "/")))
 		{
-			if(NetMatch(&pBanRange->m_Data, pAddr, i, Length))
+			*pSeparator = '\0';
+			int Bits;
+			if(ParseBanListAddr(&Range.m_LB, aEntry) == 0 && str_toint(pSeparator + 1, &Bits) && Bits > 0 && Bits <= PrefixWidth(&Range.m_LB))
 			{
-				MakeBanInfo(pBanRange, pBuf, BufferSize, MSGTYPE_PLAYER);
-				return true;
+				const int Width = PrefixWidth(&Range.m_LB);
+				if(Bits == Width)
+				{
+					Result = ImportBan(&m_BanAddrPool, &Range.m_LB, &Info);
+				}
+				else
+				{
+					// clear the host bits for the first address and set them for the last one
+					Range.m_UB = Range.m_LB;
+					for(int i = Bits; i < Width; i++)
+					{
+						const unsigned char Mask = 1 << (7 - i % 8);
+						Range.m_LB.ip[i / 8] &= ~Mask;
+						Range.m_UB.ip[i / 8] |= Mask;
+					}
+					Result = ImportBan(&m_BanRangePool, &Range, &Info);
+				}
 			}
 		}
+		else if(ParseBanListAddr(&Range.m_LB, aEntry) == 0)
+		{
+			Result = ImportBan(&m_BanAddrPool, &Range.m_LB, &Info);
+		}
+
+		if(Result == 0)
+			Added++;
+		else if(Result == 1)
+			Updated++;
+		else
+		{
+			Invalid++;
+			str_format(aBuf, sizeof(aBuf), "skipped '%s' in line %d of '%s'", aEntry, LineNumber, pFilename);
+			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "net_ban", aBuf);
+		}
 	}
 
-	return false;
+	m_BanAddrPool.Optimize();
+	m_BanRangePool.Optimize();
+
+	str_format(aBuf, sizeof(aBuf), "imported '%s': %d bans added, %d updated, %d entries skipped", pFilename, Added, Updated, Invalid);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return Added;
 }
 
 void CNetBan::ConBan(IConsole::IResult *pResult, void *pUser)
@@ -626,3 +971,12 @@ void CNetBan::ConBansSave(IConsole::IResult *pResult, void *pUser)
 	str_format(aBuf, sizeof(aBuf), "saved banlist to '%s'", pResult->GetString(0));
 	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 }
+
+void CNetBan::ConBansImport(IConsole::IResult *pResult, void *pUser)
+{
+	CNetBan *pThis = static_cast<CNetBan *>(pUser);
+
+	const int Minutes = pResult->NumArguments() > 1 ? std::clamp(pResult->GetInteger(1), 0, 525600) : 0;
+	const char *pReason = pResult->NumArguments() > 2 ? pResult->GetString(2) : "No reason given";
+	pThis->ImportBans(pResult->GetString(0), Minutes * 60, pReason);
+}
@@ -5,6 +5,10 @@
 
 #include <engine/console.h>
 
+#include <bit>
+#include <memory>
+#include <vector>
+
 inline int NetComp(const NETADDR *pAddr1, const NETADDR *pAddr2)
 {
 	return mem_comp(pAddr1, pAddr2, pAddr1->type == NETTYPE_IPV4 ? 8 : 20);
@@ -60,17 +64,155 @@ protected:
 		return pBuffer;
 	}
 
-	class CNetHash
+	// An address prefix, the address is stored as a big endian 128 bit
+	// number, IPv4 addresses only use the first 32 bits.
+	struct CPrefix
+	{
+		uint64_t m_aKey[2];
+		int m_Length;
+
+		int Bit(int Index) const { return (m_aKey[Index / 64] >> (63 - Index % 64)) & 1; }
+		void SetBit(int Index, bool Set)
+		{
+			const uint64_t Mask = (uint64_t)1 << (63 - Index % 64);
+			m_aKey[Index / 64] = Set ? m_aKey[Index / 64] | Mask : m_aKey[Index / 64] & ~Mask;
+		}
+		int CompareKey(const CPrefix &Other) const
+		{
+			if(m_aKey[0] != Other.m_aKey[0])
+				return m_aKey[0] < Other.m_aKey[0] ? -1 : 1;
+			if(m_aKey[1] != Other.m_aKey[1])
+				return m_aKey[1] < Other.m_aKey[1] ? -1 : 1;
+			return 0;
+		}
+		// Number of leading bits both keys share, at most `MaxLength`.
+		int CommonLength(const CPrefix &Other, int MaxLength) const
+		{
+			const uint64_t Diff = m_aKey[0] ^ Other.m_aKey[0];
+			const int Common = Diff ? std::countl_zero(Diff) : 64 + std::countl_zero(m_aKey[1] ^ Other.m_aKey[1]);
+			return Common < MaxLength ? Common : MaxLength;
+		}
+	};
+
+	enum
+	{
+		FAMILY_IPV4 = 0,
+		FAMILY_IPV6,
+		NUM_FAMILIES,
+	};
+
+	static int Family(const NETADDR *pAddr) { return pAddr->type == NETTYPE_IPV4 ? FAMILY_IPV4 : FAMILY_IPV6; }
+	static int Family(const CNetRange *pRange) { return Family(&pRange->m_LB); }
+	static CPrefix MakePrefix(const NETADDR *pAddr);
+	// The prefixes covering exactly the banned addresses.
+	static void MakePrefixes(const NETADDR *pAddr, std::vector<CPrefix> *pvPrefixes);
+	static void MakePrefixes(const CNetRange *pRange, std::vector<CPrefix> *pvPrefixes);
+	static CPrefix FirstPrefix(const NETADDR *pAddr) { return MakePrefix(pAddr); }
+	static CPrefix FirstPrefix(const CNetRange *pRange);
+
+	// Compressed binary trie of prefixes, each node stores the values
+	// added for its prefix. Nodes without values only exist where two
+	// branches meet.
+	template<class T>
+	class CPrefixTrie
 	{
 	public:
-		int m_Hash;
-		int m_HashIndex; // matching parts for ranges, 0 for addr
+		void Insert(const CPrefix &Prefix, T *pValue);
+		void Remove(const CPrefix &Prefix, T *pValue);
+		void Reset();
+
+		// Value added for exactly this prefix that `Predicate` accepts.
+		template<class F>
+		T *Find(const CPrefix &Prefix, const F &Predicate) const
+		{
+			for(int Index = m_Root; Index >= 0;)
+			{
+				const CNode &Node = m_vNodes[Index];
+				if(Node.m_Prefix.m_Length > Prefix.m_Length || Node.m_Prefix.CommonLength(Prefix, Node.m_Prefix.m_Length) < Node.m_Prefix.m_Length)
+					return nullptr;
+				if(Node.m_Prefix.m_Length == Prefix.m_Length)
+				{
+					for(int Value = Node.m_FirstValue; Value >= 0; Value = m_vValues[Value].m_Next)
+					{
+						if(Predicate(m_vValues[Value].m_pValue))
+							return m_vValues[Value].m_pValue;
+					}
+					return nullptr;
+				}
+				Index = Node.m_aChildren[Prefix.Bit(Node.m_Prefix.m_Length)];
+			}
+			return nullptr;
+		}
+
+		// First value of the longest prefix containing the address, the
+		// address must be at least `JUMP_BITS` long.
+		T *Match(const CPrefix &Addr) const
+		{
+			int Index = m_Root;
+			int MatchValue = -1;
+			if(m_JumpsValid)
+			{
+				const CJump &Jump = m_vJumps[Addr.m_aKey[0] >> (64 - JUMP_BITS)];
+				Index = Jump.m_Node;
+				MatchValue = Jump.m_MatchValue;
+			}
+			while(Index >= 0)
+			{
+				const CNode &Node = m_vNodes[Index];
+				if(Node.m_Prefix.CommonLength(Addr, Node.m_Prefix.m_Length) < Node.m_Prefix.m_Length)
+					break;
+				if(Node.m_FirstValue >= 0)
+					MatchValue = Node.m_FirstValue;
+				if(Node.m_Prefix.m_Length == Addr.m_Length)
+					break;
+				Index = Node.m_aChildren[Addr.Bit(Node.m_Prefix.m_Length)];
+			}
+			return MatchValue >= 0 ? m_vValues[MatchValue].m_pValue : nullptr;
+		}
+
+		// Rebuilds the table that lets `Match` skip the first levels of
+		// large tries, changes invalidate it.
+		void UpdateJumps();
 
-		CNetHash() = default;
-		CNetHash(const NETADDR *pAddr);
-		CNetHash(const CNetRange *pRange);
+		int NumNodes() const { return m_vNodes.size() - m_vFreeNodes.size(); }
 
-		static int MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17]);
+	private:
+		// kept small, lookups mostly wait for nodes to be loaded
+		struct CNode
+		{
+			CPrefix m_Prefix;
+			int m_aChildren[2];
+			int m_FirstValue;
+		};
+		struct CValue
+		{
+			T *m_pValue;
+			int m_Next;
+		};
+		// where to continue for addresses starting with the index
+		struct CJump
+		{
+			int m_Node;
+			int m_MatchValue;
+		};
+		enum
+		{
+			JUMP_BITS = 16,
+			JUMP_MIN_NODES = 1024,
+		};
+
+		int NewNode(const CPrefix &Prefix, int Length);
+		void SetChild(int Parent, int Side, int Child);
+		void AddValue(int Node, T *pValue);
+		void FillJumps(int Index, int MatchValue);
+
+		std::vector<CNode> m_vNodes;
+		std::vector<int> m_vFreeNodes;
+		std::vector<CValue> m_vValues;
+		int m_FirstFreeValue = -1;
+		int m_Root = -1;
+		std::vector<CJump> m_vJumps;
+		bool m_JumpsValid = false;
 	};
 
 	struct CBanInfo
@@ -90,62 +232,71 @@ protected:
 	{
 		T m_Data;
 		CBanInfo m_Info;
-		CNetHash m_NetHash;
 
-		// hash list
-		CBan *m_pHashNext;
-		CBan *m_pHashPrev;
+		// expiry wheel slot
+		CBan *m_pExpiryNext;
+		CBan *m_pExpiryPrev;
 
 		// used or free list
 		CBan *m_pNext;
 		CBan *m_pPrev;
 	};
 
-	template<class T, int HashCount>
+	template<class T>
 	class CBanPool
 	{
 	public:
 		typedef T CDataType;
 
-		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo, const CNetHash *pNetHash);
+		CBanPool() { Reset(); }
+		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo);
 		int Remove(CBan<CDataType> *pBan);
 		void Update(CBan<CDataType> *pBan, const CBanInfo *pInfo);
 		void Reset();
+		// Speeds up `Match` after bans were added or removed.
+		void Optimize();
+		// Appends the bans that expired before `Now`, they stay in the pool.
+		void CollectExpired(int64_t Now, std::vector<CBan<CDataType> *> *pvpExpired);
 
 		int Num() const { return m_CountUsed; }
-		bool IsFull() const { return m_CountUsed == MAX_BANS; }
 
+		// bans in the order they were added
 		CBan<CDataType> *First() const { return m_pFirstUsed; }
-		CBan<CDataType> *First(const CNetHash *pNetHash) const { return m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; }
-		CBan<CDataType> *Find(const CDataType *pData, const CNetHash *pNetHash) const
+		CBan<CDataType> *Find(const CDataType *pData) const
 		{
-			for(CBan<CDataType> *pBan = m_aapHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; pBan; pBan = pBan->m_pHashNext)
-			{
-				if(NetComp(&pBan->m_Data, pData) == 0)
-					return pBan;
-			}
-
-			return nullptr;
+			return m_aTries[Family(pData)].Find(FirstPrefix(pData), [pData](const CBan<CDataType> *pBan) {
+				return NetComp(&pBan->m_Data, pData) == 0;
+			});
 		}
+		// Returns the most specific ban containing the address.
+		CBan<CDataType> *Match(const NETADDR *pAddr) const { return m_aTries[Family(pAddr)].Match(MakePrefix(pAddr)); }
 		CBan<CDataType> *Get(int Index) const;
 
 	private:
 		enum
 		{
-			MAX_BANS = 2048,
+			CHUNK_SIZE = 256,
+			// bans are put in the slot of the second they expire in, bans
+			// expiring later than this stay in their slot for another round
+			EXPIRY_WHEEL_SIZE = 1024,
 		};
 
-		CBan<CDataType> *m_aapHashList[HashCount][256];
-		CBan<CDataType> m_aBans[MAX_BANS];
+		void LinkExpiry(CBan<CDataType> *pBan);
+		void UnlinkExpiry(CBan<CDataType> *pBan);
+
+		std::vector<std::unique_ptr<CBan<CDataType>[]>> m_vpChunks;
+		CPrefixTrie<CBan<CDataType>> m_aTries[NUM_FAMILIES];
+		std::vector<CPrefix> m_vPrefixes;
+		CBan<CDataType> *m_apExpiryWheel[EXPIRY_WHEEL_SIZE];
+		int64_t m_ExpiryCursor;
 		CBan<CDataType> *m_pFirstFree;
 		CBan<CDataType> *m_pFirstUsed;
+		CBan<CDataType> *m_pLastUsed;
 		int m_CountUsed;
-
-		void InsertUsed(CBan<CDataType> *pBan);
 	};
 
-	typedef CBanPool<NETADDR, 1> CBanAddrPool;
-	typedef CBanPool<CNetRange, 16> CBanRangePool;
+	typedef CBanPool<NETADDR> CBanAddrPool;
+	typedef CBanPool<CNetRange> CBanRangePool;
 	typedef CBan<NETADDR> CBanAddr;
 	typedef CBan<CNetRange> CBanRange;
 
@@ -155,6 +306,8 @@ protected:
 	int Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, const char *pReason, bool VerbatimReason);
 	template<class T>
 	int Unban(T *pBanPool, const typename T::CDataType *pData);
+	template<class T>
+	int ImportBan(T *pBanPool, const typename T::CDataType *pData, const CBanInfo *pInfo);
 
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
@@ -185,6 +338,9 @@ public:
 	int UnbanByIndex(int Index);
 	void UnbanAll();
 	bool IsBanned(const NETADDR *pOrigAddr, char *pBuf, unsigned BufferSize) const;
+	// Bans the addresses, CIDR prefixes and `first-last` ranges listed one
+	// per line in the file. Returns the number of added bans or -1.
+	int ImportBans(const char *pFilename, int Seconds, const char *pReason);
 
 	static void ConBan(class IConsole::IResult *pResult, void *pUser);
 	static void ConBanRange(class IConsole::IResult *pResult, void *pUser);
@@ -194,6 +350,7 @@ public:
 	static void ConBans(class IConsole::IResult *pResult, void *pUser);
 	static void ConBansFind(class IConsole::IResult *pResult, void *pUser);
 	static void ConBansSave(class IConsole::IResult *pResult, void *pUser);
+	static void ConBansImport(class IConsole::IResult *pResult, void *pUser);
 };
 
 template<class T>
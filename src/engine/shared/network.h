@@ -10,6 +10,8 @@
 
 #include <array>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
 class CHuffman;
 class CNetBan;
@@ -398,10 +400,24 @@ public:
 // server side
 class CNetServer
 {
+public:
+	// sums over the flushed batches that sent packets
+	struct CSendBatchTotals
+	{
+		int64_t m_Batches = 0;
+		int64_t m_Packets = 0;
+		int64_t m_Bytes = 0;
+		int64_t m_Syscalls = 0;
+		int64_t m_Failed = 0;
+	};
+
+private:
 	struct CSlot
 	{
 	public:
 		CNetConnection m_Connection;
+		// address this slot is currently filed under in the address indices
+		std::optional<NETADDR> m_IndexedAddr;
 	};
 
 	struct CSpamConn
@@ -412,7 +428,7 @@ class CNetServer
 	};
 
 	NETADDR m_Address;
-	NETSOCKET m_Socket;
+	NETSOCKET m_Socket = nullptr;
 	CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CLIENTS];
 	int m_MaxClients = NET_MAX_CLIENTS;
@@ -434,6 +450,17 @@ class CNetServer
 
 	CNetRecvUnpacker m_RecvUnpacker;
 
+	NETBATCHSTATS m_LastSendBatch = {};
+	CSendBatchTotals m_SendBatchTotals;
+
+	// Slots by peer address and by peer address without port. Entries are
+	// added whenever a slot gets a new peer and removed when its peer is
+	// dropped or moves to another slot. Lookups still check the slot state
+	// and ignore slots beyond `MaxClients()`.
+	std::unordered_map<NETADDR, int> m_AddrSlots;
+	std::unordered_map<NETADDR, std::vector<int>> m_IpSlots;
+	void IndexSlot(int Slot);
+	void UnindexSlot(int Slot);
 	void OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketConstruct &Packet);
 	int OnSixupCtrlMsg(NETADDR &Addr, CNetChunk *pChunk, int ControlMsg, const CNetPacketConstruct &Packet, SECURITY_TOKEN &ResponseToken, SECURITY_TOKEN Token);
 	void OnPreConnMsg(NETADDR &Addr, CNetPacketConstruct &Packet);
@@ -460,6 +487,12 @@ public:
 	int Send(CNetChunk *pChunk);
 	void Update();
 
+	// queue outgoing packets and send them with as few system calls as possible
+	void BeginSendBatch();
+	void FlushSendBatch();
+	const NETBATCHSTATS &LastSendBatch() const { return m_LastSendBatch; }
+	const CSendBatchTotals &SendBatchTotals() const { return m_SendBatchTotals; }
+
 	//
 	void Drop(int ClientId, const char *pReason);
 
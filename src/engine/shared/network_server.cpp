@@ -12,6 +12,8 @@
 #include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
 
+#include <algorithm>
+
 const int g_DummyMapCrc = 0xD6909B17;
 const unsigned char g_aDummyMapData[] = {
 	0x44, 0x41, 0x54, 0x41, 0x04, 0x00, 0x00, 0x00, 0xFA, 0x00, 0x00, 0x00,
@@ -94,6 +96,26 @@ void CNetServer::Close()
 	m_Socket = nullptr;
 }
 
+void CNetServer::BeginSendBatch()
+{
+	if(m_Socket)
+		net_udp_batch_begin(m_Socket);
+}
+
+void CNetServer::FlushSendBatch()
+{
+	if(!m_Socket)
+		return;
+	net_udp_batch_flush(m_Socket, &m_LastSendBatch);
+	if(m_LastSendBatch.packets == 0)
+		return;
+	m_SendBatchTotals.m_Batches++;
+	m_SendBatchTotals.m_Packets += m_LastSendBatch.packets;
+	m_SendBatchTotals.m_Bytes += m_LastSendBatch.bytes;
+	m_SendBatchTotals.m_Syscalls += m_LastSendBatch.syscalls;
+	m_SendBatchTotals.m_Failed += m_LastSendBatch.failed;
+}
+
 void CNetServer::Drop(int ClientId, const char *pReason)
 {
 	// TODO: insert lots of checks here
@@ -102,6 +124,7 @@ void CNetServer::Drop(int ClientId, const char *pReason)
 		m_pfnDelClient(ClientId, pReason, m_pUser);
 
 	m_aSlots[ClientId].m_Connection.Disconnect(pReason);
+	UnindexSlot(ClientId);
 }
 
 void CNetServer::Update()
@@ -150,12 +173,55 @@ void CNetServer::SendControl(NETADDR &Addr, int ControlMsg, const void *pExtra,
 	CNetBase::SendControlMsg(m_Socket, &Addr, 0, ControlMsg, pExtra, ExtraSize, SecurityToken);
 }
 
+static NETADDR AddrWithoutPort(NETADDR Addr)
+{
+	Addr.port = 0;
+	return Addr;
+}
+
+void CNetServer::IndexSlot(int Slot)
+{
+	UnindexSlot(Slot);
+
+	CSlot &IndexedSlot = m_aSlots[Slot];
+	const NETADDR &Addr = *IndexedSlot.m_Connection.PeerAddress();
+	IndexedSlot.m_IndexedAddr = Addr;
+	m_AddrSlots[Addr] = Slot;
+	m_IpSlots[AddrWithoutPort(Addr)].push_back(Slot);
+}
+
+void CNetServer::UnindexSlot(int Slot)
+{
+	CSlot &IndexedSlot = m_aSlots[Slot];
+	if(!IndexedSlot.m_IndexedAddr.has_value())
+		return;
+
+	auto AddrIt = m_AddrSlots.find(*IndexedSlot.m_IndexedAddr);
+	if(AddrIt != m_AddrSlots.end() && AddrIt->second == Slot)
+		m_AddrSlots.erase(AddrIt);
+
+	auto IpIt = m_IpSlots.find(AddrWithoutPort(*IndexedSlot.m_IndexedAddr));
+	if(IpIt != m_IpSlots.end())
+	{
+		std::vector<int> &vSlots = IpIt->second;
+		vSlots.erase(std::remove(vSlots.begin(), vSlots.end(), Slot), vSlots.end());
+		if(vSlots.empty())
+			m_IpSlots.erase(IpIt);
+	}
+	IndexedSlot.m_IndexedAddr.reset();
+}
+
 int CNetServer::NumClientsWithAddr(NETADDR Addr)
 {
+	auto IpIt = m_IpSlots.find(AddrWithoutPort(Addr));
+	if(IpIt == m_IpSlots.end())
+		return 0;
+
 	int FoundAddr = 0;
-	for(int i = 0; i < MaxClients(); ++i)
+	for(int i : IpIt->second)
 	{
-		if(m_aSlots[i].m_Connection.State() == CNetConnection::EState::OFFLINE ||
+		if(i >= MaxClients() ||
+			m_aSlots[i].m_Connection.State() == CNetConnection::EState::OFFLINE ||
 			(m_aSlots[i].m_Connection.State() == CNetConnection::EState::ERROR &&
 				(!m_aSlots[i].m_Connection.m_TimeoutProtected ||
 					!m_aSlots[i].m_Connection.m_TimeoutSituation)))
@@ -246,6 +312,7 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 
 	// init connection slot
 	m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken, Token, Sixup);
+	IndexSlot(Slot);
 
 	if(VanillaAuth)
 	{
@@ -549,14 +616,17 @@ int CNetServer::OnSixupCtrlMsg(NETADDR &Addr, CNetChunk *pChunk, int ControlMsg,
 
 int CNetServer::GetClientSlot(const NETADDR &Addr)
 {
-	for(int i = 0; i < MaxClients(); i++)
+	auto AddrIt = m_AddrSlots.find(Addr);
+	if(AddrIt == m_AddrSlots.end())
+		return -1;
+
+	const int i = AddrIt->second;
+	if(i < MaxClients() &&
+		m_aSlots[i].m_Connection.State() != CNetConnection::EState::OFFLINE &&
+		m_aSlots[i].m_Connection.State() != CNetConnection::EState::ERROR &&
+		net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
 	{
-		if(m_aSlots[i].m_Connection.State() != CNetConnection::EState::OFFLINE &&
-			m_aSlots[i].m_Connection.State() != CNetConnection::EState::ERROR &&
-			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
-		{
-			return i;
-		}
+		return i;
 	}
 	return -1;
 }
@@ -737,6 +807,8 @@ bool CNetServer::SetTimedOut(int ClientId, int OrigId)
 
 	m_aSlots[ClientId].m_Connection.SetTimedOut(ClientAddr(OrigId), m_aSlots[OrigId].m_Connection.SeqSequence(), m_aSlots[OrigId].m_Connection.AckSequence(), m_aSlots[OrigId].m_Connection.SecurityToken(), m_aSlots[OrigId].m_Connection.ResendBuffer(), m_aSlots[OrigId].m_Connection.m_Sixup);
 	m_aSlots[OrigId].m_Connection.Reset();
+	UnindexSlot(OrigId);
+	IndexSlot(ClientId);
 	return true;
 }
 
@@ -33,6 +33,22 @@ void CAbstractPacker::AddInt(int i)
 	m_pCurrent = pNext;
 }
 
+void CAbstractPacker::AddInts(const int *pValues, int Num)
+{
+	if(m_Error)
+		return;
+
+	unsigned char *pNext = CVariableInt::PackArray(m_pCurrent, pValues, Num, m_pEnd - m_pCurrent);
+	if(!pNext)
+	{
+		// add the ints that fit like `AddInt` does
+		for(int i = 0; i < Num; i++)
+			AddInt(pValues[i]);
+		return;
+	}
+	m_pCurrent = pNext;
+}
+
 void CAbstractPacker::AddString(const char *pStr, int Limit, bool AllowTruncation)
 {
 	if(m_Error)
@@ -122,6 +138,19 @@ int CUnpacker::GetInt()
 	return i;
 }
 
+void CUnpacker::GetInts(int *pValues, int Num)
+{
+	const unsigned char *pNext = m_Error ? nullptr : CVariableInt::UnpackArray(m_pCurrent, pValues, Num, m_pEnd - m_pCurrent);
+	if(!pNext)
+	{
+		// get the ints that are there like `GetInt` does
+		for(int i = 0; i < Num; i++)
+			pValues[i] = GetInt();
+		return;
+	}
+	m_pCurrent = pNext;
+}
+
 int CUnpacker::GetIntOrDefault(int Default)
 {
 	if(m_Error)
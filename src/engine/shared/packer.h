@@ -23,6 +23,7 @@ protected:
 public:
 	void Reset();
 	void AddInt(int i);
+	void AddInts(const int *pValues, int Num);
 	void AddString(const char *pStr, int Limit = 0, bool AllowTruncation = true);
 	void AddRaw(const void *pData, int Size);
 
@@ -67,6 +68,7 @@ public:
 
 	void Reset(const void *pData, int Size);
 	int GetInt();
+	void GetInts(int *pValues, int Num);
 	int GetIntOrDefault(int Default);
 	int GetUncompressedInt();
 	int GetUncompressedIntOrDefault(int Default);
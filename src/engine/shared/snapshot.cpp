@@ -14,6 +14,14 @@
 #include <cstdlib>
 #include <limits>
 
+#if defined(CONF_ARCH_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SNAPSHOT_DIFF_SSE2
+#elif defined(CONF_ARCH_ARM64) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SNAPSHOT_DIFF_NEON
+#endif
+
 // CSnapshot
 
 const CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -162,70 +170,84 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 
 // CSnapshotDelta
 
-enum
-{
-	HASHLIST_SIZE = 256,
-	HASHLIST_BUCKET_SIZE = 64,
-};
-
-struct CItemList
-{
-	int m_Num;
-	int m_aKeys[HASHLIST_BUCKET_SIZE];
-	int m_aIndex[HASHLIST_BUCKET_SIZE];
-};
-
-static inline size_t CalcHashId(int Key)
+int CSnapshotItemIndex::MemoryInts(int NumItems)
 {
-	// djb2 (http://www.cse.yorku.ca/~oz/hash.html)
-	unsigned Hash = 5381;
-	for(unsigned Shift = 0; Shift < sizeof(int); Shift++)
-		Hash = ((Hash << 5) + Hash) + ((Key >> (Shift * 8)) & 0xFF);
-	return Hash % HASHLIST_SIZE;
+	int NumSlots = 16;
+	while(NumSlots < 2 * NumItems)
+		NumSlots *= 2;
+	return 2 * NumSlots;
 }
 
-static void GenerateHash(CItemList *pHashlist, const CSnapshot *pSnapshot)
+void CSnapshotItemIndex::Build(const CSnapshot *pSnapshot, int *pMemory)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	const int NumSlots = MemoryInts(pSnapshot->NumItems()) / 2;
+	m_Shift = 32;
+	for(int Slots = NumSlots; Slots > 1; Slots /= 2)
+		m_Shift--;
+	m_pSlots = pMemory;
 
+	// slots are pairs of key and item index, -1 marks free ones
+	for(int i = 0; i < NumSlots; i++)
+		pMemory[2 * i + 1] = -1;
 	for(int i = 0; i < pSnapshot->NumItems(); i++)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		size_t HashId = CalcHashId(Key);
-		if(pHashlist[HashId].m_Num < HASHLIST_BUCKET_SIZE)
+		const int Key = pSnapshot->GetItem(i)->Key();
+		for(int Slot = FirstSlot(Key);; Slot = (Slot + 1) & (NumSlots - 1))
 		{
-			pHashlist[HashId].m_aIndex[pHashlist[HashId].m_Num] = i;
-			pHashlist[HashId].m_aKeys[pHashlist[HashId].m_Num] = Key;
-			pHashlist[HashId].m_Num++;
+			if(pMemory[2 * Slot + 1] == -1)
+			{
+				pMemory[2 * Slot] = Key;
+				pMemory[2 * Slot + 1] = i;
+				break;
+			}
+			if(pMemory[2 * Slot] == Key)
+				break; // keep the first item with the key
 		}
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+int CSnapshotItemIndex::Find(int Key) const
 {
-	size_t HashId = CalcHashId(Key);
-	for(int i = 0; i < pHashlist[HashId].m_Num; i++)
+	if(!m_pSlots)
+		return -1;
+	const int Mask = (1 << (32 - m_Shift)) - 1;
+	for(int Slot = FirstSlot(Key);; Slot = (Slot + 1) & Mask)
 	{
-		if(pHashlist[HashId].m_aKeys[i] == Key)
-			return pHashlist[HashId].m_aIndex[i];
+		if(m_pSlots[2 * Slot + 1] == -1)
+			return -1;
+		if(m_pSlots[2 * Slot] == Key)
+			return m_pSlots[2 * Slot + 1];
 	}
-
-	return -1;
 }
 
 int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
-	while(Size)
+	int i = 0;
+#if defined(SNAPSHOT_DIFF_SSE2)
+	__m128i NeededVec = _mm_setzero_si128();
+	for(; i + 4 <= Size; i += 4)
+	{
+		const __m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent + i)), _mm_loadu_si128((const __m128i *)(pPast + i)));
+		_mm_storeu_si128((__m128i *)(pOut + i), Diff);
+		NeededVec = _mm_or_si128(NeededVec, Diff);
+	}
+	Needed = _mm_movemask_epi8(_mm_cmpeq_epi32(NeededVec, _mm_setzero_si128())) != 0xffff;
+#elif defined(SNAPSHOT_DIFF_NEON)
+	uint32x4_t NeededVec = vdupq_n_u32(0);
+	for(; i + 4 <= Size; i += 4)
+	{
+		const uint32x4_t Diff = vsubq_u32(vld1q_u32((const uint32_t *)(pCurrent + i)), vld1q_u32((const uint32_t *)(pPast + i)));
+		vst1q_u32((uint32_t *)(pOut + i), Diff);
+		NeededVec = vorrq_u32(NeededVec, Diff);
+	}
+	Needed = vmaxvq_u32(NeededVec) != 0;
+#endif
+	for(; i < Size; i++)
 	{
 		// subtraction with wrapping by casting to unsigned
-		*pOut = (unsigned)*pCurrent - (unsigned)*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		pOut[i] = (unsigned)pCurrent[i] - (unsigned)pPast[i];
+		Needed |= pOut[i];
 	}
 
 	return Needed;
@@ -233,25 +255,36 @@ int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, i
 
 void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate)
 {
-	while(Size)
+	int i = 0;
+#if defined(SNAPSHOT_DIFF_SSE2)
+	for(; i + 4 <= Size; i += 4)
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast + i)), _mm_loadu_si128((const __m128i *)(pDiff + i))));
+#elif defined(SNAPSHOT_DIFF_NEON)
+	for(; i + 4 <= Size; i += 4)
+		vst1q_u32((uint32_t *)(pOut + i), vaddq_u32(vld1q_u32((const uint32_t *)(pPast + i)), vld1q_u32((const uint32_t *)(pDiff + i))));
+#endif
+	for(; i < Size; i++)
 	{
 		// addition with wrapping by casting to unsigned
-		*pOut = (unsigned)*pPast + (unsigned)*pDiff;
+		pOut[i] = (unsigned)pPast[i] + (unsigned)pDiff[i];
+	}
 
-		if(*pDiff == 0)
-			*pDataRate += 1;
-		else
+	// bits the diff takes up once packed as variable ints, unchanged ints
+	// count as one bit
+	uint64_t DataRate = 0;
+	for(i = 0; i < Size; i++)
+	{
+		if(pDiff[i] == 0)
 		{
-			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff, sizeof(aBuf));
-			*pDataRate += (uint64_t)(pEnd - (unsigned char *)aBuf) * 8;
+			DataRate += 1;
+			continue;
 		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
+		// 6 bits in the first byte, 7 in each following one
+		const unsigned Value = pDiff[i] < 0 ? ~(unsigned)pDiff[i] : (unsigned)pDiff[i];
+		const int NumBytes = Value < (1u << 6) ? 1 : Value < (1u << 13) ? 2 : Value < (1u << 20) ? 3 : Value < (1u << 27) ? 4 : 5;
+		DataRate += NumBytes * 8;
 	}
+	*pDataRate += DataRate;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -272,6 +305,16 @@ CSnapshotDelta::CSnapshotDelta(const CSnapshotDelta &Old)
 	mem_zero(&m_Empty, sizeof(m_Empty));
 }
 
+CSnapshotDelta &CSnapshotDelta::operator=(const CSnapshotDelta &Old)
+{
+	mem_copy(m_aItemSizes, Old.m_aItemSizes, sizeof(m_aItemSizes));
+	mem_copy(m_aItemSizes7, Old.m_aItemSizes7, sizeof(m_aItemSizes7));
+	mem_copy(m_aSnapshotDataRate, Old.m_aSnapshotDataRate, sizeof(m_aSnapshotDataRate));
+	mem_copy(m_aSnapshotDataUpdates, Old.m_aSnapshotDataUpdates, sizeof(m_aSnapshotDataUpdates));
+	mem_zero(&m_Empty, sizeof(m_Empty));
+	return *this;
+}
+
 void CSnapshotDelta::SetStaticsize(int ItemType, size_t Size)
 {
 	dbg_assert(ItemType >= 0 && ItemType < MAX_NETOBJSIZES, "ItemType invalid");
@@ -291,8 +334,7 @@ const CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta() const
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
-int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData)
+int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData, const CSnapshotItemIndex *pFromIndex, const CSnapshotItemIndex *pToIndex)
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_aData;
@@ -301,14 +343,19 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	CSnapshotItemIndex ToIndex;
+	int aToIndexMemory[CSnapshotItemIndex::MAX_MEMORY_INTS];
+	if(!pToIndex)
+	{
+		ToIndex.Build(pTo, aToIndexMemory);
+		pToIndex = &ToIndex;
+	}
 
 	// pack deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		if(pToIndex->Find(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -317,7 +364,13 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
+	CSnapshotItemIndex FromIndex;
+	int aFromIndexMemory[CSnapshotItemIndex::MAX_MEMORY_INTS];
+	if(!pFromIndex)
+	{
+		FromIndex.Build(pFrom, aFromIndexMemory);
+		pFromIndex = &FromIndex;
+	}
 
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
@@ -326,7 +379,7 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 	for(int i = 0; i < NumItems; i++)
 	{
 		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
+		aPastIndices[i] = pFromIndex->Find(pCurItem->Key());
 	}
 
 	for(int i = 0; i < NumItems; i++)
@@ -516,6 +569,10 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	CSnapshotBuilder Builder;
 	Builder.Init();
 
+	CSnapshotItemIndex FromIndex;
+	int aFromIndexMemory[CSnapshotItemIndex::MAX_MEMORY_INTS];
+	FromIndex.Build(pFrom, aFromIndexMemory);
+
 	// unpack deleted stuff
 	int *pDeleted = pData;
 	if(pDelta->m_NumDeletedItems < 0)
@@ -590,11 +647,11 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 		if(!pNewData)
 			return -302;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
-		if(FromIndex != -1)
+		const int FromItemIndex = FromIndex.Find(Key);
+		if(FromItemIndex != -1)
 		{
 			// we got an update so we need to apply the diff
-			UndiffItem(pFrom->GetItem(FromIndex)->Data(), pData, pNewData, ItemSize / sizeof(int32_t), &m_aSnapshotDataRate[Type]);
+			UndiffItem(pFrom->GetItem(FromItemIndex)->Data(), pData, pNewData, ItemSize / sizeof(int32_t), &m_aSnapshotDataRate[Type]);
 		}
 		else // no previous, just copy the pData
 		{
@@ -612,10 +669,43 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 
 // CSnapshotStorage
 
+const CSnapshotItemIndex *CSnapshotStorage::CHolder::ItemIndex()
+{
+	if(!m_pItemIndexMemory)
+		return nullptr;
+	if(!m_ItemIndexBuilt)
+	{
+		m_ItemIndex.Build(m_pSnap, m_pItemIndexMemory);
+		m_ItemIndexBuilt = true;
+	}
+	return &m_ItemIndex;
+}
+
+CSnapshotStorage::~CSnapshotStorage()
+{
+	PurgeAll();
+	while(m_pFirstFree)
+	{
+		CHolder *pNext = m_pFirstFree->m_pNext;
+		free(m_pFirstFree->m_pBuffer);
+		free(m_pFirstFree);
+		m_pFirstFree = pNext;
+	}
+}
+
 void CSnapshotStorage::Init()
 {
-	m_pFirst = nullptr;
-	m_pLast = nullptr;
+	PurgeAll();
+}
+
+void CSnapshotStorage::Recycle(CHolder *pHolder)
+{
+	if(pHolder->m_Indexed)
+		m_apTickIndex[pHolder->m_Tick & (TICK_INDEX_SIZE - 1)] = nullptr;
+	else
+		m_NumUnindexed--;
+	pHolder->m_pNext = m_pFirstFree;
+	m_pFirstFree = pHolder;
 }
 
 void CSnapshotStorage::PurgeAll()
@@ -623,9 +713,7 @@ void CSnapshotStorage::PurgeAll()
 	while(m_pFirst)
 	{
 		CHolder *pNext = m_pFirst->m_pNext;
-		free(m_pFirst->m_pSnap);
-		free(m_pFirst->m_pAltSnap);
-		free(m_pFirst);
+		Recycle(m_pFirst);
 		m_pFirst = pNext;
 	}
 	m_pLast = nullptr;
@@ -633,29 +721,44 @@ void CSnapshotStorage::PurgeAll()
 
 void CSnapshotStorage::PurgeUntil(int Tick)
 {
-	CHolder *pHolder = m_pFirst;
-
-	while(pHolder)
+	while(m_pFirst && m_pFirst->m_Tick < Tick)
 	{
-		CHolder *pNext = pHolder->m_pNext;
-		if(pHolder->m_Tick >= Tick)
-			return; // no more to remove
-		free(pHolder->m_pSnap);
-		free(pHolder->m_pAltSnap);
-		free(pHolder);
+		CHolder *pNext = m_pFirst->m_pNext;
+		Recycle(m_pFirst);
+		m_pFirst = pNext;
+	}
 
-		// did we come to the end of the list?
-		if(!pNext)
-			break;
+	if(m_pFirst)
+		m_pFirst->m_pPrev = nullptr;
+	else
+		m_pLast = nullptr; // no more snapshots in storage
+}
 
-		m_pFirst = pNext;
-		pNext->m_pPrev = nullptr;
-		pHolder = pNext;
+CSnapshotStorage::CHolder *CSnapshotStorage::NewHolder(size_t BufferSize)
+{
+	CHolder *pHolder = m_pFirstFree;
+	if(pHolder)
+	{
+		m_pFirstFree = pHolder->m_pNext;
+	}
+	else
+	{
+		pHolder = static_cast<CHolder *>(malloc(sizeof(CHolder)));
+		pHolder->m_pBuffer = nullptr;
+		pHolder->m_BufferSize = 0;
+		m_NumAllocations++;
 	}
 
-	// no more snapshots in storage
-	m_pFirst = nullptr;
-	m_pLast = nullptr;
+	if(pHolder->m_BufferSize < BufferSize)
+	{
+		// leave room for slightly bigger snapshots later on
+		const size_t NewSize = (BufferSize + BufferSize / 4 + 1023) & ~(size_t)1023;
+		free(pHolder->m_pBuffer);
+		pHolder->m_pBuffer = malloc(NewSize);
+		pHolder->m_BufferSize = NewSize;
+		m_NumAllocations++;
+	}
+	return pHolder;
 }
 
 void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const void *pData, size_t AltDataSize, const void *pAltData)
@@ -663,17 +766,22 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 	dbg_assert(DataSize <= (size_t)CSnapshot::MAX_SIZE, "Snapshot data size invalid");
 	dbg_assert(AltDataSize <= (size_t)CSnapshot::MAX_SIZE, "Alt snapshot data size invalid");
 
-	CHolder *pHolder = static_cast<CHolder *>(malloc(sizeof(CHolder)));
+	const size_t AltOffset = (DataSize + alignof(CSnapshot) - 1) & ~(alignof(CSnapshot) - 1);
+	const size_t IndexOffset = (AltOffset + AltDataSize + alignof(int) - 1) & ~(alignof(int) - 1);
+	const int NumItems = DataSize >= sizeof(CSnapshot) ? static_cast<const CSnapshot *>(pData)->NumItems() : 0;
+	CHolder *pHolder = NewHolder(IndexOffset + CSnapshotItemIndex::MemoryInts(NumItems) * sizeof(int));
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
+	pHolder->m_pItemIndexMemory = reinterpret_cast<int *>(static_cast<char *>(pHolder->m_pBuffer) + IndexOffset);
+	pHolder->m_ItemIndexBuilt = false;
 
-	pHolder->m_pSnap = static_cast<CSnapshot *>(malloc(DataSize));
+	pHolder->m_pSnap = static_cast<CSnapshot *>(pHolder->m_pBuffer);
 	mem_copy(pHolder->m_pSnap, pData, DataSize);
 	pHolder->m_SnapSize = DataSize;
 
 	if(AltDataSize) // create alternative if wanted
 	{
-		pHolder->m_pAltSnap = static_cast<CSnapshot *>(malloc(AltDataSize));
+		pHolder->m_pAltSnap = reinterpret_cast<CSnapshot *>(static_cast<char *>(pHolder->m_pBuffer) + AltOffset);
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
 	}
@@ -691,29 +799,54 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 	else
 		m_pFirst = pHolder;
 	m_pLast = pHolder;
+
+	CHolder *&pIndexed = m_apTickIndex[Tick & (TICK_INDEX_SIZE - 1)];
+	if(pIndexed && pIndexed->m_Tick == Tick)
+	{
+		pHolder->m_Indexed = false;
+		m_NumUnindexed++;
+		return;
+	}
+	if(pIndexed)
+	{
+		pIndexed->m_Indexed = false;
+		m_NumUnindexed++;
+	}
+	pIndexed = pHolder;
+	pHolder->m_Indexed = true;
 }
 
-int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const
+CSnapshotStorage::CHolder *CSnapshotStorage::Find(int Tick) const
 {
-	CHolder *pHolder = m_pFirst;
+	CHolder *pHolder = m_apTickIndex[Tick & (TICK_INDEX_SIZE - 1)];
+	if(pHolder && pHolder->m_Tick == Tick)
+		return pHolder;
 
-	while(pHolder)
+	// only happens if the stored ticks span more than the index size
+	if(m_NumUnindexed > 0)
 	{
-		if(pHolder->m_Tick == Tick)
+		for(CHolder *pCur = m_pFirst; pCur; pCur = pCur->m_pNext)
 		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
+			if(pCur->m_Tick == Tick)
+				return pCur;
 		}
-
-		pHolder = pHolder->m_pNext;
 	}
+	return nullptr;
+}
 
-	return -1;
+int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const
+{
+	const CHolder *pHolder = Find(Tick);
+	if(!pHolder)
+		return -1;
+
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->m_pSnap;
+	if(ppAltData)
+		*ppAltData = pHolder->m_pAltSnap;
+	return pHolder->m_SnapSize;
 }
 
 // CSnapshotBuilder
@@ -72,6 +72,28 @@ public:
 	static const CSnapshot *EmptySnapshot() { return &ms_EmptySnapshot; }
 };
 
+// Looks up item indices of a snapshot by key. The table lives in memory
+// provided by the caller, so it can be kept next to a stored snapshot.
+class CSnapshotItemIndex
+{
+	const int *m_pSlots = nullptr;
+	int m_Shift = 32;
+
+	int FirstSlot(int Key) const { return ((unsigned)Key * 0x9e3779b1u) >> m_Shift; }
+
+public:
+	enum
+	{
+		MAX_MEMORY_INTS = 4 * CSnapshot::MAX_ITEMS,
+	};
+
+	// number of ints needed to index a snapshot with `NumItems` items
+	static int MemoryInts(int NumItems);
+	void Build(const CSnapshot *pSnapshot, int *pMemory);
+	// Returns the first item with the key or -1.
+	int Find(int Key) const;
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -103,18 +125,23 @@ public:
 	static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &Old);
+	CSnapshotDelta &operator=(const CSnapshotDelta &Old);
 	uint64_t GetDataRate(int Index) const { return m_aSnapshotDataRate[Index]; }
 	uint64_t GetDataUpdates(int Index) const { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, size_t Size);
 	void SetStaticsize7(int ItemType, size_t Size);
 	const CData *EmptyDelta() const;
-	int CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData);
+	// The item indices are built on the fly if they aren't given.
+	int CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData, const CSnapshotItemIndex *pFromIndex = nullptr, const CSnapshotItemIndex *pToIndex = nullptr);
 	int UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const void *pSrcData, int DataSize, bool Sixup);
 	int DebugDumpDelta(const void *pSrcData, int DataSize);
 };
 
 // CSnapshotStorage
 
+// Keeps the snapshots of the last ticks. Purged holders and their buffers
+// are kept for reuse, so once the storage has seen its largest snapshots
+// adding more doesn't allocate.
 class CSnapshotStorage
 {
 public:
@@ -132,18 +159,57 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		// backing memory of `m_pSnap`, `m_pAltSnap` and the item index,
+		// owned by the storage
+		void *m_pBuffer;
+		size_t m_BufferSize;
+
+		// item index of `m_pSnap`, built on first use
+		int *m_pItemIndexMemory;
+		bool m_ItemIndexBuilt;
+		CSnapshotItemIndex m_ItemIndex;
+
+		const CSnapshotItemIndex *ItemIndex();
+		// whether the tick index points to this holder
+		bool m_Indexed;
+	};
+
+	enum
+	{
+		// power of two, larger than the ticks stored at once
+		TICK_INDEX_SIZE = 256,
 	};
 
-	CHolder *m_pFirst;
-	CHolder *m_pLast;
+	CHolder *m_pFirst = nullptr;
+	CHolder *m_pLast = nullptr;
 
-	CSnapshotStorage() { Init(); }
-	~CSnapshotStorage() { PurgeAll(); }
+	CSnapshotStorage() = default;
+	CSnapshotStorage(const CSnapshotStorage &) = delete;
+	CSnapshotStorage &operator=(const CSnapshotStorage &) = delete;
+	~CSnapshotStorage();
 	void Init();
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64_t Tagtime, size_t DataSize, const void *pData, size_t AltDataSize, const void *pAltData);
 	int Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData) const;
+	CHolder *Find(int Tick) const;
+
+	// heap allocations done by the storage so far
+	int64_t NumAllocations() const { return m_NumAllocations; }
+
+private:
+	CHolder *NewHolder(size_t BufferSize);
+	void Recycle(CHolder *pHolder);
+
+	// latest holder for each tick modulo `TICK_INDEX_SIZE`, except that a
+	// tick added twice keeps its first holder, like walking the list finds
+	CHolder *m_apTickIndex[TICK_INDEX_SIZE] = {};
+	// stored holders that lost their index slot to a later one
+	int m_NumUnindexed = 0;
+	// single linked through `m_pNext`
+	CHolder *m_pFirstFree = nullptr;
+	int64_t m_NumAllocations = 0;
 };
 
 class CSnapshotBuilder
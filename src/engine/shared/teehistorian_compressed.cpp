@@ -0,0 +1,281 @@
+#include "teehistorian_compressed.h"
+
+#include "uuid_manager.h"
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <zlib.h>
+
+static const CUuid TEEHISTORIAN_COMPRESSED_UUID = CalculateUuid("teehistorian-compressed@ddnet.tw");
+static const unsigned char INDEX_MAGIC[8] = {'T', 'H', 'Z', 'I', 'N', 'D', 'E', 'X'};
+
+enum
+{
+	BLOCK_HEADER_SIZE = 20,
+	INDEX_ENTRY_SIZE = 20,
+	TRAILER_SIZE = 4 + sizeof(INDEX_MAGIC),
+};
+
+static void Int64ToBytesBe(unsigned char *pBytes, int64_t Value)
+{
+	uint_to_bytes_be(pBytes, (uint64_t)Value >> 32);
+	uint_to_bytes_be(pBytes + 4, (uint64_t)Value & 0xffffffff);
+}
+
+static int64_t BytesBeToInt64(const unsigned char *pBytes)
+{
+	return (int64_t)(((uint64_t)bytes_be_to_uint(pBytes) << 32) | bytes_be_to_uint(pBytes + 4));
+}
+
+CTeeHistorianCompressedWriter::CTeeHistorianCompressedWriter(WRITE_CALLBACK pfnWriteCallback, void *pUser, int MaxBlockSize) :
+	m_pfnWriteCallback(pfnWriteCallback),
+	m_pWriteCallbackUserdata(pUser),
+	m_MaxBlockSize(MaxBlockSize)
+{
+	dbg_assert(MaxBlockSize > 0 && MaxBlockSize <= MAX_BLOCK_SIZE, "invalid compressed teehistorian block size");
+	m_vBlock.reserve(m_MaxBlockSize);
+	// nothing else is running yet
+	Output(&TEEHISTORIAN_COMPRESSED_UUID, sizeof(TEEHISTORIAN_COMPRESSED_UUID));
+	m_pThread = thread_init(CompressThread, this, "teehistorian compression");
+}
+
+CTeeHistorianCompressedWriter::~CTeeHistorianCompressedWriter()
+{
+	Finish();
+}
+
+void CTeeHistorianCompressedWriter::BeginTick(int Tick)
+{
+	m_Tick = Tick;
+	if(m_vBlock.empty())
+	{
+		m_BlockFirstTick = Tick;
+	}
+}
+
+void CTeeHistorianCompressedWriter::Write(const void *pData, int DataSize)
+{
+	dbg_assert(!m_Finished, "write to finished compressed teehistorian");
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	while(DataSize > 0)
+	{
+		const int Chunk = minimum(DataSize, m_MaxBlockSize - (int)m_vBlock.size());
+		m_vBlock.insert(m_vBlock.end(), pBytes, pBytes + Chunk);
+		pBytes += Chunk;
+		DataSize -= Chunk;
+		if((int)m_vBlock.size() == m_MaxBlockSize)
+		{
+			Flush();
+			// the current tick started in the previous block
+			m_BlockFirstTick = m_Tick + 1;
+		}
+	}
+}
+
+void CTeeHistorianCompressedWriter::Flush()
+{
+	if(m_vBlock.empty())
+		return;
+
+	auto pBlock = std::make_unique<CBlock>();
+	pBlock->m_FirstTick = m_BlockFirstTick;
+	pBlock->m_UncompressedOffset = m_UncompressedOffset;
+	pBlock->m_vData.swap(m_vBlock);
+	m_UncompressedOffset += pBlock->m_vData.size();
+	m_vBlock.reserve(m_MaxBlockSize);
+	m_BlockFirstTick = m_Tick;
+	{
+		std::lock_guard<std::mutex> Lock(m_QueueMutex);
+		m_vpQueue.push_back(std::move(pBlock));
+	}
+	m_NumQueued.Signal();
+}
+
+void CTeeHistorianCompressedWriter::Finish()
+{
+	if(m_Finished)
+		return;
+	Flush();
+	m_Finished = true;
+	{
+		std::lock_guard<std::mutex> Lock(m_QueueMutex);
+		m_vpQueue.push_back(nullptr);
+	}
+	m_NumQueued.Signal();
+	thread_wait(m_pThread);
+
+	// the compression thread is done, write the end block and the index
+	unsigned char aEnd[BLOCK_HEADER_SIZE] = {};
+	Output(aEnd, sizeof(aEnd));
+	for(const CIndexEntry &Entry : m_vIndex)
+	{
+		unsigned char aEntry[INDEX_ENTRY_SIZE];
+		uint_to_bytes_be(aEntry, Entry.m_FirstTick);
+		Int64ToBytesBe(aEntry + 4, Entry.m_FileOffset);
+		Int64ToBytesBe(aEntry + 12, Entry.m_UncompressedOffset);
+		Output(aEntry, sizeof(aEntry));
+	}
+	unsigned char aTrailer[TRAILER_SIZE];
+	uint_to_bytes_be(aTrailer, m_vIndex.size());
+	mem_copy(aTrailer + 4, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	Output(aTrailer, sizeof(aTrailer));
+}
+
+void CTeeHistorianCompressedWriter::Output(const void *pData, int DataSize)
+{
+	m_pfnWriteCallback(pData, DataSize, m_pWriteCallbackUserdata);
+	m_FileOffset += DataSize;
+}
+
+void CTeeHistorianCompressedWriter::CompressThread(void *pUser)
+{
+	static_cast<CTeeHistorianCompressedWriter *>(pUser)->CompressBlocks();
+}
+
+void CTeeHistorianCompressedWriter::CompressBlocks()
+{
+	std::vector<unsigned char> vCompressed;
+	while(true)
+	{
+		m_NumQueued.Wait();
+		std::unique_ptr<CBlock> pBlock;
+		{
+			std::lock_guard<std::mutex> Lock(m_QueueMutex);
+			pBlock = std::move(m_vpQueue.front());
+			m_vpQueue.pop_front();
+		}
+		if(pBlock == nullptr)
+			return;
+
+		uLongf CompressedSize = compressBound(pBlock->m_vData.size());
+		vCompressed.resize(BLOCK_HEADER_SIZE + CompressedSize);
+		const int Result = compress2(vCompressed.data() + BLOCK_HEADER_SIZE, &CompressedSize, pBlock->m_vData.data(), pBlock->m_vData.size(), Z_DEFAULT_COMPRESSION);
+		if(Result != Z_OK)
+		{
+			dbg_msg("teehistorian", "failed to compress block, result=%d", Result);
+			m_Error.store(true);
+			continue;
+		}
+
+		uint_to_bytes_be(vCompressed.data(), pBlock->m_FirstTick);
+		Int64ToBytesBe(vCompressed.data() + 4, pBlock->m_UncompressedOffset);
+		uint_to_bytes_be(vCompressed.data() + 12, pBlock->m_vData.size());
+		uint_to_bytes_be(vCompressed.data() + 16, CompressedSize);
+		m_vIndex.push_back({pBlock->m_FirstTick, m_FileOffset, pBlock->m_UncompressedOffset});
+		Output(vCompressed.data(), BLOCK_HEADER_SIZE + CompressedSize);
+	}
+}
+
+bool CTeeHistorianCompressedReader::IsCompressed(const void *pData, int64_t Size)
+{
+	return Size >= (int64_t)sizeof(TEEHISTORIAN_COMPRESSED_UUID) &&
+	       mem_comp(pData, &TEEHISTORIAN_COMPRESSED_UUID, sizeof(TEEHISTORIAN_COMPRESSED_UUID)) == 0;
+}
+
+bool CTeeHistorianCompressedReader::Open(const void *pData, int64_t Size)
+{
+	m_pData = (const unsigned char *)pData;
+	m_Size = Size;
+	m_vBlocks.clear();
+	m_Truncated = false;
+	if(!IsCompressed(pData, Size))
+		return false;
+	if(!ReadIndex())
+	{
+		m_Truncated = true;
+		ScanBlocks();
+	}
+	return true;
+}
+
+bool CTeeHistorianCompressedReader::ReadIndex()
+{
+	if(m_Size < (int64_t)sizeof(TEEHISTORIAN_COMPRESSED_UUID) + BLOCK_HEADER_SIZE + TRAILER_SIZE)
+		return false;
+	const unsigned char *pTrailer = m_pData + m_Size - TRAILER_SIZE;
+	if(mem_comp(pTrailer + 4, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+		return false;
+	const int64_t NumBlocks = bytes_be_to_uint(pTrailer);
+	const int64_t IndexOffset = m_Size - TRAILER_SIZE - NumBlocks * INDEX_ENTRY_SIZE;
+	if(IndexOffset < (int64_t)sizeof(TEEHISTORIAN_COMPRESSED_UUID) + BLOCK_HEADER_SIZE)
+		return false;
+
+	for(int64_t i = 0; i < NumBlocks; i++)
+	{
+		const unsigned char *pEntry = m_pData + IndexOffset + i * INDEX_ENTRY_SIZE;
+		CBlockInfo Block;
+		Block.m_FirstTick = bytes_be_to_uint(pEntry);
+		Block.m_FileOffset = BytesBeToInt64(pEntry + 4);
+		Block.m_UncompressedOffset = BytesBeToInt64(pEntry + 12);
+		if(Block.m_FileOffset < 0 || Block.m_FileOffset + BLOCK_HEADER_SIZE > IndexOffset)
+		{
+			m_vBlocks.clear();
+			return false;
+		}
+		m_vBlocks.push_back(Block);
+	}
+	return true;
+}
+
+void CTeeHistorianCompressedReader::ScanBlocks()
+{
+	int64_t Offset = sizeof(TEEHISTORIAN_COMPRESSED_UUID);
+	while(Offset + BLOCK_HEADER_SIZE <= m_Size)
+	{
+		const unsigned char *pHeader = m_pData + Offset;
+		const unsigned UncompressedSize = bytes_be_to_uint(pHeader + 12);
+		const unsigned CompressedSize = bytes_be_to_uint(pHeader + 16);
+		// end block, incomplete or corrupt block
+		if(UncompressedSize == 0 || UncompressedSize > CTeeHistorianCompressedWriter::MAX_BLOCK_SIZE || Offset + BLOCK_HEADER_SIZE + CompressedSize > m_Size)
+			break;
+		m_vBlocks.push_back({(int)bytes_be_to_uint(pHeader), Offset, BytesBeToInt64(pHeader + 4)});
+		Offset += BLOCK_HEADER_SIZE + CompressedSize;
+	}
+}
+
+int CTeeHistorianCompressedReader::FindBlock(int Tick) const
+{
+	int Low = 0;
+	int High = m_vBlocks.size();
+	// first block starting after the tick
+	while(Low < High)
+	{
+		const int Mid = (Low + High) / 2;
+		if(m_vBlocks[Mid].m_FirstTick <= Tick)
+			Low = Mid + 1;
+		else
+			High = Mid;
+	}
+	return Low - 1;
+}
+
+bool CTeeHistorianCompressedReader::ReadBlock(int Index, std::vector<unsigned char> *pvData) const
+{
+	const unsigned char *pHeader = m_pData + m_vBlocks[Index].m_FileOffset;
+	const unsigned UncompressedSize = bytes_be_to_uint(pHeader + 12);
+	const unsigned CompressedSize = bytes_be_to_uint(pHeader + 16);
+	if(UncompressedSize > CTeeHistorianCompressedWriter::MAX_BLOCK_SIZE || m_vBlocks[Index].m_FileOffset + BLOCK_HEADER_SIZE + CompressedSize > m_Size)
+		return false;
+
+	const size_t Start = pvData->size();
+	pvData->resize(Start + UncompressedSize);
+	uLongf DestSize = UncompressedSize;
+	const int Result = uncompress(pvData->data() + Start, &DestSize, pHeader + BLOCK_HEADER_SIZE, CompressedSize);
+	if(Result != Z_OK || DestSize != UncompressedSize)
+	{
+		pvData->resize(Start);
+		return false;
+	}
+	return true;
+}
+
+bool CTeeHistorianCompressedReader::ReadAll(std::vector<unsigned char> *pvData) const
+{
+	for(int i = 0; i < NumBlocks(); i++)
+	{
+		if(!ReadBlock(i, pvData))
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,138 @@
+#ifndef ENGINE_SHARED_TEEHISTORIAN_COMPRESSED_H
+#define ENGINE_SHARED_TEEHISTORIAN_COMPRESSED_H
+
+#include <base/tl/threading.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Container for teehistorian data made of independently zlib compressed
+// blocks. Blocks are handed to the output as soon as they are compressed,
+// so a crash loses at most the block that was being filled. Finishing the
+// file appends an index of all blocks, readers rebuild it by scanning the
+// blocks if it is missing.
+//
+//     file:    magic, block*, end block, index entry*, number of blocks, index magic
+//     block:   first tick, uncompressed offset, uncompressed size, compressed size, zlib data
+//     index:   first tick, file offset, uncompressed offset
+//
+// The first tick of a block is the first tick whose data starts in it.
+// Teehistorian records are delta encoded, the index lets readers find
+// where a tick starts in the uncompressed stream, parsing it still has to
+// begin at the start.
+class CTeeHistorianCompressedWriter
+{
+public:
+	typedef void (*WRITE_CALLBACK)(const void *pData, int DataSize, void *pUser);
+
+	enum
+	{
+		DEFAULT_BLOCK_SIZE = 256 * 1024,
+		// readers reject larger blocks instead of trusting the header
+		MAX_BLOCK_SIZE = 16 * 1024 * 1024,
+	};
+
+	// The write callback is called from the compression thread.
+	CTeeHistorianCompressedWriter(WRITE_CALLBACK pfnWriteCallback, void *pUser, int MaxBlockSize = DEFAULT_BLOCK_SIZE);
+	~CTeeHistorianCompressedWriter();
+
+	// Marks the start of the data of `Tick`.
+	void BeginTick(int Tick);
+	void Write(const void *pData, int DataSize);
+	// Hands the current block to the compression thread.
+	void Flush();
+	// Flushes, waits for the compression thread and writes the index.
+	void Finish();
+
+	bool Error() const { return m_Error.load(); }
+	int64_t UncompressedSize() const { return m_UncompressedOffset + m_vBlock.size(); }
+
+private:
+	struct CBlock
+	{
+		int m_FirstTick;
+		int64_t m_UncompressedOffset;
+		std::vector<unsigned char> m_vData;
+	};
+	struct CIndexEntry
+	{
+		int m_FirstTick;
+		int64_t m_FileOffset;
+		int64_t m_UncompressedOffset;
+	};
+
+	static void CompressThread(void *pUser);
+	void CompressBlocks();
+	void Output(const void *pData, int DataSize);
+
+	WRITE_CALLBACK m_pfnWriteCallback;
+	void *m_pWriteCallbackUserdata;
+	int m_MaxBlockSize;
+
+	// main thread
+	int m_Tick = 0;
+	int m_BlockFirstTick = 0;
+	int64_t m_UncompressedOffset = 0;
+	std::vector<unsigned char> m_vBlock;
+	bool m_Finished = false;
+
+	// shared, `nullptr` stops the compression thread
+	std::mutex m_QueueMutex;
+	std::deque<std::unique_ptr<CBlock>> m_vpQueue;
+	CSemaphore m_NumQueued;
+	std::atomic_bool m_Error{false};
+
+	// compression thread, the main thread may access it after `Finish`
+	int64_t m_FileOffset = 0;
+	std::vector<CIndexEntry> m_vIndex;
+
+	void *m_pThread;
+};
+
+class CTeeHistorianCompressedReader
+{
+public:
+	// Checks whether the data starts like a compressed teehistorian file.
+	static bool IsCompressed(const void *pData, int64_t Size);
+
+	// The data must stay valid while the reader is used. Returns false if
+	// it isn't a compressed teehistorian file.
+	bool Open(const void *pData, int64_t Size);
+
+	// Whether the file wasn't finished, e.g. because the server crashed.
+	// Incomplete blocks at the end are skipped.
+	bool Truncated() const { return m_Truncated; }
+
+	int NumBlocks() const { return m_vBlocks.size(); }
+	int BlockFirstTick(int Index) const { return m_vBlocks[Index].m_FirstTick; }
+	int64_t BlockUncompressedOffset(int Index) const { return m_vBlocks[Index].m_UncompressedOffset; }
+	// Returns the block in which the data of `Tick` starts, -1 if it's
+	// before the first block.
+	int FindBlock(int Tick) const;
+
+	// Appends the uncompressed data of the block.
+	bool ReadBlock(int Index, std::vector<unsigned char> *pvData) const;
+	bool ReadAll(std::vector<unsigned char> *pvData) const;
+
+private:
+	struct CBlockInfo
+	{
+		int m_FirstTick;
+		int64_t m_FileOffset;
+		int64_t m_UncompressedOffset;
+	};
+
+	bool ReadIndex();
+	void ScanBlocks();
+
+	const unsigned char *m_pData = nullptr;
+	int64_t m_Size = 0;
+	bool m_Truncated = false;
+	std::vector<CBlockInfo> m_vBlocks;
+};
+
+#endif // ENGINE_SHARED_TEEHISTORIAN_COMPRESSED_H
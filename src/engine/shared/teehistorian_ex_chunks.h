@@ -26,3 +26,4 @@ UUID(TEEHISTORIAN_ANTIBOT, "teehistorian-antibot@ddnet.org")
 UUID(TEEHISTORIAN_PLAYER_NAME, "teehistorian-player-name@ddnet.org")
 UUID(TEEHISTORIAN_PLAYER_FINISH, "teehistorian-player-finish@ddnet.org")
 UUID(TEEHISTORIAN_TEAM_FINISH, "teehistorian-team-finish@ddnet.org")
+UUID(TEEHISTORIAN_INPUT_STATS, "teehistorian-input-stats@ddnet.org")
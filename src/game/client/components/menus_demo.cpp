@@ -11,6 +11,7 @@
 #include <engine/demo.h>
 #include <engine/graphics.h>
 #include <engine/keys.h>
+#include <engine/shared/demo.h>
 #include <engine/shared/localization.h>
 #include <engine/storage.h>
 #include <engine/textrender.h>
@@ -1659,6 +1660,7 @@ void CMenus::PopupConfirmDeleteDemo()
 	str_format(aBuf, sizeof(aBuf), "%s/%s", m_aCurrentDemoFolder, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_aFilename);
 	if(Storage()->RemoveFile(aBuf, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_StorageType))
 	{
+		RemoveDemoIndex(Storage(), aBuf, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_StorageType);
 		DemolistPopulate();
 		DemolistOnUpdate(false);
 	}
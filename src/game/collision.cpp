@@ -326,31 +326,94 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
-// TODO: rewrite this smarter!
-int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
-{
-	float Distance = distance(Pos0, Pos1);
-	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
-	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		// Temporary position for checking collision
-		int ix = round_to_int(Pos.x);
-		int iy = round_to_int(Pos.y);
+// The lowest and highest tile coordinate a position can end up in, covering
+// both the rounding and the truncating conversion used by the callers.
+static void TileBounds(float Coord, int *pLow, int *pHigh)
+{
+	const int Rounded = round_to_int(Coord) / 32;
+	const int Truncated = (int)Coord / 32;
+	*pLow = minimum(Rounded, Truncated);
+	*pHigh = maximum(Rounded, Truncated);
+}
 
-		if(CheckPoint(ix, iy))
+template<typename FCandidate, typename FSample>
+void CCollision::TraverseSamples(vec2 Pos0, vec2 Pos1, int NumSamples, float Divisor, FCandidate &&IsCandidateTile, FSample &&Sample) const
+{
+	// Consecutive samples are at most one unit apart, so a block
+	// usually covers one or two tiles per axis.
+	const int BlockSize = 32;
+
+	const auto &&AnyCandidate = [&](vec2 First, vec2 Last) {
+		int aLowX[2], aHighX[2], aLowY[2], aHighY[2];
+		TileBounds(First.x, &aLowX[0], &aHighX[0]);
+		TileBounds(Last.x, &aLowX[1], &aHighX[1]);
+		TileBounds(First.y, &aLowY[0], &aHighY[0]);
+		TileBounds(Last.y, &aLowY[1], &aHighY[1]);
+		const int MinX = std::clamp(minimum(aLowX[0], aLowX[1]), 0, m_Width - 1);
+		const int MaxX = std::clamp(maximum(aHighX[0], aHighX[1]), 0, m_Width - 1);
+		const int MinY = std::clamp(minimum(aLowY[0], aLowY[1]), 0, m_Height - 1);
+		const int MaxY = std::clamp(maximum(aHighY[0], aHighY[1]), 0, m_Height - 1);
+		for(int Ny = MinY; Ny <= MaxY; Ny++)
+			for(int Nx = MinX; Nx <= MaxX; Nx++)
+				if(IsCandidateTile(Nx, Ny))
+					return true;
+		return false;
+	};
+
+	for(int Begin = 0; Begin < NumSamples; Begin += BlockSize)
+	{
+		const int End = minimum(Begin + BlockSize, NumSamples);
+		// The sample coordinates are monotonic in i, so every sample of the
+		// block lies in the tile rectangle spanned by its first and last one.
+		if(m_pTiles && !AnyCandidate(mix(Pos0, Pos1, Begin / Divisor), mix(Pos0, Pos1, (End - 1) / Divisor)))
 		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
+			if(m_VerifyTraversal)
+			{
+				for(int i = Begin; i < End; i++)
+				{
+					const vec2 Pos = mix(Pos0, Pos1, i / Divisor);
+					dbg_assert(!AnyCandidate(Pos, Pos), "tile traversal skipped a candidate sample");
+				}
+			}
+			continue;
+		}
+		for(int i = Begin; i < End; i++)
+		{
+			if(Sample(i, mix(Pos0, Pos1, i / Divisor)))
+				return;
 		}
-
-		Last = Pos;
 	}
+}
+
+int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	int Hit = 0;
+	TraverseSamples(
+		Pos0, Pos1, End + 1, End,
+		[&](int Nx, int Ny) {
+			int Index = GetIndex(Nx, Ny);
+			return Index == TILE_SOLID || Index == TILE_NOHOOK;
+		},
+		[&](int i, vec2 Pos) {
+			// Temporary position for checking collision
+			int ix = round_to_int(Pos.x);
+			int iy = round_to_int(Pos.y);
+
+			if(CheckPoint(ix, iy))
+			{
+				if(pOutCollision)
+					*pOutCollision = Pos;
+				if(pOutBeforeCollision)
+					*pOutBeforeCollision = i == 0 ? Pos0 : mix(Pos0, Pos1, (i - 1) / (float)End);
+				Hit = GetCollisionAt(ix, iy);
+				return true;
+			}
+			return false;
+		});
+	if(Hit)
+		return Hit;
 	if(pOutCollision)
 		*pOutCollision = Pos1;
 	if(pOutBeforeCollision)
@@ -362,55 +425,61 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
-	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		// Temporary position for checking collision
-		int ix = round_to_int(Pos.x);
-		int iy = round_to_int(Pos.y);
-
-		int Index = GetPureMapIndex(Pos);
-		if(pTeleNr)
-		{
-			if(g_Config.m_SvOldTeleportHook)
-				*pTeleNr = IsTeleport(Index);
-			else
-				*pTeleNr = IsTeleportHook(Index);
-		}
-		if(pTeleNr && *pTeleNr)
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return TILE_TELEINHOOK;
-		}
-
-		int hit = 0;
-		if(CheckPoint(ix, iy))
-		{
-			if(!IsThrough(ix, iy, dx, dy, Pos0, Pos1))
-				hit = GetCollisionAt(ix, iy);
-		}
-		else if(IsHookBlocker(ix, iy, Pos0, Pos1))
-		{
-			hit = TILE_NOHOOK;
-		}
-		if(hit)
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return hit;
-		}
-
-		Last = Pos;
-	}
+	if(pTeleNr)
+		*pTeleNr = 0;
+	int Hit = 0;
+	TraverseSamples(
+		Pos0, Pos1, End + 1, End,
+		[&](int Nx, int Ny) {
+			int Index = GetIndex(Nx, Ny);
+			int FrontIndex = GetFrontIndex(Nx, Ny);
+			if(Index == TILE_SOLID || Index == TILE_NOHOOK ||
+				Index == TILE_THROUGH_ALL || Index == TILE_THROUGH_DIR ||
+				FrontIndex == TILE_THROUGH_ALL || FrontIndex == TILE_THROUGH_DIR)
+				return true;
+			int MapIndex = Ny * m_Width + Nx;
+			return pTeleNr && (g_Config.m_SvOldTeleportHook ? IsTeleport(MapIndex) : IsTeleportHook(MapIndex)) != 0;
+		},
+		[&](int i, vec2 Pos) {
+			// Temporary position for checking collision
+			int ix = round_to_int(Pos.x);
+			int iy = round_to_int(Pos.y);
+
+			int Index = GetPureMapIndex(Pos);
+			if(pTeleNr)
+			{
+				if(g_Config.m_SvOldTeleportHook)
+					*pTeleNr = IsTeleport(Index);
+				else
+					*pTeleNr = IsTeleportHook(Index);
+			}
+			if(pTeleNr && *pTeleNr)
+			{
+				Hit = TILE_TELEINHOOK;
+			}
+			else if(CheckPoint(ix, iy))
+			{
+				if(!IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+					Hit = GetCollisionAt(ix, iy);
+			}
+			else if(IsHookBlocker(ix, iy, Pos0, Pos1))
+			{
+				Hit = TILE_NOHOOK;
+			}
+			if(Hit)
+			{
+				if(pOutCollision)
+					*pOutCollision = Pos;
+				if(pOutBeforeCollision)
+					*pOutBeforeCollision = i == 0 ? Pos0 : mix(Pos0, Pos1, (i - 1) / (float)End);
+				return true;
+			}
+			return false;
+		});
+	if(Hit)
+		return Hit;
 	if(pOutCollision)
 		*pOutCollision = Pos1;
 	if(pOutBeforeCollision)
@@ -422,43 +491,47 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
-	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		// Temporary position for checking collision
-		int ix = round_to_int(Pos.x);
-		int iy = round_to_int(Pos.y);
-
-		int Index = GetPureMapIndex(Pos);
-		if(pTeleNr)
-		{
-			if(g_Config.m_SvOldTeleportWeapons)
-				*pTeleNr = IsTeleport(Index);
-			else
-				*pTeleNr = IsTeleportWeapon(Index);
-		}
-		if(pTeleNr && *pTeleNr)
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return TILE_TELEINWEAPON;
-		}
-
-		if(CheckPoint(ix, iy))
-		{
-			if(pOutCollision)
-				*pOutCollision = Pos;
-			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
-			return GetCollisionAt(ix, iy);
-		}
-
-		Last = Pos;
-	}
+	if(pTeleNr)
+		*pTeleNr = 0;
+	int Hit = 0;
+	TraverseSamples(
+		Pos0, Pos1, End + 1, End,
+		[&](int Nx, int Ny) {
+			int Index = GetIndex(Nx, Ny);
+			if(Index == TILE_SOLID || Index == TILE_NOHOOK)
+				return true;
+			int MapIndex = Ny * m_Width + Nx;
+			return pTeleNr && (g_Config.m_SvOldTeleportWeapons ? IsTeleport(MapIndex) : IsTeleportWeapon(MapIndex)) != 0;
+		},
+		[&](int i, vec2 Pos) {
+			// Temporary position for checking collision
+			int ix = round_to_int(Pos.x);
+			int iy = round_to_int(Pos.y);
+
+			int Index = GetPureMapIndex(Pos);
+			if(pTeleNr)
+			{
+				if(g_Config.m_SvOldTeleportWeapons)
+					*pTeleNr = IsTeleport(Index);
+				else
+					*pTeleNr = IsTeleportWeapon(Index);
+			}
+			if(pTeleNr && *pTeleNr)
+				Hit = TILE_TELEINWEAPON;
+			else if(CheckPoint(ix, iy))
+				Hit = GetCollisionAt(ix, iy);
+			if(Hit)
+			{
+				if(pOutCollision)
+					*pOutCollision = Pos;
+				if(pOutBeforeCollision)
+					*pOutBeforeCollision = i == 0 ? Pos0 : mix(Pos0, Pos1, (i - 1) / (float)End);
+				return true;
+			}
+			return false;
+		});
+	if(Hit)
+		return Hit;
 	if(pOutCollision)
 		*pOutCollision = Pos1;
 	if(pOutBeforeCollision)
@@ -934,21 +1007,24 @@ std::vector<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxI
 	else
 	{
 		int LastIndex = 0;
-		for(int i = 0; i < End; i++)
-		{
-			float a = i / d;
-			vec2 Tmp = mix(PrevPos, Pos, a);
-			int Nx = std::clamp((int)Tmp.x / 32, 0, m_Width - 1);
-			int Ny = std::clamp((int)Tmp.y / 32, 0, m_Height - 1);
-			int Index = Ny * m_Width + Nx;
-			if(TileExists(Index) && LastIndex != Index)
-			{
-				if(MaxIndices && vIndices.size() > MaxIndices)
-					return vIndices;
-				vIndices.push_back(Index);
-				LastIndex = Index;
-			}
-		}
+		TraverseSamples(
+			PrevPos, Pos, End, d,
+			[&](int Nx, int Ny) {
+				return TileExists(Ny * m_Width + Nx);
+			},
+			[&](int i, vec2 Tmp) {
+				int Nx = std::clamp((int)Tmp.x / 32, 0, m_Width - 1);
+				int Ny = std::clamp((int)Tmp.y / 32, 0, m_Height - 1);
+				int Index = Ny * m_Width + Nx;
+				if(TileExists(Index) && LastIndex != Index)
+				{
+					if(MaxIndices && vIndices.size() > MaxIndices)
+						return true;
+					vIndices.push_back(Index);
+					LastIndex = Index;
+				}
+				return false;
+			});
 
 		return vIndices;
 	}
@@ -1141,27 +1217,30 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *pOffsetX, int *pOffsetY)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
-
-	for(int i = 0, id = std::ceil(d); i < id; i++)
-	{
-		float a = i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		int Nx = std::clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
-		int Ny = std::clamp(round_to_int(Pos.y) / 32, 0, m_Height - 1);
-		if(GetIndex(Nx, Ny) == TILE_SOLID || GetIndex(Nx, Ny) == TILE_NOHOOK || GetIndex(Nx, Ny) == TILE_NOLASER || GetFrontIndex(Nx, Ny) == TILE_NOLASER)
-		{
+	const auto &&IsNoLaserTile = [&](int Nx, int Ny) {
+		return GetIndex(Nx, Ny) == TILE_SOLID || GetIndex(Nx, Ny) == TILE_NOHOOK || GetIndex(Nx, Ny) == TILE_NOLASER || GetFrontIndex(Nx, Ny) == TILE_NOLASER;
+	};
+
+	int Hit = 0;
+	TraverseSamples(
+		Pos0, Pos1, std::ceil(d), d, IsNoLaserTile,
+		[&](int i, vec2 Pos) {
+			int Nx = std::clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
+			int Ny = std::clamp(round_to_int(Pos.y) / 32, 0, m_Height - 1);
+			if(!IsNoLaserTile(Nx, Ny))
+				return false;
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = i == 0 ? Pos0 : mix(Pos0, Pos1, (i - 1) / d);
 			if(GetFrontIndex(Nx, Ny) == TILE_NOLASER)
-				return GetFrontCollisionAt(Pos.x, Pos.y);
+				Hit = GetFrontCollisionAt(Pos.x, Pos.y);
 			else
-				return GetCollisionAt(Pos.x, Pos.y);
-		}
-		Last = Pos;
-	}
+				Hit = GetCollisionAt(Pos.x, Pos.y);
+			return true;
+		});
+	if(Hit)
+		return Hit;
 	if(pOutCollision)
 		*pOutCollision = Pos1;
 	if(pOutBeforeCollision)
@@ -1172,25 +1251,28 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 int CCollision::IntersectNoLaserNoWalls(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
 
-	for(int i = 0, id = std::ceil(d); i < id; i++)
-	{
-		float a = (float)i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
-		if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || IsFrontNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
-		{
+	int Hit = 0;
+	TraverseSamples(
+		Pos0, Pos1, std::ceil(d), d,
+		[&](int Nx, int Ny) {
+			return GetIndex(Nx, Ny) == TILE_NOLASER || GetFrontIndex(Nx, Ny) == TILE_NOLASER;
+		},
+		[&](int i, vec2 Pos) {
+			if(!IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) && !IsFrontNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
+				return false;
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = i == 0 ? Pos0 : mix(Pos0, Pos1, (float)(i - 1) / d);
 			if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
-				return GetCollisionAt(Pos.x, Pos.y);
+				Hit = GetCollisionAt(Pos.x, Pos.y);
 			else
-				return GetFrontCollisionAt(Pos.x, Pos.y);
-		}
-		Last = Pos;
-	}
+				Hit = GetFrontCollisionAt(Pos.x, Pos.y);
+			return true;
+		});
+	if(Hit)
+		return Hit;
 	if(pOutCollision)
 		*pOutCollision = Pos1;
 	if(pOutBeforeCollision)
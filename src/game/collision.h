@@ -144,7 +144,27 @@ public:
 	const std::vector<vec2> &TeleCheckOuts(int Number) { return m_TeleCheckOuts[Number]; }
 	const std::vector<vec2> &TeleOthers(int Number) { return m_TeleOthers[Number]; }
 
+	/**
+	 * Makes the line traversals check every sample they skip against
+	 * the sample-by-sample walk and assert that none of them could
+	 * have been a hit. Meant for tests, it is slow.
+	 *
+	 * @param Verify Whether skipped samples should be checked
+	 */
+	void SetVerifyTraversal(bool Verify) { m_VerifyTraversal = Verify; }
+
 private:
+	/**
+	 * Walks the samples `mix(Pos0, Pos1, i / Divisor)` for `0 <= i < NumSamples`
+	 * in order until `Sample(i, Pos)` returns true. Blocks of samples whose tiles
+	 * are all rejected by `IsCandidateTile(Nx, Ny)` are skipped without being
+	 * evaluated, so the result is the same as visiting every sample.
+	 */
+	template<typename FCandidate, typename FSample>
+	void TraverseSamples(vec2 Pos0, vec2 Pos1, int NumSamples, float Divisor, FCandidate &&IsCandidateTile, FSample &&Sample) const;
+
+	bool m_VerifyTraversal = false;
+
 	CLayers *m_pLayers;
 
 	int m_Width;
@@ -10,6 +10,7 @@
 
 #include <engine/shared/config.h>
 
+#include <algorithm>
 #include <limits>
 
 const char *CTuningParams::ms_apNames[] =
@@ -349,10 +350,13 @@ void CCharacterCore::Tick(bool UseInput, bool DoDeferredTick)
 		if(!m_HookHitDisabled && m_pWorld && m_Tuning.m_PlayerHooking && (m_HookState == HOOK_FLYING || !m_NewHook))
 		{
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			int aIds[MAX_CLIENTS];
+			const int NumIds = m_pWorld->NearbyCharacters(m_HookPos, NewPos, PhysicalSize() + 2.0f, this, aIds);
+			for(int j = 0; j < NumIds; j++)
 			{
+				const int i = aIds[j];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-				if(!pCharCore || pCharCore == this || (!(m_Super || pCharCore->m_Super) && ((m_Id != -1 && !m_pTeams->CanCollide(i, m_Id)) || pCharCore->m_Solo || m_Solo)))
+				if((!(m_Super || pCharCore->m_Super) && ((m_Id != -1 && !m_pTeams->CanCollide(i, m_Id)) || pCharCore->m_Solo || m_Solo)))
 					continue;
 
 				vec2 ClosestPoint;
@@ -462,15 +466,27 @@ void CCharacterCore::TickDeferred()
 {
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		// the hook pulls at any distance, everything else only affects touching players
+		int aIds[MAX_CLIENTS];
+		int NumIds = m_pWorld->NearbyCharacters(m_Pos, m_Pos, PhysicalSize() * 1.25f, this, aIds);
+		if(m_HookedPlayer != -1 && m_pWorld->m_apCharacters[m_HookedPlayer] && m_pWorld->m_apCharacters[m_HookedPlayer] != this)
 		{
+			int *pInsert = std::lower_bound(aIds, aIds + NumIds, m_HookedPlayer);
+			if(pInsert == aIds + NumIds || *pInsert != m_HookedPlayer)
+			{
+				std::copy_backward(pInsert, aIds + NumIds, aIds + NumIds + 1);
+				*pInsert = m_HookedPlayer;
+				NumIds++;
+			}
+		}
+
+		for(int j = 0; j < NumIds; j++)
+		{
+			const int i = aIds[j];
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-			if(!pCharCore)
+			if(m_Id != -1 && !m_pTeams->CanCollide(m_Id, i))
 				continue;
 
-			if(pCharCore == this || (m_Id != -1 && !m_pTeams->CanCollide(m_Id, i)))
-				continue; // make sure that we don't nudge our self
-
 			if(!(m_Super || pCharCore->m_Super) && (m_Solo || pCharCore->m_Solo))
 				continue;
 
@@ -567,7 +583,9 @@ void CCharacterCore::Move()
 	{
 		// check player collision
 		float Distance = distance(m_Pos, NewPos);
-		if(Distance > 0)
+		int aIds[MAX_CLIENTS];
+		const int NumIds = Distance > 0 ? m_pWorld->NearbyCharacters(m_Pos, NewPos, PhysicalSize(), this, aIds) : 0;
+		if(NumIds > 0)
 		{
 			int End = Distance + 1;
 			vec2 LastPos = m_Pos;
@@ -575,11 +593,10 @@ void CCharacterCore::Move()
 			{
 				float a = i / Distance;
 				vec2 Pos = mix(m_Pos, NewPos, a);
-				for(int p = 0; p < MAX_CLIENTS; p++)
+				for(int j = 0; j < NumIds; j++)
 				{
+					const int p = aIds[j];
 					CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
-					if(!pCharCore || pCharCore == this)
-						continue;
 					if((!(pCharCore->m_Super || m_Super) && (m_Solo || pCharCore->m_Solo || pCharCore->m_CollisionDisabled || (m_Id != -1 && !m_pTeams->CanCollide(m_Id, p)))))
 						continue;
 					float D = distance(Pos, pCharCore->m_Pos);
@@ -740,6 +757,26 @@ bool CCharacterCore::IsSwitchActiveCb(int Number, void *pUser)
 	return false;
 }
 
+int CWorldCore::NearbyCharacters(vec2 From, vec2 To, float Radius, const CCharacterCore *pExclude, int *pIds) const
+{
+	// a bit of margin for the rounding in the exact checks
+	const float Margin = Radius + 1.0f;
+	const vec2 Min = vec2(minimum(From.x, To.x) - Margin, minimum(From.y, To.y) - Margin);
+	const vec2 Max = vec2(maximum(From.x, To.x) + Margin, maximum(From.y, To.y) + Margin);
+	int NumIds = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CCharacterCore *pCharCore = m_apCharacters[i];
+		if(!pCharCore || pCharCore == pExclude)
+			continue;
+		if(m_NoBroadphase ||
+			(pCharCore->m_Pos.x >= Min.x && pCharCore->m_Pos.x <= Max.x &&
+				pCharCore->m_Pos.y >= Min.y && pCharCore->m_Pos.y <= Max.y))
+			pIds[NumIds++] = i;
+	}
+	return NumIds;
+}
+
 void CWorldCore::InitSwitchers(int HighestSwitchNumber)
 {
 	if(HighestSwitchNumber > 0)
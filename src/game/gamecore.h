@@ -172,6 +172,14 @@ public:
 	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
 	CPrng *m_pPrng;
 
+	// Fills `pIds` with the ids of the characters that might come within
+	// `Radius` of the segment from `From` to `To`, in id order. Callers
+	// still do their exact checks, the list only leaves out characters
+	// that can't pass them, so results stay the same as checking all.
+	int NearbyCharacters(vec2 From, vec2 To, float Radius, const class CCharacterCore *pExclude, int *pIds) const;
+	// Lists all characters instead, to compare against in tests.
+	bool m_NoBroadphase = false;
+
 	void InitSwitchers(int HighestSwitchNumber);
 	std::vector<SSwitchers> m_vSwitchers;
 };
@@ -8,6 +8,7 @@
 #include <game/server/gamemodes/DDRace.h>
 #include <game/server/player.h>
 #include <game/server/save.h>
+#include <game/server/score.h>
 #include <game/server/teams.h>
 
 void CGameContext::ConGoLeft(IConsole::IResult *pResult, void *pUserData)
@@ -387,6 +388,7 @@ void CGameContext::Teleport(CCharacter *pChr, vec2 Pos)
 {
 	pChr->SetPosition(Pos);
 	pChr->m_Pos = Pos;
+	pChr->GameWorld()->UpdateEntityGrid(pChr);
 	pChr->m_PrevPos = Pos;
 	pChr->m_DDRaceState = ERaceState::CHEATED;
 }
@@ -589,6 +591,13 @@ void CGameContext::ConDumpAntibot(IConsole::IResult *pResult, void *pUserData)
 	pSelf->Antibot()->ConsoleCommand("dump");
 }
 
+void CGameContext::ConDumpScoreCache(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	if(pSelf->Score())
+		pSelf->Score()->Cache()->Print(pSelf->Console());
+}
+
 void CGameContext::ConAntibot(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
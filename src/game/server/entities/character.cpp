@@ -1234,13 +1234,13 @@ void CCharacter::Snap(int SnappingClient)
 	if(!Server()->Translate(Id, SnappingClient))
 		return;
 
-	if(!CanSnapCharacter(SnappingClient))
+	if(!GameWorld()->SnapCanSnapCharacter(SnappingClient, this))
 	{
 		return;
 	}
 
 	// always snap the snapping client, even if it is not in view
-	if(!IsSnappingCharacterInView(SnappingClient) && Id != SnappingClient)
+	if(Id != SnappingClient && !GameWorld()->SnapIsCharacterInView(SnappingClient, this))
 		return;
 
 	SnapCharacter(SnappingClient, Id);
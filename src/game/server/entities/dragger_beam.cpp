@@ -99,7 +99,7 @@ void CDraggerBeam::Snap(int SnappingClient)
 
 	// Only players who can see the player attached to the dragger can see the dragger beam
 	CCharacter *pTarget = GameServer()->GetPlayerChar(m_ForClientId);
-	if(!pTarget || !pTarget->CanSnapCharacter(SnappingClient))
+	if(!pTarget || !GameWorld()->SnapCanSnapCharacter(SnappingClient, pTarget))
 	{
 		return;
 	}
@@ -327,7 +327,7 @@ void CProjectile::Snap(int SnappingClient)
 		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
 
 	if(pOwnerChar && pOwnerChar->IsAlive())
-		TeamMask = pOwnerChar->TeamMask();
+		TeamMask = GameWorld()->SnapCharacterTeamMask(pOwnerChar);
 
 	if(SnappingClient != SERVER_DEMO_CLIENT && m_Owner != -1 && !TeamMask.test(SnappingClient))
 		return;
@@ -364,6 +364,14 @@ void CProjectile::Snap(int SnappingClient)
 	}
 }
 
+bool CProjectile::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+	*pMin = GetPos(Ct);
+	*pMax = *pMin;
+	return true;
+}
+
 void CProjectile::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
@@ -23,6 +23,9 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 
 	m_pPrevTypeEntity = nullptr;
 	m_pNextTypeEntity = nullptr;
+
+	m_GridCell = -1;
+	m_InsertionOrder = 0;
 }
 
 CEntity::~CEntity()
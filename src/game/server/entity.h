@@ -26,6 +26,10 @@ private:
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	// broadphase grid, see CGameWorld::UpdateEntityGrid
+	int m_GridCell;
+	int64_t m_InsertionOrder;
+
 	/* Identity */
 	CGameWorld *m_pGameWorld;
 	CCollision *m_pCCollision;
@@ -123,6 +127,21 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: GetSnapBounds
+			Called once per snapshot tick to find out which area a
+			client has to see for Snap to add anything, so clipped
+			entities can be skipped without calling Snap.
+
+		Arguments:
+			pMin - Receives the top left corner of the area.
+			pMax - Receives the bottom right corner of the area.
+
+		Returns:
+			False if the entity can't be culled by position alone.
+	*/
+	virtual bool GetSnapBounds(vec2 *pMin, vec2 *pMax) { return false; }
+
 	/*
 		Function: SwapClients
 			Called when two players have swapped their client ids.
@@ -4,16 +4,25 @@
 
 #include "entity.h"
 #include "gamecontext.h"
+#include "player.h"
 
+#include <base/math.h>
 #include <base/system.h>
 #include <base/vmath.h>
 
+#include <algorithm>
+
 //////////////////////////////////////////////////
 // Event handler
 //////////////////////////////////////////////////
 CEventHandler::CEventHandler()
 {
 	m_pGameServer = nullptr;
+	m_PeakEvents = 0;
+	m_NumOverflows = 0;
+	m_NumSnapDropped = 0;
+	m_CellsWidth = 0;
+	m_CellsHeight = 0;
 	Clear();
 }
 
@@ -24,48 +33,116 @@ void CEventHandler::SetGameServer(CGameContext *pGameServer)
 
 void *CEventHandler::Create(int Type, int Size, CClientMask Mask)
 {
-	if(m_NumEvents == MAX_EVENTS)
-		return nullptr;
-	if(m_CurrentOffset + Size >= MAX_DATASIZE)
+	dbg_assert(Size > 0 && Size <= CHUNK_SIZE, "invalid event size");
+	if((int)m_vEvents.size() == MAX_EVENTS)
+	{
+		m_NumOverflows++;
 		return nullptr;
+	}
+
+	if(m_CurrentOffset + Size > CHUNK_SIZE)
+	{
+		m_CurrentChunk++;
+		m_CurrentOffset = 0;
+	}
+	if(m_CurrentChunk == (int)m_vpChunks.size())
+		m_vpChunks.push_back(std::make_unique<char[]>(CHUNK_SIZE));
 
-	void *p = &m_aData[m_CurrentOffset];
-	m_aOffsets[m_NumEvents] = m_CurrentOffset;
-	m_aTypes[m_NumEvents] = Type;
-	m_aSizes[m_NumEvents] = Size;
-	m_aClientMasks[m_NumEvents] = Mask;
+	char *p = &m_vpChunks[m_CurrentChunk][m_CurrentOffset];
+	m_vEvents.push_back({Type, Size, p, Mask});
 	m_CurrentOffset += Size;
-	m_NumEvents++;
+	m_PeakEvents = maximum(m_PeakEvents, (int)m_vEvents.size());
+	m_SnapPrepared = false;
 	return p;
 }
 
 void CEventHandler::Clear()
 {
-	m_NumEvents = 0;
+	m_vEvents.clear();
+	m_CurrentChunk = 0;
 	m_CurrentOffset = 0;
+	m_SnapPrepared = false;
+}
+
+int CEventHandler::CellX(float X) const
+{
+	return std::clamp((int)(X / CELL_SIZE), 0, m_CellsWidth - 1);
+}
+
+int CEventHandler::CellY(float Y) const
+{
+	return std::clamp((int)(Y / CELL_SIZE), 0, m_CellsHeight - 1);
+}
+
+void CEventHandler::PreSnap()
+{
+	m_CellsWidth = maximum(1, (GameServer()->Collision()->GetWidth() * 32 + CELL_SIZE - 1) / CELL_SIZE);
+	m_CellsHeight = maximum(1, (GameServer()->Collision()->GetHeight() * 32 + CELL_SIZE - 1) / CELL_SIZE);
+	m_vvCells.resize((size_t)m_CellsWidth * m_CellsHeight);
+	for(auto &vCell : m_vvCells)
+		vCell.clear();
+
+	for(int i = 0; i < (int)m_vEvents.size(); i++)
+	{
+		const CNetEvent_Common *pEvent = (const CNetEvent_Common *)m_vEvents[i].m_pData;
+		m_vvCells[CellY(pEvent->m_Y) * m_CellsWidth + CellX(pEvent->m_X)].push_back(i);
+	}
+	m_SnapPrepared = true;
 }
 
 void CEventHandler::Snap(int SnappingClient)
 {
-	for(int i = 0; i < m_NumEvents; i++)
+	if(!m_SnapPrepared || SnappingClient == SERVER_DEMO_CLIENT || GameServer()->m_apPlayers[SnappingClient]->m_ShowAll)
 	{
-		if(SnappingClient == SERVER_DEMO_CLIENT || m_aClientMasks[i].test(SnappingClient))
+		for(int i = 0; i < (int)m_vEvents.size(); i++)
+			SnapEvent(SnappingClient, i);
+		return;
+	}
+
+	// events outside of the map are in the border cells, the extra cell
+	// of margin keeps this conservative, SnapEvent does the exact clipping
+	const CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+	const vec2 ViewMin = pPlayer->m_ViewPos - pPlayer->m_ShowDistance;
+	const vec2 ViewMax = pPlayer->m_ViewPos + pPlayer->m_ShowDistance;
+
+	m_vSnapCandidates.clear();
+	for(int y = CellY(ViewMin.y - CELL_SIZE); y <= CellY(ViewMax.y + CELL_SIZE); y++)
+	{
+		for(int x = CellX(ViewMin.x - CELL_SIZE); x <= CellX(ViewMax.x + CELL_SIZE); x++)
 		{
-			CNetEvent_Common *pEvent = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(!NetworkClipped(GameServer(), SnappingClient, vec2(pEvent->m_X, pEvent->m_Y)))
-			{
-				int Type = m_aTypes[i];
-				int Size = m_aSizes[i];
-				const char *pData = &m_aData[m_aOffsets[i]];
-				if(GameServer()->Server()->IsSixup(SnappingClient))
-					EventToSixup(&Type, &Size, &pData);
-
-				void *pItem = GameServer()->Server()->SnapNewItem(Type, i, Size);
-				if(pItem)
-					mem_copy(pItem, pData, Size);
-			}
+			const std::vector<int> &vCell = m_vvCells[y * m_CellsWidth + x];
+			m_vSnapCandidates.insert(m_vSnapCandidates.end(), vCell.begin(), vCell.end());
 		}
 	}
+
+	// keep the creation order, so the snapshot is identical to visiting
+	// every event
+	std::sort(m_vSnapCandidates.begin(), m_vSnapCandidates.end());
+	for(int Index : m_vSnapCandidates)
+		SnapEvent(SnappingClient, Index);
+}
+
+void CEventHandler::SnapEvent(int SnappingClient, int Index)
+{
+	const CEvent &Event = m_vEvents[Index];
+	if(SnappingClient != SERVER_DEMO_CLIENT && !Event.m_ClientMask.test(SnappingClient))
+		return;
+
+	const CNetEvent_Common *pEvent = (const CNetEvent_Common *)Event.m_pData;
+	if(NetworkClipped(GameServer(), SnappingClient, vec2(pEvent->m_X, pEvent->m_Y)))
+		return;
+
+	int Type = Event.m_Type;
+	int Size = Event.m_Size;
+	const char *pData = Event.m_pData;
+	if(GameServer()->Server()->IsSixup(SnappingClient))
+		EventToSixup(&Type, &Size, &pData);
+
+	void *pItem = GameServer()->Server()->SnapNewItem(Type, Index, Size);
+	if(pItem)
+		mem_copy(pItem, pData, Size);
+	else
+		m_NumSnapDropped++;
 }
 
 void CEventHandler::EventToSixup(int *pType, int *pSize, const char **ppData)
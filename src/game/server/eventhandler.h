@@ -6,25 +6,51 @@
 #include <engine/shared/protocol.h>
 
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 class CEventHandler
 {
 	enum
 	{
-		MAX_EVENTS = 128,
-		MAX_DATASIZE = 128 * 64,
+		// the event index is used as snapshot item id
+		MAX_EVENTS = 0x10000,
+		CHUNK_SIZE = 16 * 1024,
+		CELL_SIZE = 32 * 32,
 	};
 
-	int m_aTypes[MAX_EVENTS]; // TODO: remove some of these arrays
-	int m_aOffsets[MAX_EVENTS];
-	int m_aSizes[MAX_EVENTS];
-	CClientMask m_aClientMasks[MAX_EVENTS];
-	char m_aData[MAX_DATASIZE];
+	class CEvent
+	{
+	public:
+		int m_Type;
+		int m_Size;
+		char *m_pData;
+		CClientMask m_ClientMask;
+	};
+
+	// event data lives in chunks that are kept between ticks, pointers
+	// returned by `Create` stay valid until `Clear`
+	std::vector<std::unique_ptr<char[]>> m_vpChunks;
+	int m_CurrentChunk;
+	int m_CurrentOffset;
+	std::vector<CEvent> m_vEvents;
+
+	// events bucketed by map region, built by PreSnap
+	bool m_SnapPrepared;
+	int m_CellsWidth;
+	int m_CellsHeight;
+	std::vector<std::vector<int>> m_vvCells;
+	std::vector<int> m_vSnapCandidates;
+
+	int m_PeakEvents;
+	int64_t m_NumOverflows;
+	int64_t m_NumSnapDropped;
 
 	class CGameContext *m_pGameServer;
 
-	int m_CurrentOffset;
-	int m_NumEvents;
+	int CellX(float X) const;
+	int CellY(float Y) const;
+	void SnapEvent(int SnappingClient, int Index);
 
 public:
 	CGameContext *GameServer() const { return m_pGameServer; }
@@ -40,9 +66,20 @@ public:
 	}
 
 	void Clear();
+	// Sorts the events into map regions, so Snap only visits the events
+	// near the view of the snapping client.
+	void PreSnap();
 	void Snap(int SnappingClient);
 
 	void EventToSixup(int *pType, int *pSize, const char **ppData);
+
+	int NumEvents() const { return m_vEvents.size(); }
+	// most events created between two clears
+	int PeakEvents() const { return m_PeakEvents; }
+	// events that couldn't be created because of the snapshot id range
+	int64_t NumOverflows() const { return m_NumOverflows; }
+	// events that were visible but didn't fit into a full snapshot
+	int64_t NumSnapDropped() const { return m_NumSnapDropped; }
 };
 
 #endif
@@ -25,6 +25,7 @@
 #include <engine/shared/linereader.h>
 #include <engine/shared/memheap.h>
 #include <engine/shared/protocolglue.h>
+#include <engine/shared/teehistorian_compressed.h>
 #include <engine/storage.h>
 
 #include <generated/protocol7.h>
@@ -196,6 +197,15 @@ void CGameContext::Clear()
 }
 
 void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUser)
+{
+	CGameContext *pSelf = (CGameContext *)pUser;
+	if(pSelf->m_pTeeHistorianCompressed)
+		pSelf->m_pTeeHistorianCompressed->Write(pData, DataSize);
+	else
+		aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
+}
+
+void CGameContext::TeeHistorianWriteCompressed(const void *pData, int DataSize, void *pUser)
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
 	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
@@ -1045,12 +1055,26 @@ void CGameContext::OnTick()
 			dbg_msg("teehistorian", "error writing to file, err=%d", Error);
 			Server()->SetErrorShutdown("teehistorian io error");
 		}
+		if(m_pTeeHistorianCompressed && m_pTeeHistorianCompressed->Error())
+		{
+			Server()->SetErrorShutdown("teehistorian compression error");
+		}
 
 		if(!m_TeeHistorian.Starting())
 		{
 			m_TeeHistorian.EndInputs();
 			m_TeeHistorian.EndTick();
 		}
+		if(m_pTeeHistorianCompressed)
+		{
+			// bound the data lost on a crash
+			if(Server()->Tick() - m_TeeHistorianFlushTick >= g_Config.m_SvTeeHistorianFlushInterval * Server()->TickSpeed())
+			{
+				m_pTeeHistorianCompressed->Flush();
+				m_TeeHistorianFlushTick = Server()->Tick();
+			}
+			m_pTeeHistorianCompressed->BeginTick(Server()->Tick());
+		}
 		m_TeeHistorian.BeginTick(Server()->Tick());
 		m_TeeHistorian.BeginPlayers();
 	}
@@ -1868,6 +1892,14 @@ void CGameContext::TeehistorianRecordPlayerFinish(int ClientId, int TimeTicks)
 	}
 }
 
+void CGameContext::TeehistorianRecordInputStats(int ClientId, const IServer::CInputStats &Stats)
+{
+	if(m_TeeHistorianActive)
+	{
+		m_TeeHistorian.RecordInputStats(ClientId, Stats);
+	}
+}
+
 void CGameContext::TeehistorianRecordTeamFinish(int TeamId, int TimeTicks)
 {
 	if(m_TeeHistorianActive)
@@ -3770,6 +3802,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("vote", "r['yes'|'no']", CFGFLAG_SERVER, ConVote, this, "Force a vote to yes/no");
 	Console()->Register("votes", "?i[page]", CFGFLAG_SERVER, ConVotes, this, "Show all votes (page 0 by default, 20 entries per page)");
 	Console()->Register("dump_antibot", "", CFGFLAG_SERVER | CFGFLAG_STORE, ConDumpAntibot, this, "Dumps the antibot status");
+	Console()->Register("dump_scorecache", "", CFGFLAG_SERVER, ConDumpScoreCache, this, "Dumps the hit rates of the score query cache");
 	Console()->Register("antibot", "r[command]", CFGFLAG_SERVER | CFGFLAG_STORE, ConAntibot, this, "Sends a command to the antibot");
 
 	Console()->Chain("sv_motd", ConchainSpecialMotdupdate, this);
@@ -4084,7 +4117,7 @@ void CGameContext::OnInit(const void *pPersistentData)
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, g_Config.m_SvTeeHistorianCompress ? ".z" : "");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -4098,6 +4131,11 @@ void CGameContext::OnInit(const void *pPersistentData)
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
 		m_pTeeHistorianFile = aio_new(THFile);
+		if(g_Config.m_SvTeeHistorianCompress)
+		{
+			m_pTeeHistorianCompressed = std::make_unique<CTeeHistorianCompressedWriter>(TeeHistorianWriteCompressed, this);
+			m_TeeHistorianFlushTick = Server()->Tick();
+		}
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -4430,6 +4468,15 @@ void CGameContext::OnShutdown(void *pPersistentData)
 	if(m_TeeHistorianActive)
 	{
 		m_TeeHistorian.Finish();
+		if(m_pTeeHistorianCompressed)
+		{
+			m_pTeeHistorianCompressed->Finish();
+			if(m_pTeeHistorianCompressed->Error())
+			{
+				Server()->SetErrorShutdown("teehistorian compression error");
+			}
+			m_pTeeHistorianCompressed = nullptr;
+		}
 		aio_close(m_pTeeHistorianFile);
 		aio_wait(m_pTeeHistorianFile);
 		int Error = aio_error(m_pTeeHistorianFile);
@@ -4441,6 +4488,11 @@ void CGameContext::OnShutdown(void *pPersistentData)
 		aio_free(m_pTeeHistorianFile);
 	}
 
+	if(m_Events.NumOverflows() > 0 || m_Events.NumSnapDropped() > 0)
+	{
+		log_warn("game", "lost events: peak=%d overflows=%" PRId64 " snap_dropped=%" PRId64, m_Events.PeakEvents(), m_Events.NumOverflows(), m_Events.NumSnapDropped());
+	}
+
 	// Stop any demos being recorded.
 	Server()->StopDemos();
 
@@ -4489,6 +4541,12 @@ void CGameContext::LoadMapSettings()
 	Console()->ExecuteFile(aBuf, IConsole::CLIENT_ID_NO_GAME);
 }
 
+void CGameContext::OnPreSnap()
+{
+	m_World.PreSnap();
+	m_Events.PreSnap();
+}
+
 void CGameContext::OnSnap(int ClientId, bool GlobalSnap)
 {
 	// sixup should only snap during global snap
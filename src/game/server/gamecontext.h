@@ -49,6 +49,7 @@ class CConfig;
 class CHeap;
 class CPlayer;
 class CScore;
+class CTeeHistorianCompressedWriter;
 class CUnpacker;
 class IAntibot;
 class IGameController;
@@ -122,6 +123,9 @@ class CGameContext : public IGameServer
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
 	ASYNCIO *m_pTeeHistorianFile;
+	// only set with sv_tee_historian_compress, writes to `m_pTeeHistorianFile`
+	std::unique_ptr<CTeeHistorianCompressedWriter> m_pTeeHistorianCompressed;
+	int m_TeeHistorianFlushTick;
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 	CPrng m_Prng;
@@ -130,6 +134,7 @@ class CGameContext : public IGameServer
 
 	static void CommandCallback(int ClientId, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser);
 	static void TeeHistorianWrite(const void *pData, int DataSize, void *pUser);
+	static void TeeHistorianWriteCompressed(const void *pData, int DataSize, void *pUser);
 
 	static void ConTuneParam(IConsole::IResult *pResult, void *pUserData);
 	static void ConToggleTuneParam(IConsole::IResult *pResult, void *pUserData);
@@ -162,6 +167,7 @@ class CGameContext : public IGameServer
 	static void ConVoteNo(IConsole::IResult *pResult, void *pUserData);
 	static void ConDrySave(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpAntibot(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpScoreCache(IConsole::IResult *pResult, void *pUserData);
 	static void ConAntibot(IConsole::IResult *pResult, void *pUserData);
 	static void ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainSettingUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -323,6 +329,7 @@ public:
 	void OnShutdown(void *pPersistentData) override;
 
 	void OnTick() override;
+	void OnPreSnap() override;
 	void OnSnap(int ClientId, bool GlobalSnap) override;
 	void OnPostGlobalSnap() override;
 
@@ -363,6 +370,7 @@ public:
 	void TeehistorianRecordPlayerRejoin(int ClientId) override;
 	void TeehistorianRecordPlayerName(int ClientId, const char *pName) override;
 	void TeehistorianRecordPlayerFinish(int ClientId, int TimeTicks) override;
+	void TeehistorianRecordInputStats(int ClientId, const IServer::CInputStats &Stats) override;
 	void TeehistorianRecordTeamFinish(int TeamId, int TimeTicks) override;
 
 	bool IsClientReady(int ClientId) const override;
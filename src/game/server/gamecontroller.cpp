@@ -389,6 +389,7 @@ bool IGameController::OnEntity(int Index, int x, int y, int Layer, int Flags, bo
 		int PickupFlags = TileFlagsToPickupFlags(Flags);
 		CPickup *pPickup = new CPickup(&GameServer()->m_World, Type, SubType, Layer, Number, PickupFlags);
 		pPickup->m_Pos = Pos;
+		GameServer()->m_World.UpdateEntityGrid(pPickup);
 		return true; // NOLINT(clang-analyzer-unix.Malloc)
 	}
 
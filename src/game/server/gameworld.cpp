@@ -7,6 +7,7 @@
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
+#include "player.h"
 
 #include <engine/shared/config.h>
 
@@ -48,27 +49,132 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? nullptr : m_apFirstEntityTypes[Type];
 }
 
+template<typename F>
+void CGameWorld::ForEachCandidate(int Type, vec2 Min, vec2 Max, F &&Function)
+{
+	// small margin so the candidates stay a superset despite rounding
+	const int MinX = GridCellX(Min.x - 1.0f);
+	const int MinY = GridCellY(Min.y - 1.0f);
+	const int MaxX = GridCellX(Max.x + 1.0f);
+	const int MaxY = GridCellY(Max.y + 1.0f);
+
+	// walking the list is cheaper when the area covers more cells than there are entities
+	if(!IsGridType(Type) || (int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1) > m_aNumEntities[Type])
+	{
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			if(!Function(pEnt))
+				return;
+		return;
+	}
+
+	std::vector<CEntity *> vpCandidates;
+	vpCandidates.swap(m_vpGridCandidates);
+	vpCandidates.clear();
+	for(int y = MinY; y <= MaxY; y++)
+	{
+		for(int x = MinX; x <= MaxX; x++)
+		{
+			const std::vector<CEntity *> &vpCell = m_avvpGridCells[Type][y * m_GridWidth + x];
+			vpCandidates.insert(vpCandidates.end(), vpCell.begin(), vpCell.end());
+		}
+	}
+
+	// keep the order of the entity list, entities are inserted at the front
+	std::sort(vpCandidates.begin(), vpCandidates.end(), [](const CEntity *pA, const CEntity *pB) {
+		return pA->m_InsertionOrder > pB->m_InsertionOrder;
+	});
+	for(CEntity *pEnt : vpCandidates)
+		if(!Function(pEnt))
+			break;
+	m_vpGridCandidates.swap(vpCandidates);
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	const float Range = Radius + m_aMaxProximityRadius[Type];
+	ForEachCandidate(Type, Pos - vec2(Range, Range), Pos + vec2(Range, Range), [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
 
+void CGameWorld::InitGrid()
+{
+	m_GridWidth = maximum(1, (GameServer()->Collision()->GetWidth() * 32 + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE);
+	m_GridHeight = maximum(1, (GameServer()->Collision()->GetHeight() * 32 + GRID_CELL_SIZE - 1) / GRID_CELL_SIZE);
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
+		if(IsGridType(Type))
+			m_avvpGridCells[Type].resize((size_t)m_GridWidth * m_GridHeight);
+}
+
+int CGameWorld::GridCellX(float X) const
+{
+	// written to also put NaN and infinite positions into the border cells
+	const float Cell = X / GRID_CELL_SIZE;
+	if(!(Cell > 0.0f))
+		return 0;
+	if(Cell >= m_GridWidth - 1)
+		return m_GridWidth - 1;
+	return (int)Cell;
+}
+
+int CGameWorld::GridCellY(float Y) const
+{
+	const float Cell = Y / GRID_CELL_SIZE;
+	if(!(Cell > 0.0f))
+		return 0;
+	if(Cell >= m_GridHeight - 1)
+		return m_GridHeight - 1;
+	return (int)Cell;
+}
+
+void CGameWorld::UpdateEntityGrid(CEntity *pEnt)
+{
+	if(!IsGridType(pEnt->m_ObjType) || pEnt->m_GridCell == -1)
+		return;
+
+	const int Cell = GridCellY(pEnt->m_Pos.y) * m_GridWidth + GridCellX(pEnt->m_Pos.x);
+	if(Cell == pEnt->m_GridCell)
+		return;
+
+	RemoveFromGrid(pEnt);
+	m_avvpGridCells[pEnt->m_ObjType][Cell].push_back(pEnt);
+	pEnt->m_GridCell = Cell;
+}
+
+void CGameWorld::RemoveFromGrid(CEntity *pEnt)
+{
+	std::vector<CEntity *> &vpCell = m_avvpGridCells[pEnt->m_ObjType][pEnt->m_GridCell];
+	auto It = std::find(vpCell.begin(), vpCell.end(), pEnt);
+	dbg_assert(It != vpCell.end(), "entity missing in its grid cell");
+	*It = vpCell.back();
+	vpCell.pop_back();
+}
+
+void CGameWorld::CheckGrid() const
+{
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
+	{
+		if(!IsGridType(Type))
+			continue;
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			dbg_assert(pEnt->m_GridCell == GridCellY(pEnt->m_Pos.y) * m_GridWidth + GridCellX(pEnt->m_Pos.x), "entity moved without updating the grid");
+	}
+}
+
 void CGameWorld::InsertEntity(CEntity *pEnt)
 {
 #ifdef CONF_DEBUG
@@ -82,6 +188,17 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = nullptr;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	pEnt->m_InsertionOrder = m_NextInsertionOrder++;
+	m_aNumEntities[pEnt->m_ObjType]++;
+	m_aMaxProximityRadius[pEnt->m_ObjType] = maximum(m_aMaxProximityRadius[pEnt->m_ObjType], pEnt->m_ProximityRadius);
+	if(IsGridType(pEnt->m_ObjType))
+	{
+		if(!m_GridWidth)
+			InitGrid();
+		pEnt->m_GridCell = GridCellY(pEnt->m_Pos.y) * m_GridWidth + GridCellX(pEnt->m_Pos.x);
+		m_avvpGridCells[pEnt->m_ObjType][pEnt->m_GridCell].push_back(pEnt);
+	}
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
@@ -104,10 +221,154 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = nullptr;
 	pEnt->m_pPrevTypeEntity = nullptr;
+
+	m_aNumEntities[pEnt->m_ObjType]--;
+	if(pEnt->m_GridCell != -1)
+	{
+		RemoveFromGrid(pEnt);
+		pEnt->m_GridCell = -1;
+	}
+}
+
+int CGameWorld::SnapCellX(float X) const
+{
+	return std::clamp((int)(X / SNAP_CELL_SIZE), 0, m_SnapCellsWidth - 1);
+}
+
+int CGameWorld::SnapCellY(float Y) const
+{
+	return std::clamp((int)(Y / SNAP_CELL_SIZE), 0, m_SnapCellsHeight - 1);
+}
+
+void CGameWorld::PreSnap()
+{
+#ifdef CONF_DEBUG
+	CheckGrid();
+#endif
+
+	m_SnapCellsWidth = maximum(1, (GameServer()->Collision()->GetWidth() * 32 + SNAP_CELL_SIZE - 1) / SNAP_CELL_SIZE);
+	m_SnapCellsHeight = maximum(1, (GameServer()->Collision()->GetHeight() * 32 + SNAP_CELL_SIZE - 1) / SNAP_CELL_SIZE);
+	m_vvSnapCells.resize((size_t)m_SnapCellsWidth * m_SnapCellsHeight);
+	for(auto &vCell : m_vvSnapCells)
+		vCell.clear();
+	m_vpSnapEntities.clear();
+	m_vSnapUnculled.clear();
+
+	// same order as SnapAll, characters first
+	const auto &&AddEntity = [&](CEntity *pEnt) {
+		const int Index = m_vpSnapEntities.size();
+		m_vpSnapEntities.push_back(pEnt);
+
+		vec2 Min, Max;
+		if(!pEnt->GetSnapBounds(&Min, &Max))
+		{
+			m_vSnapUnculled.push_back(Index);
+			return;
+		}
+		for(int y = SnapCellY(Min.y); y <= SnapCellY(Max.y); y++)
+			for(int x = SnapCellX(Min.x); x <= SnapCellX(Max.x); x++)
+				m_vvSnapCells[y * m_SnapCellsWidth + x].push_back(Index);
+	};
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		AddEntity(pEnt);
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		if(i == ENTTYPE_CHARACTER)
+			continue;
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			AddEntity(pEnt);
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_aSnapCanSnapKnown[i].reset();
+		m_aSnapInViewKnown[i].reset();
+	}
+	m_SnapTeamMaskKnown.reset();
+
+	m_SnapPreparedTick = Server()->Tick();
+}
+
+bool CGameWorld::SnapVisibilityPrepared(int SnappingClient)
+{
+	return m_SnapPreparedTick == Server()->Tick() && SnappingClient != SERVER_DEMO_CLIENT;
+}
+
+bool CGameWorld::SnapCanSnapCharacter(int SnappingClient, CCharacter *pChr)
+{
+	if(!SnapVisibilityPrepared(SnappingClient))
+		return pChr->CanSnapCharacter(SnappingClient);
+
+	const int Id = pChr->GetPlayer()->GetCid();
+	if(!m_aSnapCanSnapKnown[SnappingClient].test(Id))
+	{
+		m_aSnapCanSnap[SnappingClient].set(Id, pChr->CanSnapCharacter(SnappingClient));
+		m_aSnapCanSnapKnown[SnappingClient].set(Id);
+	}
+	return m_aSnapCanSnap[SnappingClient].test(Id);
+}
+
+bool CGameWorld::SnapIsCharacterInView(int SnappingClient, CCharacter *pChr)
+{
+	if(!SnapVisibilityPrepared(SnappingClient))
+		return pChr->IsSnappingCharacterInView(SnappingClient);
+
+	const int Id = pChr->GetPlayer()->GetCid();
+	if(!m_aSnapInViewKnown[SnappingClient].test(Id))
+	{
+		m_aSnapInView[SnappingClient].set(Id, pChr->IsSnappingCharacterInView(SnappingClient));
+		m_aSnapInViewKnown[SnappingClient].set(Id);
+	}
+	return m_aSnapInView[SnappingClient].test(Id);
+}
+
+CClientMask CGameWorld::SnapCharacterTeamMask(CCharacter *pChr)
+{
+	if(m_SnapPreparedTick != Server()->Tick())
+		return pChr->TeamMask();
+
+	const int Id = pChr->GetPlayer()->GetCid();
+	if(!m_SnapTeamMaskKnown.test(Id))
+	{
+		m_aSnapTeamMasks[Id] = pChr->TeamMask();
+		m_SnapTeamMaskKnown.set(Id);
+	}
+	return m_aSnapTeamMasks[Id];
 }
 
-//
 void CGameWorld::Snap(int SnappingClient)
+{
+	if(m_SnapPreparedTick != Server()->Tick() || SnappingClient == SERVER_DEMO_CLIENT || GameServer()->m_apPlayers[SnappingClient]->m_ShowAll)
+	{
+		SnapAll(SnappingClient);
+		return;
+	}
+
+	// only visit entities from the cells the client can see, the extra
+	// cell of margin keeps this conservative, Snap still does the exact
+	// clipping
+	const CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+	const vec2 ViewMin = pPlayer->m_ViewPos - pPlayer->m_ShowDistance;
+	const vec2 ViewMax = pPlayer->m_ViewPos + pPlayer->m_ShowDistance;
+
+	m_vSnapCandidates.assign(m_vSnapUnculled.begin(), m_vSnapUnculled.end());
+	for(int y = SnapCellY(ViewMin.y - SNAP_CELL_SIZE); y <= SnapCellY(ViewMax.y + SNAP_CELL_SIZE); y++)
+	{
+		for(int x = SnapCellX(ViewMin.x - SNAP_CELL_SIZE); x <= SnapCellX(ViewMax.x + SNAP_CELL_SIZE); x++)
+		{
+			const std::vector<int> &vCell = m_vvSnapCells[y * m_SnapCellsWidth + x];
+			m_vSnapCandidates.insert(m_vSnapCandidates.end(), vCell.begin(), vCell.end());
+		}
+	}
+
+	// keep the order of SnapAll, so the snapshot is identical
+	std::sort(m_vSnapCandidates.begin(), m_vSnapCandidates.end());
+	m_vSnapCandidates.erase(std::unique(m_vSnapCandidates.begin(), m_vSnapCandidates.end()), m_vSnapCandidates.end());
+	for(int Index : m_vSnapCandidates)
+		m_vpSnapEntities[Index]->Snap(SnappingClient);
+}
+
+void CGameWorld::SnapAll(int SnappingClient)
 {
 	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
 	{
@@ -211,6 +472,7 @@ void CGameWorld::Tick()
 				{
 					m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 					((CCharacter *)pEnt)->PreTick();
+					UpdateEntityGrid(pEnt);
 					pEnt = m_pNextTraverseEntity;
 				}
 			}
@@ -220,6 +482,7 @@ void CGameWorld::Tick()
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->Tick();
+				UpdateEntityGrid(pEnt);
 				pEnt = m_pNextTraverseEntity;
 			}
 		}
@@ -229,6 +492,7 @@ void CGameWorld::Tick()
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->TickDeferred();
+				UpdateEntityGrid(pEnt);
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
@@ -240,12 +504,17 @@ void CGameWorld::Tick()
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 				pEnt->TickPaused();
+				UpdateEntityGrid(pEnt);
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
 
 	RemoveEntities();
 
+#ifdef CONF_DEBUG
+	CheckGrid();
+#endif
+
 	// find the characters' strong/weak id
 	int StrongWeakId = 0;
 	for(CCharacter *pChar = (CCharacter *)FindFirst(ENTTYPE_CHARACTER); pChar; pChar = (CCharacter *)pChar->TypeNext())
@@ -292,17 +561,21 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CEntity *pClosest = nullptr;
 
-	CEntity *pEntity = FindFirst(Type);
-	for(; pEntity; pEntity = pEntity->TypeNext())
-	{
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return nullptr;
+
+	const float Range = Radius + m_aMaxProximityRadius[Type];
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x) - Range, minimum(Pos0.y, Pos1.y) - Range);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x) + Range, maximum(Pos0.y, Pos1.y) + Range);
+	ForEachCandidate(Type, Min, Max, [&](CEntity *pEntity) {
 		if(pEntity == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && pEntity != pThisOnly)
-			continue;
+			return true;
 
 		if(CollideWith != -1 && !pEntity->CanCollide(CollideWith))
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pEntity->m_Pos, IntersectPos))
@@ -319,7 +592,8 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -330,11 +604,11 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = nullptr;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	const float Range = Radius + m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	ForEachCandidate(ENTTYPE_CHARACTER, Pos - vec2(Range, Range), Pos + vec2(Range, Range), [&](CEntity *pEnt) {
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		float Len = distance(Pos, p->m_Pos);
 		if(Len < p->m_ProximityRadius + Radius)
@@ -345,7 +619,8 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 				pClosest = p;
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -353,11 +628,13 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	const float Range = Radius + m_aMaxProximityRadius[ENTTYPE_CHARACTER];
+	const vec2 Min = vec2(minimum(Pos0.x, Pos1.x) - Range, minimum(Pos0.y, Pos1.y) - Range);
+	const vec2 Max = vec2(maximum(Pos0.x, Pos1.x) + Range, maximum(Pos0.y, Pos1.y) + Range);
+	ForEachCandidate(ENTTYPE_CHARACTER, Min, Max, [&](CEntity *pEnt) {
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -368,7 +645,8 @@ std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1
 				vpCharacters.push_back(pChr);
 			}
 		}
-	}
+		return true;
+	});
 	return vpCharacters;
 }
 
@@ -37,6 +37,58 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// broadphase grid for the entity types that are queried by position
+	enum
+	{
+		GRID_CELL_SIZE = 8 * 32,
+	};
+	int m_GridWidth = 0;
+	int m_GridHeight = 0;
+	int64_t m_NextInsertionOrder = 0;
+	int m_aNumEntities[NUM_ENTTYPES] = {};
+	float m_aMaxProximityRadius[NUM_ENTTYPES] = {};
+	std::vector<std::vector<CEntity *>> m_avvpGridCells[NUM_ENTTYPES];
+
+	static bool IsGridType(int Type) { return Type == ENTTYPE_CHARACTER || Type == ENTTYPE_PICKUP; }
+	void InitGrid();
+	int GridCellX(float X) const;
+	int GridCellY(float Y) const;
+	void RemoveFromGrid(CEntity *pEnt);
+	// Calls Function with the entities of the type that may lie within Min
+	// and Max, in the order of the entity list, until it returns false.
+	template<typename F>
+	void ForEachCandidate(int Type, vec2 Min, vec2 Max, F &&Function);
+	// reused by ForEachCandidate, a nested query gets a vector of its own
+	std::vector<CEntity *> m_vpGridCandidates;
+	void CheckGrid() const;
+
+	// shared snapshot state, built once per snapshot tick by PreSnap
+	enum
+	{
+		SNAP_CELL_SIZE = 32 * 32,
+	};
+	int m_SnapPreparedTick = -1;
+	int m_SnapCellsWidth = 0;
+	int m_SnapCellsHeight = 0;
+	std::vector<CEntity *> m_vpSnapEntities;
+	std::vector<int> m_vSnapUnculled;
+	std::vector<std::vector<int>> m_vvSnapCells;
+	std::vector<int> m_vSnapCandidates;
+
+	int SnapCellX(float X) const;
+	int SnapCellY(float Y) const;
+	void SnapAll(int SnappingClient);
+
+	// character visibility of the current snapshot, indexed by the
+	// snapping client and filled on first use, reset by PreSnap
+	CClientMask m_aSnapCanSnapKnown[MAX_CLIENTS];
+	CClientMask m_aSnapCanSnap[MAX_CLIENTS];
+	CClientMask m_aSnapInViewKnown[MAX_CLIENTS];
+	CClientMask m_aSnapInView[MAX_CLIENTS];
+	CClientMask m_SnapTeamMaskKnown;
+	CClientMask m_aSnapTeamMasks[MAX_CLIENTS];
+	bool SnapVisibilityPrepared(int SnappingClient);
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -141,9 +193,51 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: UpdateEntityGrid
+			Moves an entity to the grid cell of its current position.
+			Must be called after changing the position of an entity
+			outside of its own tick functions.
+
+		Arguments:
+			pEntity - Entity that was moved
+	*/
+	void UpdateEntityGrid(CEntity *pEntity);
+
 	void RemoveEntitiesFromPlayer(int PlayerId);
 	void RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers);
 
+	/*
+		Function: PreSnap
+			Collects all entities together with the area they are
+			visible from. Called once per snapshot tick before the
+			per client snapshots are created, allowing Snap to skip
+			entities that are clipped for the snapping client.
+	*/
+	void PreSnap();
+
+	/*
+		Function: SnapCanSnapCharacter
+			Same as CCharacter::CanSnapCharacter, but only computed
+			once per snapshot for each snapping client and character.
+			Must only be used while snapping.
+	*/
+	bool SnapCanSnapCharacter(int SnappingClient, CCharacter *pChr);
+
+	/*
+		Function: SnapIsCharacterInView
+			Same as CCharacter::IsSnappingCharacterInView, cached
+			like SnapCanSnapCharacter.
+	*/
+	bool SnapIsCharacterInView(int SnappingClient, CCharacter *pChr);
+
+	/*
+		Function: SnapCharacterTeamMask
+			Same as CCharacter::TeamMask, cached for the current
+			snapshot.
+	*/
+	CClientMask SnapCharacterTeamMask(CCharacter *pChr);
+
 	/*
 		Function: Snap
 			Calls Snap on all the entities in the world to create
@@ -486,7 +486,7 @@ void CPlayer::Snap(int SnappingClient)
 		pRaceInfo->m_RaceStartTick = m_pCharacter->m_StartTime;
 	}
 
-	bool ShowSpec = m_pCharacter && m_pCharacter->IsPaused() && m_pCharacter->CanSnapCharacter(SnappingClient);
+	bool ShowSpec = m_pCharacter && m_pCharacter->IsPaused() && GameServer()->m_World.SnapCanSnapCharacter(SnappingClient, m_pCharacter);
 
 	if(SnappingClient != SERVER_DEMO_CLIENT)
 	{
@@ -4,13 +4,68 @@
 #include "teams.h"
 
 #include <engine/shared/config.h>
+#include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
 
 #include <game/server/entities/character.h>
 #include <game/server/gamemodes/DDRace.h>
 #include <game/team_state.h>
 
+#include <zlib.h>
+
 #include <cstdio> // sscanf
+#include <memory>
+
+static const unsigned char SAVE_BINARY_MAGIC[4] = {'T', 'W', 'S', 'V'};
+static const char SAVE_DATA_PREFIX[] = "$bin\n";
+
+enum
+{
+	SAVE_BINARY_VERSION = 1,
+	SAVE_BINARY_FLAG_COMPRESSED = 1,
+	// fixed header: magic, version, flags, uncompressed size
+	SAVE_BINARY_HEADER_SIZE = sizeof(SAVE_BINARY_MAGIC) + 3 * 4,
+};
+
+class CSavePacker : public CAbstractPacker
+{
+public:
+	CSavePacker() :
+		CAbstractPacker(m_aBuffer, sizeof(m_aBuffer))
+	{
+	}
+
+private:
+	unsigned char m_aBuffer[1024 * 64];
+};
+
+static void AddFloat(CAbstractPacker *pPacker, float Value)
+{
+	int Bits;
+	mem_copy(&Bits, &Value, sizeof(Bits));
+	pPacker->AddInt(Bits);
+}
+
+static float GetFloat(CUnpacker *pUnpacker)
+{
+	const int Bits = pUnpacker->GetInt();
+	float Value;
+	mem_copy(&Value, &Bits, sizeof(Value));
+	return Value;
+}
+
+static void AddVec(CAbstractPacker *pPacker, vec2 Value)
+{
+	AddFloat(pPacker, Value.x);
+	AddFloat(pPacker, Value.y);
+}
+
+static vec2 GetVec(CUnpacker *pUnpacker)
+{
+	const float x = GetFloat(pUnpacker);
+	const float y = GetFloat(pUnpacker);
+	return vec2(x, y);
+}
 
 CSaveTee::CSaveTee() = default;
 
@@ -193,6 +248,7 @@ bool CSaveTee::Load(CCharacter *pChr, std::optional<int> Team)
 		pChr->m_StartTime = pChr->Server()->Tick() - m_Time;
 
 	pChr->m_Pos = m_Pos;
+	pChr->GameWorld()->UpdateEntityGrid(pChr);
 	pChr->m_PrevPos = m_PrevPos;
 	pChr->m_TeleCheckpoint = m_TeleCheckpoint;
 	pChr->m_LastPenalty = m_LastPenalty;
@@ -263,20 +319,22 @@ bool CSaveTee::Load(CCharacter *pChr, std::optional<int> Team)
 	return Valid;
 }
 
-char *CSaveTee::GetString(const CSaveTeam *pTeam)
+int CSaveTee::HookedPlayerIndex(const CSaveTeam *pTeam) const
 {
-	int HookedPlayer = -1;
 	if(m_HookedPlayer != -1)
 	{
 		for(int n = 0; n < pTeam->GetMembersCount(); n++)
 		{
 			if(m_HookedPlayer == pTeam->m_pSavedTees[n].GetClientId())
-			{
-				HookedPlayer = n;
-				break;
-			}
+				return n;
 		}
 	}
+	return -1;
+}
+
+char *CSaveTee::GetString(const CSaveTeam *pTeam)
+{
+	const int HookedPlayer = HookedPlayerIndex(pTeam);
 
 	str_format(m_aString, sizeof(m_aString),
 		"%s\t%d\t%d\t%d\t%d\t%d\t"
@@ -473,6 +531,178 @@ int CSaveTee::FromString(const char *pString)
 	}
 }
 
+void CSaveTee::ToBinary(CAbstractPacker *pPacker, const CSaveTeam *pTeam) const
+{
+	// same order as the text format
+	pPacker->AddString(m_aName);
+	pPacker->AddInt(m_Alive);
+	pPacker->AddInt(m_Paused);
+	pPacker->AddInt(m_NeededFaketuning);
+	pPacker->AddInt(m_TeeFinished);
+	pPacker->AddInt(m_IsSolo);
+	for(const CWeaponStat &Weapon : m_aWeapons)
+	{
+		pPacker->AddInt(Weapon.m_AmmoRegenStart);
+		pPacker->AddInt(Weapon.m_Ammo);
+		pPacker->AddInt(Weapon.m_Ammocost);
+		pPacker->AddInt(Weapon.m_Got);
+	}
+	pPacker->AddInt(m_LastWeapon);
+	pPacker->AddInt(m_QueuedWeapon);
+
+	pPacker->AddInt(m_EndlessJump);
+	pPacker->AddInt(m_Jetpack);
+	pPacker->AddInt(m_NinjaJetpack);
+	pPacker->AddInt(m_FreezeTime);
+	pPacker->AddInt(m_FreezeStart);
+	pPacker->AddInt(m_DeepFrozen);
+	pPacker->AddInt(m_EndlessHook);
+	pPacker->AddInt(m_DDRaceState);
+	pPacker->AddInt(m_HitDisabledFlags);
+	pPacker->AddInt(m_CollisionEnabled);
+	pPacker->AddInt(m_TuneZone);
+	pPacker->AddInt(m_TuneZoneOld);
+	pPacker->AddInt(m_HookHitEnabled);
+	pPacker->AddInt(m_Time);
+	AddVec(pPacker, m_Pos);
+	AddVec(pPacker, m_PrevPos);
+	pPacker->AddInt(m_TeleCheckpoint);
+	pPacker->AddInt(m_LastPenalty);
+	AddVec(pPacker, m_CorePos);
+	AddVec(pPacker, m_Vel);
+	pPacker->AddInt(m_ActiveWeapon);
+	pPacker->AddInt(m_Jumped);
+	pPacker->AddInt(m_JumpedTotal);
+	pPacker->AddInt(m_Jumps);
+	AddVec(pPacker, m_HookPos);
+	AddVec(pPacker, m_HookDir);
+	AddVec(pPacker, m_HookTeleBase);
+	pPacker->AddInt(m_HookTick);
+	pPacker->AddInt(m_HookState);
+
+	pPacker->AddInt(m_TimeCpBroadcastEndTime);
+	pPacker->AddInt(m_LastTimeCp);
+	pPacker->AddInt(m_LastTimeCpBroadcasted);
+	for(float TimeCp : m_aCurrentTimeCp)
+		AddFloat(pPacker, TimeCp);
+	pPacker->AddInt(m_NotEligibleForFinish);
+	pPacker->AddInt(m_HasTelegunGun);
+	pPacker->AddInt(m_HasTelegunLaser);
+	pPacker->AddInt(m_HasTelegunGrenade);
+
+	CUuid GameUuid;
+	if(ParseUuid(&GameUuid, m_aGameUuid))
+		GameUuid = CalculateUuid("game-uuid-nonexistent@ddnet.tw");
+	pPacker->AddRaw(&GameUuid, sizeof(GameUuid));
+
+	pPacker->AddInt(HookedPlayerIndex(pTeam));
+	pPacker->AddInt(m_NewHook);
+	pPacker->AddInt(m_InputDirection);
+	pPacker->AddInt(m_InputJump);
+	pPacker->AddInt(m_InputFire);
+	pPacker->AddInt(m_InputHook);
+	pPacker->AddInt(m_ReloadTimer);
+	pPacker->AddInt(m_TeeStarted);
+	pPacker->AddInt(m_LiveFrozen);
+	AddVec(pPacker, m_Ninja.m_ActivationDir);
+	pPacker->AddInt(m_Ninja.m_ActivationTick);
+	pPacker->AddInt(m_Ninja.m_CurrentMoveTime);
+	pPacker->AddInt(m_Ninja.m_OldVelAmount);
+}
+
+bool CSaveTee::FromBinary(CUnpacker *pUnpacker, int NumMembers)
+{
+	str_copy(m_aName, pUnpacker->GetString(), sizeof(m_aName));
+	m_Alive = pUnpacker->GetInt();
+	m_Paused = pUnpacker->GetInt();
+	m_NeededFaketuning = pUnpacker->GetInt();
+	m_TeeFinished = pUnpacker->GetInt();
+	m_IsSolo = pUnpacker->GetInt();
+	for(CWeaponStat &Weapon : m_aWeapons)
+	{
+		Weapon.m_AmmoRegenStart = pUnpacker->GetInt();
+		Weapon.m_Ammo = pUnpacker->GetInt();
+		Weapon.m_Ammocost = pUnpacker->GetInt();
+		Weapon.m_Got = pUnpacker->GetInt();
+	}
+	m_LastWeapon = pUnpacker->GetInt();
+	m_QueuedWeapon = pUnpacker->GetInt();
+
+	m_EndlessJump = pUnpacker->GetInt();
+	m_Jetpack = pUnpacker->GetInt();
+	m_NinjaJetpack = pUnpacker->GetInt();
+	m_FreezeTime = pUnpacker->GetInt();
+	m_FreezeStart = pUnpacker->GetInt();
+	m_DeepFrozen = pUnpacker->GetInt();
+	m_EndlessHook = pUnpacker->GetInt();
+	m_DDRaceState = pUnpacker->GetInt();
+	m_HitDisabledFlags = pUnpacker->GetInt();
+	m_CollisionEnabled = pUnpacker->GetInt();
+	m_TuneZone = pUnpacker->GetInt();
+	m_TuneZoneOld = pUnpacker->GetInt();
+	m_HookHitEnabled = pUnpacker->GetInt();
+	m_Time = pUnpacker->GetInt();
+	m_Pos = GetVec(pUnpacker);
+	m_PrevPos = GetVec(pUnpacker);
+	m_TeleCheckpoint = pUnpacker->GetInt();
+	m_LastPenalty = pUnpacker->GetInt();
+	m_CorePos = GetVec(pUnpacker);
+	m_Vel = GetVec(pUnpacker);
+	m_ActiveWeapon = pUnpacker->GetInt();
+	m_Jumped = pUnpacker->GetInt();
+	m_JumpedTotal = pUnpacker->GetInt();
+	m_Jumps = pUnpacker->GetInt();
+	m_HookPos = GetVec(pUnpacker);
+	m_HookDir = GetVec(pUnpacker);
+	m_HookTeleBase = GetVec(pUnpacker);
+	m_HookTick = pUnpacker->GetInt();
+	m_HookState = pUnpacker->GetInt();
+
+	m_TimeCpBroadcastEndTime = pUnpacker->GetInt();
+	m_LastTimeCp = pUnpacker->GetInt();
+	m_LastTimeCpBroadcasted = pUnpacker->GetInt();
+	for(float &TimeCp : m_aCurrentTimeCp)
+		TimeCp = GetFloat(pUnpacker);
+	m_NotEligibleForFinish = pUnpacker->GetInt();
+	m_HasTelegunGun = pUnpacker->GetInt();
+	m_HasTelegunLaser = pUnpacker->GetInt();
+	m_HasTelegunGrenade = pUnpacker->GetInt();
+
+	const unsigned char *pGameUuid = pUnpacker->GetRaw(sizeof(CUuid));
+	if(pGameUuid)
+	{
+		CUuid GameUuid;
+		mem_copy(&GameUuid, pGameUuid, sizeof(GameUuid));
+		FormatUuid(GameUuid, m_aGameUuid, sizeof(m_aGameUuid));
+	}
+
+	m_HookedPlayer = pUnpacker->GetInt();
+	m_NewHook = pUnpacker->GetInt();
+	m_InputDirection = pUnpacker->GetInt();
+	m_InputJump = pUnpacker->GetInt();
+	m_InputFire = pUnpacker->GetInt();
+	m_InputHook = pUnpacker->GetInt();
+	m_ReloadTimer = pUnpacker->GetInt();
+	m_TeeStarted = pUnpacker->GetInt();
+	m_LiveFrozen = pUnpacker->GetInt();
+	m_Ninja.m_ActivationDir = GetVec(pUnpacker);
+	m_Ninja.m_ActivationTick = pUnpacker->GetInt();
+	m_Ninja.m_CurrentMoveTime = pUnpacker->GetInt();
+	m_Ninja.m_OldVelAmount = pUnpacker->GetInt();
+
+	if(pUnpacker->Error())
+	{
+		dbg_msg("load", "failed to load binary tee");
+		return false;
+	}
+	if(m_HookedPlayer < -1 || m_HookedPlayer >= NumMembers)
+	{
+		dbg_msg("load", "invalid hooked player %d", m_HookedPlayer);
+		return false;
+	}
+	return true;
+}
+
 void CSaveTee::LoadHookedPlayer(const CSaveTeam *pTeam)
 {
 	if(m_HookedPlayer == -1)
@@ -793,6 +1023,8 @@ int CSaveTeam::FromString(const char *pString)
 				dbg_msg("load", "loaded %d vars", Num - 1);
 				return 1;
 			}
+			// hooked players are stored as index until MatchPlayers
+			m_pSavedTees[n].SetClientId(n);
 		}
 		else
 		{
@@ -849,6 +1081,185 @@ int CSaveTeam::FromString(const char *pString)
 	return 0;
 }
 
+bool CSaveTeam::ToBinary(std::vector<unsigned char> *pvData)
+{
+	std::unique_ptr<CSavePacker> pPacker = std::make_unique<CSavePacker>();
+	pPacker->Reset();
+	pPacker->AddInt(static_cast<int>(m_TeamState));
+	pPacker->AddInt(m_MembersCount);
+	pPacker->AddInt(m_pSwitchers ? m_HighestSwitchNumber : 0);
+	pPacker->AddInt(m_TeamLocked);
+	pPacker->AddInt(m_Practice);
+	for(int i = 0; i < m_MembersCount; i++)
+		m_pSavedTees[i].ToBinary(pPacker.get(), this);
+	if(m_pSwitchers)
+	{
+		for(int i = 1; i < m_HighestSwitchNumber + 1; i++)
+		{
+			pPacker->AddInt(m_pSwitchers[i].m_Status);
+			pPacker->AddInt(m_pSwitchers[i].m_EndTime);
+			pPacker->AddInt(m_pSwitchers[i].m_Type);
+		}
+	}
+	if(pPacker->Error())
+	{
+		dbg_msg("save", "savegame too big for the binary format");
+		return false;
+	}
+
+	pvData->resize(SAVE_BINARY_HEADER_SIZE + compressBound(pPacker->Size()));
+	unsigned char *pHeader = pvData->data();
+	mem_copy(pHeader, SAVE_BINARY_MAGIC, sizeof(SAVE_BINARY_MAGIC));
+	uint_to_bytes_be(pHeader + 4, SAVE_BINARY_VERSION);
+	uint_to_bytes_be(pHeader + 12, pPacker->Size());
+
+	uLongf CompressedSize = pvData->size() - SAVE_BINARY_HEADER_SIZE;
+	if(compress2(pvData->data() + SAVE_BINARY_HEADER_SIZE, &CompressedSize, pPacker->Data(), pPacker->Size(), Z_DEFAULT_COMPRESSION) == Z_OK &&
+		CompressedSize < (uLongf)pPacker->Size())
+	{
+		uint_to_bytes_be(pHeader + 8, SAVE_BINARY_FLAG_COMPRESSED);
+		pvData->resize(SAVE_BINARY_HEADER_SIZE + CompressedSize);
+	}
+	else
+	{
+		uint_to_bytes_be(pHeader + 8, 0);
+		pvData->resize(SAVE_BINARY_HEADER_SIZE + pPacker->Size());
+		mem_copy(pvData->data() + SAVE_BINARY_HEADER_SIZE, pPacker->Data(), pPacker->Size());
+	}
+	return true;
+}
+
+int CSaveTeam::FromBinary(const unsigned char *pData, int Size)
+{
+	if(Size < SAVE_BINARY_HEADER_SIZE || mem_comp(pData, SAVE_BINARY_MAGIC, sizeof(SAVE_BINARY_MAGIC)) != 0)
+	{
+		dbg_msg("load", "savegame: not a binary savegame");
+		return 1;
+	}
+	const unsigned Version = bytes_be_to_uint(pData + 4);
+	const unsigned Flags = bytes_be_to_uint(pData + 8);
+	const unsigned PayloadSize = bytes_be_to_uint(pData + 12);
+	if(Version != SAVE_BINARY_VERSION)
+	{
+		dbg_msg("load", "savegame: unsupported binary version %u", Version);
+		return 1;
+	}
+	if(PayloadSize > sizeof(m_aString))
+	{
+		dbg_msg("load", "savegame: binary savegame too big");
+		return 1;
+	}
+
+	std::vector<unsigned char> vPayload;
+	const unsigned char *pPayload = pData + SAVE_BINARY_HEADER_SIZE;
+	if(Flags & SAVE_BINARY_FLAG_COMPRESSED)
+	{
+		vPayload.resize(PayloadSize);
+		uLongf DestSize = PayloadSize;
+		if(uncompress(vPayload.data(), &DestSize, pPayload, Size - SAVE_BINARY_HEADER_SIZE) != Z_OK || DestSize != PayloadSize)
+		{
+			dbg_msg("load", "savegame: failed to decompress");
+			return 1;
+		}
+		pPayload = vPayload.data();
+	}
+	else if(PayloadSize != (unsigned)(Size - SAVE_BINARY_HEADER_SIZE))
+	{
+		dbg_msg("load", "savegame: wrong binary size");
+		return 1;
+	}
+
+	CUnpacker Unpacker;
+	Unpacker.Reset(pPayload, PayloadSize);
+	m_TeamState = static_cast<ETeamState>(Unpacker.GetInt());
+	m_MembersCount = Unpacker.GetInt();
+	m_HighestSwitchNumber = Unpacker.GetInt();
+	m_TeamLocked = Unpacker.GetInt();
+	m_Practice = Unpacker.GetInt();
+	// every tee and switcher takes at least one byte per value
+	if(Unpacker.Error() || m_MembersCount < 0 || m_MembersCount > 64 ||
+		m_HighestSwitchNumber < 0 || m_HighestSwitchNumber > (int)PayloadSize)
+	{
+		dbg_msg("load", "savegame: wrong binary team stats");
+		return 1;
+	}
+
+	delete[] m_pSavedTees;
+	m_pSavedTees = nullptr;
+	if(m_MembersCount)
+		m_pSavedTees = new CSaveTee[m_MembersCount];
+	for(int n = 0; n < m_MembersCount; n++)
+	{
+		if(!m_pSavedTees[n].FromBinary(&Unpacker, m_MembersCount))
+			return 1;
+		m_pSavedTees[n].SetClientId(n);
+	}
+
+	delete[] m_pSwitchers;
+	m_pSwitchers = nullptr;
+	if(m_HighestSwitchNumber)
+		m_pSwitchers = new SSimpleSwitchers[m_HighestSwitchNumber + 1];
+	for(int n = 1; n < m_HighestSwitchNumber + 1; n++)
+	{
+		m_pSwitchers[n].m_Status = Unpacker.GetInt();
+		m_pSwitchers[n].m_EndTime = Unpacker.GetInt();
+		m_pSwitchers[n].m_Type = Unpacker.GetInt();
+	}
+	if(Unpacker.Error())
+	{
+		dbg_msg("load", "savegame: failed to load switchers");
+		return 1;
+	}
+	return 0;
+}
+
+bool CSaveTeam::ConvertLegacy(const char *pLegacy, std::vector<unsigned char> *pvData)
+{
+	std::unique_ptr<CSaveTeam> pTeam = std::make_unique<CSaveTeam>();
+	return pTeam->FromString(pLegacy) == 0 && pTeam->ToBinary(pvData);
+}
+
+const char *CSaveTeam::GetSaveData()
+{
+	std::vector<unsigned char> vData;
+	if(!ToBinary(&vData))
+		return GetString();
+
+	int Length = str_length(SAVE_DATA_PREFIX);
+	for(int i = 0; i < m_MembersCount; i++)
+		Length += str_length(m_pSavedTees[i].GetName()) + 2;
+	const int Base64Length = (vData.size() + 2) / 3 * 4;
+	if(Length + Base64Length + 1 > (int)sizeof(m_aString))
+		return GetString();
+
+	str_copy(m_aString, SAVE_DATA_PREFIX);
+	for(int i = 0; i < m_MembersCount; i++)
+	{
+		str_append(m_aString, m_pSavedTees[i].GetName());
+		str_append(m_aString, "\t\n");
+	}
+	str_base64(m_aString + Length, sizeof(m_aString) - Length, vData.data(), vData.size());
+	return m_aString;
+}
+
+int CSaveTeam::FromSaveData(const char *pString)
+{
+	if(!str_startswith(pString, SAVE_DATA_PREFIX))
+		return FromString(pString);
+
+	// the member names are only there for searching, the binary save
+	// after the last line break contains them as well
+	const char *pBase64 = str_rchr(pString, '\n') + 1;
+	std::vector<unsigned char> vData(str_length(pBase64) / 4 * 3 + 3);
+	const int Size = str_base64_decode(vData.data(), vData.size(), pBase64);
+	if(Size < 0)
+	{
+		dbg_msg("load", "savegame: invalid base64");
+		return 1;
+	}
+	return FromBinary(vData.data(), Size);
+}
+
 bool CSaveTeam::MatchPlayers(const char (*paNames)[MAX_NAME_LENGTH], const int *pClientId, int NumPlayer, char *pMessage, int MessageLen) const
 {
 	if(NumPlayer > m_MembersCount)
@@ -10,7 +10,10 @@
 #include <game/team_state.h>
 
 #include <optional>
+#include <vector>
 
+class CAbstractPacker;
+class CUnpacker;
 class IGameController;
 class CGameContext;
 class CGameWorld;
@@ -44,6 +47,8 @@ public:
 	bool Load(CCharacter *pchr, std::optional<int> Team = std::nullopt);
 	char *GetString(const CSaveTeam *pTeam);
 	int FromString(const char *pString);
+	void ToBinary(CAbstractPacker *pPacker, const CSaveTeam *pTeam) const;
+	bool FromBinary(CUnpacker *pUnpacker, int NumMembers);
 	void LoadHookedPlayer(const CSaveTeam *pTeam);
 	bool IsHooking() const;
 	vec2 GetPos() const { return m_Pos; }
@@ -61,6 +66,8 @@ public:
 	};
 
 private:
+	int HookedPlayerIndex(const CSaveTeam *pTeam) const;
+
 	int m_ClientId;
 
 	char m_aString[2048];
@@ -175,10 +182,28 @@ class CSaveTeam
 public:
 	CSaveTeam();
 	~CSaveTeam();
+	// legacy tab separated text format, still used for teehistorian and
+	// dry saves
 	char *GetString();
 	int GetMembersCount() const { return m_MembersCount; }
 	// MatchPlayers has to be called afterwards
 	int FromString(const char *pString);
+
+	// Versioned binary format, compressed if that makes it smaller.
+	bool ToBinary(std::vector<unsigned char> *pvData);
+	// MatchPlayers has to be called afterwards, returns 0 on success
+	int FromBinary(const unsigned char *pData, int Size);
+	// Converts a save in the legacy text format into the binary format.
+	static bool ConvertLegacy(const char *pLegacy, std::vector<unsigned char> *pvData);
+
+	// Save data as stored in the database: a line with the name of each
+	// member, so saves can still be searched by player, followed by the
+	// base64 encoded binary save. Falls back to the legacy text format
+	// if it doesn't fit.
+	const char *GetSaveData();
+	// Loads save data in either format, returns 0 on success. MatchPlayers
+	// has to be called afterwards.
+	int FromSaveData(const char *pString);
 	// returns true if a team can load, otherwise writes a nice error Message in pMessage
 	bool MatchPlayers(const char (*paNames)[MAX_NAME_LENGTH], const int *pClientId, int NumPlayer, char *pMessage, int MessageLen) const;
 	ESaveResult Save(CGameContext *pGameServer, int Team, bool Dry = false, bool Force = false);
@@ -35,7 +35,8 @@ void CScore::ExecPlayerThread(
 	const char *pThreadName,
 	int ClientId,
 	const char *pName,
-	int Offset)
+	int Offset,
+	CScoreCache::EQuery CacheQuery)
 {
 	auto pResult = NewSqlPlayerResult(ClientId);
 	if(pResult == nullptr)
@@ -47,6 +48,18 @@ void CScore::ExecPlayerThread(
 	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientId), sizeof(Tmp->m_aRequestingPlayer));
 	Tmp->m_Offset = Offset;
 
+	if(CacheQuery != CScoreCache::QUERY_NONE)
+	{
+		// answer from the cache without taking up a database worker
+		if(m_pCache->Lookup(CacheQuery, Tmp.get(), pResult.get()))
+		{
+			pResult->m_Success = true;
+			pResult->m_Completed.store(true);
+			return;
+		}
+		Tmp->m_pCache = m_pCache;
+	}
+
 	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
 }
 
@@ -75,6 +88,7 @@ void CScore::GeneratePassphrase(char *pBuf, int BufSize)
 
 CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	m_pPool(pPool),
+	m_pCache(std::make_shared<CScoreCache>()),
 	m_pGameServer(pGameServer),
 	m_pServer(pGameServer->Server())
 {
@@ -119,6 +133,13 @@ void CScore::LoadBestTime()
 
 	auto Tmp = std::make_unique<CSqlLoadBestTimeRequest>(LoadBestTimeResult);
 	str_copy(Tmp->m_aMap, Server()->GetMapName(), sizeof(Tmp->m_aMap));
+	if(m_pCache->Lookup(CScoreCache::QUERY_BEST_TIME, Tmp->m_aMap, &LoadBestTimeResult->m_CurrentRecord, &Tmp->m_CacheGeneration))
+	{
+		LoadBestTimeResult->m_Success = true;
+		LoadBestTimeResult->m_Completed.store(true);
+		return;
+	}
+	Tmp->m_pCache = m_pCache;
 	m_pPool->Execute(CScoreWorker::LoadBestTime, std::move(Tmp), "load best time");
 }
 
@@ -143,7 +164,7 @@ void CScore::MapInfo(int ClientId, const char *pMapName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::MapInfo, "map info", ClientId, pMapName, 0);
+	ExecPlayerThread(CScoreWorker::MapInfo, "map info", ClientId, pMapName, 0, CScoreCache::QUERY_MAP_INFO);
 }
 
 void CScore::SaveScore(int ClientId, int TimeTicks, const char *pTimestamp, const float aTimeCp[NUM_CHECKPOINTS], bool NotEligible)
@@ -167,6 +188,7 @@ void CScore::SaveScore(int ClientId, int TimeTicks, const char *pTimestamp, cons
 	str_copy(Tmp->m_aTimestamp, pTimestamp, sizeof(Tmp->m_aTimestamp));
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCurrentTimeCp[i] = aTimeCp[i];
+	Tmp->m_pCache = m_pCache;
 
 	m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(Tmp), "save score");
 }
@@ -193,6 +215,7 @@ void CScore::SaveTeamScore(int Team, int *pClientIds, unsigned int Size, int Tim
 	FormatUuid(GameServer()->GameUuid(), Tmp->m_aGameUuid, sizeof(Tmp->m_aGameUuid));
 	str_copy(Tmp->m_aMap, Server()->GetMapName(), sizeof(Tmp->m_aMap));
 	Tmp->m_TeamrankUuid = RandomUuid();
+	Tmp->m_pCache = m_pCache;
 
 	m_pPool->ExecuteWrite(CScoreWorker::SaveTeamScore, std::move(Tmp), "save team score");
 }
@@ -215,14 +238,14 @@ void CScore::ShowTop(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientId, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientId, "", Offset, CScoreCache::QUERY_TOP);
 }
 
 void CScore::ShowTeamTop5(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTeamTop5, "show team top5", ClientId, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTeamTop5, "show team top5", ClientId, "", Offset, CScoreCache::QUERY_TEAM_TOP5);
 }
 
 void CScore::ShowPlayerTeamTop5(int ClientId, const char *pName, int Offset)
@@ -250,14 +273,14 @@ void CScore::ShowPoints(int ClientId, const char *pName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowPoints, "show points", ClientId, pName, 0);
+	ExecPlayerThread(CScoreWorker::ShowPoints, "show points", ClientId, pName, 0, CScoreCache::QUERY_POINTS);
 }
 
 void CScore::ShowTopPoints(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTopPoints, "show top points", ClientId, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTopPoints, "show top points", ClientId, "", Offset, CScoreCache::QUERY_TOP_POINTS);
 }
 
 void CScore::RandomMap(int ClientId, int MinStars, int MaxStars)
@@ -322,6 +345,7 @@ void CScore::SaveTeam(int ClientId, const char *pCode, const char *pServer)
 	str_copy(Tmp->m_aClientName, this->Server()->ClientName(ClientId), sizeof(Tmp->m_aClientName));
 	Tmp->m_aGeneratedCode[0] = '\0';
 	GeneratePassphrase(Tmp->m_aGeneratedCode, sizeof(Tmp->m_aGeneratedCode));
+	Tmp->m_Binary = g_Config.m_SvSaveBinary;
 
 	if(Tmp->m_aCode[0] == '\0')
 	{
@@ -15,6 +15,7 @@ class CScore
 {
 	CPlayerData m_aPlayerData[MAX_CLIENTS];
 	CDbConnectionPool *m_pPool;
+	std::shared_ptr<CScoreCache> m_pCache;
 
 	CGameContext *GameServer() const { return m_pGameServer; }
 	IServer *Server() const { return m_pServer; }
@@ -33,7 +34,8 @@ class CScore
 		const char *pThreadName,
 		int ClientId,
 		const char *pName,
-		int Offset);
+		int Offset,
+		CScoreCache::EQuery CacheQuery = CScoreCache::QUERY_NONE);
 
 	// returns true if the player should be rate limited
 	bool RateLimitPlayer(int ClientId);
@@ -42,6 +44,7 @@ public:
 	CScore(CGameContext *pGameServer, CDbConnectionPool *pPool);
 
 	CPlayerData *PlayerData(int Id) { return &m_aPlayerData[Id]; }
+	CScoreCache *Cache() { return m_pCache.get(); }
 
 	void LoadBestTime();
 	void MapInfo(int ClientId, const char *pMapName);
@@ -3,6 +3,7 @@
 #include <base/log.h>
 #include <base/system.h>
 
+#include <engine/console.h>
 #include <engine/server/databases/connection.h>
 #include <engine/server/databases/connection_pool.h>
 #include <engine/server/sql_string_helpers.h>
@@ -54,6 +55,178 @@ void CScorePlayerResult::SetVariant(Variant v)
 	}
 }
 
+CScoreCache::CWriteGuard::CWriteGuard(CScoreCache *pCache, const char *pMap) :
+	m_pCache(pCache)
+{
+	if(m_pCache == nullptr)
+		return;
+	std::lock_guard<std::mutex> Lock(m_pCache->m_Mutex);
+	m_pCache->m_WritesInProgress++;
+	m_pCache->Invalidate(pMap);
+}
+
+CScoreCache::CWriteGuard::~CWriteGuard()
+{
+	if(m_pCache == nullptr)
+		return;
+	std::lock_guard<std::mutex> Lock(m_pCache->m_Mutex);
+	m_pCache->m_WritesInProgress--;
+	m_pCache->m_Generation++;
+}
+
+void CScoreCache::Invalidate(const char *pMap)
+{
+	m_Generation++;
+	for(auto It = m_Entries.begin(); It != m_Entries.end();)
+	{
+		if(It->second.m_Map.empty() || It->second.m_Map == pMap)
+			It = m_Entries.erase(It);
+		else
+			++It;
+	}
+}
+
+CScoreCache::CEntry *CScoreCache::Find(EQuery Query, const std::string &Key, uint64_t *pGeneration)
+{
+	auto It = m_Entries.find(Key);
+	if(It != m_Entries.end() && It->second.m_Expiry > time_get_impl())
+	{
+		m_aHits[Query]++;
+		return &It->second;
+	}
+	m_aMisses[Query]++;
+	*pGeneration = m_Generation;
+	return nullptr;
+}
+
+CScoreCache::CEntry *CScoreCache::Insert(EQuery Query, const std::string &Key, const char *pMap, uint64_t Generation)
+{
+	if(g_Config.m_SvSqlCacheTime <= 0 || m_WritesInProgress > 0 || Generation != m_Generation)
+		return nullptr;
+	if(m_Entries.size() >= MAX_ENTRIES)
+	{
+		const int64_t Now = time_get_impl();
+		for(auto It = m_Entries.begin(); It != m_Entries.end();)
+		{
+			if(It->second.m_Expiry <= Now)
+				It = m_Entries.erase(It);
+			else
+				++It;
+		}
+		if(m_Entries.size() >= MAX_ENTRIES)
+			m_Entries.clear();
+	}
+	CEntry &Entry = m_Entries[Key];
+	Entry.m_Map = pMap;
+	Entry.m_Expiry = time_get_impl() + (int64_t)g_Config.m_SvSqlCacheTime * time_freq();
+	return &Entry;
+}
+
+bool CScoreCache::Lookup(EQuery Query, const std::string &Key, CScorePlayerResult *pResult, uint64_t *pGeneration)
+{
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	const CEntry *pEntry = Find(Query, Key, pGeneration);
+	if(pEntry == nullptr)
+		return false;
+	pResult->m_MessageKind = pEntry->m_MessageKind;
+	pResult->m_Data = pEntry->m_Data;
+	return true;
+}
+
+bool CScoreCache::Lookup(EQuery Query, const std::string &Key, float *pBestTime, uint64_t *pGeneration)
+{
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	const CEntry *pEntry = Find(Query, Key, pGeneration);
+	if(pEntry == nullptr)
+		return false;
+	*pBestTime = pEntry->m_BestTime;
+	return true;
+}
+
+void CScoreCache::Store(EQuery Query, const std::string &Key, const char *pMap, uint64_t Generation, const CScorePlayerResult &Result)
+{
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	CEntry *pEntry = Insert(Query, Key, pMap, Generation);
+	if(pEntry == nullptr)
+		return;
+	pEntry->m_MessageKind = Result.m_MessageKind;
+	pEntry->m_Data = Result.m_Data;
+}
+
+void CScoreCache::Store(EQuery Query, const std::string &Key, const char *pMap, uint64_t Generation, float BestTime)
+{
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	CEntry *pEntry = Insert(Query, Key, pMap, Generation);
+	if(pEntry == nullptr)
+		return;
+	pEntry->m_BestTime = BestTime;
+}
+
+void CScoreCache::Print(IConsole *pConsole)
+{
+	static const char *s_apQueryNames[NUM_QUERIES] = {"best time", "map info", "top", "team top5", "points", "top points"};
+
+	std::lock_guard<std::mutex> Lock(m_Mutex);
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%d cached results", (int)m_Entries.size());
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	for(int i = 0; i < NUM_QUERIES; i++)
+	{
+		const int64_t Total = m_aHits[i] + m_aMisses[i];
+		str_format(aBuf, sizeof(aBuf), "%s: hits=%d misses=%d hit rate=%d%%",
+			s_apQueryNames[i], (int)m_aHits[i], (int)m_aMisses[i], Total > 0 ? (int)(m_aHits[i] * 100 / Total) : 0);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	}
+}
+
+// The key holds every request field the result depends on, the map is
+// only set if the result doesn't depend on finishes on other maps.
+static std::string PlayerCacheKey(CScoreCache::EQuery Query, const CSqlPlayerRequest *pData, const char **ppMap)
+{
+	char aKey[512];
+	switch(Query)
+	{
+	case CScoreCache::QUERY_TOP:
+	case CScoreCache::QUERY_TEAM_TOP5:
+		str_format(aKey, sizeof(aKey), "%d|%s|%d|%s|%d", Query, pData->m_aMap, pData->m_Offset, pData->m_aServer, g_Config.m_SvRegionalRankings);
+		*ppMap = pData->m_aMap;
+		break;
+	case CScoreCache::QUERY_TOP_POINTS:
+		str_format(aKey, sizeof(aKey), "%d|%d", Query, pData->m_Offset);
+		*ppMap = "";
+		break;
+	default:
+		// the answer names the requesting player
+		str_format(aKey, sizeof(aKey), "%d|%s|%s", Query, pData->m_aName, pData->m_aRequestingPlayer);
+		*ppMap = "";
+		break;
+	}
+	return aKey;
+}
+
+bool CScoreCache::Lookup(EQuery Query, CSqlPlayerRequest *pRequest, CScorePlayerResult *pResult)
+{
+	const char *pMap;
+	return Lookup(Query, PlayerCacheKey(Query, pRequest, &pMap), pResult, &pRequest->m_CacheGeneration);
+}
+
+void CScoreCache::Store(EQuery Query, const CSqlPlayerRequest *pRequest, const CScorePlayerResult &Result)
+{
+	const char *pMap;
+	const std::string Key = PlayerCacheKey(Query, pRequest, &pMap);
+	Store(Query, Key, pMap, pRequest->m_CacheGeneration, Result);
+}
+
+static bool CachedPlayerQuery(CScoreCache::EQuery Query, CDbConnectionPool::FRead pfnQuery, IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	if(!pfnQuery(pSqlServer, pGameData, pError, ErrorSize))
+		return false;
+	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
+	if(pData->m_pCache)
+		pData->m_pCache->Store(Query, pData, *dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get()));
+	return true;
+}
+
 CTeamrank::CTeamrank() :
 	m_NumNames(0)
 {
@@ -168,6 +341,10 @@ bool CScoreWorker::LoadBestTime(IDbConnection *pSqlServer, const ISqlData *pGame
 		pResult->m_CurrentRecord = pSqlServer->GetFloat(1);
 	}
 
+	if(pData->m_pCache)
+	{
+		pData->m_pCache->Store(CScoreCache::QUERY_BEST_TIME, pData->m_aMap, pData->m_aMap, pData->m_CacheGeneration, pResult->m_CurrentRecord);
+	}
 	return true;
 }
 
@@ -364,7 +541,7 @@ bool CScoreWorker::MapVote(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return true;
 }
 
-bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+static bool MapInfoUncached(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -490,11 +667,17 @@ bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return true;
 }
 
+bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	return CachedPlayerQuery(CScoreCache::QUERY_MAP_INFO, MapInfoUncached, pSqlServer, pGameData, pError, ErrorSize);
+}
+
 bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlScoreData *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
 	auto *paMessages = pResult->m_Data.m_aaMessages;
+	CScoreCache::CWriteGuard CacheGuard(pData->m_pCache.get(), pData->m_aMap);
 
 	char aBuf[1024];
 
@@ -652,6 +835,7 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlTeamScoreData *>(pGameData);
+	CScoreCache::CWriteGuard CacheGuard(pData->m_pCache.get(), pData->m_aMap);
 
 	char aBuf[512];
 
@@ -1014,7 +1198,7 @@ bool CScoreWorker::ShowTeamRank(IDbConnection *pSqlServer, const ISqlData *pGame
 	return true;
 }
 
-bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+static bool ShowTopUncached(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -1107,7 +1291,12 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return End;
 }
 
-bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	return CachedPlayerQuery(CScoreCache::QUERY_TOP, ShowTopUncached, pSqlServer, pGameData, pError, ErrorSize);
+}
+
+static bool ShowTeamTop5Uncached(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -1204,6 +1393,11 @@ bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGame
 	return true;
 }
 
+bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	return CachedPlayerQuery(CScoreCache::QUERY_TEAM_TOP5, ShowTeamTop5Uncached, pSqlServer, pGameData, pError, ErrorSize);
+}
+
 bool CScoreWorker::ShowPlayerTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
@@ -1411,7 +1605,7 @@ bool CScoreWorker::ShowTimes(IDbConnection *pSqlServer, const ISqlData *pGameDat
 	return true;
 }
 
-bool CScoreWorker::ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+static bool ShowPointsUncached(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -1456,7 +1650,12 @@ bool CScoreWorker::ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameDa
 	return true;
 }
 
-bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+bool CScoreWorker::ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	return CachedPlayerQuery(CScoreCache::QUERY_POINTS, ShowPointsUncached, pSqlServer, pGameData, pError, ErrorSize);
+}
+
+static bool ShowTopPointsUncached(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
@@ -1505,6 +1704,11 @@ bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGam
 	return true;
 }
 
+bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	return CachedPlayerQuery(CScoreCache::QUERY_TOP_POINTS, ShowTopPointsUncached, pSqlServer, pGameData, pError, ErrorSize);
+}
+
 bool CScoreWorker::RandomMap(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlRandomMapRequest *>(pGameData);
@@ -1675,7 +1879,8 @@ bool CScoreWorker::SaveTeam(IDbConnection *pSqlServer, const ISqlData *pGameData
 	char aSaveId[UUID_MAXSTRSIZE];
 	FormatUuid(pResult->m_SaveId, aSaveId, UUID_MAXSTRSIZE);
 
-	char *pSaveState = pResult->m_SavedTeam.GetString();
+	// loading understands both formats, writing binary saves is opt-in
+	const char *pSaveState = pData->m_Binary ? pResult->m_SavedTeam.GetSaveData() : pResult->m_SavedTeam.GetString();
 	char aBuf[65536];
 
 	dbg_msg("score/dbg", "code=%s failure=%d", pData->m_aCode, (int)w);
@@ -1819,7 +2024,7 @@ bool CScoreWorker::LoadTeam(IDbConnection *pSqlServer, const ISqlData *pGameData
 
 	char aSaveString[65536];
 	pSqlServer->GetString(1, aSaveString, sizeof(aSaveString));
-	int Num = pResult->m_SavedTeam.FromString(aSaveString);
+	int Num = pResult->m_SavedTeam.FromSaveData(aSaveString);
 
 	if(Num != 0)
 	{
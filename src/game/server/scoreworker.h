@@ -10,11 +10,15 @@
 #include <game/voting.h>
 
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+class IConsole;
+struct CSqlPlayerRequest;
 class IDbConnection;
 class IGameController;
 
@@ -64,6 +68,78 @@ struct CScorePlayerResult : ISqlResult
 	void SetVariant(Variant v);
 };
 
+// Caches the results of read queries that only change when a finish is
+// saved. The read workers share it, SaveScore and SaveTeamScore drop the
+// entries of their map. Finishes written by other servers to the same
+// database only show up after sv_sql_cache_time.
+class CScoreCache
+{
+public:
+	enum EQuery
+	{
+		QUERY_NONE = -1,
+		QUERY_BEST_TIME,
+		QUERY_MAP_INFO,
+		QUERY_TOP,
+		QUERY_TEAM_TOP5,
+		QUERY_POINTS,
+		QUERY_TOP_POINTS,
+		NUM_QUERIES,
+	};
+
+	// Drops the entries of the map. Until the guard is destroyed no
+	// results are stored, as they could miss the write.
+	class CWriteGuard
+	{
+	public:
+		CWriteGuard(CScoreCache *pCache, const char *pMap);
+		~CWriteGuard();
+
+	private:
+		CScoreCache *m_pCache;
+	};
+
+	// Called on the main thread before the request is queued. On a miss
+	// `pGeneration` is set to the value the worker passes to `Store`.
+	bool Lookup(EQuery Query, const std::string &Key, CScorePlayerResult *pResult, uint64_t *pGeneration);
+	bool Lookup(EQuery Query, const std::string &Key, float *pBestTime, uint64_t *pGeneration);
+	bool Lookup(EQuery Query, CSqlPlayerRequest *pRequest, CScorePlayerResult *pResult);
+	// `pMap` is empty if the result depends on finishes on all maps.
+	void Store(EQuery Query, const std::string &Key, const char *pMap, uint64_t Generation, const CScorePlayerResult &Result);
+	void Store(EQuery Query, const std::string &Key, const char *pMap, uint64_t Generation, float BestTime);
+	void Store(EQuery Query, const CSqlPlayerRequest *pRequest, const CScorePlayerResult &Result);
+
+	void Print(IConsole *pConsole);
+
+private:
+	enum
+	{
+		MAX_ENTRIES = 512,
+	};
+
+	struct CEntry
+	{
+		std::string m_Map;
+		int64_t m_Expiry;
+		CScorePlayerResult::Variant m_MessageKind;
+		decltype(CScorePlayerResult::m_Data) m_Data;
+		float m_BestTime;
+	};
+
+	CEntry *Find(EQuery Query, const std::string &Key, uint64_t *pGeneration);
+	CEntry *Insert(EQuery Query, const std::string &Key, const char *pMap, uint64_t Generation);
+	void Invalidate(const char *pMap);
+
+	std::mutex m_Mutex;
+	std::unordered_map<std::string, CEntry> m_Entries;
+	// changes with every write, results of queries that started
+	// before aren't stored
+	uint64_t m_Generation = 0;
+	int m_WritesInProgress = 0;
+	int64_t m_aHits[NUM_QUERIES] = {};
+	int64_t m_aMisses[NUM_QUERIES] = {};
+};
+
 struct CScoreLoadBestTimeResult : ISqlResult
 {
 	CScoreLoadBestTimeResult() :
@@ -82,6 +158,10 @@ struct CSqlLoadBestTimeRequest : ISqlData
 
 	// current map
 	char m_aMap[MAX_MAP_LENGTH];
+	// only set if the cache missed, the result is stored with the
+	// generation of the lookup
+	std::shared_ptr<CScoreCache> m_pCache;
+	uint64_t m_CacheGeneration = 0;
 };
 
 struct CSqlPlayerRequest : ISqlData
@@ -99,6 +179,10 @@ struct CSqlPlayerRequest : ISqlData
 	// relevant for /top5 kind of requests
 	int m_Offset;
 	char m_aServer[5];
+	// only set if the cache missed, the result is stored with the
+	// generation of the lookup
+	std::shared_ptr<CScoreCache> m_pCache;
+	uint64_t m_CacheGeneration = 0;
 };
 
 struct CScoreRandomMapResult : ISqlResult
@@ -146,6 +230,7 @@ struct CSqlScoreData : ISqlData
 	int m_Num;
 	bool m_Search;
 	char m_aRequestingPlayer[MAX_NAME_LENGTH];
+	std::shared_ptr<CScoreCache> m_pCache;
 };
 
 struct CScoreSaveResult : ISqlResult
@@ -186,6 +271,7 @@ struct CSqlTeamScoreData : ISqlData
 	unsigned int m_Size;
 	char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
 	CUuid m_TeamrankUuid;
+	std::shared_ptr<CScoreCache> m_pCache;
 };
 
 struct CSqlTeamSaveData : ISqlData
@@ -200,6 +286,7 @@ struct CSqlTeamSaveData : ISqlData
 	char m_aCode[128];
 	char m_aGeneratedCode[128];
 	char m_aServer[5];
+	bool m_Binary;
 };
 
 struct CSqlTeamLoadRequest : ISqlData
@@ -853,6 +853,24 @@ void CTeeHistorian::RecordTeamFinish(int TeamId, int TimeTicks)
 	WriteExtra(UUID_TEEHISTORIAN_TEAM_FINISH, Buffer.Data(), Buffer.Size());
 }
 
+void CTeeHistorian::RecordInputStats(int ClientId, const IServer::CInputStats &Stats)
+{
+	CTeehistorianPacker Buffer;
+	Buffer.Reset();
+	Buffer.AddInt(ClientId);
+	Buffer.AddInt(Stats.m_NumInputs);
+	Buffer.AddInt(Stats.m_NumLate);
+	Buffer.AddInt(Stats.m_NumTooEarly);
+	Buffer.AddInt(Stats.m_NumDuplicate);
+	Buffer.AddInt(Stats.m_NumMissing);
+	if(m_Debug)
+	{
+		dbg_msg("teehistorian", "input_stats cid=%d inputs=%d late=%d too_early=%d duplicate=%d missing=%d", ClientId, Stats.m_NumInputs, Stats.m_NumLate, Stats.m_NumTooEarly, Stats.m_NumDuplicate, Stats.m_NumMissing);
+	}
+
+	WriteExtra(UUID_TEEHISTORIAN_INPUT_STATS, Buffer.Data(), Buffer.Size());
+}
+
 void CTeeHistorian::Finish()
 {
 	dbg_assert(m_State == STATE_START || m_State == STATE_INPUTS || m_State == STATE_BEFORE_ENDTICK || m_State == STATE_BEFORE_TICK, "invalid teehistorian state");
@@ -4,6 +4,7 @@
 #include <base/hash.h>
 
 #include <engine/console.h>
+#include <engine/server.h>
 #include <engine/shared/protocol.h>
 
 #include <generated/protocol.h>
@@ -95,6 +96,7 @@ public:
 
 	void RecordPlayerFinish(int ClientId, int TimeTicks);
 	void RecordTeamFinish(int TeamId, int TimeTicks);
+	void RecordInputStats(int ClientId, const IServer::CInputStats &Stats);
 
 	int m_Debug; // Possible values: 0, 1, 2.
 
@@ -1,7 +1,11 @@
+#include <base/system.h>
+
 #include <engine/shared/compression.h>
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 static const int DATA[] = {0, 1, -1, 32, 64, 256, -512, 12345, -123456, 1234567, 12345678, 123456789, 2147483647, (-2147483647 - 1)};
 static const int NUM = std::size(DATA);
 static const int SIZES[NUM] = {1, 1, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4, 5, 5};
@@ -82,3 +86,127 @@ TEST(CVariableInt, DecompressBufferTooSmall)
 	long CompressedSize = CVariableInt::Decompress(aCompressed, sizeof(aCompressed), aUncompressed, sizeof(aUncompressed));
 	ASSERT_EQ(CompressedSize, -1);
 }
+
+static unsigned FuzzRandom(unsigned *pSeed)
+{
+	*pSeed = *pSeed * 1103515245 + 12345;
+	return *pSeed >> 8;
+}
+
+// random ints of all packed sizes, small ones more often like in snapshots
+static int FuzzInt(unsigned *pSeed)
+{
+	const int Bits = FuzzRandom(pSeed) % 4 == 0 ? FuzzRandom(pSeed) % 33 : FuzzRandom(pSeed) % 7;
+	const unsigned Value = (FuzzRandom(pSeed) << 16) ^ FuzzRandom(pSeed);
+	const int Result = Bits >= 32 ? (int)Value : (int)(Value & ((1u << Bits) - 1));
+	return FuzzRandom(pSeed) % 2 ? ~Result : Result;
+}
+
+TEST(CVariableInt, FuzzCompressMatchesPack)
+{
+	unsigned Seed = 1;
+	for(int Round = 0; Round < 2000; Round++)
+	{
+		std::vector<int> vValues(FuzzRandom(&Seed) % 100);
+		for(int &Value : vValues)
+			Value = FuzzInt(&Seed);
+
+		unsigned char aExpected[100 * CVariableInt::MAX_BYTES_PACKED];
+		unsigned char *pExpectedEnd = aExpected;
+		for(int Value : vValues)
+			pExpectedEnd = CVariableInt::Pack(pExpectedEnd, Value, aExpected + sizeof(aExpected) - pExpectedEnd);
+		const int ExpectedSize = pExpectedEnd - aExpected;
+
+		// exactly fitting, larger and too small buffers
+		for(int DstSize : {ExpectedSize, ExpectedSize + 7, ExpectedSize - 1, ExpectedSize / 2})
+		{
+			if(DstSize < 0)
+				continue;
+			std::vector<unsigned char> vCompressed(DstSize);
+			const long Size = CVariableInt::Compress(vValues.data(), vValues.size() * sizeof(int), vCompressed.data(), DstSize);
+			if(DstSize < ExpectedSize)
+			{
+				EXPECT_EQ(Size, -1);
+				continue;
+			}
+			ASSERT_EQ(Size, ExpectedSize);
+			EXPECT_EQ(mem_comp(vCompressed.data(), aExpected, ExpectedSize), 0);
+			EXPECT_EQ(CVariableInt::PackArray(vCompressed.data(), vValues.data(), vValues.size(), DstSize), vCompressed.data() + ExpectedSize);
+		}
+	}
+}
+
+TEST(CVariableInt, FuzzDecompressMatchesUnpack)
+{
+	unsigned Seed = 2;
+	for(int Round = 0; Round < 5000; Round++)
+	{
+		// valid data with random bytes in between, some of it truncated
+		std::vector<unsigned char> vData;
+		const int NumValues = FuzzRandom(&Seed) % 60;
+		for(int i = 0; i < NumValues; i++)
+		{
+			unsigned char aPacked[CVariableInt::MAX_BYTES_PACKED];
+			const unsigned char *pEnd = CVariableInt::Pack(aPacked, FuzzInt(&Seed), sizeof(aPacked));
+			const unsigned char *pStart = aPacked;
+			vData.insert(vData.end(), pStart, pEnd);
+			if(FuzzRandom(&Seed) % 8 == 0)
+				vData.push_back(FuzzRandom(&Seed));
+		}
+		if(!vData.empty() && FuzzRandom(&Seed) % 4 == 0)
+			vData.resize(FuzzRandom(&Seed) % vData.size());
+
+		// the reference unpacks one int after another
+		std::vector<int> vExpected;
+		bool ExpectedError = false;
+		const unsigned char *pSrc = vData.data();
+		const unsigned char *pSrcEnd = pSrc + vData.size();
+		while(pSrc < pSrcEnd)
+		{
+			int Value;
+			pSrc = CVariableInt::Unpack(pSrc, &Value, pSrcEnd - pSrc);
+			if(!pSrc)
+			{
+				ExpectedError = true;
+				break;
+			}
+			vExpected.push_back(Value);
+		}
+
+		for(int NumDst : {(int)vExpected.size(), (int)vExpected.size() + 3, (int)vExpected.size() - 1})
+		{
+			if(NumDst < 0)
+				continue;
+			std::vector<int> vValues(NumDst + 1);
+			const long Size = CVariableInt::Decompress(vData.data(), vData.size(), vValues.data(), NumDst * sizeof(int));
+			if(ExpectedError || NumDst < (int)vExpected.size())
+			{
+				EXPECT_EQ(Size, -1);
+				continue;
+			}
+			ASSERT_EQ(Size, (long)(vExpected.size() * sizeof(int)));
+			for(size_t i = 0; i < vExpected.size(); i++)
+			{
+				EXPECT_EQ(vValues[i], vExpected[i]);
+			}
+		}
+
+		// unpacking a known number of ints stops after them
+		if(!vExpected.empty())
+		{
+			const int Num = 1 + FuzzRandom(&Seed) % vExpected.size();
+			std::vector<int> vValues(Num);
+			const unsigned char *pEnd = CVariableInt::UnpackArray(vData.data(), vValues.data(), Num, vData.size());
+			ASSERT_NE(pEnd, nullptr);
+			for(int i = 0; i < Num; i++)
+			{
+				EXPECT_EQ(vValues[i], vExpected[i]);
+			}
+			if(Num == (int)vExpected.size() && !ExpectedError)
+			{
+				EXPECT_EQ(pEnd, vData.data() + vData.size());
+			}
+			EXPECT_EQ(CVariableInt::UnpackArray(vData.data(), vValues.data(), Num, pEnd - vData.data() - 1), nullptr);
+		}
+	}
+}
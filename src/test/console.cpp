@@ -0,0 +1,121 @@
+#include <base/log.h>
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+static void CountCall(IConsole::IResult *pResult, void *pUserData)
+{
+	(*static_cast<int *>(pUserData))++;
+}
+
+static void ChainCountCall(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	(*static_cast<int *>(pUserData))++;
+	pfnCallback(pResult, pCallbackUserData);
+}
+
+TEST(Console, FindCommand)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+
+	int ServerCalls = 0;
+	int ClientCalls = 0;
+	pConsole->Register("test_cmd", "", CFGFLAG_CLIENT, CountCall, &ClientCalls, "");
+	pConsole->Register("test_cmd", "", CFGFLAG_SERVER, CountCall, &ServerCalls, "");
+
+	// names are case insensitive and the flag mask picks the command
+	pConsole->ExecuteLine("TEST_Cmd");
+	EXPECT_EQ(ServerCalls, 1);
+	EXPECT_EQ(ClientCalls, 0);
+	ASSERT_NE(pConsole->GetCommandInfo("Test_Cmd", CFGFLAG_CLIENT, false), nullptr);
+	EXPECT_EQ(pConsole->GetCommandInfo("test_cmd", CFGFLAG_CLIENT, true), nullptr);
+	EXPECT_EQ(pConsole->GetCommandInfo("test_cm", CFGFLAG_SERVER, false), nullptr);
+
+	// registering again replaces the callback
+	int ReplacedCalls = 0;
+	pConsole->Register("test_cmd", "", CFGFLAG_SERVER, CountCall, &ReplacedCalls, "");
+	pConsole->ExecuteLine("test_cmd");
+	EXPECT_EQ(ServerCalls, 1);
+	EXPECT_EQ(ReplacedCalls, 1);
+
+	int ChainCalls = 0;
+	pConsole->Chain("test_cmd", ChainCountCall, &ChainCalls);
+	pConsole->ExecuteLine("test_cmd");
+	EXPECT_EQ(ChainCalls, 1);
+	EXPECT_EQ(ReplacedCalls, 2);
+
+	// temporary commands come and go
+	pConsole->RegisterTemp("temp_a", "", CFGFLAG_SERVER, "");
+	pConsole->RegisterTemp("temp_b", "", CFGFLAG_SERVER, "");
+	EXPECT_NE(pConsole->GetCommandInfo("TEMP_A", CFGFLAG_SERVER, true), nullptr);
+	pConsole->DeregisterTemp("temp_a");
+	EXPECT_EQ(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_NE(pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true), nullptr);
+	// reuses the recycled entry under a new name
+	pConsole->RegisterTemp("temp_c", "", CFGFLAG_SERVER, "");
+	EXPECT_NE(pConsole->GetCommandInfo("temp_c", CFGFLAG_SERVER, true), nullptr);
+	pConsole->DeregisterTempAll();
+	EXPECT_EQ(pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_EQ(pConsole->GetCommandInfo("temp_c", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_NE(pConsole->GetCommandInfo("test_cmd", CFGFLAG_SERVER, false), nullptr);
+}
+
+// about as many commands as a server registers, the names must outlive the console
+static void RegisterManyCommands(IConsole *pConsole, int NumCommands, std::deque<std::string> &vNames, int *pCalls)
+{
+	for(int i = 0; i < NumCommands; i++)
+	{
+		vNames.push_back("bench_cmd_" + std::to_string(i));
+		pConsole->Register(vNames.back().c_str(), "?i[value]", CFGFLAG_SERVER, CountCall, pCalls, "");
+	}
+}
+
+TEST(Console, ExecuteManyCommands)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+	const int NumCommands = 1000;
+	std::deque<std::string> vNames;
+	int Calls = 0;
+	RegisterManyCommands(pConsole.get(), NumCommands, vNames, &Calls);
+
+	for(int i = 0; i < NumCommands; i++)
+	{
+		pConsole->ExecuteLine(("bench_cmd_" + std::to_string((i * 7919) % NumCommands) + " " + std::to_string(i)).c_str());
+	}
+	EXPECT_EQ(Calls, NumCommands);
+	EXPECT_NE(pConsole->GetCommandInfo("bench_cmd_999", CFGFLAG_SERVER, false), nullptr);
+	EXPECT_EQ(pConsole->GetCommandInfo("bench_cmd_1000", CFGFLAG_SERVER, false), nullptr);
+}
+
+TEST(Console, DISABLED_BenchmarkExecute)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+	const int NumCommands = 1000;
+	std::deque<std::string> vNames;
+	int Calls = 0;
+	RegisterManyCommands(pConsole.get(), NumCommands, vNames, &Calls);
+
+	std::vector<std::string> vLines;
+	for(int i = 0; i < NumCommands * 20; i++)
+	{
+		vLines.push_back("bench_cmd_" + std::to_string((i * 7919) % NumCommands) + " " + std::to_string(i));
+	}
+
+	const int64_t Start = time_get_impl();
+	for(const std::string &Line : vLines)
+	{
+		pConsole->ExecuteLine(Line.c_str());
+	}
+	const int64_t Duration = time_get_impl() - Start;
+
+	EXPECT_EQ(Calls, (int)vLines.size());
+	log_info("console", "executed %d lines in %.2f ms, %.0f lines/s", (int)vLines.size(), Duration * 1000.0 / time_freq(), vLines.size() * (double)time_freq() / maximum<int64_t>(Duration, 1));
+}
@@ -1,5 +1,7 @@
 #include "test.h"
 
+#include <base/system.h>
+
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 
@@ -112,3 +114,61 @@ TEST(Datafile, StringData)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, MemoryMapped)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+
+	char aLarge[64 * 1024];
+	for(int i = 0; i < (int)sizeof(aLarge); i++)
+	{
+		aLarge[i] = i % 251;
+	}
+
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(pStorage.get(), Info.m_aFilename));
+
+		EXPECT_EQ(Writer.AddDataString("Abc"), 0);
+		EXPECT_EQ(Writer.AddData(sizeof(aLarge), aLarge), 1);
+
+		Writer.Finish();
+	}
+
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		CDataFileReader MappedReader;
+		ASSERT_TRUE(MappedReader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+
+		EXPECT_EQ(Reader.MappedData(), nullptr);
+		ASSERT_NE(MappedReader.MappedData(), nullptr);
+		EXPECT_EQ(MappedReader.MapSize(), Reader.MapSize());
+		EXPECT_EQ(MappedReader.Crc(), Reader.Crc());
+		EXPECT_EQ(MappedReader.Sha256(), Reader.Sha256());
+
+		void *pFileData;
+		unsigned FileSize;
+		ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_ALL, &pFileData, &FileSize));
+		ASSERT_EQ((int)FileSize, MappedReader.MapSize());
+		EXPECT_EQ(mem_comp(MappedReader.MappedData(), pFileData, FileSize), 0);
+		free(pFileData);
+
+		EXPECT_STREQ(MappedReader.GetDataString(0), "Abc");
+		ASSERT_EQ(MappedReader.GetDataSize(1), (int)sizeof(aLarge));
+		EXPECT_EQ(mem_comp(MappedReader.GetData(1), aLarge, sizeof(aLarge)), 0);
+		MappedReader.UnloadData(1);
+		EXPECT_EQ(mem_comp(MappedReader.GetData(1), aLarge, sizeof(aLarge)), 0);
+
+		Reader.Close();
+		MappedReader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
@@ -0,0 +1,307 @@
+#include "test.h"
+
+#include <base/log.h>
+#include <base/system.h>
+
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/filecollection.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+static const int DEMO_ITEM_TYPE = 1;
+
+class CSnapshotTickListener : public CDemoPlayer::IListener
+{
+public:
+	int m_LastTick = -1;
+
+	void OnDemoPlayerSnapshot(void *pData, int Size) override
+	{
+		const CSnapshot *pSnap = (const CSnapshot *)pData;
+		const int Index = pSnap->GetItemIndex(DEMO_ITEM_TYPE << 16);
+		m_LastTick = Index < 0 ? -1 : pSnap->GetItem(Index)->Data()[0];
+	}
+	void OnDemoPlayerMessage(void *pData, int Size) override {}
+};
+
+// Returns the time spent in the recorder calls, without stopping.
+static int64_t RecordDemo(IStorage *pStorage, CSnapshotDelta *pDelta, const char *pFilename, int FirstTick, int NumTicks, CDemoWriter *pWriter = nullptr, int NumFillerItems = 16)
+{
+	unsigned char aMapData[1024];
+	for(int i = 0; i < (int)sizeof(aMapData); i++)
+		aMapData[i] = i * 31;
+
+	// demo chunks are huffman compressed
+	CNetBase::Init();
+	CDemoRecorder Recorder(pDelta, false, pWriter);
+	EXPECT_EQ(Recorder.Start(pStorage, nullptr, pFilename, "0.6 626fce9a778df4d4", "test", sha256(aMapData, sizeof(aMapData)), 0x12345678, "server", sizeof(aMapData), aMapData, nullptr, nullptr, nullptr), 0);
+
+	CSnapshotBuilder Builder;
+	alignas(CSnapshot) char aSnapshot[CSnapshot::MAX_SIZE];
+	int64_t Duration = 0;
+	for(int Tick = FirstTick; Tick < FirstTick + NumTicks; Tick++)
+	{
+		Builder.Init();
+		// the first item carries the tick, the others move around a bit
+		int *pTick = (int *)Builder.NewItem(DEMO_ITEM_TYPE, 0, 4 * sizeof(int));
+		pTick[0] = Tick;
+		for(int Id = 0; Id < NumFillerItems; Id++)
+		{
+			int *pItem = (int *)Builder.NewItem(DEMO_ITEM_TYPE + 1, Id, 8 * sizeof(int));
+			for(int i = 0; i < 8; i++)
+				pItem[i] = (Tick / (Id + 1) + i) % 1000;
+		}
+		const int Size = Builder.Finish(aSnapshot);
+		const int64_t Start = time_get_impl();
+		Recorder.RecordSnapshot(Tick, aSnapshot, Size);
+		if(Tick % SERVER_TICK_SPEED == 0)
+		{
+			const int aMessage[4] = {Tick, 1, 2, 3};
+			Recorder.RecordMessage(aMessage, sizeof(aMessage));
+		}
+		Duration += time_get_impl() - Start;
+	}
+	EXPECT_EQ(Recorder.Stop(IDemoRecorder::EStopMode::KEEP_FILE), 0);
+	return Duration;
+}
+
+TEST(Demo, Index)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_TRUE(pStorage);
+	g_Config.m_DemoKeyframeInterval = 2;
+
+	// 20 minutes of ticks
+	const int FirstTick = 1000;
+	const int NumTicks = 20 * 60 * SERVER_TICK_SPEED;
+	CSnapshotDelta Delta;
+	RecordDemo(pStorage.get(), &Delta, "test.demo", FirstTick, NumTicks);
+	ASSERT_TRUE(pStorage->FileExists("test.demo.idx", IStorage::TYPE_SAVE));
+
+	CSnapshotTickListener Listener;
+	CDemoPlayer IndexedPlayer(&Delta, false);
+	IndexedPlayer.SetListener(&Listener);
+	ASSERT_EQ(IndexedPlayer.Load(pStorage.get(), nullptr, "test.demo", IStorage::TYPE_SAVE), 0);
+	EXPECT_TRUE(IndexedPlayer.LoadedIndex());
+
+	ASSERT_TRUE(pStorage->RemoveFile("test.demo.idx", IStorage::TYPE_SAVE));
+	CDemoPlayer ScannedPlayer(&Delta, false);
+	ASSERT_EQ(ScannedPlayer.Load(pStorage.get(), nullptr, "test.demo", IStorage::TYPE_SAVE), 0);
+	EXPECT_FALSE(ScannedPlayer.LoadedIndex());
+
+	// the index has to describe the same demo as scanning it
+	EXPECT_EQ(IndexedPlayer.BaseInfo()->m_FirstTick, FirstTick);
+	EXPECT_EQ(IndexedPlayer.BaseInfo()->m_LastTick, FirstTick + NumTicks - 1);
+	EXPECT_EQ(IndexedPlayer.BaseInfo()->m_FirstTick, ScannedPlayer.BaseInfo()->m_FirstTick);
+	EXPECT_EQ(IndexedPlayer.BaseInfo()->m_LastTick, ScannedPlayer.BaseInfo()->m_LastTick);
+	ASSERT_EQ(IndexedPlayer.NumKeyFrames(), ScannedPlayer.NumKeyFrames());
+	for(int i = 0; i < IndexedPlayer.NumKeyFrames(); i++)
+	{
+		EXPECT_EQ(IndexedPlayer.KeyFrame(i).m_Filepos, ScannedPlayer.KeyFrame(i).m_Filepos);
+		EXPECT_EQ(IndexedPlayer.KeyFrame(i).m_Tick, ScannedPlayer.KeyFrame(i).m_Tick);
+	}
+	EXPECT_GE(IndexedPlayer.NumKeyFrames(), NumTicks / (2 * SERVER_TICK_SPEED + 1));
+	ScannedPlayer.Stop();
+
+	// seek back and forth, the snapshot shown has to be the one of the current tick
+	const int aWantedTicks[] = {FirstTick + NumTicks / 2, FirstTick + NumTicks / 2 + 10, FirstTick + NumTicks / 2 + 3 * SERVER_TICK_SPEED, FirstTick + 20, FirstTick + NumTicks - 1, FirstTick + 7777};
+	for(int WantedTick : aWantedTicks)
+	{
+		ASSERT_EQ(IndexedPlayer.SetPos(WantedTick), 0) << IndexedPlayer.ErrorMessage();
+		EXPECT_EQ(IndexedPlayer.Info()->m_NextTick, WantedTick);
+		EXPECT_EQ(Listener.m_LastTick, IndexedPlayer.BaseInfo()->m_CurrentTick);
+	}
+	IndexedPlayer.Stop();
+	g_Config.m_DemoKeyframeInterval = CConfig::ms_DemoKeyframeInterval;
+}
+
+TEST(Demo, DISABLED_BenchmarkIndex)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_TRUE(pStorage);
+	g_Config.m_DemoKeyframeInterval = 2;
+
+	const int NumTicks = 20 * 60 * SERVER_TICK_SPEED;
+	CSnapshotDelta Delta;
+	RecordDemo(pStorage.get(), &Delta, "test.demo", 0, NumTicks);
+
+	CDemoPlayer IndexedPlayer(&Delta, false);
+	int64_t Start = time_get_impl();
+	ASSERT_EQ(IndexedPlayer.Load(pStorage.get(), nullptr, "test.demo", IStorage::TYPE_SAVE), 0);
+	const int64_t IndexedDuration = time_get_impl() - Start;
+
+	const int NumSeeks = 100;
+	Start = time_get_impl();
+	for(int i = 0; i < NumSeeks; i++)
+	{
+		ASSERT_EQ(IndexedPlayer.SetPos((i * 7919) % NumTicks), 0) << IndexedPlayer.ErrorMessage();
+	}
+	const int64_t SeekDuration = time_get_impl() - Start;
+	IndexedPlayer.Stop();
+
+	ASSERT_TRUE(pStorage->RemoveFile("test.demo.idx", IStorage::TYPE_SAVE));
+	CDemoPlayer ScannedPlayer(&Delta, false);
+	Start = time_get_impl();
+	ASSERT_EQ(ScannedPlayer.Load(pStorage.get(), nullptr, "test.demo", IStorage::TYPE_SAVE), 0);
+	const int64_t ScannedDuration = time_get_impl() - Start;
+	ScannedPlayer.Stop();
+
+	log_info("demo", "loaded %d ticks in %.3f ms with index, %.3f ms scanning, %.3f ms per seek",
+		NumTicks, IndexedDuration * 1000.0 / time_freq(), ScannedDuration * 1000.0 / time_freq(), SeekDuration * 1000.0 / time_freq() / NumSeeks);
+	g_Config.m_DemoKeyframeInterval = CConfig::ms_DemoKeyframeInterval;
+}
+
+TEST(Demo, StaleIndex)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_TRUE(pStorage);
+	g_Config.m_DemoKeyframeInterval = CConfig::ms_DemoKeyframeInterval;
+
+	// an index left behind by a different demo with the same name is ignored
+	CSnapshotDelta Delta;
+	RecordDemo(pStorage.get(), &Delta, "first.demo", 0, 60 * SERVER_TICK_SPEED);
+	RecordDemo(pStorage.get(), &Delta, "second.demo", 500, 30 * SERVER_TICK_SPEED);
+	ASSERT_TRUE(pStorage->RemoveFile("second.demo.idx", IStorage::TYPE_SAVE));
+	ASSERT_TRUE(pStorage->RenameFile("first.demo.idx", "second.demo.idx", IStorage::TYPE_SAVE));
+
+	CDemoPlayer Player(&Delta, false);
+	ASSERT_EQ(Player.Load(pStorage.get(), nullptr, "second.demo", IStorage::TYPE_SAVE), 0);
+	EXPECT_FALSE(Player.LoadedIndex());
+	EXPECT_EQ(Player.BaseInfo()->m_FirstTick, 500);
+	EXPECT_EQ(Player.BaseInfo()->m_LastTick, 500 + 30 * SERVER_TICK_SPEED - 1);
+	Player.Stop();
+}
+
+TEST(Demo, IndexFollowsDemo)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_TRUE(pStorage);
+	g_Config.m_DemoKeyframeInterval = CConfig::ms_DemoKeyframeInterval;
+
+	// rotating auto demos removes the index of each removed demo
+	CSnapshotDelta Delta;
+	ASSERT_TRUE(pStorage->CreateFolder("auto", IStorage::TYPE_SAVE));
+	const char *apDemos[] = {"auto/test_2024-01-01_10-00-00.demo", "auto/test_2024-01-02_10-00-00.demo", "auto/test_2024-01-03_10-00-00.demo"};
+	for(const char *pDemo : apDemos)
+		RecordDemo(pStorage.get(), &Delta, pDemo, 0, 10 * SERVER_TICK_SPEED);
+	CFileCollection AutoDemos;
+	AutoDemos.Init(pStorage.get(), "auto", "test", ".demo", 1);
+	char aIndex[IO_MAX_PATH_LENGTH];
+	for(int i = 0; i < 2; i++)
+	{
+		DemoIndexFilename(apDemos[i], aIndex, sizeof(aIndex));
+		EXPECT_FALSE(pStorage->FileExists(apDemos[i], IStorage::TYPE_SAVE));
+		EXPECT_FALSE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+	}
+	DemoIndexFilename(apDemos[2], aIndex, sizeof(aIndex));
+	EXPECT_TRUE(pStorage->FileExists(apDemos[2], IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+
+	// renaming moves the index along and replaces a stale one with the new name
+	RecordDemo(pStorage.get(), &Delta, "renamed.demo", 500, 10 * SERVER_TICK_SPEED);
+	ASSERT_TRUE(pStorage->RemoveFile("renamed.demo", IStorage::TYPE_SAVE));
+	ASSERT_TRUE(pStorage->RenameFile(apDemos[2], "renamed.demo", IStorage::TYPE_SAVE));
+	RenameDemoIndex(pStorage.get(), apDemos[2], "renamed.demo", IStorage::TYPE_SAVE);
+	EXPECT_FALSE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+	CDemoPlayer Player(&Delta, false);
+	ASSERT_EQ(Player.Load(pStorage.get(), nullptr, "renamed.demo", IStorage::TYPE_SAVE), 0);
+	EXPECT_TRUE(Player.LoadedIndex());
+	EXPECT_EQ(Player.BaseInfo()->m_FirstTick, 0);
+	Player.Stop();
+
+	// removing a demo removes its index
+	ASSERT_TRUE(pStorage->RemoveFile("renamed.demo", IStorage::TYPE_SAVE));
+	RemoveDemoIndex(pStorage.get(), "renamed.demo", IStorage::TYPE_SAVE);
+	EXPECT_FALSE(pStorage->FileExists("renamed.demo.idx", IStorage::TYPE_SAVE));
+	ASSERT_TRUE(pStorage->RemoveFolder("auto", IStorage::TYPE_SAVE));
+}
+
+TEST(Demo, AsyncWriter)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_TRUE(pStorage);
+	g_Config.m_DemoKeyframeInterval = CConfig::ms_DemoKeyframeInterval;
+	g_Config.m_DemoAsync = 1;
+	// the test records far faster than real time, make sure the queue holds everything
+	g_Config.m_DemoAsyncQueueSize = 1024 * 1024;
+
+	// the same demo written on the caller and on the writer thread
+	const int NumTicks = 5 * 60 * SERVER_TICK_SPEED;
+	CSnapshotDelta Delta;
+	CDemoWriter Writer;
+	RecordDemo(pStorage.get(), &Delta, "sync.demo", 0, NumTicks, nullptr, 200);
+	RecordDemo(pStorage.get(), &Delta, "async.demo", 0, NumTicks, &Writer, 200);
+	EXPECT_EQ(Writer.QueuedBytes(), 0u);
+	EXPECT_EQ(Writer.NumDroppedSnapshots(), 0);
+
+	CDemoPlayer SyncPlayer(&Delta, false);
+	CDemoPlayer AsyncPlayer(&Delta, false);
+	ASSERT_EQ(SyncPlayer.Load(pStorage.get(), nullptr, "sync.demo", IStorage::TYPE_SAVE), 0);
+	ASSERT_EQ(AsyncPlayer.Load(pStorage.get(), nullptr, "async.demo", IStorage::TYPE_SAVE), 0);
+	EXPECT_TRUE(AsyncPlayer.LoadedIndex());
+	EXPECT_EQ(AsyncPlayer.BaseInfo()->m_FirstTick, SyncPlayer.BaseInfo()->m_FirstTick);
+	EXPECT_EQ(AsyncPlayer.BaseInfo()->m_LastTick, SyncPlayer.BaseInfo()->m_LastTick);
+	ASSERT_EQ(AsyncPlayer.NumKeyFrames(), SyncPlayer.NumKeyFrames());
+	for(int i = 0; i < AsyncPlayer.NumKeyFrames(); i++)
+	{
+		EXPECT_EQ(AsyncPlayer.KeyFrame(i).m_Filepos, SyncPlayer.KeyFrame(i).m_Filepos);
+	}
+	SyncPlayer.Stop();
+	AsyncPlayer.Stop();
+
+	// a tiny queue drops snapshots, what is written is still a valid demo
+	g_Config.m_DemoAsyncQueueSize = 256;
+	RecordDemo(pStorage.get(), &Delta, "dropped.demo", 0, NumTicks, &Writer, 1000);
+	CSnapshotTickListener Listener;
+	CDemoPlayer DroppedPlayer(&Delta, false);
+	DroppedPlayer.SetListener(&Listener);
+	ASSERT_EQ(DroppedPlayer.Load(pStorage.get(), nullptr, "dropped.demo", IStorage::TYPE_SAVE), 0);
+	EXPECT_TRUE(DroppedPlayer.LoadedIndex());
+	ASSERT_EQ(DroppedPlayer.SetPos(DroppedPlayer.BaseInfo()->m_LastTick), 0) << DroppedPlayer.ErrorMessage();
+	EXPECT_EQ(Listener.m_LastTick, DroppedPlayer.BaseInfo()->m_CurrentTick);
+	// the length in the header only covers what was written
+	EXPECT_LE((int)bytes_be_to_uint(DroppedPlayer.Info()->m_Header.m_aLength), (DroppedPlayer.BaseInfo()->m_LastTick - DroppedPlayer.BaseInfo()->m_FirstTick) / SERVER_TICK_SPEED);
+	DroppedPlayer.Stop();
+	EXPECT_GT(Writer.NumDroppedSnapshots(), 0);
+
+	g_Config.m_DemoAsync = CConfig::ms_DemoAsync;
+	g_Config.m_DemoAsyncQueueSize = CConfig::ms_DemoAsyncQueueSize;
+}
+
+TEST(Demo, DISABLED_BenchmarkAsyncWriter)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_TRUE(pStorage);
+	g_Config.m_DemoKeyframeInterval = CConfig::ms_DemoKeyframeInterval;
+	g_Config.m_DemoAsync = 1;
+	g_Config.m_DemoAsyncQueueSize = 1024 * 1024;
+
+	const int NumTicks = 5 * 60 * SERVER_TICK_SPEED;
+	CSnapshotDelta Delta;
+	CDemoWriter Writer;
+	const int64_t SyncDuration = RecordDemo(pStorage.get(), &Delta, "sync.demo", 0, NumTicks, nullptr, 200);
+	const int64_t AsyncDuration = RecordDemo(pStorage.get(), &Delta, "async.demo", 0, NumTicks, &Writer, 200);
+
+	log_info("demo", "recorded %d ticks in %.3f ms on the caller, %.3f ms synchronously, peak queue %d KiB",
+		NumTicks, AsyncDuration * 1000.0 / time_freq(), SyncDuration * 1000.0 / time_freq(), (int)(Writer.PeakQueuedBytes() / 1024));
+	g_Config.m_DemoAsync = CConfig::ms_DemoAsync;
+	g_Config.m_DemoAsyncQueueSize = CConfig::ms_DemoAsyncQueueSize;
+}
@@ -1,5 +1,6 @@
 #include "test.h"
 
+#include <base/log.h>
 #include <base/logger.h>
 #include <base/system.h>
 #include <base/types.h>
@@ -15,8 +16,13 @@
 #include <engine/shared/config.h>
 
 #include <generated/protocol.h>
+#include <generated/protocol7.h>
 
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/prng.h>
 #include <game/server/entities/character.h>
+#include <game/server/entities/pickup.h>
 #include <game/server/gamecontext.h>
 #include <game/server/gamecontroller.h>
 #include <game/server/gameworld.h>
@@ -27,6 +33,7 @@
 
 #include <memory>
 #include <thread>
+#include <tuple>
 
 bool IsInterrupted()
 {
@@ -242,6 +249,7 @@ TEST_F(CTestGameWorld, IntersectEntity)
 	vec2 CloserToFromButTooFarFromLine = vec2(11, 11 + Radius + pChrLeft->GetProximityRadius());
 	pChrLeft->SetPosition(CloserToFromButTooFarFromLine);
 	pChrLeft->m_Pos = CloserToFromButTooFarFromLine;
+	GameServer()->m_World.UpdateEntityGrid(pChrLeft);
 
 	pIntersectedChar = (CCharacter *)GameServer()->m_World.IntersectEntity(
 		vec2(10, 10), // intersect from
@@ -255,6 +263,247 @@ TEST_F(CTestGameWorld, IntersectEntity)
 	EXPECT_EQ(pIntersectedChar, pChrRight);
 }
 
+TEST_F(CTestGameWorld, FindEntitiesGrid)
+{
+	// pickups spread over several grid cells, some of them moved after insertion
+	std::vector<CPickup *> vpPickups;
+	for(int i = 0; i < 200; i++)
+	{
+		CPickup *pPickup = new CPickup(&GameServer()->m_World, POWERUP_HEALTH, 0, 0, 0, 0);
+		pPickup->m_Pos = vec2((i * 37) % 1500, (i * 91) % 1200);
+		GameServer()->m_World.UpdateEntityGrid(pPickup);
+		vpPickups.push_back(pPickup);
+	}
+	for(int i = 0; i < 200; i += 3)
+	{
+		vpPickups[i]->m_Pos += vec2(300, -200);
+		GameServer()->m_World.UpdateEntityGrid(vpPickups[i]);
+	}
+
+	const vec2 aCenters[] = {vec2(0, 0), vec2(500, 400), vec2(1400, 1100), vec2(-300, 700)};
+	const float aRadii[] = {10.0f, 100.0f, 400.0f};
+	for(const vec2 &Center : aCenters)
+	{
+		for(float Radius : aRadii)
+		{
+			// the result must be the same as walking the entity list
+			std::vector<CEntity *> vpExpected;
+			for(CEntity *pEnt = GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_PICKUP); pEnt; pEnt = pEnt->TypeNext())
+				if(distance(pEnt->m_Pos, Center) < Radius + pEnt->GetProximityRadius())
+					vpExpected.push_back(pEnt);
+
+			CEntity *apEnts[256];
+			int Num = GameServer()->m_World.FindEntities(Center, Radius, apEnts, std::size(apEnts), CGameWorld::ENTTYPE_PICKUP);
+			ASSERT_EQ(Num, (int)vpExpected.size());
+			for(int i = 0; i < Num; i++)
+				EXPECT_EQ(apEnts[i], vpExpected[i]);
+		}
+	}
+}
+
+// The sample-by-sample walk that `CCollision::IntersectLine` used before it learned to skip tiles
+static int IntersectLineReference(const CCollision *pCollision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+		if(pCollision->CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return pCollision->GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static std::vector<int> GetMapIndicesReference(const CCollision *pCollision, vec2 PrevPos, vec2 Pos)
+{
+	std::vector<int> vIndices;
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		float a = i / d;
+		vec2 Tmp = mix(PrevPos, Pos, a);
+		int Nx = std::clamp((int)Tmp.x / 32, 0, pCollision->GetWidth() - 1);
+		int Ny = std::clamp((int)Tmp.y / 32, 0, pCollision->GetHeight() - 1);
+		int Index = Ny * pCollision->GetWidth() + Nx;
+		if(pCollision->TileExists(Index) && LastIndex != Index)
+		{
+			vIndices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return vIndices;
+}
+
+TEST_F(CTestGameWorld, CollisionTraversal)
+{
+	CCollision *pCollision = GameServer()->Collision();
+	pCollision->SetVerifyTraversal(true);
+
+	CPrng Prng;
+	uint64_t aSeed[2] = {0x5eed, 1};
+	Prng.Seed(aSeed);
+	const auto &&RandomPos = [&]() {
+		// a bit outside of the map to cover the clamping as well
+		float x = (int)(Prng.RandomBits() % ((pCollision->GetWidth() + 4) * 32 * 8)) / 8.0f - 64.0f;
+		float y = (int)(Prng.RandomBits() % ((pCollision->GetHeight() + 4) * 32 * 8)) / 8.0f - 64.0f;
+		return vec2(x, y);
+	};
+
+	int NumHits = 0;
+	for(int i = 0; i < 2000; i++)
+	{
+		vec2 Pos0 = RandomPos();
+		vec2 Pos1 = i % 2 ? RandomPos() : Pos0 + direction((Prng.RandomBits() % 3600) / 10.0f) * 800.0f;
+
+		vec2 Collision, BeforeCollision, ExpectedCollision, ExpectedBeforeCollision;
+		int Hit = pCollision->IntersectLine(Pos0, Pos1, &Collision, &BeforeCollision);
+		int ExpectedHit = IntersectLineReference(pCollision, Pos0, Pos1, &ExpectedCollision, &ExpectedBeforeCollision);
+		ASSERT_EQ(Hit, ExpectedHit);
+		// bit-exact, not just close
+		ASSERT_EQ(mem_comp(&Collision, &ExpectedCollision, sizeof(Collision)), 0);
+		ASSERT_EQ(mem_comp(&BeforeCollision, &ExpectedBeforeCollision, sizeof(BeforeCollision)), 0);
+		NumHits += Hit != 0;
+
+		if(distance(Pos0, Pos1) > 0.0f)
+		{
+			EXPECT_EQ(pCollision->GetMapIndices(Pos0, Pos1), GetMapIndicesReference(pCollision, Pos0, Pos1));
+		}
+
+		// these only assert on the verified traversal
+		int TeleNr;
+		pCollision->IntersectLineTeleHook(Pos0, Pos1, &Collision, &BeforeCollision, &TeleNr);
+		pCollision->IntersectLineTeleWeapon(Pos0, Pos1, &Collision, &BeforeCollision, &TeleNr);
+		pCollision->IntersectNoLaser(Pos0, Pos1, &Collision, &BeforeCollision);
+		pCollision->IntersectNoLaserNoWalls(Pos0, Pos1, &Collision, &BeforeCollision);
+	}
+	EXPECT_GT(NumHits, 0);
+}
+
+// Ticks the same cores with and without the broadphase and checks that
+// they stay identical. Measures both if pDuration is set.
+static void CheckCoreBroadphase(CCollision *pCollision, int NumTicks, int64_t *pDuration)
+{
+	const int NumCores = 64;
+
+	CPrng Prng;
+	uint64_t aSeed[2] = {0xc0de, 2};
+	Prng.Seed(aSeed);
+
+	// spawn everyone on free spots of a small area so they run into each other
+	std::vector<vec2> vSpawns;
+	while((int)vSpawns.size() < NumCores)
+	{
+		vec2 Pos = vec2(pCollision->GetWidth() * 16.0f, pCollision->GetHeight() * 16.0f) + vec2((int)(Prng.RandomBits() % 640) - 320, (int)(Prng.RandomBits() % 640) - 320);
+		if(!pCollision->CheckPoint(Pos) && !pCollision->CheckPoint(Pos + vec2(14, 14)) && !pCollision->CheckPoint(Pos - vec2(14, 14)))
+			vSpawns.push_back(Pos);
+	}
+
+	// recorded inputs, replayed on both worlds
+	std::vector<CNetObj_PlayerInput> vInputs(NumTicks * NumCores);
+	for(int i = 0; i < NumTicks * NumCores; i++)
+	{
+		CNetObj_PlayerInput &Input = vInputs[i];
+		Input = {};
+		Input.m_Direction = (int)(Prng.RandomBits() % 3) - 1;
+		Input.m_Jump = Prng.RandomBits() % 8 == 0;
+		Input.m_Hook = Prng.RandomBits() % 3 != 0;
+		Input.m_TargetX = (int)(Prng.RandomBits() % 401) - 200;
+		Input.m_TargetY = (int)(Prng.RandomBits() % 401) - 200;
+		if(Input.m_TargetX == 0 && Input.m_TargetY == 0)
+			Input.m_TargetY = -1;
+	}
+
+	struct CWorld
+	{
+		CWorldCore m_Core;
+		CTeamsCore m_Teams;
+		CCharacterCore m_aCharacters[NumCores];
+	};
+	auto pBroadphase = std::make_unique<CWorld>();
+	auto pReference = std::make_unique<CWorld>();
+	pReference->m_Core.m_NoBroadphase = true;
+	for(CWorld *pWorld : {pBroadphase.get(), pReference.get()})
+	{
+		for(int i = 0; i < NumCores; i++)
+		{
+			CCharacterCore &Core = pWorld->m_aCharacters[i];
+			Core.Init(&pWorld->m_Core, pCollision, &pWorld->m_Teams);
+			Core.Reset();
+			Core.m_Id = i;
+			Core.m_Pos = vSpawns[i];
+			Core.m_Tuning = pWorld->m_Core.m_aTuning[0];
+			pWorld->m_Core.m_apCharacters[i] = &Core;
+		}
+	}
+
+	int NumPlayerHooks = 0;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		int Index = 0;
+		for(CWorld *pWorld : {pBroadphase.get(), pReference.get()})
+		{
+			const int64_t Start = pDuration ? time_get_impl() : 0;
+			for(int i = 0; i < NumCores; i++)
+			{
+				pWorld->m_aCharacters[i].m_Input = vInputs[Tick * NumCores + i];
+				pWorld->m_aCharacters[i].Tick(true, false);
+			}
+			for(auto &Core : pWorld->m_aCharacters)
+				Core.TickDeferred();
+			for(auto &Core : pWorld->m_aCharacters)
+			{
+				Core.Move();
+				Core.Quantize();
+			}
+			if(pDuration)
+				pDuration[Index] += time_get_impl() - Start;
+			Index++;
+		}
+
+		// bit-exact, not just close
+		for(int i = 0; i < NumCores; i++)
+		{
+			const CCharacterCore &Core = pBroadphase->m_aCharacters[i];
+			const CCharacterCore &Expected = pReference->m_aCharacters[i];
+			ASSERT_EQ(mem_comp(&Core.m_Pos, &Expected.m_Pos, sizeof(Core.m_Pos)), 0) << "tick " << Tick << " core " << i;
+			ASSERT_EQ(mem_comp(&Core.m_Vel, &Expected.m_Vel, sizeof(Core.m_Vel)), 0) << "tick " << Tick << " core " << i;
+			ASSERT_EQ(mem_comp(&Core.m_HookPos, &Expected.m_HookPos, sizeof(Core.m_HookPos)), 0) << "tick " << Tick << " core " << i;
+			ASSERT_EQ(Core.m_HookState, Expected.m_HookState);
+			ASSERT_EQ(Core.HookedPlayer(), Expected.HookedPlayer());
+			ASSERT_EQ(Core.m_TriggeredEvents, Expected.m_TriggeredEvents);
+			NumPlayerHooks += Core.HookedPlayer() != -1;
+		}
+	}
+	EXPECT_GT(NumPlayerHooks, 0);
+}
+
+TEST_F(CTestGameWorld, CoreBroadphase)
+{
+	CheckCoreBroadphase(GameServer()->Collision(), 5 * SERVER_TICK_SPEED, nullptr);
+}
+
+TEST_F(CTestGameWorld, DISABLED_BenchmarkCoreBroadphase)
+{
+	const int NumTicks = 30 * SERVER_TICK_SPEED;
+	int64_t aDuration[2] = {0, 0};
+	CheckCoreBroadphase(GameServer()->Collision(), NumTicks, aDuration);
+	log_info("gameworld", "%d ticks in %.2f ms with broadphase, %.2f ms checking all", NumTicks, aDuration[0] * 1000.0 / time_freq(), aDuration[1] * 1000.0 / time_freq());
+}
+
 TEST_F(CTestGameWorld, BasicTick)
 {
 	int ClientId = 0;
@@ -310,3 +559,265 @@ TEST_F(CTestGameWorld, CharacterEmote)
 	pChr->Freeze(10);
 	ASSERT_EQ(pChr->DetermineEyeEmote(), EMOTE_ANGRY);
 }
+
+TEST_F(CTestGameWorld, SnapshotThreads)
+{
+	const int NumClients = 24;
+	const int NumTicks = 20;
+
+	CPrng Prng;
+	uint64_t aSeed[2] = {0x5eed, 3};
+	Prng.Seed(aSeed);
+
+	// every client gets its own snapshots with items that move, come and go,
+	// and sound events that only have a static size for 0.7 clients
+	for(int ClientId = 0; ClientId < NumClients; ClientId++)
+	{
+		CServer::CClient &Client = m_pServer->m_aClients[ClientId];
+		Client.m_Sixup = ClientId % 3 == 0;
+		for(int Tick = 1; Tick <= NumTicks; Tick++)
+		{
+			m_pServer->m_SnapshotBuilder.Init(Client.m_Sixup);
+			for(int Id = 0; Id < 32; Id++)
+			{
+				if(Prng.RandomBits() % 4 == 0)
+					continue;
+				CNetObj_Character *pCharacter = (CNetObj_Character *)m_pServer->m_SnapshotBuilder.NewItem(NETOBJTYPE_CHARACTER, Id, sizeof(CNetObj_Character));
+				ASSERT_NE(pCharacter, nullptr);
+				mem_zero(pCharacter, sizeof(*pCharacter));
+				pCharacter->m_Tick = Tick;
+				pCharacter->m_X = Id * 32 + Tick * (Id % 4);
+				pCharacter->m_Y = Prng.RandomBits() % 64;
+			}
+			if(Client.m_Sixup)
+			{
+				protocol7::CNetEvent_SoundWorld *pSound = (protocol7::CNetEvent_SoundWorld *)m_pServer->m_SnapshotBuilder.NewItem(protocol7::NETEVENTTYPE_SOUNDWORLD, 0, sizeof(protocol7::CNetEvent_SoundWorld));
+				ASSERT_NE(pSound, nullptr);
+				mem_zero(pSound, sizeof(*pSound));
+				pSound->m_SoundId = Tick;
+			}
+			else
+			{
+				CNetEvent_SoundWorld *pSound = (CNetEvent_SoundWorld *)m_pServer->m_SnapshotBuilder.NewItem(NETEVENTTYPE_SOUNDWORLD, 0, sizeof(CNetEvent_SoundWorld));
+				ASSERT_NE(pSound, nullptr);
+				mem_zero(pSound, sizeof(*pSound));
+				pSound->m_SoundId = Tick;
+			}
+			char aData[CSnapshot::MAX_SIZE];
+			const int Size = m_pServer->m_SnapshotBuilder.Finish(aData);
+			Client.m_Snapshots.Add(Tick, time_get(), Size, aData, 0, nullptr);
+		}
+		// some clients haven't acked any snapshot that is still stored
+		Client.m_LastAckedSnapshot = ClientId % 5 == 0 ? -1 : NumTicks - 1 - ClientId % 4;
+		m_pServer->m_vSnapshotClients.push_back(ClientId);
+	}
+
+	const int OldSnapshotThreads = m_pServer->Config()->m_SvSnapshotThreads;
+	using CResult = std::tuple<int, int, int, std::vector<char>>;
+	const auto &&CreateDeltas = [&](int Threads) {
+		m_pServer->Config()->m_SvSnapshotThreads = Threads;
+		for(int ClientId : m_pServer->m_vSnapshotClients)
+			m_pServer->m_aClients[ClientId].m_SnapRate = CServer::CClient::SNAPRATE_FULL;
+		m_pServer->CreateSnapshotDeltas();
+		std::vector<CResult> vResults;
+		for(int ClientId : m_pServer->m_vSnapshotClients)
+		{
+			const CServer::CClient &Client = m_pServer->m_aClients[ClientId];
+			const char *pCompData = Client.m_vSnapshotCompData.data();
+			vResults.emplace_back(Client.m_SnapshotDeltaTick, Client.m_SnapshotCrc, Client.m_SnapRate, std::vector<char>(pCompData, pCompData + Client.m_SnapshotCompSize));
+		}
+		return vResults;
+	};
+
+	// the main thread path is the reference, both with and without an acked snapshot
+	const std::vector<CResult> vReference = CreateDeltas(0);
+	ASSERT_EQ((int)vReference.size(), NumClients);
+	EXPECT_EQ(std::get<0>(vReference[0]), -1);
+	EXPECT_EQ(std::get<2>(vReference[0]), CServer::CClient::SNAPRATE_RECOVER);
+	EXPECT_EQ(std::get<0>(vReference[1]), NumTicks - 2);
+	for(const CResult &Result : vReference)
+		EXPECT_FALSE(std::get<3>(Result).empty());
+
+	for(int Threads : {1, 3, 16})
+	{
+		EXPECT_EQ(CreateDeltas(Threads), vReference) << "threads=" << Threads;
+	}
+
+	// shut down the workers again
+	m_pServer->Config()->m_SvSnapshotThreads = 0;
+	m_pServer->UpdateSnapshotJobPool();
+	m_pServer->Config()->m_SvSnapshotThreads = OldSnapshotThreads;
+	m_pServer->m_vSnapshotClients.clear();
+}
+
+TEST_F(CTestGameWorld, MapPrepareJob)
+{
+	const auto &&Prepare = [&](const char *pMapName) {
+		for(int i = 0; i < 10000 && !m_pServer->MapPrepared(pMapName); i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return m_pServer->MapPrepared(pMapName);
+	};
+	const auto &&ExpectCurrentMap = [&](const char *pFilename) {
+		void *pData;
+		unsigned Size;
+		ASSERT_TRUE(m_pStorage->ReadFile(pFilename, IStorage::TYPE_ALL, &pData, &Size));
+		SHA256_DIGEST Sha256;
+		unsigned Crc;
+		ASSERT_TRUE(m_pStorage->CalculateHashes(pFilename, IStorage::TYPE_ALL, &Sha256, &Crc));
+		EXPECT_EQ(m_pServer->m_aCurrentMapCrc[CServer::MAP_TYPE_SIX], Crc);
+		EXPECT_EQ(m_pServer->m_aCurrentMapSha256[CServer::MAP_TYPE_SIX], Sha256);
+		ASSERT_EQ(m_pServer->m_aCurrentMapSize[CServer::MAP_TYPE_SIX], Size);
+		EXPECT_EQ(mem_comp(m_pServer->m_apCurrentMapData[CServer::MAP_TYPE_SIX], pData, Size), 0);
+		free(pData);
+	};
+
+	// prepare then load
+	ASSERT_TRUE(Prepare("Tutorial"));
+	ASSERT_NE(m_pServer->LoadMap("Tutorial"), 0);
+	EXPECT_EQ(m_pServer->m_pMapPrepareJob, nullptr);
+	ExpectCurrentMap("maps/Tutorial.map");
+
+	// another map than the prepared one is loaded from disk
+	ASSERT_TRUE(Prepare("ctf1"));
+	ASSERT_NE(m_pServer->LoadMap("ctf2"), 0);
+	EXPECT_EQ(m_pServer->m_pMapPrepareJob, nullptr);
+	ExpectCurrentMap("maps/ctf2.map");
+	EXPECT_FALSE(m_pServer->m_pMap->LoadPrepared("maps/ctf1.map"));
+
+	// a map file modified after it was prepared is loaded again
+	const auto &&CopyMap = [&](const char *pFrom, const char *pTo) {
+		void *pData;
+		unsigned Size;
+		ASSERT_TRUE(m_pStorage->ReadFile(pFrom, IStorage::TYPE_ALL, &pData, &Size));
+		IOHANDLE File = m_pStorage->OpenFile(pTo, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		EXPECT_EQ(io_write(File, pData, Size), Size);
+		io_close(File);
+		free(pData);
+	};
+	m_pStorage->CreateFolder("maps", IStorage::TYPE_SAVE);
+	CopyMap("maps/ctf1.map", "maps/prepare_test.map");
+	ASSERT_TRUE(Prepare("prepare_test"));
+	CopyMap("maps/ctf3.map", "maps/prepare_test.map");
+	ASSERT_NE(m_pServer->LoadMap("prepare_test"), 0);
+	ExpectCurrentMap("maps/ctf3.map");
+
+	ASSERT_NE(m_pServer->LoadMap("coverage"), 0);
+}
+
+TEST_F(CTestGameWorld, SnapCulling)
+{
+	int ClientId = 0;
+	GameServer()->CreatePlayer(ClientId, TEAM_RED, false, -1);
+	CPlayer *pPlayer = GameServer()->m_apPlayers[ClientId];
+	pPlayer->m_ViewPos = vec2(0, 0);
+	pPlayer->m_ShowDistance = vec2(1000, 800);
+
+	CPickup *pNear = new CPickup(&GameServer()->m_World, POWERUP_HEALTH, 0, 0, 0, 0);
+	pNear->m_Pos = vec2(100, 100);
+	GameServer()->m_World.UpdateEntityGrid(pNear);
+	CPickup *pFar = new CPickup(&GameServer()->m_World, POWERUP_HEALTH, 0, 0, 0, 0);
+	pFar->m_Pos = vec2(10000, 10000);
+	GameServer()->m_World.UpdateEntityGrid(pFar);
+
+	const auto &&Snap = [&](bool PreSnap, char *pData) {
+		if(PreSnap)
+			GameServer()->m_World.PreSnap();
+		m_pServer->m_SnapshotBuilder.Init();
+		GameServer()->m_World.Snap(ClientId);
+		return m_pServer->m_SnapshotBuilder.Finish(pData);
+	};
+
+	// culled snapshot must be identical to snapping every entity
+	char aFull[CSnapshot::MAX_SIZE];
+	char aCulled[CSnapshot::MAX_SIZE];
+	int FullSize = Snap(false, aFull);
+	int CulledSize = Snap(true, aCulled);
+	ASSERT_EQ(FullSize, CulledSize);
+	EXPECT_EQ(mem_comp(aFull, aCulled, FullSize), 0);
+
+	const CSnapshot *pSnap = (const CSnapshot *)aCulled;
+	EXPECT_NE(pSnap->FindItem(NETOBJTYPE_PICKUP, pNear->GetId()), nullptr);
+	EXPECT_EQ(pSnap->FindItem(NETOBJTYPE_PICKUP, pFar->GetId()), nullptr);
+}
+
+TEST_F(CTestGameWorld, EventCulling)
+{
+	int ClientId = 0;
+	GameServer()->CreatePlayer(ClientId, TEAM_RED, false, -1);
+	CPlayer *pPlayer = GameServer()->m_apPlayers[ClientId];
+	pPlayer->m_ViewPos = vec2(0, 0);
+	pPlayer->m_ShowDistance = vec2(1000, 800);
+
+	// far more events than the old fixed buffer could hold
+	CEventHandler &Events = GameServer()->m_Events;
+	Events.Clear();
+	for(int i = 0; i < 2000; i++)
+	{
+		CNetEvent_SoundWorld *pEvent = Events.Create<CNetEvent_SoundWorld>();
+		ASSERT_NE(pEvent, nullptr);
+		pEvent->m_X = (i % 100) * 200;
+		pEvent->m_Y = (i / 100) * 200;
+		pEvent->m_SoundId = i;
+	}
+	EXPECT_EQ(Events.NumEvents(), 2000);
+
+	const auto &&Snap = [&](bool PreSnap, char *pData) {
+		if(PreSnap)
+			Events.PreSnap();
+		m_pServer->m_SnapshotBuilder.Init();
+		Events.Snap(ClientId);
+		return m_pServer->m_SnapshotBuilder.Finish(pData);
+	};
+
+	// culled snapshot must be identical to visiting every event
+	char aFull[CSnapshot::MAX_SIZE];
+	char aCulled[CSnapshot::MAX_SIZE];
+	int FullSize = Snap(false, aFull);
+	int CulledSize = Snap(true, aCulled);
+	ASSERT_EQ(FullSize, CulledSize);
+	EXPECT_EQ(mem_comp(aFull, aCulled, FullSize), 0);
+
+	const CSnapshot *pSnap = (const CSnapshot *)aCulled;
+	EXPECT_EQ(pSnap->NumItems(), 6 * 5);
+	EXPECT_NE(pSnap->FindItem(NETEVENTTYPE_SOUNDWORLD, 0), nullptr);
+	EXPECT_EQ(pSnap->FindItem(NETEVENTTYPE_SOUNDWORLD, 1999), nullptr);
+	EXPECT_EQ(Events.NumSnapDropped(), 0);
+	Events.Clear();
+}
+
+TEST_F(CTestGameWorld, SnapVisibility)
+{
+	for(int ClientId = 0; ClientId < 4; ClientId++)
+	{
+		GameServer()->CreatePlayer(ClientId, TEAM_RED, false, -1);
+		CPlayer *pPlayer = GameServer()->m_apPlayers[ClientId];
+		pPlayer->ForceSpawn(vec2(100 + ClientId * 50, 100));
+		pPlayer->m_ViewPos = vec2(100, 100);
+		pPlayer->m_ShowDistance = vec2(1000, 800);
+		pPlayer->m_ShowOthers = SHOW_OTHERS_ON;
+	}
+	GameServer()->m_pController->Teams().SetForceCharacterTeam(2, 1);
+	GameServer()->m_apPlayers[1]->m_ShowOthers = SHOW_OTHERS_OFF;
+	GameServer()->m_apPlayers[3]->m_ShowOthers = SHOW_OTHERS_ONLY_TEAM;
+
+	GameServer()->m_World.PreSnap();
+	for(int SnappingClient = 0; SnappingClient < 4; SnappingClient++)
+	{
+		for(int Id = 0; Id < 4; Id++)
+		{
+			CCharacter *pChr = GameServer()->GetPlayerChar(Id);
+			ASSERT_NE(pChr, nullptr);
+			// ask twice, the second answer comes from the cache
+			for(int i = 0; i < 2; i++)
+			{
+				EXPECT_EQ(GameServer()->m_World.SnapCanSnapCharacter(SnappingClient, pChr), pChr->CanSnapCharacter(SnappingClient));
+				EXPECT_EQ(GameServer()->m_World.SnapIsCharacterInView(SnappingClient, pChr), pChr->IsSnappingCharacterInView(SnappingClient));
+				EXPECT_EQ(GameServer()->m_World.SnapCharacterTeamMask(pChr), pChr->TeamMask());
+			}
+		}
+	}
+	EXPECT_FALSE(GameServer()->m_World.SnapCanSnapCharacter(1, GameServer()->GetPlayerChar(2)));
+	EXPECT_FALSE(GameServer()->m_World.SnapCanSnapCharacter(3, GameServer()->GetPlayerChar(2)));
+	EXPECT_TRUE(GameServer()->m_World.SnapCanSnapCharacter(0, GameServer()->GetPlayerChar(2)));
+}
@@ -1,9 +1,230 @@
+#include <base/log.h>
+#include <base/math.h>
 #include <base/system.h>
 
+#include <engine/shared/compression.h>
 #include <engine/shared/huffman.h>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <vector>
+
+// The previous implementation that decodes one symbol per LUT lookup,
+// the current one must produce the same output.
+class CReferenceHuffman
+{
+	enum
+	{
+		EOF_SYMBOL = 256,
+		MAX_SYMBOLS = EOF_SYMBOL + 1,
+		MAX_NODES = MAX_SYMBOLS * 2 - 1,
+		LUTBITS = 10,
+		LUTSIZE = 1 << LUTBITS,
+		LUTMASK = LUTSIZE - 1,
+	};
+
+	struct CNode
+	{
+		unsigned m_Bits;
+		unsigned m_NumBits;
+		unsigned short m_aLeafs[2];
+		unsigned char m_Symbol;
+	};
+
+	struct CConstructNode
+	{
+		unsigned short m_NodeId;
+		int m_Frequency;
+	};
+
+	CNode m_aNodes[MAX_NODES] = {};
+	CNode *m_apDecodeLut[LUTSIZE] = {};
+	CNode *m_pStartNode = nullptr;
+	int m_NumNodes = 0;
+
+	void Setbits_r(CNode *pNode, int Bits, unsigned Depth)
+	{
+		if(pNode->m_aLeafs[1] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[1]], Bits | (1 << Depth), Depth + 1);
+		if(pNode->m_aLeafs[0] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[0]], Bits, Depth + 1);
+		if(pNode->m_NumBits)
+		{
+			pNode->m_Bits = Bits;
+			pNode->m_NumBits = Depth;
+		}
+	}
+
+public:
+	CReferenceHuffman()
+	{
+		CConstructNode aNodesLeftStorage[MAX_SYMBOLS];
+		CConstructNode *apNodesLeft[MAX_SYMBOLS];
+		int NumNodesLeft = MAX_SYMBOLS;
+		for(int i = 0; i < MAX_SYMBOLS; i++)
+		{
+			m_aNodes[i].m_NumBits = 0xFFFFFFFF;
+			m_aNodes[i].m_Symbol = i;
+			m_aNodes[i].m_aLeafs[0] = 0xffff;
+			m_aNodes[i].m_aLeafs[1] = 0xffff;
+			aNodesLeftStorage[i].m_Frequency = i == EOF_SYMBOL ? 1 : CHuffman::ms_aFreqTable[i];
+			aNodesLeftStorage[i].m_NodeId = i;
+			apNodesLeft[i] = &aNodesLeftStorage[i];
+		}
+		m_NumNodes = MAX_SYMBOLS;
+		while(NumNodesLeft > 1)
+		{
+			std::stable_sort(apNodesLeft, apNodesLeft + NumNodesLeft, [](const CConstructNode *pNode1, const CConstructNode *pNode2) {
+				return pNode2->m_Frequency < pNode1->m_Frequency;
+			});
+			m_aNodes[m_NumNodes].m_NumBits = 0;
+			m_aNodes[m_NumNodes].m_aLeafs[0] = apNodesLeft[NumNodesLeft - 1]->m_NodeId;
+			m_aNodes[m_NumNodes].m_aLeafs[1] = apNodesLeft[NumNodesLeft - 2]->m_NodeId;
+			apNodesLeft[NumNodesLeft - 2]->m_NodeId = m_NumNodes;
+			apNodesLeft[NumNodesLeft - 2]->m_Frequency = apNodesLeft[NumNodesLeft - 1]->m_Frequency + apNodesLeft[NumNodesLeft - 2]->m_Frequency;
+			m_NumNodes++;
+			NumNodesLeft--;
+		}
+		m_pStartNode = &m_aNodes[m_NumNodes - 1];
+		Setbits_r(m_pStartNode, 0, 0);
+
+		for(int i = 0; i < LUTSIZE; i++)
+		{
+			unsigned Bits = i;
+			int k;
+			CNode *pNode = m_pStartNode;
+			for(k = 0; k < LUTBITS; k++)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+				Bits >>= 1;
+				if(pNode->m_NumBits)
+				{
+					m_apDecodeLut[i] = pNode;
+					break;
+				}
+			}
+			if(k == LUTBITS)
+				m_apDecodeLut[i] = pNode;
+		}
+	}
+
+	int Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
+	{
+		const unsigned char *pSrc = (const unsigned char *)pInput;
+		const unsigned char *pSrcEnd = pSrc + InputSize;
+		unsigned char *pDst = (unsigned char *)pOutput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+		for(int i = 0; i <= InputSize; i++)
+		{
+			const int Symbol = pSrc + i == pSrcEnd ? (int)EOF_SYMBOL : pSrc[i];
+			Bits |= m_aNodes[Symbol].m_Bits << Bitcount;
+			Bitcount += m_aNodes[Symbol].m_NumBits;
+			while(Bitcount >= 8)
+			{
+				*pDst++ = (unsigned char)(Bits & 0xff);
+				if(pDst == pDstEnd)
+					return -1;
+				Bits >>= 8;
+				Bitcount -= 8;
+			}
+		}
+		*pDst++ = Bits;
+		return (int)(pDst - (const unsigned char *)pOutput);
+	}
+
+	int Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
+	{
+		unsigned char *pDst = (unsigned char *)pOutput;
+		const unsigned char *pSrc = (const unsigned char *)pInput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		const unsigned char *pSrcEnd = pSrc + InputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+		while(true)
+		{
+			while(Bitcount < 24 && pSrc != pSrcEnd)
+			{
+				Bits |= (*pSrc++) << Bitcount;
+				Bitcount += 8;
+			}
+			const CNode *pNode = m_apDecodeLut[Bits & LUTMASK];
+			if(pNode->m_NumBits)
+			{
+				Bits >>= pNode->m_NumBits;
+				Bitcount -= pNode->m_NumBits;
+			}
+			else
+			{
+				Bits >>= LUTBITS;
+				Bitcount -= LUTBITS;
+				while(true)
+				{
+					pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+					Bitcount--;
+					Bits >>= 1;
+					if(pNode->m_NumBits)
+						break;
+					if(Bitcount == 0)
+						return -1;
+				}
+			}
+			if(pNode == &m_aNodes[EOF_SYMBOL])
+				break;
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+		}
+		return (int)(pDst - (const unsigned char *)pOutput);
+	}
+};
+
+// Packets like the game sends them: mostly small variable length integers
+// and other bytes distributed like the network traffic the frequency table
+// was made from.
+static std::vector<std::vector<unsigned char>> GeneratePackets(int NumPackets)
+{
+	unsigned Seed = 1234;
+	const auto &&Random = [&]() {
+		Seed = Seed * 1103515245 + 12345;
+		return (Seed >> 16) & 0x7fff;
+	};
+	// without the zero byte, the table gives it an extreme frequency
+	std::vector<unsigned char> vTrafficBytes;
+	for(int i = 1; i < 256; i++)
+	{
+		vTrafficBytes.insert(vTrafficBytes.end(), CHuffman::ms_aFreqTable[i], i);
+	}
+
+	std::vector<std::vector<unsigned char>> vvPackets;
+	for(int p = 0; p < NumPackets; p++)
+	{
+		std::vector<unsigned char> vPacket;
+		const int NumValues = 1 + Random() % 400;
+		for(int i = 0; i < NumValues; i++)
+		{
+			const unsigned Kind = Random() % 16;
+			if(Kind < 10)
+			{
+				unsigned char aPacked[CVariableInt::MAX_BYTES_PACKED];
+				const int Value = Kind < 6 ? (int)(Random() % 4) : (int)(Random() % 2000) - 1000;
+				const unsigned char *pEnd = CVariableInt::Pack(aPacked, Value, sizeof(aPacked));
+				const unsigned char *pStart = aPacked;
+				vPacket.insert(vPacket.end(), pStart, pEnd);
+			}
+			else
+			{
+				vPacket.push_back(vTrafficBytes[(Random() << 15 | Random()) % vTrafficBytes.size()]);
+			}
+		}
+		vPacket.resize(minimum<size_t>(vPacket.size(), 1400));
+		vvPackets.push_back(vPacket);
+	}
+	return vvPackets;
+}
+
 TEST(Huffman, CompressionShouldNotChangeData)
 {
 	CHuffman Huffman;
@@ -47,3 +268,84 @@ TEST(Huffman, CompressionCompatible)
 	EXPECT_EQ(match, 0) << "The compression is not compatible with older/other implementations anymore";
 	EXPECT_EQ(Size, 15);
 }
+
+TEST(Huffman, MatchesReference)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+	CReferenceHuffman Reference;
+
+	std::vector<std::vector<unsigned char>> vvPackets = GeneratePackets(500);
+	// edge cases: empty, a single byte and every byte value
+	vvPackets.emplace_back();
+	vvPackets.push_back({0x42});
+	vvPackets.emplace_back();
+	for(int i = 0; i < 256; i++)
+		vvPackets.back().push_back(i);
+
+	for(const std::vector<unsigned char> &vPacket : vvPackets)
+	{
+		unsigned char aCompressed[4096];
+		unsigned char aReferenceCompressed[4096];
+		const int Size = Huffman.Compress(vPacket.data(), vPacket.size(), aCompressed, sizeof(aCompressed));
+		const int ReferenceSize = Reference.Compress(vPacket.data(), vPacket.size(), aReferenceCompressed, sizeof(aReferenceCompressed));
+		ASSERT_EQ(Size, ReferenceSize);
+		ASSERT_EQ(mem_comp(aCompressed, aReferenceCompressed, Size), 0);
+
+		unsigned char aDecompressed[2048];
+		ASSERT_EQ(Huffman.Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed)), (int)vPacket.size());
+		EXPECT_EQ(mem_comp(aDecompressed, vPacket.data(), vPacket.size()), 0);
+		ASSERT_EQ(Reference.Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed)), (int)vPacket.size());
+
+		// too small buffers fail the same way
+		for(int OutputSize = maximum(Size - 6, 1); OutputSize < Size; OutputSize++)
+		{
+			EXPECT_EQ(Huffman.Compress(vPacket.data(), vPacket.size(), aCompressed, OutputSize), -1);
+		}
+		EXPECT_EQ(Huffman.Compress(vPacket.data(), vPacket.size(), aCompressed, Size), Size);
+		if(!vPacket.empty())
+		{
+			EXPECT_EQ(Huffman.Decompress(aCompressed, Size, aDecompressed, vPacket.size() - 1), -1);
+		}
+	}
+}
+
+TEST(Huffman, DISABLED_Benchmark)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+	CReferenceHuffman Reference;
+
+	const std::vector<std::vector<unsigned char>> vvPackets = GeneratePackets(2000);
+	std::vector<std::vector<unsigned char>> vvCompressed;
+	int64_t TotalSize = 0;
+	for(const std::vector<unsigned char> &vPacket : vvPackets)
+	{
+		std::vector<unsigned char> vCompressed(4096);
+		vCompressed.resize(Huffman.Compress(vPacket.data(), vPacket.size(), vCompressed.data(), vCompressed.size()));
+		vvCompressed.push_back(vCompressed);
+		TotalSize += vPacket.size();
+	}
+
+	const int Rounds = 20;
+	const auto &&Measure = [&](const char *pName, auto &&Function) {
+		const int64_t Start = time_get_impl();
+		for(int Round = 0; Round < Rounds; Round++)
+		{
+			for(size_t i = 0; i < vvPackets.size(); i++)
+			{
+				Function(i);
+			}
+		}
+		const double Seconds = maximum<int64_t>(time_get_impl() - Start, 1) / (double)time_freq();
+		log_info("huffman", "%s: %.1f MB/s", pName, TotalSize * Rounds / Seconds / 1000000.0);
+	};
+
+	unsigned char aBuffer[4096];
+	Measure("compress", [&](size_t i) { Huffman.Compress(vvPackets[i].data(), vvPackets[i].size(), aBuffer, sizeof(aBuffer)); });
+	Measure("compress (reference)", [&](size_t i) { Reference.Compress(vvPackets[i].data(), vvPackets[i].size(), aBuffer, sizeof(aBuffer)); });
+	int Failures = 0;
+	Measure("decompress", [&](size_t i) { Failures += Huffman.Decompress(vvCompressed[i].data(), vvCompressed[i].size(), aBuffer, sizeof(aBuffer)) != (int)vvPackets[i].size(); });
+	Measure("decompress (reference)", [&](size_t i) { Failures += Reference.Decompress(vvCompressed[i].data(), vvCompressed[i].size(), aBuffer, sizeof(aBuffer)) != (int)vvPackets[i].size(); });
+	EXPECT_EQ(Failures, 0);
+}
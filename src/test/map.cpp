@@ -0,0 +1,105 @@
+#include "test.h"
+
+#include <base/system.h>
+
+#include <engine/kernel.h>
+#include <engine/shared/datafile.h>
+#include <engine/shared/map.h>
+#include <engine/storage.h>
+
+#include <game/mapitems.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+class CTestMap : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	std::unique_ptr<IStorage> m_pStorage;
+	CMap m_Map;
+	std::unique_ptr<IKernel> m_pKernel;
+
+	CTestMap()
+	{
+		m_Info.m_DeleteTestStorageFilesOnSuccess = true;
+		m_pStorage = m_Info.CreateTestStorage();
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		m_pKernel->RegisterInterface(m_pStorage.get(), false);
+		m_pKernel->RegisterInterface(static_cast<IEngineMap *>(&m_Map), false);
+	}
+
+	// Writes a map that only has a version item and pData as data
+	void WriteMap(const char *pFilename, const char *pData)
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(m_pStorage.get(), pFilename));
+		CMapItemVersion Version;
+		Version.m_Version = 1;
+		Writer.AddItem(MAPITEMTYPE_VERSION, 0, sizeof(Version), &Version);
+		Writer.AddDataString(pData);
+		Writer.Finish();
+	}
+};
+
+TEST_F(CTestMap, PrepareThenLoad)
+{
+	WriteMap("current.map", "current");
+	WriteMap("next.map", "next");
+	ASSERT_TRUE(m_Map.Load("current.map"));
+
+	// the current map stays until the prepared one is loaded
+	ASSERT_TRUE(m_Map.Prepare("next.map"));
+	EXPECT_STREQ(m_Map.GetDataString(0), "current");
+	ASSERT_TRUE(m_Map.LoadPrepared("next.map"));
+	EXPECT_STREQ(m_Map.GetDataString(0), "next");
+
+	unsigned Crc;
+	SHA256_DIGEST Sha256;
+	ASSERT_TRUE(m_pStorage->CalculateHashes("next.map", IStorage::TYPE_SAVE, &Sha256, &Crc));
+	EXPECT_EQ(m_Map.Crc(), Crc);
+	EXPECT_EQ(m_Map.Sha256(), Sha256);
+
+	// a prepared map is only loaded once
+	EXPECT_FALSE(m_Map.LoadPrepared("next.map"));
+	EXPECT_STREQ(m_Map.GetDataString(0), "next");
+	m_Map.Unload();
+}
+
+TEST_F(CTestMap, PrepareNameMismatch)
+{
+	WriteMap("current.map", "current");
+	WriteMap("next.map", "next");
+	ASSERT_TRUE(m_Map.Load("current.map"));
+
+	ASSERT_TRUE(m_Map.Prepare("next.map"));
+	EXPECT_FALSE(m_Map.LoadPrepared("current.map"));
+	EXPECT_STREQ(m_Map.GetDataString(0), "current");
+
+	// the mismatch dropped the prepared map
+	EXPECT_FALSE(m_Map.LoadPrepared("next.map"));
+	EXPECT_STREQ(m_Map.GetDataString(0), "current");
+
+	EXPECT_FALSE(m_Map.Prepare("missing.map"));
+	EXPECT_FALSE(m_Map.LoadPrepared("missing.map"));
+	m_Map.Unload();
+}
+
+TEST_F(CTestMap, PrepareModifiedFile)
+{
+	WriteMap("current.map", "current");
+	WriteMap("next.map", "next");
+	ASSERT_TRUE(m_Map.Load("current.map"));
+
+	ASSERT_TRUE(m_Map.Prepare("next.map"));
+	WriteMap("next.map", "modified after preparing");
+	EXPECT_FALSE(m_Map.LoadPrepared("next.map"));
+	EXPECT_STREQ(m_Map.GetDataString(0), "current");
+
+	// the stale map was dropped, loading reads the modified file
+	EXPECT_FALSE(m_Map.LoadPrepared("next.map"));
+	ASSERT_TRUE(m_Map.Load("next.map"));
+	EXPECT_STREQ(m_Map.GetDataString(0), "modified after preparing");
+	m_Map.Unload();
+}
@@ -3,6 +3,8 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <set>
+#include <string>
 
 using namespace std::chrono_literals;
 
@@ -52,3 +54,92 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, BatchedSend)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4 | NETTYPE_IPV6;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR TargetV4;
+	NETADDR TargetV6;
+	ASSERT_FALSE(net_addr_from_str(&TargetV4, "127.0.0.1"));
+	ASSERT_FALSE(net_addr_from_str(&TargetV6, "[::1]"));
+	TargetV4.port = Bindaddr.port;
+	TargetV6.port = Bindaddr.port;
+
+	struct CPacket
+	{
+		const NETADDR *m_pTarget;
+		std::string m_Data;
+	};
+	const CPacket aPackets[] = {{&TargetV4, "abc"}, {&TargetV4, "defg"}, {&TargetV6, "hi"}};
+
+	net_udp_batch_begin(Socket2);
+	for(const CPacket &Packet : aPackets)
+		EXPECT_EQ(net_udp_send(Socket2, Packet.m_pTarget, Packet.m_Data.data(), Packet.m_Data.size()), (int)Packet.m_Data.size());
+
+	// nothing leaves the socket before the flush
+	EXPECT_EQ(net_socket_read_wait(Socket1, 0s), 0);
+
+	// the kernel may drop loopback packets under load, only the accounting is exact
+	NETBATCHSTATS Stats;
+	net_udp_batch_flush(Socket2, &Stats);
+	EXPECT_EQ(Stats.packets, 3);
+	EXPECT_EQ(Stats.bytes, 9);
+	EXPECT_GE(Stats.failed, 0);
+	EXPECT_LE(Stats.failed, Stats.packets);
+	EXPECT_GE(Stats.syscalls, 1);
+	EXPECT_LE(Stats.syscalls, 3);
+
+	// packets from different address families may arrive in any order,
+	// send the missing ones again in a new batch if they got lost
+	std::set<std::string> Received;
+	for(int Try = 0; Try < 10 && Received.size() < std::size(aPackets); Try++)
+	{
+		if(Try > 0)
+		{
+			net_udp_batch_begin(Socket2);
+			for(const CPacket &Packet : aPackets)
+				if(!Received.count(Packet.m_Data))
+					net_udp_send(Socket2, Packet.m_pTarget, Packet.m_Data.data(), Packet.m_Data.size());
+			net_udp_batch_flush(Socket2, &Stats);
+			EXPECT_EQ(Stats.packets, (int)(std::size(aPackets) - Received.size()));
+		}
+		while(Received.size() < std::size(aPackets) && net_socket_read_wait(Socket1, 1s) == 1)
+		{
+			NETADDR Addr;
+			unsigned char *pData;
+			int Size;
+			while((Size = net_udp_recv(Socket1, &Addr, &pData)) > 0)
+				Received.emplace((const char *)pData, Size);
+		}
+	}
+	EXPECT_EQ(Received, (std::set<std::string>{"abc", "defg", "hi"}));
+
+	// sending directly again after the flush
+	bool Delivered = false;
+	for(int Try = 0; Try < 10 && !Delivered; Try++)
+	{
+		EXPECT_EQ(net_udp_send(Socket2, &TargetV4, "jkl", 3), 3);
+		while(!Delivered && net_socket_read_wait(Socket1, 1s) == 1)
+		{
+			NETADDR Addr;
+			unsigned char *pData;
+			int Size;
+			while((Size = net_udp_recv(Socket1, &Addr, &pData)) > 0)
+				Delivered |= std::string((const char *)pData, Size) == "jkl";
+		}
+	}
+	EXPECT_TRUE(Delivered);
+
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
@@ -0,0 +1,342 @@
+#include "test.h"
+
+#include <base/log.h>
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/netban.h>
+#include <engine/storage.h>
+
+#include <game/prng.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+class CTestNetBan : public CNetBan
+{
+public:
+	std::unique_ptr<IConsole> m_pTestConsole = CreateConsole(CFGFLAG_SERVER);
+
+	CTestNetBan(IStorage *pStorage = nullptr)
+	{
+		Init(m_pTestConsole.get(), pStorage);
+	}
+
+	bool IsBanned(const char *pAddr)
+	{
+		NETADDR Addr;
+		EXPECT_EQ(net_addr_from_str(&Addr, pAddr), 0);
+		char aBuf[256];
+		return CNetBan::IsBanned(&Addr, aBuf, sizeof(aBuf));
+	}
+
+	static CBanInfo Info(int64_t Expires)
+	{
+		CBanInfo Info = {0};
+		Info.m_Expires = Expires;
+		str_copy(Info.m_aReason, "test");
+		return Info;
+	}
+
+	using CNetBan::CBanAddrPool;
+	using CNetBan::CBanInfo;
+	using CNetBan::ImportBan;
+	using CNetBan::m_BanAddrPool;
+	using CNetBan::m_BanRangePool;
+	using CNetBan::CBanAddr;
+};
+
+static NETADDR RandomAddr(CPrng *pPrng, bool IPv6)
+{
+	NETADDR Addr = NETADDR_ZEROED;
+	Addr.type = IPv6 ? NETTYPE_IPV6 : NETTYPE_IPV4;
+	for(int i = 0; i < (IPv6 ? 16 : 4); i++)
+		Addr.ip[i] = pPrng->RandomBits();
+	// keep away from localhost, it can't be banned
+	if(Addr.ip[0] == 127 || (IPv6 && Addr.ip[0] == 0))
+		Addr.ip[0] = 128;
+	return Addr;
+}
+
+TEST(NetBan, AddressesAndRanges)
+{
+	CTestNetBan Ban;
+	NETADDR Addr;
+	CNetRange Range;
+
+	ASSERT_EQ(net_addr_from_str(&Addr, "10.1.2.3"), 0);
+	EXPECT_EQ(Ban.BanAddr(&Addr, 0, "test", false), 0);
+	EXPECT_EQ(Ban.BanAddr(&Addr, 60, "test", false), 1);
+	ASSERT_EQ(net_addr_from_str(&Range.m_LB, "10.2.0.5"), 0);
+	ASSERT_EQ(net_addr_from_str(&Range.m_UB, "10.2.3.7"), 0);
+	EXPECT_EQ(Ban.BanRange(&Range, 0, "test"), 0);
+	ASSERT_EQ(net_addr_from_str(&Range.m_LB, "[2001:db8::]"), 0);
+	ASSERT_EQ(net_addr_from_str(&Range.m_UB, "[2001:db8::ffff:ffff]"), 0);
+	EXPECT_EQ(Ban.BanRange(&Range, 0, "test"), 0);
+	ASSERT_EQ(net_addr_from_str(&Range.m_LB, "127.0.0.0"), 0);
+	ASSERT_EQ(net_addr_from_str(&Range.m_UB, "127.0.0.255"), 0);
+	EXPECT_EQ(Ban.BanRange(&Range, 0, "test"), -1);
+
+	EXPECT_TRUE(Ban.IsBanned("10.1.2.3:8303"));
+	EXPECT_FALSE(Ban.IsBanned("10.1.2.4"));
+	EXPECT_FALSE(Ban.IsBanned("10.2.0.4"));
+	EXPECT_TRUE(Ban.IsBanned("10.2.0.5"));
+	EXPECT_TRUE(Ban.IsBanned("10.2.1.0"));
+	EXPECT_TRUE(Ban.IsBanned("10.2.3.7"));
+	EXPECT_FALSE(Ban.IsBanned("10.2.3.8"));
+	EXPECT_TRUE(Ban.IsBanned("[2001:db8::1234:5678]:8303"));
+	EXPECT_FALSE(Ban.IsBanned("[2001:db8::1:0:0]"));
+	EXPECT_FALSE(Ban.IsBanned("10.0.0.0"));
+
+	ASSERT_EQ(net_addr_from_str(&Range.m_LB, "10.2.0.5"), 0);
+	ASSERT_EQ(net_addr_from_str(&Range.m_UB, "10.2.3.7"), 0);
+	EXPECT_EQ(Ban.UnbanByRange(&Range), 0);
+	EXPECT_FALSE(Ban.IsBanned("10.2.1.0"));
+	EXPECT_EQ(Ban.UnbanByIndex(0), 0);
+	EXPECT_FALSE(Ban.IsBanned("10.1.2.3"));
+	EXPECT_TRUE(Ban.IsBanned("[2001:db8::1]"));
+	Ban.UnbanAll();
+	EXPECT_FALSE(Ban.IsBanned("[2001:db8::1]"));
+}
+
+// Compares the bans with a linear search over all of them. With a shared
+// prefix, all bans are in 10.0.0.0/8 and 2000::/3, so the roots of the
+// tries have a prefix shorter than their jump table.
+static void CheckMatchesReference(uint64_t Seed, bool SharedPrefix, int NumBans)
+{
+	CTestNetBan Ban;
+	CPrng Prng;
+	uint64_t aSeed[2] = {Seed, 1};
+	Prng.Seed(aSeed);
+
+	// small ranges around few prefixes so that they overlap
+	std::vector<NETADDR> vAddrs;
+	std::vector<CNetRange> vRanges;
+	for(int i = 0; i < NumBans; i++)
+	{
+		const bool IPv6 = i % 2;
+		NETADDR Addr = RandomAddr(&Prng, IPv6);
+		Addr.ip[1] = Addr.ip[1] % 4;
+		if(SharedPrefix)
+			Addr.ip[0] = IPv6 ? 0x20 | (Addr.ip[0] & 0x1f) : 10;
+		if(i % 3 == 0)
+		{
+			if(Ban.BanAddr(&Addr, 0, "test", false) == 0)
+				vAddrs.push_back(Addr);
+			continue;
+		}
+		CNetRange Range;
+		Range.m_LB = Addr;
+		Range.m_UB = Addr;
+		const int Last = IPv6 ? 15 : 3;
+		const int Span = Prng.RandomBits() % 70000;
+		for(int Byte = Last, Carry = Span; Byte >= 0 && Carry; Byte--)
+		{
+			Carry += Range.m_UB.ip[Byte];
+			Range.m_UB.ip[Byte] = Carry & 0xff;
+			Carry >>= 8;
+		}
+		if(Range.IsValid() && Ban.BanRange(&Range, 0, "test") == 0)
+			vRanges.push_back(Range);
+	}
+
+	const auto &&Check = [&]() {
+		CPrng CheckPrng;
+		uint64_t aCheckSeed[2] = {0xc0ffee, 2};
+		CheckPrng.Seed(aCheckSeed);
+		int Banned = 0;
+		for(int i = 0; i < 10000; i++)
+		{
+			// pick addresses near the bans to hit their edges
+			NETADDR Addr;
+			if(i % 2)
+				Addr = vRanges[CheckPrng.RandomBits() % vRanges.size()].m_UB;
+			else
+				Addr = vRanges[CheckPrng.RandomBits() % vRanges.size()].m_LB;
+			const int Last = Addr.type == NETTYPE_IPV4 ? 3 : 15;
+			Addr.ip[Last] += (int)(CheckPrng.RandomBits() % 5) - 2;
+			if(i % 7 == 0)
+				Addr = vAddrs[CheckPrng.RandomBits() % vAddrs.size()];
+			// and addresses anywhere else
+			if(i % 11 == 0)
+				Addr = RandomAddr(&CheckPrng, i % 2);
+
+			bool Expected = false;
+			for(const NETADDR &BannedAddr : vAddrs)
+				Expected = Expected || NetComp(&BannedAddr, &Addr) == 0;
+			for(const CNetRange &Range : vRanges)
+			{
+				const int Length = Range.m_LB.type == NETTYPE_IPV4 ? 4 : 16;
+				Expected = Expected || (Range.m_LB.type == Addr.type && mem_comp(Range.m_LB.ip, Addr.ip, Length) <= 0 && mem_comp(Range.m_UB.ip, Addr.ip, Length) >= 0);
+			}
+			char aBuf[256];
+			ASSERT_EQ(Ban.CNetBan::IsBanned(&Addr, aBuf, sizeof(aBuf)), Expected);
+			Banned += Expected;
+		}
+		EXPECT_GT(Banned, 500);
+	};
+	const auto &&CheckOptimized = [&]() {
+		Check();
+		Ban.m_BanAddrPool.Optimize();
+		Ban.m_BanRangePool.Optimize();
+		Check();
+	};
+	CheckOptimized();
+
+	// removing half of the bans must leave the others intact
+	std::vector<CNetRange> vRemainingRanges;
+	for(size_t i = 0; i < vRanges.size(); i++)
+	{
+		if(i % 2)
+			vRemainingRanges.push_back(vRanges[i]);
+		else
+			EXPECT_EQ(Ban.UnbanByRange(&vRanges[i]), 0);
+	}
+	vRanges = vRemainingRanges;
+	CheckOptimized();
+}
+
+TEST(NetBan, MatchesReference)
+{
+	CheckMatchesReference(0xba5, false, 2000);
+}
+
+TEST(NetBan, MatchesReferenceSharedPrefix)
+{
+	CheckMatchesReference(0x5ba5, true, 3500);
+}
+
+TEST(NetBan, Expiry)
+{
+	CTestNetBan Ban;
+	CTestNetBan::CBanAddrPool &Pool = Ban.m_BanAddrPool;
+	CPrng Prng;
+	uint64_t aSeed[2] = {0xe, 3};
+	Prng.Seed(aSeed);
+
+	// bans expiring within a few seconds and bans that go around the wheel
+	const int64_t Start = 1000000;
+	std::vector<int64_t> vExpires;
+	for(int i = 0; i < 3000; i++)
+	{
+		NETADDR Addr = RandomAddr(&Prng, false);
+		const int64_t Expires = i % 10 == 0 ? (int64_t)CTestNetBan::CBanInfo::EXPIRES_NEVER : Start + 1 + Prng.RandomBits() % (i % 2 ? 30 : 5000);
+		const CTestNetBan::CBanInfo Info = CTestNetBan::Info(Expires);
+		if(Ban.ImportBan(&Pool, &Addr, &Info) == 0)
+			vExpires.push_back(Expires);
+	}
+
+	std::vector<CTestNetBan::CBanAddr *> vpExpired;
+	Pool.CollectExpired(Start, &vpExpired);
+	EXPECT_TRUE(vpExpired.empty());
+	for(int64_t Now = Start + 1; Now < Start + 6000; Now += 1 + Now % 7)
+	{
+		vpExpired.clear();
+		Pool.CollectExpired(Now, &vpExpired);
+		for(CTestNetBan::CBanAddr *pBan : vpExpired)
+		{
+			ASSERT_LT(pBan->m_Info.m_Expires, Now);
+			Pool.Remove(pBan);
+		}
+		int Remaining = 0;
+		for(int64_t Expires : vExpires)
+			Remaining += Expires == CTestNetBan::CBanInfo::EXPIRES_NEVER || Expires >= Now;
+		ASSERT_EQ(Pool.Num(), Remaining);
+	}
+}
+
+TEST(NetBan, Import)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_NE(pStorage, nullptr);
+
+	IOHANDLE File = pStorage->OpenFile("bans.txt", IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	const char aBans[] =
+		"# comment\n"
+		"10.0.0.1\n"
+		"  10.1.0.0/16 ; SBL123\n"
+		"10.2.0.1-10.2.0.9\n"
+		"2001:db8::/32\n"
+		"10.3.0.0/40\n"
+		"127.0.0.1\n"
+		"invalid\n"
+		"\n";
+	io_write(File, aBans, str_length(aBans));
+	io_close(File);
+
+	CTestNetBan Ban(pStorage.get());
+	EXPECT_EQ(Ban.ImportBans("bans.txt", 0, "test"), 4);
+	EXPECT_EQ(Ban.ImportBans("missing.txt", 0, "test"), -1);
+	EXPECT_TRUE(Ban.IsBanned("10.0.0.1"));
+	EXPECT_FALSE(Ban.IsBanned("10.0.255.255"));
+	EXPECT_TRUE(Ban.IsBanned("10.1.0.0"));
+	EXPECT_TRUE(Ban.IsBanned("10.1.255.255"));
+	EXPECT_FALSE(Ban.IsBanned("10.2.0.10"));
+	EXPECT_TRUE(Ban.IsBanned("10.2.0.9"));
+	EXPECT_TRUE(Ban.IsBanned("[2001:db8:ffff::1]"));
+	EXPECT_FALSE(Ban.IsBanned("[2001:db9::1]"));
+	EXPECT_FALSE(Ban.IsBanned("10.3.0.0"));
+	EXPECT_EQ(Ban.m_BanAddrPool.Num(), 1);
+	EXPECT_EQ(Ban.m_BanRangePool.Num(), 3);
+
+	// importing again only updates the bans
+	EXPECT_EQ(Ban.ImportBans("bans.txt", 60, "test"), 0);
+	EXPECT_EQ(Ban.m_BanRangePool.Num(), 3);
+}
+
+TEST(NetBan, DISABLED_Benchmark)
+{
+	CTestNetBan Ban;
+	CPrng Prng;
+	uint64_t aSeed[2] = {0xbe4c, 4};
+	Prng.Seed(aSeed);
+
+	// 100k entries like an abuse feed, mostly single addresses and CIDR ranges
+	const CTestNetBan::CBanInfo Info = CTestNetBan::Info(CTestNetBan::CBanInfo::EXPIRES_NEVER);
+	int64_t Start = time_get_impl();
+	for(int i = 0; i < 100000; i++)
+	{
+		const bool IPv6 = i % 5 == 0;
+		NETADDR Addr = RandomAddr(&Prng, IPv6);
+		if(i % 2)
+		{
+			Ban.ImportBan(&Ban.m_BanAddrPool, &Addr, &Info);
+			continue;
+		}
+		const int Width = IPv6 ? 128 : 32;
+		const int Bits = IPv6 ? 48 + Prng.RandomBits() % 17 : 20 + Prng.RandomBits() % 9;
+		CNetRange Range;
+		Range.m_LB = Addr;
+		Range.m_UB = Addr;
+		for(int b = Bits; b < Width; b++)
+		{
+			Range.m_LB.ip[b / 8] &= ~(1 << (7 - b % 8));
+			Range.m_UB.ip[b / 8] |= 1 << (7 - b % 8);
+		}
+		Ban.ImportBan(&Ban.m_BanRangePool, &Range, &Info);
+	}
+	Ban.m_BanAddrPool.Optimize();
+	Ban.m_BanRangePool.Optimize();
+	const int64_t InsertDuration = time_get_impl() - Start;
+
+	std::vector<NETADDR> vAddrs;
+	for(int i = 0; i < 1000000; i++)
+		vAddrs.push_back(RandomAddr(&Prng, i % 5 == 0));
+	char aBuf[256];
+	int Banned = 0;
+	Start = time_get_impl();
+	for(const NETADDR &Addr : vAddrs)
+		Banned += Ban.CNetBan::IsBanned(&Addr, aBuf, sizeof(aBuf));
+	const int64_t LookupDuration = time_get_impl() - Start;
+
+	EXPECT_GT(Banned, 0);
+	log_info("netban", "%d address and %d range bans added in %.2f ms", Ban.m_BanAddrPool.Num(), Ban.m_BanRangePool.Num(), InsertDuration * 1000.0 / time_freq());
+	log_info("netban", "%d lookups (%d banned) in %.2f ms, %.1f ns per lookup", (int)vAddrs.size(), Banned, LookupDuration * 1000.0 / time_freq(), LookupDuration * 1e9 / time_freq() / vAddrs.size());
+}
@@ -0,0 +1,234 @@
+#include <base/system.h>
+
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+class CTestNetServer : public ::testing::Test
+{
+protected:
+	CNetServer m_Server;
+	NETADDR m_ServerAddr;
+	std::set<int> m_Clients;
+	std::vector<std::unique_ptr<CNetClient>> m_vpNetClients;
+	// clients that aren't pumped anymore, so the server times them out
+	std::set<const CNetClient *> m_SilentClients;
+
+	int m_OldConnTimeout;
+	int m_OldSvConnlimit;
+	int m_OldSvConnlimitTime;
+
+	static int NewClientCallback(int ClientId, void *pUser, bool Sixup)
+	{
+		static_cast<CTestNetServer *>(pUser)->m_Clients.insert(ClientId);
+		return 0;
+	}
+	static int NewClientNoAuthCallback(int ClientId, void *pUser)
+	{
+		static_cast<CTestNetServer *>(pUser)->m_Clients.insert(ClientId);
+		return 0;
+	}
+	static int ClientRejoinCallback(int ClientId, void *pUser)
+	{
+		return 0;
+	}
+	static int DelClientCallback(int ClientId, const char *pReason, void *pUser)
+	{
+		static_cast<CTestNetServer *>(pUser)->m_Clients.erase(ClientId);
+		return 0;
+	}
+
+	CTestNetServer()
+	{
+		CNetBase::Init();
+		m_OldConnTimeout = g_Config.m_ConnTimeout;
+		m_OldSvConnlimit = g_Config.m_SvConnlimit;
+		m_OldSvConnlimitTime = g_Config.m_SvConnlimitTime;
+		g_Config.m_ConnTimeout = CConfig::ms_ConnTimeout;
+		// every test connects more often than the spam protection allows
+		g_Config.m_SvConnlimit = 100;
+		g_Config.m_SvConnlimitTime = CConfig::ms_SvConnlimitTime;
+	}
+
+	~CTestNetServer() override
+	{
+		for(auto &pClient : m_vpNetClients)
+			pClient->Close();
+		m_Server.Close();
+		g_Config.m_ConnTimeout = m_OldConnTimeout;
+		g_Config.m_SvConnlimit = m_OldSvConnlimit;
+		g_Config.m_SvConnlimitTime = m_OldSvConnlimitTime;
+	}
+
+	void Open(int MaxClients, int MaxClientsPerIp)
+	{
+		m_Server.Close();
+		m_Clients.clear();
+		NETADDR BindAddr = {};
+		BindAddr.type = NETTYPE_IPV4;
+		ASSERT_FALSE(net_addr_from_str(&m_ServerAddr, "127.0.0.1"));
+		do
+		{
+			BindAddr.port = secure_rand() % 64511 + 1024;
+		} while(!m_Server.Open(BindAddr, nullptr, MaxClients, MaxClientsPerIp));
+		m_ServerAddr.port = BindAddr.port;
+		m_Server.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
+	}
+
+	CNetClient *NewClient()
+	{
+		NETADDR BindAddr = {};
+		BindAddr.type = NETTYPE_IPV4;
+		m_vpNetClients.push_back(std::make_unique<CNetClient>());
+		CNetClient *pClient = m_vpNetClients.back().get();
+		do
+		{
+			BindAddr.port = secure_rand() % 64511 + 1024;
+		} while(!pClient->Open(BindAddr));
+		return pClient;
+	}
+
+	// Pumps the server and all clients until Done returns true or the time is up.
+	bool Pump(const std::function<bool()> &Done, std::chrono::seconds Timeout = std::chrono::seconds(2))
+	{
+		const auto Deadline = std::chrono::steady_clock::now() + Timeout;
+		while(std::chrono::steady_clock::now() < Deadline)
+		{
+			// the network code uses the cached time, like the server loop does
+			set_new_tick();
+			CNetChunk Chunk;
+			SECURITY_TOKEN Token;
+			m_Server.Update();
+			while(m_Server.Recv(&Chunk, &Token) > 0)
+			{
+			}
+			for(auto &pClient : m_vpNetClients)
+			{
+				if(m_SilentClients.count(pClient.get()))
+					continue;
+				pClient->Update();
+				while(pClient->Recv(&Chunk, &Token, false) > 0)
+				{
+				}
+			}
+			if(Done())
+				return true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+
+	// Returns the slot the client got, -1 if the server refused it.
+	int Connect(CNetClient *pClient)
+	{
+		const std::set<int> Before = m_Clients;
+		pClient->Connect(&m_ServerAddr, 1);
+		int Slot = -1;
+		Pump([&]() {
+			for(int ClientId : m_Clients)
+			{
+				if(!Before.count(ClientId))
+				{
+					Slot = ClientId;
+					return true;
+				}
+			}
+			return pClient->State() == NETSTATE_OFFLINE;
+		});
+		return Slot;
+	}
+
+	void Drop(CNetClient *pClient, int Slot)
+	{
+		m_Server.Drop(Slot, "test");
+		EXPECT_TRUE(Pump([&]() { return pClient->State() == NETSTATE_OFFLINE; }));
+	}
+};
+
+TEST_F(CTestNetServer, SlotsByAddress)
+{
+	Open(4, 2);
+
+	// two clients from the same IP fit, the third one doesn't
+	CNetClient *pFirst = NewClient();
+	CNetClient *pSecond = NewClient();
+	CNetClient *pThird = NewClient();
+	const int FirstSlot = Connect(pFirst);
+	const int SecondSlot = Connect(pSecond);
+	ASSERT_GE(FirstSlot, 0);
+	ASSERT_GE(SecondSlot, 0);
+	EXPECT_NE(FirstSlot, SecondSlot);
+	EXPECT_EQ(Connect(pThird), -1);
+	EXPECT_STREQ(pThird->ErrorString(), "Only 2 players with the same IP are allowed");
+
+	// a dropped client doesn't count anymore and can reconnect from the same address
+	Drop(pFirst, FirstSlot);
+	EXPECT_EQ(Connect(pFirst), FirstSlot);
+
+	// dropping frees the IP for another address
+	Drop(pSecond, SecondSlot);
+	pThird->ResetErrorString();
+	const int ThirdSlot = Connect(pThird);
+	EXPECT_EQ(ThirdSlot, SecondSlot);
+	EXPECT_EQ(Connect(pSecond), -1);
+	EXPECT_EQ(m_Clients, (std::set<int>{FirstSlot, ThirdSlot}));
+
+	// a client that times out doesn't count anymore either, the others
+	// keep their connection alive with a keepalive every second
+	g_Config.m_ConnTimeout = 2;
+	m_SilentClients.insert(pThird);
+	EXPECT_TRUE(Pump([&]() { return !m_Clients.count(ThirdSlot); }, std::chrono::seconds(5)));
+	EXPECT_EQ(m_Clients, (std::set<int>{FirstSlot}));
+	EXPECT_EQ(Connect(pSecond), ThirdSlot);
+}
+
+TEST_F(CTestNetServer, MaxClientsChange)
+{
+	Open(4, 4);
+	CNetClient *pFirst = NewClient();
+	CNetClient *pSecond = NewClient();
+	ASSERT_EQ(Connect(pFirst), 0);
+	ASSERT_EQ(Connect(pSecond), 1);
+
+	// reopening with fewer slots starts empty and only uses those slots
+	pFirst->Disconnect("reopen");
+	pSecond->Disconnect("reopen");
+	Open(1, 4);
+	EXPECT_EQ(Connect(pFirst), 0);
+	EXPECT_EQ(Connect(pSecond), -1);
+	EXPECT_STREQ(pSecond->ErrorString(), "This server is full");
+	EXPECT_EQ(m_Clients, (std::set<int>{0}));
+}
+
+TEST_F(CTestNetServer, SendBatchTotals)
+{
+	Open(4, 4);
+	CNetClient *pClient = NewClient();
+	const int Slot = Connect(pClient);
+	ASSERT_GE(Slot, 0);
+
+	// the close message of the drop goes out with the batch
+	m_Server.BeginSendBatch();
+	m_Server.Drop(Slot, "test");
+	m_Server.FlushSendBatch();
+	const CNetServer::CSendBatchTotals &Totals = m_Server.SendBatchTotals();
+	EXPECT_EQ(Totals.m_Batches, 1);
+	EXPECT_GE(Totals.m_Packets, 1);
+	EXPECT_EQ(Totals.m_Packets, m_Server.LastSendBatch().packets);
+	EXPECT_EQ(Totals.m_Bytes, m_Server.LastSendBatch().bytes);
+	EXPECT_GE(Totals.m_Syscalls, 1);
+	EXPECT_EQ(Totals.m_Failed, 0);
+
+	// batches without packets aren't counted
+	m_Server.BeginSendBatch();
+	m_Server.FlushSendBatch();
+	EXPECT_EQ(m_Server.SendBatchTotals().m_Batches, 1);
+}
@@ -327,3 +327,50 @@ TEST(Packer, Error3)
 	Packer.AddString("test");
 	EXPECT_EQ(Packer.Error(), true);
 }
+
+TEST(Packer, AddIntsMatchesAddInt)
+{
+	const int aValues[] = {0, 1, -1, 63, -64, 64, -65, 12345, -123456, 2147483647, (-2147483647 - 1), 7, 0, 0, 0, 0, 0, 0, 0, 0, 5};
+	const int Num = std::size(aValues);
+	char aData[CPacker::PACKER_BUFFER_SIZE];
+	mem_zero(aData, sizeof(aData));
+
+	// with enough room, and running out of it in the middle
+	for(int Offset : {0, (int)sizeof(aData) - 30, (int)sizeof(aData) - 5})
+	{
+		CPacker Expected;
+		Expected.Reset();
+		Expected.AddRaw(aData, Offset);
+		for(int Value : aValues)
+			Expected.AddInt(Value);
+
+		CPacker Packer;
+		Packer.Reset();
+		Packer.AddRaw(aData, Offset);
+		Packer.AddInts(aValues, Num);
+		EXPECT_EQ(Packer.Error(), Expected.Error());
+		ASSERT_EQ(Packer.Size(), Expected.Size());
+		EXPECT_EQ(mem_comp(Packer.Data(), Expected.Data(), Packer.Size()), 0);
+
+		// unpack everything that was packed and one int more than that
+		int aUnpacked[std::size(aValues) + 1];
+		int aExpectedUnpacked[std::size(aValues) + 1];
+		CUnpacker Unpacker;
+		Unpacker.Reset(Packer.Data() + Offset, Packer.Size() - Offset);
+		Unpacker.GetInts(aUnpacked, Num + 1);
+		CUnpacker ExpectedUnpacker;
+		ExpectedUnpacker.Reset(Packer.Data() + Offset, Packer.Size() - Offset);
+		for(int &Value : aExpectedUnpacked)
+			Value = ExpectedUnpacker.GetInt();
+		EXPECT_TRUE(Unpacker.Error());
+		EXPECT_EQ(mem_comp(aUnpacked, aExpectedUnpacked, sizeof(aUnpacked)), 0);
+
+		if(!Packer.Error())
+		{
+			Unpacker.Reset(Packer.Data() + Offset, Packer.Size() - Offset);
+			Unpacker.GetInts(aUnpacked, Num);
+			EXPECT_FALSE(Unpacker.Error());
+			EXPECT_EQ(mem_comp(aUnpacked, aValues, sizeof(aValues)), 0);
+		}
+	}
+}
@@ -0,0 +1,151 @@
+#include <base/log.h>
+#include <base/system.h>
+
+#include <game/server/save.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+static const int NUM_BENCH_MEMBERS = 16;
+
+static std::string LegacyTee(const char *pName, int HookedPlayer)
+{
+	char aBuf[2048];
+	str_format(aBuf, sizeof(aBuf),
+		"%s\t1\t0\t0\t0\t0\t"
+		// weapons
+		"0\t-1\t0\t1\t0\t-1\t0\t1\t0\t-1\t0\t0\t0\t-1\t0\t1\t0\t-1\t0\t0\t0\t0\t0\t0\t"
+		"1\t-1\t"
+		// tee states
+		"0\t0\t0\t0\t0\t0\t0\t1\t0\t1\t0\t0\t1\t12345\t"
+		"1234\t567\t1230\t560\t"
+		"3\t0\t"
+		"1234\t567\t1.500000\t-3.250000\t"
+		"1\t0\t0\t2\t"
+		"1300\t500\t0.707107\t-0.707107\t"
+		"0\t0\t12\t0\t"
+		// time checkpoints
+		"0\t2\t2\t"
+		"12.340000\t25.500000\t0.000000\t0.000000\t0.000000\t"
+		"0.000000\t0.000000\t0.000000\t0.000000\t0.000000\t"
+		"0.000000\t0.000000\t0.000000\t0.000000\t0.000000\t"
+		"0.000000\t0.000000\t0.000000\t0.000000\t0.000000\t"
+		"0.000000\t0.000000\t0.000000\t0.000000\t0.000000\t"
+		"0\t0\t0\t0\t"
+		"8d300ecf-5873-4297-bee5-95668fdff320\t"
+		"%d\t0\t0\t0\t0\t0\t0\t1\t0\t"
+		"0.000000\t0.000000\t0\t0\t0",
+		pName, HookedPlayer);
+	return aBuf;
+}
+
+static std::string LegacyTeam(int NumMembers)
+{
+	char aBuf[64];
+	str_format(aBuf, sizeof(aBuf), "2\t%d\t2\t0\t0", NumMembers);
+	std::string Team = aBuf;
+	for(int i = 0; i < NumMembers; i++)
+	{
+		str_format(aBuf, sizeof(aBuf), "player %d", i);
+		Team += "\n";
+		Team += LegacyTee(aBuf, i + 1 < NumMembers ? i + 1 : -1);
+	}
+	Team += "\n1\t0\t0\n0\t1234\t1";
+	return Team;
+}
+
+TEST(SaveTeam, LegacyRoundtrip)
+{
+	const std::string Legacy = LegacyTeam(3);
+	auto pTeam = std::make_unique<CSaveTeam>();
+	ASSERT_EQ(pTeam->FromString(Legacy.c_str()), 0);
+	EXPECT_EQ(pTeam->GetMembersCount(), 3);
+	EXPECT_STREQ(pTeam->GetString(), Legacy.c_str());
+}
+
+TEST(SaveTeam, BinaryRoundtrip)
+{
+	const std::string Legacy = LegacyTeam(3);
+	std::vector<unsigned char> vData;
+	ASSERT_TRUE(CSaveTeam::ConvertLegacy(Legacy.c_str(), &vData));
+
+	auto pTeam = std::make_unique<CSaveTeam>();
+	ASSERT_EQ(pTeam->FromBinary(vData.data(), vData.size()), 0);
+	EXPECT_STREQ(pTeam->GetString(), Legacy.c_str());
+
+	// the database format keeps a searchable line per member
+	const std::string SaveData = pTeam->GetSaveData();
+	EXPECT_NE(SaveData.find("\nplayer 1\t"), std::string::npos);
+	auto pLoaded = std::make_unique<CSaveTeam>();
+	ASSERT_EQ(pLoaded->FromSaveData(SaveData.c_str()), 0);
+	EXPECT_STREQ(pLoaded->GetString(), Legacy.c_str());
+
+	// legacy saves still load
+	ASSERT_EQ(pLoaded->FromSaveData(Legacy.c_str()), 0);
+	EXPECT_STREQ(pLoaded->GetString(), Legacy.c_str());
+}
+
+TEST(SaveTeam, BinaryCorrupted)
+{
+	std::vector<unsigned char> vData;
+	ASSERT_TRUE(CSaveTeam::ConvertLegacy(LegacyTeam(3).c_str(), &vData));
+	auto pTeam = std::make_unique<CSaveTeam>();
+
+	EXPECT_NE(pTeam->FromBinary(vData.data(), vData.size() - 1), 0);
+	EXPECT_NE(pTeam->FromBinary(vData.data(), 8), 0);
+
+	std::vector<unsigned char> vCorrupted = vData;
+	vCorrupted.back() ^= 0xff;
+	EXPECT_NE(pTeam->FromBinary(vCorrupted.data(), vCorrupted.size()), 0);
+
+	vCorrupted = vData;
+	vCorrupted[7] = 99; // version
+	EXPECT_NE(pTeam->FromBinary(vCorrupted.data(), vCorrupted.size()), 0);
+
+	EXPECT_NE(pTeam->FromSaveData("$bin\nplayer 0\t\n!!!"), 0);
+}
+
+TEST(SaveTeam, BinarySmallerThanText)
+{
+	const std::string Legacy = LegacyTeam(NUM_BENCH_MEMBERS);
+	auto pTeam = std::make_unique<CSaveTeam>();
+	ASSERT_EQ(pTeam->FromString(Legacy.c_str()), 0);
+	EXPECT_LT(str_length(pTeam->GetSaveData()), (int)Legacy.size());
+}
+
+TEST(SaveTeam, DISABLED_Benchmark)
+{
+	const std::string Legacy = LegacyTeam(NUM_BENCH_MEMBERS);
+	const int NumIterations = 200;
+	auto pTeam = std::make_unique<CSaveTeam>();
+	ASSERT_EQ(pTeam->FromString(Legacy.c_str()), 0);
+	const std::string SaveData = pTeam->GetSaveData();
+
+	int64_t aEncode[2] = {0, 0};
+	int64_t aDecode[2] = {0, 0};
+	for(int i = 0; i < NumIterations; i++)
+	{
+		int64_t Start = time_get_impl();
+		pTeam->GetString();
+		aEncode[0] += time_get_impl() - Start;
+		Start = time_get_impl();
+		ASSERT_EQ(pTeam->FromString(Legacy.c_str()), 0);
+		aDecode[0] += time_get_impl() - Start;
+
+		Start = time_get_impl();
+		pTeam->GetSaveData();
+		aEncode[1] += time_get_impl() - Start;
+		Start = time_get_impl();
+		ASSERT_EQ(pTeam->FromSaveData(SaveData.c_str()), 0);
+		aDecode[1] += time_get_impl() - Start;
+	}
+
+	const double Scale = 1000000.0 / time_freq() / NumIterations;
+	log_info("save", "%d members, text: %d bytes, encode %.1f us, decode %.1f us",
+		NUM_BENCH_MEMBERS, (int)Legacy.size(), aEncode[0] * Scale, aDecode[0] * Scale);
+	log_info("save", "%d members, binary: %d bytes, encode %.1f us, decode %.1f us",
+		NUM_BENCH_MEMBERS, (int)SaveData.size(), aEncode[1] * Scale, aDecode[1] * Scale);
+}
@@ -1,3 +1,5 @@
+#include "test.h"
+
 #include <base/detect.h>
 
 #include <engine/server/databases/connection.h>
@@ -10,6 +12,9 @@
 #include <gtest/gtest.h>
 #include <sqlite3.h>
 
+#include <chrono>
+#include <thread>
+
 #if defined(CONF_TEST_MYSQL)
 int DummyMysqlInit = (MysqlInit(), 1);
 #endif
@@ -74,7 +79,7 @@ struct Score : public testing::TestWithParam<IDbConnection *>
 		ASSERT_EQ(NumInserted, 1);
 	}
 
-	void InsertRank(float Time = 100.0, bool WithTimeCheckPoints = false)
+	void InsertRank(float Time = 100.0, bool WithTimeCheckPoints = false, std::shared_ptr<CScoreCache> pCache = nullptr)
 	{
 		str_copy(g_Config.m_SvSqlServerName, "USA", sizeof(g_Config.m_SvSqlServerName));
 		CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
@@ -87,6 +92,7 @@ struct Score : public testing::TestWithParam<IDbConnection *>
 		for(int i = 0; i < NUM_CHECKPOINTS; i++)
 			ScoreData.m_aCurrentTimeCp[i] = WithTimeCheckPoints ? i : 0;
 		str_copy(ScoreData.m_aRequestingPlayer, "deen", sizeof(ScoreData.m_aRequestingPlayer));
+		ScoreData.m_pCache = std::move(pCache);
 		ASSERT_TRUE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
 	}
 
@@ -107,8 +113,22 @@ struct Score : public testing::TestWithParam<IDbConnection *>
 		}
 	}
 
+	// does what CScore does: looks the request up in the cache on
+	// the main thread, then runs the query on a miss
+	void CachedQuery(CScoreCache::EQuery Query, CDbConnectionPool::FRead pfnQuery, bool ExpectHit)
+	{
+		m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+		m_PlayerRequest.m_pCache = nullptr;
+		ASSERT_EQ(m_pCache->Lookup(Query, &m_PlayerRequest, m_pPlayerResult.get()), ExpectHit);
+		if(ExpectHit)
+			return;
+		m_PlayerRequest.m_pCache = m_pCache;
+		ASSERT_TRUE(pfnQuery(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	}
+
 	IDbConnection *m_pConn{GetParam()};
 	char m_aError[256] = {};
+	std::shared_ptr<CScoreCache> m_pCache{std::make_shared<CScoreCache>()};
 	std::shared_ptr<CScorePlayerResult> m_pPlayerResult{std::make_shared<CScorePlayerResult>()};
 	CSqlPlayerRequest m_PlayerRequest{m_pPlayerResult};
 };
@@ -146,6 +166,53 @@ TEST_P(SingleScore, Top)
 			"-----------------------------------------"});
 }
 
+TEST_P(SingleScore, TopCached)
+{
+	g_Config.m_SvRegionalRankings = false;
+	g_Config.m_SvSqlCacheTime = 60;
+	CachedQuery(CScoreCache::QUERY_TOP, CScoreWorker::ShowTop, false);
+
+	// finishes on other servers only show up once the entry expires
+	InsertRank(50.0);
+	CachedQuery(CScoreCache::QUERY_TOP, CScoreWorker::ShowTop, true);
+	ExpectLines(m_pPlayerResult,
+		{"------------ Global Top ------------",
+			"1. nameless tee Time: 01:40.00",
+			"-----------------------------------------"});
+
+	// finishes on this server clear the cache
+	InsertRank(40.0, false, m_pCache);
+	CachedQuery(CScoreCache::QUERY_TOP, CScoreWorker::ShowTop, false);
+	ExpectLines(m_pPlayerResult,
+		{"------------ Global Top ------------",
+			"1. nameless tee Time: 40.00",
+			"-----------------------------------------"});
+	CachedQuery(CScoreCache::QUERY_TOP, CScoreWorker::ShowTop, true);
+}
+
+TEST_P(SingleScore, CacheWriteInProgress)
+{
+	g_Config.m_SvRegionalRankings = false;
+	g_Config.m_SvSqlCacheTime = 60;
+	{
+		// results of queries running next to a write aren't stored
+		CScoreCache::CWriteGuard Guard(m_pCache.get(), "Kobra 3");
+		CachedQuery(CScoreCache::QUERY_TOP, CScoreWorker::ShowTop, false);
+	}
+	CachedQuery(CScoreCache::QUERY_TOP, CScoreWorker::ShowTop, false);
+
+	// neither are results of queries that started before a write
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_FALSE(m_pCache->Lookup(CScoreCache::QUERY_POINTS, &m_PlayerRequest, m_pPlayerResult.get()));
+	m_PlayerRequest.m_pCache = m_pCache;
+	{
+		CScoreCache::CWriteGuard Guard(m_pCache.get(), "Kobra 3");
+	}
+	ASSERT_TRUE(CScoreWorker::ShowPoints(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	CachedQuery(CScoreCache::QUERY_POINTS, CScoreWorker::ShowPoints, false);
+	CachedQuery(CScoreCache::QUERY_POINTS, CScoreWorker::ShowPoints, true);
+}
+
 TEST_P(SingleScore, RankRegional)
 {
 	g_Config.m_SvRegionalRankings = true;
@@ -387,6 +454,20 @@ TEST_P(MapInfo, ExactFinish)
 	}
 }
 
+TEST_P(MapInfo, Cached)
+{
+	g_Config.m_SvSqlCacheTime = 60;
+	str_copy(m_PlayerRequest.m_aName, "Kobra 3", sizeof(m_PlayerRequest.m_aName));
+	CachedQuery(CScoreCache::QUERY_MAP_INFO, CScoreWorker::MapInfo, false);
+	CachedQuery(CScoreCache::QUERY_MAP_INFO, CScoreWorker::MapInfo, true);
+	EXPECT_THAT(m_pPlayerResult->m_Data.m_aaMessages[0], testing::MatchesRegex(".*, 0 finishes by 0 tees"));
+
+	// finishes on this server clear the cache
+	InsertRank(100.0, false, m_pCache);
+	CachedQuery(CScoreCache::QUERY_MAP_INFO, CScoreWorker::MapInfo, false);
+	EXPECT_THAT(m_pPlayerResult->m_Data.m_aaMessages[0], testing::MatchesRegex(".*, 1 finish by 1 tee in 01:40 median"));
+}
+
 TEST_P(MapInfo, Fuzzy)
 {
 	InsertRank();
@@ -493,6 +574,25 @@ TEST_P(Points, NoPointsTop)
 					     "-------------------------------"});
 }
 
+TEST_P(Points, Cached)
+{
+	g_Config.m_SvSqlCacheTime = 60;
+	CachedQuery(CScoreCache::QUERY_POINTS, CScoreWorker::ShowPoints, false);
+	CachedQuery(CScoreCache::QUERY_TOP_POINTS, CScoreWorker::ShowTopPoints, false);
+
+	// finishes on this server clear the cache, on any map
+	InsertRank(100.0, false, m_pCache);
+	CachedQuery(CScoreCache::QUERY_POINTS, CScoreWorker::ShowPoints, false);
+	ExpectLines(m_pPlayerResult, {"1. nameless tee Points: 5, requested by brainless tee"}, true);
+	CachedQuery(CScoreCache::QUERY_TOP_POINTS, CScoreWorker::ShowTopPoints, false);
+	ExpectLines(m_pPlayerResult,
+		{"-------- Top Points --------",
+			"1. nameless tee Points: 5",
+			"-------------------------------"});
+	CachedQuery(CScoreCache::QUERY_POINTS, CScoreWorker::ShowPoints, true);
+	ExpectLines(m_pPlayerResult, {"1. nameless tee Points: 5, requested by brainless tee"}, true);
+}
+
 TEST_P(Points, OnePoints)
 {
 	m_pConn->AddPoints("nameless tee", 2, m_aError, sizeof(m_aError));
@@ -665,3 +765,110 @@ INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
 INSTANTIATE(RandomMap);
+
+struct CPoolTestResult : ISqlResult
+{
+	int m_Points = -1;
+};
+
+struct CPoolTestData : ISqlData
+{
+	CPoolTestData(std::shared_ptr<CPoolTestResult> pResult, int Seq) :
+		ISqlData(std::move(pResult)), m_Seq(Seq)
+	{
+	}
+	int m_Seq;
+};
+
+// only touched by the write lane
+static int s_NextWriteSeq = 0;
+
+static bool PoolTestWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CPoolTestData *>(pGameData);
+	if(pData->m_Seq != s_NextWriteSeq++)
+	{
+		str_format(pError, ErrorSize, "write %d executed out of order", pData->m_Seq);
+		return false;
+	}
+	return pSqlServer->AddPoints("pool tee", 1, pError, ErrorSize);
+}
+
+static bool PoolTestRead(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	auto *pResult = dynamic_cast<CPoolTestResult *>(pGameData->m_pResult.get());
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "SELECT COALESCE(SUM(Points), 0) FROM %s_points", pSqlServer->GetPrefix());
+	if(!pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		return false;
+	bool End;
+	if(!pSqlServer->Step(&End, pError, ErrorSize) || End)
+		return false;
+	pResult->m_Points = pSqlServer->GetInt(1);
+	return true;
+}
+
+TEST(DbConnectionPool, ParallelReadsOrderedWrites)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+	const int OldReadWorkers = g_Config.m_SvSqlReadWorkers;
+	g_Config.m_SvSqlReadWorkers = 4;
+
+	const int NumQueries = 200;
+	std::vector<std::shared_ptr<CPoolTestResult>> vpReads;
+	std::vector<std::shared_ptr<CPoolTestResult>> vpWrites;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, aFilename);
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		s_NextWriteSeq = 0;
+		for(int i = 0; i < NumQueries; i++)
+		{
+			vpWrites.push_back(std::make_shared<CPoolTestResult>());
+			Pool.ExecuteWrite(PoolTestWrite, std::make_unique<CPoolTestData>(vpWrites.back(), i), "pool test write");
+			vpReads.push_back(std::make_shared<CPoolTestResult>());
+			Pool.Execute(PoolTestRead, std::make_unique<CPoolTestData>(vpReads.back(), i), "pool test read");
+		}
+
+		// reads are dismissed on shutdown, wait for them first
+		const int64_t Deadline = time_get_impl() + 30 * time_freq();
+		for(const auto &pRead : vpReads)
+		{
+			while(!pRead->m_Completed.load() && time_get_impl() < Deadline)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		Pool.OnShutdown();
+	}
+	// the pool reads it on the first query, restore it before any assertion can return
+	g_Config.m_SvSqlReadWorkers = OldReadWorkers;
+
+	for(int i = 0; i < NumQueries; i++)
+	{
+		ASSERT_TRUE(vpReads[i]->m_Completed.load()) << i;
+		EXPECT_TRUE(vpReads[i]->m_Success) << i;
+		EXPECT_GE(vpReads[i]->m_Points, 0) << i;
+		EXPECT_LE(vpReads[i]->m_Points, NumQueries) << i;
+		ASSERT_TRUE(vpWrites[i]->m_Completed.load()) << i;
+		EXPECT_TRUE(vpWrites[i]->m_Success) << i;
+	}
+	EXPECT_EQ(s_NextWriteSeq, NumQueries);
+
+	auto pConn = CreateSqliteConnection(aFilename, false);
+	char aError[256] = {};
+	ASSERT_TRUE(pConn->Connect(aError, sizeof(aError))) << aError;
+	auto pResult = std::make_shared<CPoolTestResult>();
+	CPoolTestData Data(pResult, 0);
+	ASSERT_TRUE(PoolTestRead(pConn.get(), &Data, aError, sizeof(aError))) << aError;
+	EXPECT_EQ(pResult->m_Points, NumQueries);
+	pConn->Disconnect();
+	pConn.reset();
+
+	fs_remove(aFilename);
+	char aWal[IO_MAX_PATH_LENGTH];
+	str_format(aWal, sizeof(aWal), "%s-wal", aFilename);
+	fs_remove(aWal);
+	str_format(aWal, sizeof(aWal), "%s-shm", aFilename);
+	fs_remove(aWal);
+}
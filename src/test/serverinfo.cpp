@@ -1,9 +1,17 @@
 #include <engine/external/json-parser/json.h>
+#include <engine/server/server.h>
 #include <engine/serverbrowser.h>
+#include <engine/shared/masterserver.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
 #include <engine/shared/serverinfo.h>
 
 #include <gtest/gtest.h>
 
+#include <climits>
+#include <optional>
+#include <vector>
+
 TEST(ServerInfo, ParseLocation)
 {
 	int Result;
@@ -52,3 +60,191 @@ TEST(ServerInfo, Crc)
 	EXPECT_EQ(ParseCrcOrDeadbeef("000000000"), 0xdeadbeef);
 	EXPECT_EQ(ParseCrcOrDeadbeef("00000000x"), 0xdeadbeef);
 }
+
+struct CInfoClient
+{
+	char m_aName[64];
+	char m_aClan[64];
+	int m_Country;
+	std::optional<int> m_Score;
+	bool m_Player;
+};
+
+// Packs a client the way the server info did before the entries were cached
+static void PackClientInline(CPacker *pPacker, const CInfoClient &Client)
+{
+	char aBuf[128];
+	pPacker->AddString(Client.m_aName, MAX_NAME_LENGTH);
+	pPacker->AddString(Client.m_aClan, MAX_CLAN_LENGTH);
+	str_format(aBuf, sizeof(aBuf), "%d", Client.m_Country);
+	pPacker->AddString(aBuf, 0);
+	int Score = -9999;
+	if(Client.m_Score.has_value())
+	{
+		Score = Client.m_Score.value();
+		if(Score == 9999)
+			Score = -10000;
+		else if(Score == 0)
+			Score = -1;
+		else
+			Score = -Score;
+	}
+	str_format(aBuf, sizeof(aBuf), "%d", Score);
+	pPacker->AddString(aBuf, 0);
+	str_format(aBuf, sizeof(aBuf), "%d", Client.m_Player ? 1 : 0);
+	pPacker->AddString(aBuf, 0);
+}
+
+static void PackClientFragment(CPacker *pPacker, const CInfoClient &Client)
+{
+	CPacker Fragment;
+	Fragment.Reset();
+	CServer::PackServerInfoClient(&Fragment, Client.m_aName, Client.m_aClan, Client.m_Country, Client.m_Score, Client.m_Player);
+	pPacker->AddRaw(Fragment.Data(), Fragment.Size());
+}
+
+// Splits the clients into chunks like CServer::CacheServerInfo
+static std::vector<std::vector<unsigned char>> ServerInfoChunks(int Type, const std::vector<CInfoClient> &vClients, void (*pfnPackClient)(CPacker *, const CInfoClient &))
+{
+	char aBuf[16];
+	CPacker Prefix;
+	Prefix.Reset();
+	Prefix.AddString("0.6.4, 19.0", 32);
+	Prefix.AddString("Test server", 256);
+	Prefix.AddString("Tutorial", 32);
+	Prefix.AddString("DDraceNetwork", 16);
+	Prefix.AddString("0", 0);
+
+	std::vector<std::vector<unsigned char>> vvChunks;
+	CPacker q;
+	auto &&Save = [&](int Size) { vvChunks.emplace_back(q.Data(), q.Data() + Size); };
+	auto &&Reset = [&]() {
+		q.Reset();
+		if(Type != SERVERINFO_EXTENDED || vvChunks.empty())
+			q.AddRaw(Prefix.Data(), Prefix.Size());
+	};
+
+	Reset();
+	int PlayersStored = 0;
+	if(Type == SERVERINFO_64_LEGACY)
+		q.AddInt(PlayersStored);
+	int Remaining = Type == SERVERINFO_EXTENDED ? -1 : Type == SERVERINFO_64_LEGACY ? 24 : 16;
+	for(int i = 0; i < (int)vClients.size(); i++)
+	{
+		if(Remaining == 0)
+		{
+			if(Type == SERVERINFO_VANILLA)
+				break;
+			Save(q.Size());
+			Reset();
+			q.AddInt(PlayersStored);
+			Remaining = 24;
+		}
+		if(Remaining > 0)
+			Remaining--;
+
+		const int PreviousSize = q.Size();
+		pfnPackClient(&q, vClients[i]);
+		if(Type == SERVERINFO_EXTENDED)
+		{
+			q.AddString("", 0);
+			if(q.Size() >= NET_MAX_PAYLOAD - 18)
+			{
+				i--;
+				Save(PreviousSize);
+				Reset();
+				str_format(aBuf, sizeof(aBuf), "%d", (int)vvChunks.size());
+				q.AddString(aBuf, 0);
+				q.AddString("", 0);
+				continue;
+			}
+		}
+		PlayersStored++;
+	}
+	Save(q.Size());
+	EXPECT_FALSE(q.Error());
+	return vvChunks;
+}
+
+static const unsigned char *ServerInfoHeader(int Type, int Chunk)
+{
+	if(Type == SERVERINFO_EXTENDED)
+		return Chunk == 0 ? SERVERBROWSE_INFO_EXTENDED : SERVERBROWSE_INFO_EXTENDED_MORE;
+	if(Type == SERVERINFO_64_LEGACY)
+		return SERVERBROWSE_INFO_64_LEGACY;
+	return SERVERBROWSE_INFO;
+}
+
+TEST(ServerInfo, ReplyFromFragments)
+{
+	std::vector<CInfoClient> vClients;
+	const std::optional<int> aScores[] = {std::nullopt, 0, 9999, 1234, -5, 100000};
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CInfoClient Client;
+		// some names and clans are longer than the protocol allows
+		str_format(Client.m_aName, sizeof(Client.m_aName), i % 3 ? "player %d" : "ünïcödé plåyer näme %d", i);
+		str_format(Client.m_aClan, sizeof(Client.m_aClan), i % 4 ? "clan" : "a rather long clan name %d", i);
+		Client.m_Country = i % 5 ? 276 : -1;
+		Client.m_Score = aScores[i % std::size(aScores)];
+		Client.m_Player = i % 2;
+		vClients.push_back(Client);
+	}
+
+	const int aTokens[] = {0, 1, -1, 123456, 0xffffff};
+	for(int Type : {SERVERINFO_VANILLA, SERVERINFO_EXTENDED, SERVERINFO_64_LEGACY})
+	{
+		const std::vector<std::vector<unsigned char>> vvOldChunks = ServerInfoChunks(Type, vClients, PackClientInline);
+		const std::vector<std::vector<unsigned char>> vvChunks = ServerInfoChunks(Type, vClients, PackClientFragment);
+		ASSERT_EQ(vvChunks, vvOldChunks) << "type=" << Type;
+		if(Type != SERVERINFO_VANILLA)
+		{
+			EXPECT_GT(vvChunks.size(), 1u) << "type=" << Type;
+		}
+
+		for(int Token : aTokens)
+		{
+			for(int i = 0; i < (int)vvChunks.size(); i++)
+			{
+				CPacker Old;
+				Old.Reset();
+				Old.AddRaw(ServerInfoHeader(Type, i), SERVERBROWSE_SIZE);
+				char aToken[16];
+				str_format(aToken, sizeof(aToken), "%d", Token);
+				Old.AddString(aToken, 0);
+				Old.AddRaw(vvOldChunks[i].data(), vvOldChunks[i].size());
+				ASSERT_FALSE(Old.Error());
+
+				unsigned char aData[NET_MAX_PAYLOAD];
+				const int Size = CServer::FormatServerInfoReply(aData, sizeof(aData), ServerInfoHeader(Type, i), Token, vvChunks[i].data(), vvChunks[i].size());
+				ASSERT_EQ(Size, Old.Size()) << "type=" << Type << " token=" << Token << " chunk=" << i;
+				EXPECT_EQ(mem_comp(aData, Old.Data(), Size), 0) << "type=" << Type << " token=" << Token << " chunk=" << i;
+			}
+		}
+	}
+
+	for(const CInfoClient &Client : vClients)
+	{
+		CPacker Old;
+		Old.Reset();
+		Old.AddString(Client.m_aName, MAX_NAME_LENGTH);
+		Old.AddString(Client.m_aClan, MAX_CLAN_LENGTH);
+		Old.AddInt(Client.m_Country);
+		Old.AddInt(Client.m_Score.value_or(-1));
+		Old.AddInt(Client.m_Player ? 0 : 1);
+
+		CPacker Sixup;
+		Sixup.Reset();
+		CServer::PackServerInfoClientSixup(&Sixup, Client.m_aName, Client.m_aClan, Client.m_Country, Client.m_Score, Client.m_Player);
+		ASSERT_EQ(Sixup.Size(), Old.Size());
+		EXPECT_EQ(mem_comp(Sixup.Data(), Old.Data(), Sixup.Size()), 0);
+	}
+}
+
+TEST(ServerInfo, ReplyTooLarge)
+{
+	const std::vector<unsigned char> vChunk(NET_MAX_PAYLOAD - 18, 'a');
+	unsigned char aData[NET_MAX_PAYLOAD];
+	EXPECT_EQ(CServer::FormatServerInfoReply(aData, sizeof(aData), SERVERBROWSE_INFO_EXTENDED, 0xffffff, vChunk.data(), vChunk.size()), SERVERBROWSE_SIZE + 9 + (int)vChunk.size());
+	EXPECT_EQ(CServer::FormatServerInfoReply(aData, sizeof(aData), SERVERBROWSE_INFO_EXTENDED, INT_MIN, vChunk.data(), vChunk.size()), -1);
+}
@@ -1,3 +1,4 @@
+#include <base/log.h>
 #include <base/system.h>
 
 #include <engine/shared/snapshot.h>
@@ -6,6 +7,8 @@
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 TEST(Snapshot, CrcOneInt)
 {
 	CSnapshotBuilder Builder;
@@ -85,3 +88,292 @@ TEST(Snapshot, CrcOverflow)
 
 	ASSERT_EQ(pSnapshot->Crc(), 1);
 }
+
+TEST(Snapshot, StorageReusesHolders)
+{
+	CSnapshotStorage Storage;
+	int aData[64];
+	int aAltData[32];
+	for(int i = 0; i < 64; i++)
+		aData[i] = i;
+	for(int i = 0; i < 32; i++)
+		aAltData[i] = -i;
+
+	// keeps 150 ticks like the server does
+	int64_t WarmAllocations = 0;
+	for(int Tick = 1; Tick <= 1000; Tick++)
+	{
+		if(Tick == 500)
+			WarmAllocations = Storage.NumAllocations();
+		Storage.PurgeUntil(Tick - 150);
+		aData[0] = Tick;
+		Storage.Add(Tick, Tick * 10, sizeof(aData) - (Tick % 3) * sizeof(int), aData, Tick % 2 ? sizeof(aAltData) : 0, aAltData);
+	}
+	EXPECT_GT(WarmAllocations, 0);
+	EXPECT_EQ(Storage.NumAllocations(), WarmAllocations);
+
+	int64_t Tagtime;
+	const CSnapshot *pData;
+	const CSnapshot *pAltData;
+	EXPECT_EQ(Storage.Get(849, nullptr, nullptr, nullptr), -1);
+	ASSERT_EQ(Storage.Get(851, &Tagtime, &pData, &pAltData), (int)(sizeof(aData) - 2 * sizeof(int)));
+	EXPECT_EQ(Tagtime, 8510);
+	EXPECT_EQ(((const int *)pData)[0], 851);
+	ASSERT_NE(pAltData, nullptr);
+	EXPECT_EQ(mem_comp(pAltData, aAltData, sizeof(aAltData)), 0);
+	ASSERT_EQ(Storage.Get(1000, nullptr, nullptr, &pAltData), (int)(sizeof(aData) - sizeof(int)));
+	EXPECT_EQ(pAltData, nullptr);
+
+	// ticks more than the index size apart share index slots
+	Storage.PurgeAll();
+	for(int Tick = 0; Tick < 3 * CSnapshotStorage::TICK_INDEX_SIZE; Tick += 7)
+	{
+		aData[0] = Tick;
+		Storage.Add(Tick, 0, sizeof(aData), aData, 0, nullptr);
+	}
+	for(int Tick = 0; Tick < 3 * CSnapshotStorage::TICK_INDEX_SIZE; Tick++)
+	{
+		const int Size = Storage.Get(Tick, nullptr, &pData, nullptr);
+		if(Tick % 7 == 0)
+		{
+			ASSERT_EQ(Size, (int)sizeof(aData)) << Tick;
+			EXPECT_EQ(((const int *)pData)[0], Tick);
+		}
+		else
+		{
+			EXPECT_EQ(Size, -1) << Tick;
+		}
+	}
+	Storage.PurgeUntil(2 * CSnapshotStorage::TICK_INDEX_SIZE);
+	EXPECT_EQ(Storage.Get(7, nullptr, nullptr, nullptr), -1);
+	EXPECT_EQ(Storage.m_pFirst->m_Tick, 518);
+	EXPECT_EQ(Storage.m_pFirst->m_pPrev, nullptr);
+
+	// a tick added twice returns the first snapshot of it
+	Storage.PurgeAll();
+	const int aTicks[] = {10, 11, 10, 12};
+	for(int i = 0; i < (int)std::size(aTicks); i++)
+		Storage.Add(aTicks[i], i, sizeof(aData), aData, 0, nullptr);
+	ASSERT_EQ(Storage.Get(10, &Tagtime, &pData, nullptr), (int)sizeof(aData));
+	EXPECT_EQ(Tagtime, 0);
+	EXPECT_EQ(Storage.Find(10), Storage.m_pFirst);
+	// once the first one is purged the later one is found
+	Storage.PurgeUntil(11);
+	ASSERT_EQ(Storage.Get(10, &Tagtime, nullptr, nullptr), (int)sizeof(aData));
+	EXPECT_EQ(Tagtime, 2);
+	Storage.PurgeAll();
+	EXPECT_EQ(Storage.Get(10, nullptr, nullptr, nullptr), -1);
+}
+
+// plain CSnapshotDelta::CreateDelta with linear lookups and scalar diffs,
+// for comparing the output
+static int CreateDeltaReference(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData)
+{
+	CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pDstData;
+	int *pData = (int *)pDelta->m_aData;
+	pDelta->m_NumDeletedItems = 0;
+	pDelta->m_NumUpdateItems = 0;
+	pDelta->m_NumTempItems = 0;
+
+	for(int i = 0; i < pFrom->NumItems(); i++)
+	{
+		if(pTo->GetItemIndex(pFrom->GetItem(i)->Key()) == -1)
+		{
+			pDelta->m_NumDeletedItems++;
+			*pData++ = pFrom->GetItem(i)->Key();
+		}
+	}
+
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		const int Size = pTo->GetItemSize(i) / sizeof(int32_t);
+		const CSnapshotItem *pCurItem = pTo->GetItem(i);
+		const int PastIndex = pFrom->GetItemIndex(pCurItem->Key());
+		int aDiff[CSnapshot::MAX_SIZE / sizeof(int32_t)];
+		bool Changed = true;
+		if(PastIndex != -1)
+		{
+			int Needed = 0;
+			for(int j = 0; j < Size; j++)
+			{
+				aDiff[j] = (unsigned)pCurItem->Data()[j] - (unsigned)pFrom->GetItem(PastIndex)->Data()[j];
+				Needed |= aDiff[j];
+			}
+			Changed = Needed != 0;
+		}
+		else
+		{
+			mem_copy(aDiff, pCurItem->Data(), Size * sizeof(int32_t));
+		}
+		if(Changed)
+		{
+			*pData++ = pCurItem->Type();
+			*pData++ = pCurItem->Id();
+			*pData++ = Size;
+			mem_copy(pData, aDiff, Size * sizeof(int32_t));
+			pData += Size;
+			pDelta->m_NumUpdateItems++;
+		}
+	}
+
+	if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems)
+		return 0;
+	return (int)((char *)pData - (char *)pDstData);
+}
+
+// players running around with projectiles coming and going, like a
+// busy server
+static std::vector<std::vector<char>> GenerateSnapshots(int NumTicks)
+{
+	std::vector<std::vector<char>> vvSnapshots;
+	CSnapshotBuilder Builder;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		Builder.Init();
+		for(int i = 0; i < 64; i++)
+		{
+			CNetObj_Character *pChar = (CNetObj_Character *)Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+			mem_zero(pChar, sizeof(*pChar));
+			pChar->m_Tick = Tick - Tick % 5;
+			pChar->m_X = 1000 + i * 64 + (i % 3 ? Tick * (i % 7) : 0);
+			pChar->m_Y = 2000 - (i % 2 ? (Tick * i) % 300 : 0);
+			pChar->m_VelX = i % 3 ? (i % 7) * 256 : 0;
+			pChar->m_Direction = (Tick / 10 + i) % 3 - 1;
+			pChar->m_Weapon = (i + Tick / 50) % 6;
+		}
+		for(int i = 0; i < 40; i++)
+		{
+			// each projectile lives for 20 ticks
+			const int Id = (Tick / 20) * 40 + i;
+			if((Id + Tick) % 3 == 0)
+				continue;
+			CNetObj_Projectile *pProj = (CNetObj_Projectile *)Builder.NewItem(NETOBJTYPE_PROJECTILE, Id % 1024, sizeof(CNetObj_Projectile));
+			pProj->m_X = i * 100;
+			pProj->m_Y = -i * 100;
+			pProj->m_VelX = 100;
+			pProj->m_VelY = -50;
+			pProj->m_Type = i % 4;
+			pProj->m_StartTick = Tick - Tick % 20;
+		}
+		std::vector<char> vSnapshot(CSnapshot::MAX_SIZE);
+		vSnapshot.resize(Builder.Finish(vSnapshot.data()));
+		vvSnapshots.push_back(vSnapshot);
+	}
+	return vvSnapshots;
+}
+
+TEST(Snapshot, DeltaMatchesReference)
+{
+	const std::vector<std::vector<char>> vvSnapshots = GenerateSnapshots(500);
+	CSnapshotDelta Delta;
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE);
+	std::vector<char> vReference(CSnapshot::MAX_SIZE);
+	std::vector<char> vUnpacked(CSnapshot::MAX_SIZE);
+	std::vector<int> vFromIndexMemory(CSnapshotItemIndex::MAX_MEMORY_INTS);
+	std::vector<int> vToIndexMemory(CSnapshotItemIndex::MAX_MEMORY_INTS);
+
+	for(size_t i = 0; i < vvSnapshots.size(); i++)
+	{
+		// deltas against a few ticks back like against the last acked snapshot
+		for(size_t Back : {(size_t)1, (size_t)3, (size_t)25})
+		{
+			const CSnapshot *pFrom = i >= Back ? (const CSnapshot *)vvSnapshots[i - Back].data() : CSnapshot::EmptySnapshot();
+			const CSnapshot *pTo = (const CSnapshot *)vvSnapshots[i].data();
+
+			const int ReferenceSize = CreateDeltaReference(pFrom, pTo, vReference.data());
+			const int Size = Delta.CreateDelta(pFrom, pTo, vDelta.data());
+			ASSERT_EQ(Size, ReferenceSize) << i << " " << Back;
+			ASSERT_EQ(mem_comp(vDelta.data(), vReference.data(), Size), 0) << i << " " << Back;
+
+			// with cached item indices
+			CSnapshotItemIndex FromIndex;
+			CSnapshotItemIndex ToIndex;
+			FromIndex.Build(pFrom, vFromIndexMemory.data());
+			ToIndex.Build(pTo, vToIndexMemory.data());
+			ASSERT_EQ(Delta.CreateDelta(pFrom, pTo, vDelta.data(), &FromIndex, &ToIndex), ReferenceSize);
+			ASSERT_EQ(mem_comp(vDelta.data(), vReference.data(), Size), 0) << i << " " << Back;
+
+			if(Size)
+			{
+				const int UnpackedSize = Delta.UnpackDelta(pFrom, (CSnapshot *)vUnpacked.data(), vDelta.data(), Size, false);
+				// kept items come first, so only the order may differ
+				ASSERT_EQ(UnpackedSize, (int)vvSnapshots[i].size());
+				const CSnapshot *pUnpacked = (const CSnapshot *)vUnpacked.data();
+				ASSERT_EQ(pUnpacked->NumItems(), pTo->NumItems());
+				for(int j = 0; j < pTo->NumItems(); j++)
+				{
+					const int Index = pUnpacked->GetItemIndex(pTo->GetItem(j)->Key());
+					ASSERT_NE(Index, -1);
+					ASSERT_EQ(pUnpacked->GetItemSize(Index), pTo->GetItemSize(j));
+					ASSERT_EQ(mem_comp(pUnpacked->GetItem(Index)->Data(), pTo->GetItem(j)->Data(), pTo->GetItemSize(j)), 0);
+				}
+			}
+		}
+	}
+}
+
+TEST(Snapshot, DISABLED_BenchmarkDelta)
+{
+	const std::vector<std::vector<char>> vvSnapshots = GenerateSnapshots(500);
+	CSnapshotDelta Delta;
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE);
+	std::vector<int> vFromIndexMemory(CSnapshotItemIndex::MAX_MEMORY_INTS);
+	std::vector<int> vToIndexMemory(CSnapshotItemIndex::MAX_MEMORY_INTS);
+
+	const int Rounds = 10;
+	const auto &&Measure = [&](const char *pName, auto &&Function) {
+		const int64_t Start = time_get_impl();
+		for(int Round = 0; Round < Rounds; Round++)
+		{
+			for(size_t i = 0; i < vvSnapshots.size(); i++)
+			{
+				for(size_t Back : {(size_t)1, (size_t)3, (size_t)25})
+				{
+					const CSnapshot *pFrom = i >= Back ? (const CSnapshot *)vvSnapshots[i - Back].data() : CSnapshot::EmptySnapshot();
+					Function(pFrom, (const CSnapshot *)vvSnapshots[i].data());
+				}
+			}
+		}
+		const int64_t Duration = time_get_impl() - Start;
+		log_info("snapshot", "%s: %d deltas in %.2f ms", pName, (int)vvSnapshots.size() * 3 * Rounds, Duration * 1000.0 / time_freq());
+	};
+
+	Measure("reference", [&](const CSnapshot *pFrom, const CSnapshot *pTo) {
+		CreateDeltaReference(pFrom, pTo, vDelta.data());
+	});
+	Measure("delta", [&](const CSnapshot *pFrom, const CSnapshot *pTo) {
+		Delta.CreateDelta(pFrom, pTo, vDelta.data());
+	});
+	Measure("delta with item indices", [&](const CSnapshot *pFrom, const CSnapshot *pTo) {
+		CSnapshotItemIndex FromIndex;
+		CSnapshotItemIndex ToIndex;
+		FromIndex.Build(pFrom, vFromIndexMemory.data());
+		ToIndex.Build(pTo, vToIndexMemory.data());
+		Delta.CreateDelta(pFrom, pTo, vDelta.data(), &FromIndex, &ToIndex);
+	});
+}
+
+TEST(Snapshot, DiffItemTail)
+{
+	// sizes that don't fill whole vectors
+	for(int Size = 0; Size < 11; Size++)
+	{
+		int aPast[11];
+		int aCurrent[11];
+		int aDiff[11];
+		int aUndiffed[11];
+		for(int i = 0; i < Size; i++)
+		{
+			aPast[i] = (int)((unsigned)i * 0x10000001u);
+			aCurrent[i] = aPast[i];
+		}
+		EXPECT_FALSE(CSnapshotDelta::DiffItem(aPast, aCurrent, aDiff, Size));
+		if(Size == 0)
+			continue;
+		aCurrent[Size - 1] = -0x7fffffff;
+		EXPECT_TRUE(CSnapshotDelta::DiffItem(aPast, aCurrent, aDiff, Size));
+		for(int i = 0; i < Size; i++)
+			aUndiffed[i] = (unsigned)aPast[i] + (unsigned)aDiff[i];
+		EXPECT_EQ(mem_comp(aUndiffed, aCurrent, Size * sizeof(int)), 0);
+	}
+}
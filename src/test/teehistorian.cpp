@@ -3,6 +3,7 @@
 #include <engine/external/json-parser/json.h>
 #include <engine/server.h>
 #include <engine/shared/config.h>
+#include <engine/shared/teehistorian_compressed.h>
 
 #include <game/gamecore.h>
 #include <game/server/teehistorian.h>
@@ -24,6 +25,10 @@ protected:
 
 	std::vector<unsigned char> m_vBuffer;
 
+	// also writes the compressed container if set
+	std::unique_ptr<CTeeHistorianCompressedWriter> m_pCompressed;
+	std::vector<unsigned char> m_vCompressedBuffer;
+
 	enum
 	{
 		STATE_NONE,
@@ -95,6 +100,14 @@ protected:
 	{
 		TeeHistorian *pThis = (TeeHistorian *)pUser;
 		WriteBuffer(pThis->m_vBuffer, pData, DataSize);
+		if(pThis->m_pCompressed)
+			pThis->m_pCompressed->Write(pData, DataSize);
+	}
+
+	static void WriteCompressed(const void *pData, int DataSize, void *pUser)
+	{
+		TeeHistorian *pThis = (TeeHistorian *)pUser;
+		WriteBuffer(pThis->m_vCompressedBuffer, pData, DataSize);
 	}
 
 	void Reset(const CTeeHistorian::CGameInfo *pGameInfo)
@@ -190,6 +203,8 @@ protected:
 			m_TH.EndInputs();
 			m_TH.EndTick();
 		}
+		if(m_pCompressed)
+			m_pCompressed->BeginTick(Tick);
 		m_TH.BeginTick(Tick);
 		m_TH.BeginPlayers();
 		m_State = STATE_PLAYERS;
@@ -887,6 +902,27 @@ TEST_F(TeeHistorian, TeamFinish)
 	Expect(EXPECTED, sizeof(EXPECTED));
 }
 
+TEST_F(TeeHistorian, InputStats)
+{
+	const unsigned char EXPECTED[] = {
+		// EX uuid=4cf23603-9353-3c77-8cea-b30f516cb4bb datalen=7
+		0x4a,
+		0x4c, 0xf2, 0x36, 0x03, 0x93, 0x53, 0x3c, 0x77,
+		0x8c, 0xea, 0xb3, 0x0f, 0x51, 0x6c, 0xb4, 0xbb,
+		0x07,
+		// (INPUT_STATS) cid=3 inputs=1000 late=2 too_early=1 duplicate=0 missing=5
+		0x03, 0xa8, 0x0f, 0x02, 0x01, 0x00, 0x05};
+
+	IServer::CInputStats Stats;
+	Stats.m_NumInputs = 1000;
+	Stats.m_NumLate = 2;
+	Stats.m_NumTooEarly = 1;
+	Stats.m_NumDuplicate = 0;
+	Stats.m_NumMissing = 5;
+	m_TH.RecordInputStats(3, Stats);
+	Expect(EXPECTED, sizeof(EXPECTED));
+}
+
 TEST_F(TeeHistorian, PrevGameUuid)
 {
 	m_GameInfo.m_HavePrevGameUuid = true;
@@ -906,3 +942,68 @@ TEST_F(TeeHistorian, PrevGameUuid)
 	EXPECT_STREQ(JsonPrevGameUuid, "fe19c218-f555-4002-a273-126c59ccc17a");
 	json_value_free(pJson);
 }
+
+TEST_F(TeeHistorian, Compressed)
+{
+	m_pCompressed = std::make_unique<CTeeHistorianCompressedWriter>(WriteCompressed, this, 512);
+	Reset(&m_GameInfo);
+
+	std::vector<size_t> vTickOffsets(1);
+	for(int t = 1; t <= 2000; t++)
+	{
+		if(t % 100 == 0)
+			m_pCompressed->Flush();
+		Tick(t);
+		vTickOffsets.push_back(m_vBuffer.size());
+		Player(0, t, t * 2);
+		Player(1, t % 7, 100);
+	}
+	Finish();
+	m_pCompressed->Finish();
+	EXPECT_FALSE(m_pCompressed->Error());
+	EXPECT_EQ(m_pCompressed->UncompressedSize(), (int64_t)m_vBuffer.size());
+
+	CTeeHistorianCompressedReader Reader;
+	ASSERT_TRUE(Reader.Open(m_vCompressedBuffer.data(), m_vCompressedBuffer.size()));
+	EXPECT_FALSE(Reader.Truncated());
+	EXPECT_GT(Reader.NumBlocks(), 20);
+	std::vector<unsigned char> vData;
+	ASSERT_TRUE(Reader.ReadAll(&vData));
+	EXPECT_EQ(vData, m_vBuffer);
+	EXPECT_LT(m_vCompressedBuffer.size(), m_vBuffer.size());
+
+	// the found block holds the start of the tick
+	for(int t = 1; t <= 2000; t++)
+	{
+		const int Block = Reader.FindBlock(t);
+		ASSERT_GE(Block, 0) << t;
+		EXPECT_LE(Reader.BlockUncompressedOffset(Block), (int64_t)vTickOffsets[t]) << t;
+		if(Block + 1 < Reader.NumBlocks())
+		{
+			EXPECT_GE(Reader.BlockUncompressedOffset(Block + 1), (int64_t)vTickOffsets[t]) << t;
+		}
+	}
+
+	// cut off in the middle of the last block, as if the server crashed
+	const size_t LastBlockOffset = m_vCompressedBuffer.size() - 20 * (Reader.NumBlocks() + 1) - 12 - 10;
+	CTeeHistorianCompressedReader Truncated;
+	ASSERT_TRUE(Truncated.Open(m_vCompressedBuffer.data(), LastBlockOffset));
+	EXPECT_TRUE(Truncated.Truncated());
+	EXPECT_EQ(Truncated.NumBlocks(), Reader.NumBlocks() - 1);
+	vData.clear();
+	ASSERT_TRUE(Truncated.ReadAll(&vData));
+	ASSERT_EQ(vData.size(), (size_t)Reader.BlockUncompressedOffset(Reader.NumBlocks() - 1));
+	EXPECT_TRUE(std::equal(vData.begin(), vData.end(), m_vBuffer.begin()));
+
+	// a block claiming a huge uncompressed size isn't allocated
+	std::vector<unsigned char> vCorrupt = m_vCompressedBuffer;
+	uint_to_bytes_be(vCorrupt.data() + sizeof(CUuid) + 12, 0xffffffff);
+	CTeeHistorianCompressedReader Corrupt;
+	ASSERT_TRUE(Corrupt.Open(vCorrupt.data(), vCorrupt.size()));
+	vData.clear();
+	EXPECT_FALSE(Corrupt.ReadBlock(0, &vData));
+	EXPECT_TRUE(vData.empty());
+	EXPECT_TRUE(Corrupt.ReadBlock(1, &vData));
+
+	EXPECT_FALSE(CTeeHistorianCompressedReader::IsCompressed(m_vBuffer.data(), m_vBuffer.size()));
+}
@@ -0,0 +1,59 @@
+#include <base/logger.h>
+#include <base/system.h>
+
+#include <engine/shared/teehistorian_compressed.h>
+
+#include <vector>
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+	if(argc != 3)
+	{
+		dbg_msg("usage", "%s <compressed teehistorian> <output teehistorian>", argv[0]);
+		return -1;
+	}
+
+	IOHANDLE InputFile = io_open(argv[1], IOFLAG_READ);
+	void *pData;
+	unsigned DataSize;
+	const bool ReadSuccess = InputFile && io_read_all(InputFile, &pData, &DataSize);
+	if(InputFile)
+		io_close(InputFile);
+	if(!ReadSuccess)
+	{
+		log_error("teehistorian_decompress", "failed to read '%s'", argv[1]);
+		return -1;
+	}
+
+	CTeeHistorianCompressedReader Reader;
+	std::vector<unsigned char> vData;
+	bool Success = Reader.Open(pData, DataSize);
+	if(!Success)
+	{
+		log_error("teehistorian_decompress", "'%s' is not a compressed teehistorian file", argv[1]);
+	}
+	else
+	{
+		if(Reader.Truncated())
+			log_warn("teehistorian_decompress", "'%s' wasn't finished, only reading complete blocks", argv[1]);
+		Success = Reader.ReadAll(&vData);
+		if(!Success)
+			log_error("teehistorian_decompress", "failed to decompress '%s'", argv[1]);
+	}
+	free(pData);
+	if(!Success)
+		return -1;
+
+	IOHANDLE File = io_open(argv[2], IOFLAG_WRITE);
+	if(!File)
+	{
+		log_error("teehistorian_decompress", "failed to open '%s' for writing", argv[2]);
+		return -1;
+	}
+	io_write(File, vData.data(), vData.size());
+	io_close(File);
+	log_info("teehistorian_decompress", "wrote %d blocks, %d bytes to '%s'", Reader.NumBlocks(), (int)vData.size(), argv[2]);
+	return 0;
+}